@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "log.h"
+
+/**
+   Minimal size of arena chunk in bytes.
+*/
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+
+static struct __ArenaChunk * _arena_chunk_new(size_t size);
+
+
+void * arena_alloc(Arena * arena, size_t size)
+{
+	/* Keep every object aligned like max_align_t */
+	size_t aligned = (size + alignof(max_align_t) - 1) &
+		~(alignof(max_align_t) - 1);
+	if(aligned < size)
+	{
+		log_write(LOG_ERR, "Cannot allocate %lu bytes from arena", size);
+		return NULL;
+	}
+
+	struct __ArenaChunk * chunk = arena->_chunks;
+	if(chunk == NULL || chunk->size - chunk->used < aligned)
+	{
+		if((chunk = _arena_chunk_new(aligned > ARENA_CHUNK_SIZE ?
+									 aligned : ARENA_CHUNK_SIZE)) == NULL)
+		{
+			return NULL;
+		}
+		chunk->next = arena->_chunks;
+		arena->_chunks = chunk;
+	}
+
+	void * memory = (uint8_t *)chunk->data + chunk->used;
+	chunk->used += aligned;
+	arena->allocated += aligned;
+	memset(memory, 0, size);
+	return memory;
+}
+
+char * arena_strdup(Arena * arena, const char * string)
+{
+	size_t length = strlen(string);
+	char * copy;
+	if((copy = arena_alloc(arena, length + 1)) == NULL)
+	{
+		return NULL;
+	}
+	memcpy(copy, string, length);
+	return copy;
+}
+
+void arena_reset(Arena * arena)
+{
+	struct __ArenaChunk * chunk = arena->_chunks;
+	if(chunk != NULL && chunk->next == NULL)
+	{
+		chunk->used = 0;
+		arena->allocated = 0;
+		return;
+	}
+
+	/* Replace all chunks with one chunk, enough for the whole previous
+	   cycle */
+	size_t size = 0;
+	for(; chunk != NULL; chunk = chunk->next)
+	{
+		size += chunk->size;
+	}
+	arena_free(arena);
+	if(size > 0)
+	{
+		arena->_chunks = _arena_chunk_new(size);
+	}
+}
+
+void arena_free(Arena * arena)
+{
+	struct __ArenaChunk * chunk = arena->_chunks;
+	while(chunk != NULL)
+	{
+		struct __ArenaChunk * next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	arena->_chunks = NULL;
+	arena->allocated = 0;
+}
+
+
+/**
+   Allocate new chunk of memory for arena.
+
+   @param[in] size Size of memory for objects in bytes.
+   @return New empty chunk or NULL on error.
+*/
+static struct __ArenaChunk * _arena_chunk_new(size_t size)
+{
+	struct __ArenaChunk * chunk;
+	if(size > SIZE_MAX - sizeof(struct __ArenaChunk) ||
+	   (chunk = malloc(sizeof(struct __ArenaChunk) + size)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate %lu bytes for arena: %s", size,
+				  strerror(errno));
+		return NULL;
+	}
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
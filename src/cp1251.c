@@ -0,0 +1,372 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "cp1251.h"
+
+
+/**
+   Unicode code points for CP1251 characters from 0x80 to 0xff.
+   Zero for undefined character.
+*/
+static const uint16_t cp1251ToUnicode[128] = {
+	0x0402, 0x0403, 0x201a, 0x0453, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x20ac, 0x2030, 0x0409, 0x2039, 0x040a, 0x040c, 0x040b, 0x040f,
+	0x0452, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x0000, 0x2122, 0x0459, 0x203a, 0x045a, 0x045c, 0x045b, 0x045f,
+	0x00a0, 0x040e, 0x045e, 0x0408, 0x00a4, 0x0490, 0x00a6, 0x00a7,
+	0x0401, 0x00a9, 0x0404, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x0407,
+	0x00b0, 0x00b1, 0x0406, 0x0456, 0x0491, 0x00b5, 0x00b6, 0x00b7,
+	0x0451, 0x2116, 0x0454, 0x00bb, 0x0458, 0x0405, 0x0455, 0x0457,
+	0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+	0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+	0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+	0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+	0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+	0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+	0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+	0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+};
+
+/**
+   Map Unicode code point to CP1251 character.
+*/
+struct __UnicodeToCp1251
+{
+	uint16_t unicode; /**< Unicode code point */
+	uint8_t cp1251;   /**< CP1251 character */
+};
+
+/**
+   CP1251 characters from 0x80 to 0xbf, sorted by Unicode code point.
+   Letters from 0xc0 to 0xff are mapped to U+0410..U+044F directly.
+*/
+static const struct __UnicodeToCp1251 unicodeToCp1251[] = {
+	{0x00a0, 0xa0}, {0x00a4, 0xa4}, {0x00a6, 0xa6}, {0x00a7, 0xa7},
+	{0x00a9, 0xa9}, {0x00ab, 0xab}, {0x00ac, 0xac}, {0x00ad, 0xad},
+	{0x00ae, 0xae}, {0x00b0, 0xb0}, {0x00b1, 0xb1}, {0x00b5, 0xb5},
+	{0x00b6, 0xb6}, {0x00b7, 0xb7}, {0x00bb, 0xbb}, {0x0401, 0xa8},
+	{0x0402, 0x80}, {0x0403, 0x81}, {0x0404, 0xaa}, {0x0405, 0xbd},
+	{0x0406, 0xb2}, {0x0407, 0xaf}, {0x0408, 0xa3}, {0x0409, 0x8a},
+	{0x040a, 0x8c}, {0x040b, 0x8e}, {0x040c, 0x8d}, {0x040e, 0xa1},
+	{0x040f, 0x8f}, {0x0451, 0xb8}, {0x0452, 0x90}, {0x0453, 0x83},
+	{0x0454, 0xba}, {0x0455, 0xbe}, {0x0456, 0xb3}, {0x0457, 0xbf},
+	{0x0458, 0xbc}, {0x0459, 0x9a}, {0x045a, 0x9c}, {0x045b, 0x9e},
+	{0x045c, 0x9d}, {0x045e, 0xa2}, {0x045f, 0x9f}, {0x0490, 0xa5},
+	{0x0491, 0xb4}, {0x2013, 0x96}, {0x2014, 0x97}, {0x2018, 0x91},
+	{0x2019, 0x92}, {0x201a, 0x82}, {0x201c, 0x93}, {0x201d, 0x94},
+	{0x201e, 0x84}, {0x2020, 0x86}, {0x2021, 0x87}, {0x2022, 0x95},
+	{0x2026, 0x85}, {0x2030, 0x89}, {0x2039, 0x8b}, {0x203a, 0x9b},
+	{0x20ac, 0x88}, {0x2116, 0xb9}, {0x2122, 0x99},
+};
+
+/**
+   First Unicode code point of continuous range of Cyrillic letters.
+*/
+#define CYRILLIC_START 0x0410
+/**
+   Last Unicode code point of continuous range of Cyrillic letters.
+*/
+#define CYRILLIC_END   0x044f
+/**
+   CP1251 character for CYRILLIC_START.
+*/
+#define CP1251_CYRILLIC_START 0xc0
+
+
+static size_t _ascii_run(const uint8_t * string, size_t length);
+static int _compare_unicode(const void * key, const void * element);
+static int _unicode_to_cp1251(uint32_t unicode, uint8_t * result);
+static size_t _utf8_decode(const uint8_t * string, size_t length,
+						   uint32_t * unicode);
+
+
+size_t cp1251_to_utf8_length(const char * string, size_t length)
+{
+	const uint8_t * in = (const uint8_t *)string;
+	size_t result = 0;
+	size_t i = 0;
+	while(i < length)
+	{
+		size_t run = _ascii_run(in + i, length - i);
+		result += run;
+		i += run;
+		if(i == length)
+		{
+			break;
+		}
+
+		uint16_t unicode = cp1251ToUnicode[in[i] - 0x80];
+		if(unicode == 0)
+		{
+			return CP1251_ERROR;
+		}
+		result += unicode < 0x0800 ? 2 : 3;
+		i++;
+	}
+	return result;
+}
+
+size_t cp1251_to_utf8(const char * string, size_t length, char * out,
+					  size_t outSize)
+{
+	const uint8_t * in = (const uint8_t *)string;
+	size_t position = 0;
+	size_t i = 0;
+	while(i < length)
+	{
+		size_t run = _ascii_run(in + i, length - i);
+		if(position + run >= outSize)
+		{
+			return CP1251_ERROR;
+		}
+		memcpy(out + position, in + i, run);
+		position += run;
+		i += run;
+		if(i == length)
+		{
+			break;
+		}
+
+		uint16_t unicode = cp1251ToUnicode[in[i] - 0x80];
+		if(unicode == 0)
+		{
+			return CP1251_ERROR;
+		}
+		if(unicode < 0x0800)
+		{
+			if(position + 2 >= outSize)
+			{
+				return CP1251_ERROR;
+			}
+			out[position++] = (char)(0xc0 | (unicode >> 6));
+			out[position++] = (char)(0x80 | (unicode & 0x3f));
+		}
+		else
+		{
+			if(position + 3 >= outSize)
+			{
+				return CP1251_ERROR;
+			}
+			out[position++] = (char)(0xe0 | (unicode >> 12));
+			out[position++] = (char)(0x80 | ((unicode >> 6) & 0x3f));
+			out[position++] = (char)(0x80 | (unicode & 0x3f));
+		}
+		i++;
+	}
+
+	if(position >= outSize)
+	{
+		return CP1251_ERROR;
+	}
+	out[position] = '\0';
+	return position;
+}
+
+size_t utf8_to_cp1251_length(const char * string, size_t length)
+{
+	const uint8_t * in = (const uint8_t *)string;
+	size_t result = 0;
+	size_t i = 0;
+	while(i < length)
+	{
+		size_t run = _ascii_run(in + i, length - i);
+		result += run;
+		i += run;
+		if(i == length)
+		{
+			break;
+		}
+
+		uint32_t unicode;
+		uint8_t cp1251;
+		size_t sequenceLength = _utf8_decode(in + i, length - i, &unicode);
+		if(sequenceLength == 0 || _unicode_to_cp1251(unicode, &cp1251))
+		{
+			return CP1251_ERROR;
+		}
+		result++;
+		i += sequenceLength;
+	}
+	return result;
+}
+
+size_t utf8_to_cp1251(const char * string, size_t length, char * out,
+					  size_t outSize)
+{
+	const uint8_t * in = (const uint8_t *)string;
+	size_t position = 0;
+	size_t i = 0;
+	while(i < length)
+	{
+		size_t run = _ascii_run(in + i, length - i);
+		if(position + run >= outSize)
+		{
+			return CP1251_ERROR;
+		}
+		memcpy(out + position, in + i, run);
+		position += run;
+		i += run;
+		if(i == length)
+		{
+			break;
+		}
+
+		uint32_t unicode;
+		uint8_t cp1251;
+		size_t sequenceLength = _utf8_decode(in + i, length - i, &unicode);
+		if(sequenceLength == 0 || _unicode_to_cp1251(unicode, &cp1251) ||
+		   position + 1 >= outSize)
+		{
+			return CP1251_ERROR;
+		}
+		out[position++] = (char)cp1251;
+		i += sequenceLength;
+	}
+
+	if(position >= outSize)
+	{
+		return CP1251_ERROR;
+	}
+	out[position] = '\0';
+	return position;
+}
+
+
+/**
+   Returns length of run of ASCII characters at the start of string.
+
+   @param[in] string String.
+   @param[in] length Length of string in bytes.
+   @return Count of bytes below 0x80 at the start of string.
+*/
+static size_t _ascii_run(const uint8_t * string, size_t length)
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	for(; i + 16 <= length; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(string + i));
+		int mask = _mm_movemask_epi8(chunk);
+		if(mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#else
+	for(; i + 8 <= length; i += 8)
+	{
+		uint64_t chunk;
+		memcpy(&chunk, string + i, 8);
+		if(chunk & 0x8080808080808080ULL)
+		{
+			break;
+		}
+	}
+#endif
+	while(i < length && string[i] < 0x80)
+	{
+		i++;
+	}
+	return i;
+}
+
+static int _compare_unicode(const void * key, const void * element)
+{
+	uint32_t unicode = *(const uint32_t *)key;
+	uint16_t elementUnicode =
+		((const struct __UnicodeToCp1251 *)element)->unicode;
+	if(unicode < elementUnicode)
+	{
+		return -1;
+	}
+	else if(unicode == elementUnicode)
+	{
+		return 0;
+	}
+	else
+	{
+		return 1;
+	}
+}
+
+/**
+   Find CP1251 character for non-ASCII Unicode code point.
+
+   @param[in] unicode Unicode code point.
+   @param[out] result CP1251 character.
+   @return 0 on success or -1 if there is no such character in CP1251.
+*/
+static int _unicode_to_cp1251(uint32_t unicode, uint8_t * result)
+{
+	if(unicode >= CYRILLIC_START && unicode <= CYRILLIC_END)
+	{
+		*result = CP1251_CYRILLIC_START + (unicode - CYRILLIC_START);
+		return 0;
+	}
+
+	const struct __UnicodeToCp1251 * found = bsearch(
+		&unicode, unicodeToCp1251,
+		sizeof(unicodeToCp1251) / sizeof(unicodeToCp1251[0]),
+		sizeof(struct __UnicodeToCp1251), _compare_unicode);
+	if(found == NULL)
+	{
+		return -1;
+	}
+	*result = found->cp1251;
+	return 0;
+}
+
+/**
+   Decode one non-ASCII UTF8 sequence.
+
+   @param[in] string Start of UTF8 sequence.
+   @param[in] length Count of bytes available.
+   @param[out] unicode Decoded Unicode code point.
+   @return Length of sequence in bytes or 0 if sequence is malformed.
+*/
+static size_t _utf8_decode(const uint8_t * string, size_t length,
+						   uint32_t * unicode)
+{
+	size_t sequenceLength;
+	uint32_t minimum;
+	if((string[0] & 0xe0) == 0xc0)
+	{
+		sequenceLength = 2;
+		minimum = 0x80;
+		*unicode = string[0] & 0x1f;
+	}
+	else if((string[0] & 0xf0) == 0xe0)
+	{
+		sequenceLength = 3;
+		minimum = 0x800;
+		*unicode = string[0] & 0x0f;
+	}
+	else if((string[0] & 0xf8) == 0xf0)
+	{
+		sequenceLength = 4;
+		minimum = 0x10000;
+		*unicode = string[0] & 0x07;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if(sequenceLength > length)
+	{
+		return 0;
+	}
+	for(size_t i = 1; i < sequenceLength; i++)
+	{
+		if((string[i] & 0xc0) != 0x80)
+		{
+			return 0;
+		}
+		*unicode = (*unicode << 6) | (string[i] & 0x3f);
+	}
+	return *unicode < minimum ? 0 : sequenceLength;
+}
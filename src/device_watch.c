@@ -0,0 +1,201 @@
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include "device_watch.h"
+#include "log.h"
+
+
+#if defined(__linux__)
+/**
+   Size of buffer for inotify events.
+*/
+#define DEVICE_EVENTS_BUFFER_LEN (16 * (sizeof(struct inotify_event) + \
+										NAME_MAX + 1))
+
+static int _device_wait(const char * device, int timeout, bool appear,
+						int eventFd);
+static int _device_remaining_ms(struct timespec * deadline);
+#endif
+
+
+int device_wait_appear(const char * device, int timeout, int eventFd)
+{
+#if defined(__linux__)
+	return _device_wait(device, timeout, true, eventFd);
+#else
+	return -1;
+#endif
+}
+
+int device_wait_disappear(const char * device, int timeout)
+{
+#if defined(__linux__)
+	return _device_wait(device, timeout, false, -1);
+#else
+	return -1;
+#endif
+}
+
+
+#if defined(__linux__)
+/**
+   Wait for device creation or removal with inotify.
+
+   Watch is added to the directory with device before checking device
+   existence, so event will not be lost between check and wait.
+
+   @param[in] device Path to symbolic device.
+   @param[in] timeout Maximal time to wait in seconds.
+   @param[in] appear Wait for creation if true, otherwise wait for removal.
+   @param[in] eventFd Descriptor to stop waiting when it becomes readable,
+   or -1.
+   @return 0 if device appeared/disappeared, 1 on timeout, signal or event
+   on eventFd, -1 if device cannot be watched or (for appear) already
+   exists.
+*/
+static int _device_wait(const char * device, int timeout, bool appear,
+						int eventFd)
+{
+	const char * name = strrchr(device, '/');
+	if(device[0] != '/' || name == NULL || name[1] == '\0')
+	{
+		log_write(LOG_DEBUG, "Cannot watch %s, it is not a path", device);
+		return -1;
+	}
+
+	char * directory;
+	if((directory = strndup(device, name == device ? 1 : name - device)) ==
+	   NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for directory of %s: %s",
+				  device, strerror(errno));
+		return -1;
+	}
+	name++;
+
+	int fd;
+	if((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		log_write(LOG_WARNING, "Cannot initialize inotify: %s",
+				  strerror(errno));
+		free(directory);
+		return -1;
+	}
+	uint32_t mask = appear ? IN_CREATE | IN_MOVED_TO :
+		IN_DELETE | IN_MOVED_FROM;
+	if(inotify_add_watch(fd, directory, mask) == -1)
+	{
+		log_write(LOG_WARNING, "Cannot watch %s directory: %s", directory,
+				  strerror(errno));
+		free(directory);
+		close(fd);
+		return -1;
+	}
+	free(directory);
+
+	bool exists = access(device, F_OK) == 0;
+	if(appear && exists)
+	{
+		close(fd);
+		return -1;
+	}
+	if(!appear && !exists)
+	{
+		close(fd);
+		return 0;
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout;
+
+	int result = 1;
+	struct pollfd pfd[2] = {
+		{.fd = fd, .events = POLLIN},
+		{.fd = eventFd, .events = POLLIN}
+	};
+	char buffer[DEVICE_EVENTS_BUFFER_LEN]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	while(result == 1)
+	{
+		int remaining = _device_remaining_ms(&deadline);
+		int ready = remaining > 0 ?
+			poll(pfd, eventFd != -1 ? 2 : 1, remaining) : 0;
+		if(ready == -1)
+		{
+			if(errno != EINTR)
+			{
+				log_write(LOG_ERR, "Cannot wait for %s: %s", device,
+						  strerror(errno));
+			}
+			break;
+		}
+		if(ready == 0)
+		{
+			log_write(LOG_DEBUG, "Timeout when waiting %s to %s", device,
+					  appear ? "appear" : "disappear");
+			break;
+		}
+
+		ssize_t length;
+		while((length = read(fd, buffer, sizeof(buffer))) > 0)
+		{
+			for(char * event = buffer; event < buffer + length;
+				event += sizeof(struct inotify_event) +
+					((struct inotify_event *)event)->len)
+			{
+				struct inotify_event * ievent = (struct inotify_event *)event;
+				if(ievent->mask & IN_Q_OVERFLOW)
+				{
+					/* Some events are lost, check device directly */
+					if((access(device, F_OK) == 0) == appear)
+					{
+						result = 0;
+					}
+				}
+				else if(ievent->len > 0 && strcmp(ievent->name, name) == 0)
+				{
+					result = 0;
+				}
+			}
+		}
+		if(pfd[1].revents)
+		{
+			break;
+		}
+	}
+
+	close(fd);
+	if(result == 0)
+	{
+		log_write(LOG_DEBUG, "Device %s %s", device,
+				  appear ? "appeared" : "disappeared");
+	}
+	return result;
+}
+
+/**
+   Returns milliseconds until deadline.
+
+   @param[in] deadline Deadline on CLOCK_MONOTONIC.
+   @return Milliseconds until deadline or 0 if deadline passed.
+*/
+static int _device_remaining_ms(struct timespec * deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long remaining = (deadline->tv_sec - now.tv_sec) * 1000LL +
+		(deadline->tv_nsec - now.tv_nsec) / 1000000;
+	return remaining > 0 ? (int)remaining : 0;
+}
+#endif
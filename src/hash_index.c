@@ -0,0 +1,218 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_index.h"
+#include "log.h"
+
+/**
+   Minimal qty of slots in hash index.
+*/
+#define HASH_INDEX_MIN_CAPACITY 16
+
+/**
+   Marker of removed element.
+*/
+static char __tombstone;
+#define HASH_INDEX_TOMBSTONE ((void *)&__tombstone)
+
+
+static size_t _hash_index_capacity(size_t qty);
+static size_t _hash_index_slot(HashIndex * index, uint64_t key);
+static int _hash_index_resize(HashIndex * index, size_t capacity);
+
+
+int hash_index_init(HashIndex * index, size_t qty)
+{
+	index->count = 0;
+	index->_used = 0;
+	index->_capacity = _hash_index_capacity(qty);
+	if((index->_slots = calloc(index->_capacity,
+							   sizeof(struct __HashIndexSlot))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for hash index with %lu "
+				  "slots: %s", index->_capacity, strerror(errno));
+		index->_capacity = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void hash_index_free(HashIndex * index)
+{
+	free(index->_slots);
+	index->_slots = NULL;
+	index->_capacity = 0;
+	index->_used = 0;
+	index->count = 0;
+}
+
+int hash_index_insert(HashIndex * index, uint64_t key, void * value)
+{
+	if(value == NULL)
+	{
+		log_write(LOG_ERR, "Cannot insert NULL value to hash index");
+		return -1;
+	}
+
+	/* Keep load factor (with tombstones) below 0.7 */
+	if((index->_used + 1) * 10 > index->_capacity * 7)
+	{
+		size_t capacity = _hash_index_capacity(index->count + 1);
+		if(_hash_index_resize(index, capacity))
+		{
+			return -1;
+		}
+	}
+
+	size_t mask = index->_capacity - 1;
+	size_t slot = _hash_index_slot(index, key);
+	while(index->_slots[slot].value != NULL &&
+		  index->_slots[slot].value != HASH_INDEX_TOMBSTONE)
+	{
+		slot = (slot + 1) & mask;
+	}
+	if(index->_slots[slot].value == NULL)
+	{
+		index->_used++;
+	}
+	index->_slots[slot].key = key;
+	index->_slots[slot].value = value;
+	index->count++;
+	return 0;
+}
+
+int hash_index_remove(HashIndex * index, uint64_t key, void * value)
+{
+	if(index->_capacity == 0)
+	{
+		return -1;
+	}
+
+	size_t mask = index->_capacity - 1;
+	size_t slot = _hash_index_slot(index, key);
+	while(index->_slots[slot].value != NULL)
+	{
+		if(index->_slots[slot].value == value &&
+		   index->_slots[slot].key == key)
+		{
+			index->_slots[slot].value = HASH_INDEX_TOMBSTONE;
+			index->count--;
+			return 0;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+void * hash_index_find(HashIndex * index, uint64_t key, size_t * cursor)
+{
+	if(index->_capacity == 0)
+	{
+		return NULL;
+	}
+
+	size_t mask = index->_capacity - 1;
+	while(*cursor < index->_capacity)
+	{
+		size_t slot = (_hash_index_slot(index, key) + *cursor) & mask;
+		(*cursor)++;
+
+		if(index->_slots[slot].value == NULL)
+		{
+			*cursor = index->_capacity;
+			return NULL;
+		}
+		if(index->_slots[slot].value != HASH_INDEX_TOMBSTONE &&
+		   index->_slots[slot].key == key)
+		{
+			return index->_slots[slot].value;
+		}
+	}
+	return NULL;
+}
+
+
+/**
+   Returns qty of slots, enough to store given qty of elements.
+
+   @param[in] qty Qty of elements.
+   @return Power of two qty of slots.
+*/
+static size_t _hash_index_capacity(size_t qty)
+{
+	size_t capacity = HASH_INDEX_MIN_CAPACITY;
+	while(capacity * 7 < qty * 10 * 2)
+	{
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+/**
+   Returns first slot to probe for given key.
+
+   Keys may be sequential record IDs, so they are mixed with splitmix64
+   finalizer before use.
+
+   @param[in] index Hash index.
+   @param[in] key Key.
+   @return Slot number.
+*/
+static size_t _hash_index_slot(HashIndex * index, uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111eb;
+	key ^= key >> 31;
+	return key & (index->_capacity - 1);
+}
+
+/**
+   Move all elements of hash index to the new slots.
+
+   Tombstones are dropped.
+
+   @param[in] index Hash index.
+   @param[in] capacity New qty of slots.
+   @return 0 on success or -1 on error.
+*/
+static int _hash_index_resize(HashIndex * index, size_t capacity)
+{
+	struct __HashIndexSlot * slots;
+	if((slots = calloc(capacity, sizeof(struct __HashIndexSlot))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for hash index with %lu "
+				  "slots: %s", capacity, strerror(errno));
+		return -1;
+	}
+
+	struct __HashIndexSlot * oldSlots = index->_slots;
+	size_t oldCapacity = index->_capacity;
+	index->_slots = slots;
+	index->_capacity = capacity;
+	index->_used = 0;
+	index->count = 0;
+
+	size_t mask = capacity - 1;
+	for(size_t i = 0; i < oldCapacity; i++)
+	{
+		if(oldSlots[i].value == NULL ||
+		   oldSlots[i].value == HASH_INDEX_TOMBSTONE)
+		{
+			continue;
+		}
+		size_t slot = _hash_index_slot(index, oldSlots[i].key);
+		while(slots[slot].value != NULL)
+		{
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = oldSlots[i];
+		index->_used++;
+		index->count++;
+	}
+
+	free(oldSlots);
+	return 0;
+}
@@ -1,114 +1,49 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* For copy_file_range() */
+#endif
 #include <errno.h>
 #include <fcntl.h>
-#include <iconv.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(__FreeBSD__)
+#include <sys/param.h>
+#endif
 
+#include "cp1251.h"
 #include "helper.h"
 #include "log.h"
 #include "umash.h"
 
 
-#if defined (__FreeBSD__)
-#define UTF8 "UTF-8"
-#else
-#define UTF8 "UTF8"
-#endif
-#define CP1251 "CP1251"
+static char * _iconv_utf8_to_cp1251(Arena * arena, const char * string);
+static char * _iconv_cp1251_to_utf8(Arena * arena, const char * string);
 
 
 char * iconv_utf8_to_cp1251(char * string)
 {
-	iconv_t iconvfd;
-	if((iconvfd = iconv_open(CP1251, UTF8)) == (iconv_t)-1)
-	{
-		log_write(LOG_ERR, "Cannot initialize UTF8->CP1251 convertor: %s",
-				  strerror(errno));
-		return NULL;
-	}
-
-	char * inString = string;
-	size_t inStringLen = strlen(string);
-	size_t outStringLen = inStringLen * 2; /* 1 cyrillic symbol == 2 bytes */
-	char * outString;
-	if((outString = calloc(outStringLen, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate memory for converted string: %s",
-				  strerror(errno));
-		if(iconv_close(iconvfd) == -1)
-		{
-			log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-		}
-		return NULL;
-	}
-
-	char * result = outString;
-	if(iconv(iconvfd, &inString, &inStringLen,
-			 &outString, &outStringLen) == (size_t)-1)
-	{
-		log_write(LOG_ERR, "Failed to convert UTF8 string \"%s\" to CP1251: %s",
-				  string, strerror(errno));
-		if(iconv_close(iconvfd) == -1)
-		{
-			log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-		}
-		free(outString);
-		return NULL;
-	}
-
-	if(iconv_close(iconvfd) == -1)
-	{
-		log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-	}
-	return result;
+	return _iconv_utf8_to_cp1251(NULL, string);
 }
 
 char * iconv_cp1251_to_utf8(char * string)
 {
-	iconv_t iconvfd;
-	if((iconvfd = iconv_open(UTF8, CP1251)) == (iconv_t)-1)
-	{
-		log_write(LOG_ERR, "Cannot initialize CP1251->UTF8 convertor: %s",
-				  strerror(errno));
-		return NULL;
-	}
-
-	char * inString = string;
-	size_t inStringLen = strlen(string);
-	size_t outStringLen = inStringLen * 2;
-	char * outString;
-	if((outString = calloc(outStringLen, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate memory for converted string: %s",
-				  strerror(errno));
-		if(iconv_close(iconvfd) == -1)
-		{
-			log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-		}
-		return NULL;
-	}
+	return _iconv_cp1251_to_utf8(NULL, string);
+}
 
-	char * result = outString;
-	if(iconv(iconvfd, &inString, &inStringLen,
-			 &outString, &outStringLen) == (size_t)-1)
-	{
-		log_write(LOG_ERR, "Failed to convert CP1251 string \"%s\" to UTF8: %s",
-				  string, strerror(errno));
-		if(iconv_close(iconvfd) == -1)
-		{
-			log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-		}
-		free(outString);
-		return NULL;
-	}
+char * iconv_utf8_to_cp1251_arena(Arena * arena, const char * string)
+{
+	return _iconv_utf8_to_cp1251(arena, string);
+}
 
-	if(iconv_close(iconvfd) == -1)
-	{
-		log_write(LOG_ERR, "Cannot close iconv: %s", strerror(errno));
-	}
-	return result;
+char * iconv_cp1251_to_utf8_arena(Arena * arena, const char * string)
+{
+	return _iconv_cp1251_to_utf8(arena, string);
 }
 
 int read_chunks(int fd, char * buf, unsigned int length)
@@ -164,16 +99,55 @@ int write_chunks(int fd, char * buf, unsigned int length)
 	return 0;
 }
 
+/**
+   Seed to derive UMASH parameters.
+*/
+#define HASH_PARAMS_SEED 0xc328ec6a247b1455
+/**
+   Seed for UMASH hash-function.
+*/
+#define HASH_SEED 0x18af24e667bbd865
+
+/**
+   UMASH parameters, derived once per process.
+*/
+static struct umash_params hashParams;
+/**
+   True if hashParams are derived.
+*/
+static bool hashParamsReady = false;
+
+
+void str_hash_init()
+{
+	if(!hashParamsReady)
+	{
+		umash_params_derive(&hashParams, HASH_PARAMS_SEED, NULL);
+		hashParamsReady = true;
+	}
+}
+
 uint64_t str_hash(char * buf, size_t length)
 {
-	/* Prepare configuration for UMASH hash-function */
-	static uint64_t seed1 = 0xc328ec6a247b1455;
-	static uint64_t seed2 = 0x18af24e667bbd865;
-	struct umash_params umashp;
-	umash_params_derive(&umashp, seed1, NULL);
-	return umash_full(&umashp, seed2, 0, buf, length);
+	str_hash_init();
+	return umash_full(&hashParams, HASH_SEED, 0, buf, length);
 }
 
+void str_hash_batch(const HashString * strings, size_t qty, uint64_t * hashes)
+{
+	str_hash_init();
+	for(size_t i = 0; i < qty; i++)
+	{
+		hashes[i] = umash_full(&hashParams, HASH_SEED, 0, strings[i].string,
+							   strings[i].length);
+	}
+}
+
+struct umash_fp str_fingerprint(const char * buf, size_t length)
+{
+	str_hash_init();
+	return umash_fprint(&hashParams, HASH_SEED, buf, length);
+}
 
 /**
    Filename of Datebook PDB file from previous iteration.
@@ -194,16 +168,38 @@ uint64_t str_hash(char * buf, size_t length)
 #define MAX_PATH_LEN 300
 
 /**
-   Copy buffer length
+   Copy buffer length, used if file cannot be copied inside the kernel.
+*/
+#define COPY_BUFFER_LENGTH 65536
+
+/**
+   Max qty of bytes to copy with one copy_file_range() call.
 */
-#define COPY_BUFFER_LENGTH 4096
+#define COPY_RANGE_LENGTH (1 << 30)
+
+#if defined(__linux__) || \
+	(defined(__FreeBSD__) && __FreeBSD_version >= 1300037)
+/**
+   Defined if copy_file_range() is available.
+*/
+#define HAVE_COPY_FILE_RANGE
+#endif
+
+/**
+   Suffix for temporary file, used by save_file() and save_data(). Should
+   end with six 'X' characters for mkstemp().
+*/
+#define SAVE_FILE_TMP_SUFFIX ".XXXXXX"
 
 
 static int _check_previous_pdb(char * dataDir, char * pdbFileName,
 							   char ** result);
 static int _save_as_previous_pdb(char ** pathToPrevPDB, char * pathToCurrentPDB,
 								 char * dataDir, char * prevPdbFname);
-static int _cp(char * from, char * to);
+static int _copy_fd(int fromFd, int toFd);
+static int _sync_directory(const char * path);
+static int _save_tmp_file(const char * tmpPath, int fd, const char * to,
+						  mode_t mode, int result);
 
 
 int check_previous_pdbs(SyncSettings * syncSettings)
@@ -316,8 +312,9 @@ int save_as_previous_pdbs(SyncSettings * syncSettings, PalmData * palmData)
    is NULL, then it will be constructed as concatenation of dataDir
    and prevPdbFname strings.
 
-   Then a new hardlink will be created at given path. Hardlink will
-   point to pathtoCurrentPDB file.
+   Then pathToCurrentPDB file will be saved to given path with
+   save_file(), so PDB file from previous synchronization is replaced
+   atomically.
 
    @param[in] pathToPrevPDB path to copy previous PDB file to.
    @param[in] pathToCurrentPDB path to PDB file, downloaded from Palm handheld
@@ -347,7 +344,7 @@ static int _save_as_previous_pdb(char ** pathToPrevPDB, char * pathToCurrentPDB,
 				  " file as from prev sync", *pathToPrevPDB);
 	}
 
-	if(_cp(pathToCurrentPDB, *pathToPrevPDB))
+	if(save_file(pathToCurrentPDB, *pathToPrevPDB))
 	{
 		log_write(LOG_ERR, "Failed copy %s to %s: %s", pathToCurrentPDB,
 				  *pathToPrevPDB, strerror(errno));
@@ -357,14 +354,7 @@ static int _save_as_previous_pdb(char ** pathToPrevPDB, char * pathToCurrentPDB,
 	return 0;
 }
 
-/**
-   Simple realization of cp here.
-
-   @param[in] from Path for copy source.
-   @param[in] to Path to copy target.
-   @return Zero on success, non-zero value on error.
-*/
-static int _cp(char * from, char * to)
+int copy_file(const char * from, const char * to)
 {
 	int fromFd = -1;
 	int toFd = -1;
@@ -378,8 +368,146 @@ static int _cp(char * from, char * to)
 					S_IRUSR | S_IWUSR | S_IRGRP)) < 0)
 	{
 		log_write(LOG_ERR, "Cannot open %s as copy target", to);
-		goto cp_error;
+		close(fromFd);
+		return -1;
+	}
+
+	int result = _copy_fd(fromFd, toFd);
+	if(close(toFd))
+	{
+		log_write(LOG_ERR, "Cannot close %s file", to);
+		result = -1;
+	}
+	if(close(fromFd))
+	{
+		log_write(LOG_ERR, "Cannot close %s file", from);
+		result = -1;
+	}
+	return result;
+}
+
+int save_file(const char * from, const char * to)
+{
+	size_t tmpLength = strlen(to) + strlen(SAVE_FILE_TMP_SUFFIX) + 1;
+	char * tmpPath;
+	if((tmpPath = calloc(tmpLength, sizeof(char))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for temporary path for %s",
+				  to);
+		return -1;
+	}
+	snprintf(tmpPath, tmpLength, "%s" SAVE_FILE_TMP_SUFFIX, to);
+
+	int fromFd = -1;
+	int toFd = -1;
+	if((fromFd = open(from, O_RDONLY)) < 0)
+	{
+		log_write(LOG_ERR, "Cannot open %s to save", from);
+		free(tmpPath);
+		return -1;
 	}
+	if((toFd = mkstemp(tmpPath)) < 0)
+	{
+		log_write(LOG_ERR, "Cannot create temporary file %s: %s", tmpPath,
+				  strerror(errno));
+		close(fromFd);
+		free(tmpPath);
+		return -1;
+	}
+
+	int result = _copy_fd(fromFd, toFd);
+	close(fromFd);
+	result = _save_tmp_file(tmpPath, toFd, to, S_IRUSR | S_IWUSR | S_IRGRP,
+							result);
+	free(tmpPath);
+	return result;
+}
+
+int save_data(const char * to, const char * data, size_t size, mode_t mode)
+{
+	size_t tmpLength = strlen(to) + strlen(SAVE_FILE_TMP_SUFFIX) + 1;
+	char * tmpPath;
+	if((tmpPath = calloc(tmpLength, sizeof(char))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for temporary path for %s",
+				  to);
+		return -1;
+	}
+	snprintf(tmpPath, tmpLength, "%s" SAVE_FILE_TMP_SUFFIX, to);
+
+	int toFd;
+	if((toFd = mkstemp(tmpPath)) < 0)
+	{
+		log_write(LOG_ERR, "Cannot create temporary file %s: %s", tmpPath,
+				  strerror(errno));
+		free(tmpPath);
+		return -1;
+	}
+
+	int result = 0;
+	for(size_t written = 0; written < size;)
+	{
+		ssize_t length;
+		if((length = write(toFd, data + written, size - written)) == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			log_write(LOG_ERR, "Cannot write to %s: %s", tmpPath,
+					  strerror(errno));
+			result = -1;
+			break;
+		}
+		written += length;
+	}
+	result = _save_tmp_file(tmpPath, toFd, to, mode, result);
+	free(tmpPath);
+	return result;
+}
+
+/**
+   Copy contents of one file to another.
+
+   The cheapest available way is used. First, target file shares data
+   with source file (reflink), if filesystem supports it. Then data is
+   copied inside the kernel with copy_file_range(). If both are not
+   possible (e.g. files are on different filesystems), data is copied
+   through the buffer.
+
+   @param[in] fromFd Descriptor of file to copy from.
+   @param[in] toFd Descriptor of empty file to copy to.
+   @return Zero on success, non-zero value on error.
+*/
+static int _copy_fd(int fromFd, int toFd)
+{
+#if defined(__linux__)
+	if(ioctl(toFd, FICLONE, fromFd) == 0)
+	{
+		return 0;
+	}
+#endif
+
+#if defined(HAVE_COPY_FILE_RANGE)
+	ssize_t copied;
+	bool copiedAny = false;
+	while((copied = copy_file_range(fromFd, NULL, toFd, NULL,
+									COPY_RANGE_LENGTH, 0)) > 0)
+	{
+		copiedAny = true;
+	}
+	if(copied == 0)
+	{
+		return 0;
+	}
+	if(copiedAny || (errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+					 errno != EOPNOTSUPP && errno != EINTR))
+	{
+		log_write(LOG_ERR, "Cannot copy file: %s", strerror(errno));
+		return -1;
+	}
+	/* Nothing is copied, so offsets of both files are not changed */
+#endif
 
 	uint8_t buffer[COPY_BUFFER_LENGTH];
 	ssize_t readed;
@@ -398,36 +526,166 @@ static int _cp(char * from, char * to)
 			}
 			else if(errno != EINTR)
 			{
-				goto cp_error;
+				log_write(LOG_ERR, "Cannot write copy of file: %s",
+						  strerror(errno));
+				return -1;
 			}
 		}
 		while(readed > 0);
 	}
+	if(readed < 0)
+	{
+		log_write(LOG_ERR, "Cannot read file to copy: %s", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
 
-	if(readed == 0)
+/**
+   Flush directory entries of directory with given file to disk.
+
+   @param[in] path Path to file.
+   @return Zero on success, non-zero value on error.
+*/
+static int _sync_directory(const char * path)
+{
+	const char * slash = strrchr(path, '/');
+	char * directory;
+	if((directory = slash == NULL ? strdup(".") :
+		strndup(path, slash == path ? 1 : slash - path)) == NULL)
 	{
-		if(close(toFd))
-		{
-			log_write(LOG_ERR, "Cannot close %s file", to);
-			toFd = -1;
-			goto cp_error;
-		}
-		if(close(fromFd))
-		{
-			log_write(LOG_ERR, "Cannot close %s file", from);
-			return -1;
-		}
-		return 0;
+		log_write(LOG_ERR, "Cannot allocate memory for directory of %s",
+				  path);
+		return -1;
 	}
 
-cp_error:
-	if(toFd != -1 && close(toFd))
+	int fd;
+	int result = 0;
+	if((fd = open(directory, O_RDONLY | O_DIRECTORY)) == -1 || fsync(fd))
 	{
-		log_write(LOG_ERR, "Cannot close %s file", to);
+		log_write(LOG_WARNING, "Cannot flush %s directory to disk: %s",
+				  directory, strerror(errno));
+		result = -1;
 	}
-	if(close(fromFd))
+	if(fd != -1)
 	{
-		log_write(LOG_ERR, "Cannot close %s file", from);
+		close(fd);
+	}
+	free(directory);
+	return result;
+}
+
+/**
+   Flush temporary file to disk and rename it to target path.
+
+   Temporary file is removed on error.
+
+   @param[in] tmpPath Path to temporary file.
+   @param[in] fd Descriptor of temporary file, which is closed here.
+   @param[in] to Target path.
+   @param[in] mode Permissions of target file.
+   @param[in] result Result of writing to temporary file.
+   @return Zero on success, non-zero value on error.
+*/
+static int _save_tmp_file(const char * tmpPath, int fd, const char * to,
+						  mode_t mode, int result)
+{
+	if(result == 0 && fchmod(fd, mode))
+	{
+		log_write(LOG_ERR, "Cannot change mode of %s: %s", tmpPath,
+				  strerror(errno));
+		result = -1;
+	}
+	if(result == 0 && fsync(fd))
+	{
+		log_write(LOG_ERR, "Cannot flush %s to disk: %s", tmpPath,
+				  strerror(errno));
+		result = -1;
+	}
+	if(close(fd))
+	{
+		log_write(LOG_ERR, "Cannot close %s file", tmpPath);
+		result = -1;
+	}
+	if(result == 0 && rename(tmpPath, to))
+	{
+		log_write(LOG_ERR, "Cannot rename %s to %s: %s", tmpPath, to,
+				  strerror(errno));
+		result = -1;
+	}
+	if(result)
+	{
+		unlink(tmpPath);
+	}
+	else
+	{
+		/* Make rename durable. File is already saved, so error is not
+		   fatal */
+		_sync_directory(to);
+	}
+	return result;
+}
+
+/**
+   Convert given string from UTF8 to CP1251 encoding.
+
+   @param[in] arena Arena to allocate string from or NULL to allocate it
+   with malloc().
+   @param[in] string Characters in UTF8 encoding.
+   @return Characters in CP1251 encoding or NULL on error.
+*/
+static char * _iconv_utf8_to_cp1251(Arena * arena, const char * string)
+{
+	size_t inStringLen = strlen(string);
+	size_t outStringLen;
+	if((outStringLen = utf8_to_cp1251_length(string, inStringLen)) ==
+	   CP1251_ERROR)
+	{
+		log_write(LOG_ERR, "Failed to convert UTF8 string \"%s\" to CP1251: "
+				  "invalid or unmappable character", string);
+		return NULL;
+	}
+
+	char * outString;
+	if((outString = arena != NULL ? arena_alloc(arena, outStringLen + 1) :
+		malloc(outStringLen + 1)) == NULL)
+	{
+		log_write(LOG_ERR, "Failed to allocate memory for converted string: %s",
+				  strerror(errno));
+		return NULL;
+	}
+	utf8_to_cp1251(string, inStringLen, outString, outStringLen + 1);
+	return outString;
+}
+
+/**
+   Convert given string from CP1251 to UTF8 encoding.
+
+   @param[in] arena Arena to allocate string from or NULL to allocate it
+   with malloc().
+   @param[in] string Characters in CP1251 encoding.
+   @return Characters in UTF8 encoding or NULL on error.
+*/
+static char * _iconv_cp1251_to_utf8(Arena * arena, const char * string)
+{
+	size_t inStringLen = strlen(string);
+	size_t outStringLen;
+	if((outStringLen = cp1251_to_utf8_length(string, inStringLen)) ==
+	   CP1251_ERROR)
+	{
+		log_write(LOG_ERR, "Failed to convert CP1251 string \"%s\" to UTF8: "
+				  "undefined character", string);
+		return NULL;
+	}
+
+	char * outString;
+	if((outString = arena != NULL ? arena_alloc(arena, outStringLen + 1) :
+		malloc(outStringLen + 1)) == NULL)
+	{
+		log_write(LOG_ERR, "Failed to allocate memory for converted string: %s",
+				  strerror(errno));
+		return NULL;
 	}
-	return -1;
+	cp1251_to_utf8(string, inStringLen, outString, outStringLen + 1);
+	return outString;
 }
@@ -0,0 +1,99 @@
+/**
+   @author Eugene Andrienko
+   @brief Arena allocator for objects, living during one synchronization
+   @file arena.h
+
+   Memory is taken from large chunks and is never freed by pieces — all
+   allocated objects are released at once by arena_reset().
+*/
+
+/**
+   @page arena Arena allocator
+
+   One synchronization cycle creates a lot of small objects: memos, notes
+   from OrgMode file and their strings. All of them are not necessary
+   after synchronization, so they are allocated from arena and released
+   together at the end of cycle:
+   - arena_alloc() - allocate zeroed memory.
+   - arena_strdup() - copy string to arena.
+   - arena_reset() - release all allocated objects.
+   - arena_free() - free memory of arena.
+
+   Zero-initialized Arena structure is an empty arena, ready to use.
+
+   arena_reset() keeps one chunk, large enough for all objects from the
+   previous cycle, so the next cycle of long-running daemon usually does
+   not call malloc() at all.
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/**
+   Chunk of memory for arena.
+*/
+struct __ArenaChunk
+{
+	struct __ArenaChunk * next; /**< Previous chunk of arena */
+	size_t size;                /**< Size of data in bytes */
+	size_t used;                /**< Qty of allocated bytes */
+	max_align_t data[];         /**< Memory for objects */
+};
+#endif
+
+/**
+   Arena allocator.
+*/
+struct Arena
+{
+	size_t allocated;                 /**< Qty of allocated bytes */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	struct __ArenaChunk * _chunks;    /**< Chunks, the current one is first */
+#endif
+};
+typedef struct Arena Arena;
+
+
+/**
+   Allocate zeroed memory from arena.
+
+   Memory is aligned for any type, like memory from malloc().
+
+   @param[in] arena Arena.
+   @param[in] size Size of memory in bytes.
+   @return Pointer to memory or NULL on error.
+*/
+void * arena_alloc(Arena * arena, size_t size);
+
+/**
+   Copy string to arena.
+
+   @param[in] arena Arena.
+   @param[in] string Null-terminated string.
+   @return Copy of string or NULL on error.
+*/
+char * arena_strdup(Arena * arena, const char * string);
+
+/**
+   Release all objects, allocated from arena.
+
+   Pointers, returned by arena before reset, must not be used.
+
+   @param[in] arena Arena.
+*/
+void arena_reset(Arena * arena);
+
+/**
+   Free all memory of arena.
+
+   Arena remains valid and empty.
+
+   @param[in] arena Arena.
+*/
+void arena_free(Arena * arena);
+
+#endif
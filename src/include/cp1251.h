@@ -0,0 +1,97 @@
+/**
+   @author Eugene Andrienko
+   @brief Table-driven conversion between CP1251 and UTF8
+   @file cp1251.h
+
+   Palm PDA stores strings in CP1251 encoding, while OrgMode files and
+   in-memory structures use UTF8. This module converts strings between
+   these encodings with lookup tables instead of iconv.
+*/
+
+/**
+   @page cp1251 Conversion between CP1251 and UTF8
+
+   CP1251 has only 128 non-ASCII characters, so conversion is done with
+   256-entry lookup table in one direction and with lookup table for
+   Cyrillic letters plus small sorted table for the remaining characters
+   in another direction. Runs of ASCII characters are copied as is, they
+   are located with SSE2 instructions where available.
+
+   To convert strings there are next functions:
+   - cp1251_to_utf8_length() - exact length of CP1251 string in UTF8.
+   - cp1251_to_utf8() - convert CP1251 string to UTF8.
+   - utf8_to_cp1251_length() - exact length of UTF8 string in CP1251.
+   - utf8_to_cp1251() - convert UTF8 string to CP1251.
+
+   Conversion functions write to caller-provided buffers, so caller can
+   allocate buffer of exact size or reuse one buffer for many strings.
+*/
+
+#ifndef _CP1251_H_
+#define _CP1251_H_
+
+#include <stddef.h>
+
+
+/**
+   Returned by conversion functions if string cannot be converted.
+*/
+#define CP1251_ERROR ((size_t)-1)
+
+
+/**
+   Returns length of CP1251 string after conversion to UTF8.
+
+   @param[in] string String in CP1251 encoding.
+   @param[in] length Length of string in bytes.
+   @return Length of UTF8 string in bytes, without null-terminating
+   character, or CP1251_ERROR if string contains byte, undefined in CP1251.
+*/
+size_t cp1251_to_utf8_length(const char * string, size_t length);
+
+/**
+   Convert CP1251 string to UTF8.
+
+   Result is null-terminated, so output buffer should be at least
+   cp1251_to_utf8_length() + 1 bytes long.
+
+   @param[in] string String in CP1251 encoding.
+   @param[in] length Length of string in bytes.
+   @param[out] out Buffer for UTF8 string.
+   @param[in] outSize Size of buffer.
+   @return Length of UTF8 string in bytes, without null-terminating
+   character, or CP1251_ERROR if string cannot be converted or buffer is
+   too small.
+*/
+size_t cp1251_to_utf8(const char * string, size_t length, char * out,
+					  size_t outSize);
+
+/**
+   Returns length of UTF8 string after conversion to CP1251.
+
+   @param[in] string String in UTF8 encoding.
+   @param[in] length Length of string in bytes.
+   @return Length of CP1251 string in bytes, without null-terminating
+   character, or CP1251_ERROR if string is malformed or contains
+   characters, which are absent in CP1251.
+*/
+size_t utf8_to_cp1251_length(const char * string, size_t length);
+
+/**
+   Convert UTF8 string to CP1251.
+
+   Result is null-terminated, so output buffer should be at least
+   utf8_to_cp1251_length() + 1 bytes long.
+
+   @param[in] string String in UTF8 encoding.
+   @param[in] length Length of string in bytes.
+   @param[out] out Buffer for CP1251 string.
+   @param[in] outSize Size of buffer.
+   @return Length of CP1251 string in bytes, without null-terminating
+   character, or CP1251_ERROR if string cannot be converted or buffer is
+   too small.
+*/
+size_t utf8_to_cp1251(const char * string, size_t length, char * out,
+					  size_t outSize);
+
+#endif
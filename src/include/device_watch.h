@@ -0,0 +1,55 @@
+/**
+   @author Eugene Andrienko
+   @brief Wait for Palm device node to appear or disappear
+   @file device_watch.h
+
+   Functions from this module sleep until symbolic device of Palm PDA
+   is created or removed by the system, instead of checking it every
+   second.
+*/
+
+/**
+   @page device_watch Device watching
+
+   Palm PDA in HotSync mode appears in system as symbolic device (like
+   /dev/ttyUSB1), which disappears when synchronization ends. To not poll
+   this device every second, daemon waits for events from inotify on the
+   directory with device:
+   - device_wait_appear() - wait for device to appear.
+   - device_wait_disappear() - wait for device to disappear.
+
+   While device is absent, daemon may wait for other events too: waiting
+   for device to appear stops when additional descriptor becomes readable.
+
+   If inotify is not available (non-Linux systems) or device is not a path
+   in filesystem (e.g. "usb:"), functions return -1 and caller should fall
+   back to polling.
+*/
+
+#ifndef _DEVICE_WATCH_H_
+#define _DEVICE_WATCH_H_
+
+/**
+   Wait for device to appear in filesystem.
+
+   @param[in] device Path to symbolic device.
+   @param[in] timeout Maximal time to wait in seconds.
+   @param[in] eventFd Descriptor to stop waiting when it becomes readable,
+   or -1. Events from it are not read.
+   @return 0 if device appeared, 1 on timeout, if waiting was interrupted by
+   signal or by event on eventFd, -1 if device already exists or cannot be
+   watched.
+*/
+int device_wait_appear(const char * device, int timeout, int eventFd);
+
+/**
+   Wait for device to disappear from filesystem.
+
+   @param[in] device Path to symbolic device.
+   @param[in] timeout Maximal time to wait in seconds.
+   @return 0 if device disappeared or not exists, 1 on timeout or if waiting
+   was interrupted by signal, -1 if device cannot be watched.
+*/
+int device_wait_disappear(const char * device, int timeout);
+
+#endif
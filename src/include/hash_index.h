@@ -0,0 +1,116 @@
+/**
+   @author Eugene Andrienko
+   @brief Open-addressing hash index from 64-bit keys to pointers
+   @file hash_index.h
+
+   Index maps 64-bit keys (unique record IDs, string hashes) to
+   pointers to the indexed elements. One key may be mapped to several
+   elements, so callers should compare found elements with the desired
+   one if key is a hash of something.
+*/
+
+/**
+   @page hash_index Hash index
+
+   Open-addressing hash table with linear probing, which is used to
+   find memos and tasks by ID or by hash of header without sorting all
+   elements on every search.
+
+   - hash_index_init() - allocate memory for index.
+   - hash_index_free() - free memory, allocated for index.
+   - hash_index_insert() - add key and element to index.
+   - hash_index_remove() - remove key and element from index.
+   - hash_index_find() - iterate over elements with given key.
+
+   Removed elements are marked with tombstones, which are dropped when
+   index grows.
+*/
+
+#ifndef _HASH_INDEX_H_
+#define _HASH_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/**
+   Slot of hash index.
+*/
+struct __HashIndexSlot
+{
+	uint64_t key; /**< Key of element */
+	void * value; /**< Pointer to element, NULL for empty slot */
+};
+#endif
+
+/**
+   Hash index.
+*/
+struct HashIndex
+{
+	size_t count;                   /**< Qty of elements in index */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	size_t _capacity;               /**< Qty of slots, power of two */
+	size_t _used;                   /**< Qty of non-empty slots, including
+									   tombstones */
+	struct __HashIndexSlot * _slots; /**< Slots of index */
+#endif
+};
+typedef struct HashIndex HashIndex;
+
+
+/**
+   Allocate memory for hash index.
+
+   @param[in] index Hash index to initialize.
+   @param[in] qty Expected qty of elements in index.
+   @return 0 on success or -1 on error.
+*/
+int hash_index_init(HashIndex * index, size_t qty);
+
+/**
+   Free memory, allocated for hash index.
+
+   Indexed elements are not freed.
+
+   @param[in] index Hash index.
+*/
+void hash_index_free(HashIndex * index);
+
+/**
+   Add element with given key to the hash index.
+
+   @param[in] index Hash index.
+   @param[in] key Key of element.
+   @param[in] value Pointer to element. Should not be NULL.
+   @return 0 on success or -1 on error.
+*/
+int hash_index_insert(HashIndex * index, uint64_t key, void * value);
+
+/**
+   Remove element with given key from the hash index.
+
+   @param[in] index Hash index.
+   @param[in] key Key of element.
+   @param[in] value Pointer to element.
+   @return 0 on success or -1 if there is no such element in index.
+*/
+int hash_index_remove(HashIndex * index, uint64_t key, void * value);
+
+/**
+   Find element with given key in hash index.
+
+   To get all elements with given key, call this function repeatedly
+   with the same cursor until it returns NULL.
+
+   @param[in] index Hash index.
+   @param[in] key Key to search for.
+   @param[in,out] cursor Search position. Should be set to zero before
+   the first call.
+   @return Pointer to element or NULL if there are no more elements with
+   given key.
+*/
+void * hash_index_find(HashIndex * index, uint64_t key, size_t * cursor);
+
+#endif
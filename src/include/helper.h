@@ -9,9 +9,18 @@
 
    - iconv_utf8_to_cp1251() - convert given string from UTF8 to CP1251
    - iconv_cp1251_to_utf8() - convert given string from CP1251 to UTF8
+   - iconv_utf8_to_cp1251_arena() - convert string from UTF8 to CP1251 to
+     memory from arena
+   - iconv_cp1251_to_utf8_arena() - convert string from CP1251 to UTF8 to
+     memory from arena
    - read_chunks() - read bytes from file by chunks
    - write_chunks() - write bytes to file by chunks
+   - copy_file() - copy file to given path
+   - save_file() - atomically save file to given path
+   - save_data() - atomically save data from memory to given path
    - str_hash() - compute hash for given string
+   - str_hash_batch() - compute hashes for array of strings
+   - str_fingerprint() - compute 128-bit fingerprint for given string
    - check_previous_pdbs() - check PDBs from previous synchronization
    cycle for existence
    - save_as_previous_pdbs() - save current set of PDBs as PDBs from previous
@@ -23,7 +32,10 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include "arena.h"
 #include "palm.h"
+#include "umash.h"
 #include "sync.h"
 
 
@@ -38,7 +50,8 @@
 
    Set of functions to perform character conversion for character
    arrays. Conversion can be performed from CP1251 to UTF8 and
-   backwards, from UTF8 to CP1251.
+   backwards, from UTF8 to CP1251. Conversion is done with lookup
+   tables from cp1251.h.
 
    @{
 */
@@ -46,8 +59,9 @@
 /**
    Convert given string from UTF8 to CP1251 encoding.
 
-   Function will allocate (2 * symbols in UTF8 string) bytes for CP1251
-   string. Memory for this string should be freed outside of this function.
+   Function will allocate exactly as much bytes as needed for CP1251
+   string and null-terminating character. Memory for this string should
+   be freed outside of this function.
 
    @param[in] string Characters in UTF8 encoding.
    @return Characters in CP1251 encoding. Memory for string allocated inside
@@ -58,8 +72,9 @@ char * iconv_utf8_to_cp1251(char * string);
 /**
    Convert given string from CP1251 to UTF8 encoding.
 
-   Function will allocate (2 * symbols in CP1251 string) bytes for UTF8
-   string. Memory for this string should be freed outside of this function.
+   Function will allocate exactly as much bytes as needed for UTF8
+   string and null-terminating character. Memory for this string should
+   be freed outside of this function.
 
    @param[in] string Characters in CP1251 encoding.
    @return Characters in UTF8 encoding. Memory for string allocated inside
@@ -67,6 +82,30 @@ char * iconv_utf8_to_cp1251(char * string);
 */
 char * iconv_cp1251_to_utf8(char * string);
 
+/**
+   Convert given string from UTF8 to CP1251 encoding.
+
+   Like iconv_utf8_to_cp1251(), but memory for CP1251 string is taken
+   from arena and should not be freed.
+
+   @param[in] arena Arena to allocate string from.
+   @param[in] string Characters in UTF8 encoding.
+   @return Characters in CP1251 encoding or NULL on error.
+*/
+char * iconv_utf8_to_cp1251_arena(Arena * arena, const char * string);
+
+/**
+   Convert given string from CP1251 to UTF8 encoding.
+
+   Like iconv_cp1251_to_utf8(), but memory for UTF8 string is taken from
+   arena and should not be freed.
+
+   @param[in] arena Arena to allocate string from.
+   @param[in] string Characters in CP1251 encoding.
+   @return Characters in UTF8 encoding or NULL on error.
+*/
+char * iconv_cp1251_to_utf8_arena(Arena * arena, const char * string);
+
 /**
    @}
 */
@@ -101,10 +140,78 @@ int read_chunks(int fd, char * buf, unsigned int length);
 */
 int write_chunks(int fd, char * buf, unsigned int length);
 
+/**
+   Copy file to given path.
+
+   Target file will be created or truncated. Data is shared with reflink
+   or copied inside the kernel with copy_file_range() when possible,
+   otherwise it is copied through the buffer.
+
+   @param[in] from Path for copy source.
+   @param[in] to Path to copy target.
+   @return Zero on success, non-zero value on error.
+*/
+int copy_file(const char * from, const char * to);
+
+/**
+   Save file to given path atomically.
+
+   File is copied to temporary file in the directory of target like in
+   copy_file(), flushed to disk and renamed to given path. Then directory
+   is flushed too. So target file is either old or completely new, even
+   if system crashes while saving.
+
+   @param[in] from Path to file to save.
+   @param[in] to Path to save file to.
+   @return Zero on success, non-zero value on error.
+*/
+int save_file(const char * from, const char * to);
+
+/**
+   Save data from memory to given path atomically.
+
+   Data is written to temporary file like in save_file(), so target file
+   is either old or completely new.
+
+   @param[in] to Path to save data to.
+   @param[in] data Data to save.
+   @param[in] size Size of data in bytes.
+   @param[in] mode Permissions of saved file.
+   @return Zero on success, non-zero value on error.
+*/
+int save_data(const char * to, const char * data, size_t size, mode_t mode);
+
 /**
    @}
 */
 
+/**
+   \defgroup hash String hashing
+
+   Strings are hashed with UMASH. Parameters of hash-function are
+   derived once and kept for the process lifetime.
+
+   @{
+*/
+
+/**
+   String for str_hash_batch().
+*/
+struct HashString
+{
+	const char * string; /**< String, may be not null-terminated */
+	size_t length;       /**< Length of string in bytes */
+};
+typedef struct HashString HashString;
+
+/**
+   Derive parameters of hash-function.
+
+   Called implicitly by the hash functions, but should be called at startup,
+   before any threads are started.
+*/
+void str_hash_init();
+
 /**
    Compute hash for given string.
 
@@ -114,6 +221,32 @@ int write_chunks(int fd, char * buf, unsigned int length);
 */
 uint64_t str_hash(char * buf, size_t length);
 
+/**
+   Compute hashes for array of strings.
+
+   Result for each string is the same as result of str_hash().
+
+   @param[in] strings Array of strings.
+   @param[in] qty Qty of strings in array.
+   @param[out] hashes Array of qty hashes.
+*/
+void str_hash_batch(const HashString * strings, size_t qty, uint64_t * hashes);
+
+/**
+   Compute 128-bit fingerprint for given string.
+
+   First half of fingerprint is equal to str_hash() of the same string.
+
+   @param[in] buf String to compute fingerprint to.
+   @param[in] length Length of string.
+   @return Resulting fingerprint.
+*/
+struct umash_fp str_fingerprint(const char * buf, size_t length);
+
+/**
+   @}
+*/
+
 
 /**
    \defgroup previous_pdbs Processing PDB files from previous synchronization cycle
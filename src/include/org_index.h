@@ -0,0 +1,57 @@
+/**
+   @author Eugene Andrienko
+   @brief Index of parsed headlines of OrgMode file
+   @file org_index.h
+
+   Index keeps parsed first-level headlines of OrgMode file between
+   synchronizations, so only changed headlines are parsed again.
+*/
+
+/**
+   @page org_index Index of OrgMode headlines
+
+   Usually only few headlines of OrgMode file are changed between two
+   synchronizations. To not parse the whole file every time, file is split
+   to blocks: text before the first headline and first-level headlines
+   with text below them. Index in data directory keeps for every block its
+   byte range, UMASH fingerprint of its contents and parsed fields of
+   headline.
+
+   org_index_parse() works like parse_orgmode_file():
+   - If size and modification time of file are the same as in index, all
+     headlines are taken from index without reading the file.
+   - Otherwise file is read and split to blocks. Blocks with fingerprint
+     from index are taken from index, other blocks are parsed.
+   - After parsing without errors index is rewritten for the current
+     contents of file.
+
+   Timestamps in index depend on timezone, so index is not used if
+   timezone is changed.
+*/
+
+#ifndef _ORG_INDEX_H_
+#define _ORG_INDEX_H_
+
+#include <sys/stat.h>
+#include "orgmode_parser.h"
+
+
+/**
+   Parse OrgMode file, reusing headlines from index.
+
+   Index is created if it does not exist or cannot be used, and is
+   rewritten after parsing without syntax errors.
+
+   @param[in] path Path to OrgMode file.
+   @param[in] indexPath Path to index file.
+   @param[out] errors Qty of skipped entries with syntax errors. May be NULL.
+   @param[out] fileStat Status of file, which offsets of headlines belong
+   to. May be NULL.
+   @return Initialized and filled OrgModeEntries structure, which should be
+   freed with free_orgmode_parser(), or NULL if parsing failed.
+*/
+OrgModeEntries * org_index_parse(const char * path, const char * indexPath,
+								 unsigned int * errors,
+								 struct stat * fileStat);
+
+#endif
@@ -3,29 +3,39 @@
    @brief Operates with OrgMode file with notes on disk
    @file org_notes.h
 
-   Reading and parsing OrgMode file use flex/bison parser functions. Writing to
-   OrgMode file realized separately, via read_chunks() and write_chunks()
-   functions.
+   Reading and parsing OrgMode file use flex/bison parser functions. Changes
+   of OrgMode file are collected in memory and written at once.
 */
 
 /**
    @page org_notes Process notes in OrgMode file
 
    To read and parse notes from OrgMode file — use org_notes_parse(), which
-   returns initialized queue of OrgNote entries with parsed notes. When this
-   structure is no longer necessary — free it via org_notes_free().
-
-   To write new note to OrgMode file — use set of functions:
-   - org_notes_open() — to open file for writing
-   - org_notes_write() — to write new note to file
-   - org_notes_close() — to close previously opened file.
+   returns initialized queue of OrgNote entries with parsed notes. Queue and
+   notes are allocated from arena and are released with arena_reset().
+
+   To write notes to OrgMode file — use set of functions:
+   - org_notes_open() — to start collecting changes of file
+   - org_notes_write() — to add new note to the end of file
+   - org_notes_replace() — to replace parsed note in place
+   - org_notes_close() — to write all changes to file.
+
+   File is rewritten once per synchronization and atomically: new contents
+   is written to temporary file, flushed to disk and renamed to the file.
+   So crash while synchronizing leaves either old or completely new file.
+   If file is changed by someone else since it was parsed, changes are not
+   written at all: status of file from org_notes_parse() is given to
+   org_notes_open().
 */
 
 #ifndef _ORG_NOTES_H_
 #define _ORG_NOTES_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/queue.h>
+#include <sys/stat.h>
+#include "arena.h"
 
 
 /**
@@ -41,6 +51,8 @@ struct OrgNote
 	TAILQ_ENTRY(OrgNote) pointers;
 #endif
 	uint64_t header_hash; /**< Note header hash */
+	size_t offset;        /**< Offset of note in OrgMode file */
+	size_t length;        /**< Length of note in OrgMode file */
 };
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 TAILQ_HEAD(NotesQueue, OrgNote);
@@ -51,51 +63,92 @@ typedef struct OrgNote OrgNote;
 */
 typedef struct NotesQueue OrgNotes;
 
+/**
+   Changes of OrgMode file, collected during synchronization.
+*/
+typedef struct __OrgNotesWriter OrgNotesWriter;
+
 /**
    Parse given OrgMode file with notes inside.
 
+   Queue, notes and their strings are allocated from arena.
+
+   If file contains notes with syntax errors, all of them are logged and
+   NULL is returned: missing note cannot be distinguished from note,
+   deleted on desktop.
+
+   If path to index is given, only notes changed since the previous
+   parsing are parsed, see @ref org_index.
+
    @param[in] path Path to OrgMode file to parse.
+   @param[in] indexPath Path to index of OrgMode file. May be NULL to parse
+   the whole file without index.
+   @param[in] arena Arena for parsed notes.
+   @param[out] fileStat Status of file, which offsets of notes belong to.
+   May be NULL.
    @return Pointer to queue with parsed notes or NULL if error.
 */
-OrgNotes * org_notes_parse(const char * path);
+OrgNotes * org_notes_parse(const char * path, const char * indexPath,
+						   Arena * arena, struct stat * fileStat);
 
 /**
-   Free inner structures and queue with parsed notes.
+   Start collecting changes of OrgMode file.
 
-   @param[in] notes Pointer to queue to free.
-*/
-void org_notes_free(OrgNotes * notes);
-
-/**
-   Open OrgMode file to write.
+   Changes are written only if size and modification time of file are
+   still the same as when notes were parsed.
 
    @param[in] path Path to OrgMode file.
-   @return File descriptor on success or -1 on errror.
+   @param[in] fileStat Status of file from org_notes_parse().
+   @param[in] arena Arena for writer and new notes.
+   @return Writer or NULL on error.
 */
-int org_notes_open(const char * path);
+OrgNotesWriter * org_notes_open(const char * path,
+								const struct stat * fileStat, Arena * arena);
 
 /**
-   Write given note to file.
+   Add new note to the end of file.
 
    If category is NULL — write note without category. If text is NULL — write
    only header without additional text.
 
-   @param[in] fd File descriptor of OrgMode file.
-   @param[in] header Header for OrgMode record.
-   @param[in] text Text for OrgMode record. May be NULL if there is no text for
-   note.
+   @param[in] writer Writer of OrgMode file.
+   @param[in] header Header for OrgMode record in CP1251.
+   @param[in] text Text for OrgMode record in CP1251. May be NULL if there is
+   no text for note.
    @param[in] category Text name of category. May be NULL if there is no
    category.
    @return 0 on success or non-zero value on error.
 */
-int org_notes_write(int fd, char * header, char * text, char * category);
+int org_notes_write(OrgNotesWriter * writer, const char * header,
+					const char * text, const char * category);
 
 /**
-   Close OrgMode file, opened for writing.
+   Replace note in file with new version.
+
+   The whole note is replaced: its headline and text below it. Blank
+   lines and OrgMode directives after the text are kept.
+
+   @param[in] writer Writer of OrgMode file.
+   @param[in] note Note, parsed from the file.
+   @param[in] header New header in CP1251.
+   @param[in] text New text in CP1251. May be NULL if there is no text.
+   @param[in] category Text name of category. May be NULL if there is no
+   category.
+   @return 0 on success or non-zero value on error.
+*/
+int org_notes_replace(OrgNotesWriter * writer, const OrgNote * note,
+					  const char * header, const char * text,
+					  const char * category);
+
+/**
+   Write all collected changes to file.
+
+   File is not touched if there are no changes. Writer is freed even on
+   error.
 
-   @param[in] fd File descriptor to close.
+   @param[in] writer Writer of OrgMode file.
    @return 0 on success or non-zero value on error.
 */
-int org_notes_close(int fd);
+int org_notes_close(OrgNotesWriter * writer);
 
 #endif
@@ -0,0 +1,112 @@
+/**
+   @author Eugene Andrienko
+   @brief Keep notes from OrgMode file parsed while waiting for Palm
+   @file org_watch.h
+
+   Watcher re-parses OrgMode file with notes after every change, so notes
+   are ready when Palm PDA is connected.
+*/
+
+/**
+   @page org_watch Pre-parsed OrgMode notes
+
+   While Palm PDA is in HotSync mode, it waits for the end of
+   synchronization. To not parse OrgMode file at this time, daemon parses
+   it while waiting for the device:
+   - org_watch_init() - start watching OrgMode file.
+   - org_watch_update() - parse file again if it is changed. Should be
+     called when descriptor from OrgWatch becomes readable or periodically.
+   - org_watch_notes() - get notes, parsed from the current contents of
+     file.
+   - org_watch_free() - stop watching and free parsed notes.
+
+   Changes are detected with inotify on the directory with file, so files
+   saved by editors via rename are detected too. Size and modification time
+   of file are checked before notes are returned, so without inotify
+   (non-Linux systems) notes are still consistent with file.
+*/
+
+#ifndef _ORG_WATCH_H_
+#define _ORG_WATCH_H_
+
+#include <stdbool.h>
+#include "arena.h"
+#include "org_notes.h"
+
+
+/**
+   Watcher of OrgMode file with notes.
+*/
+struct OrgWatch
+{
+	int fd;                  /**< Descriptor, which becomes readable when
+							    file is changed, or -1 if file cannot be
+							    watched */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	char * _path;            /**< Path to OrgMode file */
+	char * _indexPath;       /**< Path to index of OrgMode file */
+	const char * _name;      /**< Name of file in its directory */
+	bool _changed;           /**< File is changed since the last parsing */
+	bool _parsed;            /**< File is parsed, even with errors */
+	long long _size;         /**< Size of parsed file */
+	long long _mtimeSec;     /**< Modification time of parsed file, seconds */
+	long _mtimeNsec;         /**< Modification time of parsed file,
+							    nanoseconds */
+	OrgNotes * _notes;       /**< Parsed notes or NULL on parsing error */
+	struct stat _fileStat;   /**< Status of file, which notes are parsed
+							    from */
+	Arena _arena;            /**< Arena for parsed notes */
+#endif
+};
+typedef struct OrgWatch OrgWatch;
+
+
+/**
+   Start watching OrgMode file with notes.
+
+   File is not parsed here, call org_watch_update() for this.
+
+   @param[out] watch Watcher to initialize.
+   @param[in] path Path to OrgMode file with notes.
+   @param[in] indexPath Path to index of OrgMode file. May be NULL.
+   @return 0 on success or -1 on error. If inotify is not available,
+   watcher is initialized without descriptor.
+*/
+int org_watch_init(OrgWatch * watch, const char * path,
+				   const char * indexPath);
+
+/**
+   Parse OrgMode file again if it is changed.
+
+   Pending events from descriptor are read without blocking. If file
+   contains syntax errors, it is not parsed again until the next change.
+
+   @param[in] watch Watcher of OrgMode file.
+   @return 0 if notes are parsed from the current contents of file, -1 on
+   error.
+*/
+int org_watch_update(OrgWatch * watch);
+
+/**
+   Returns notes, parsed from the current contents of OrgMode file.
+
+   Notes are owned by watcher and must not be changed. They remain valid
+   until the next call of org_watch_update(), org_watch_notes() or
+   org_watch_free().
+
+   @param[in] watch Watcher of OrgMode file.
+   @param[out] fileStat Status of file, which notes are parsed from, for
+   org_notes_open(). May be NULL.
+   @return Notes or NULL if file cannot be parsed. Caller should parse file
+   itself in that case to report errors.
+*/
+OrgNotes * org_watch_notes(OrgWatch * watch, struct stat * fileStat);
+
+/**
+   Stop watching OrgMode file and free parsed notes.
+
+   @param[in] watch Watcher of OrgMode file.
+*/
+void org_watch_free(OrgWatch * watch);
+
+#endif
@@ -50,12 +50,35 @@
 
 /**
    Record with paths to **temporary** PDB files.
+
+   On Linux temporary PDB files are kept in memory and paths point to
+   /proc/self/fd, so they should be used only by this process.
 */
 struct PalmData {
 	char * datebookDBPath; /**< Path to DatebookDB */
 	char * memoDBPath;     /**< Path to MemoDB */
 	char * todoDBPath;     /**< Path to ToDoDB */
 	char * tasksDBPath;    /**< Path to TasksDB-PTod */
+	const char * cacheDir; /**< Directory with cached copies of databases or
+							  NULL */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	int _datebookDBFd;     /**< Descriptor of in-memory DatebookDB or -1 */
+	int _memoDBFd;         /**< Descriptor of in-memory MemoDB or -1 */
+	int _todoDBFd;         /**< Descriptor of in-memory ToDoDB or -1 */
+	int _tasksDBFd;        /**< Descriptor of in-memory TasksDB-PTod or -1 */
+	char * _datebookDBReadPath; /**< Path to DatebookDB as read from Palm */
+	char * _memoDBReadPath;     /**< Path to MemoDB as read from Palm */
+	char * _todoDBReadPath;     /**< Path to ToDoDB as read from Palm */
+	char * _tasksDBReadPath;    /**< Path to TasksDB-PTod as read from Palm */
+	int _datebookDBReadFd; /**< Descriptor of in-memory DatebookDB as read
+							  from Palm or -1 */
+	int _memoDBReadFd;     /**< Descriptor of in-memory MemoDB as read from
+							  Palm or -1 */
+	int _todoDBReadFd;     /**< Descriptor of in-memory ToDoDB as read from
+							  Palm or -1 */
+	int _tasksDBReadFd;    /**< Descriptor of in-memory TasksDB-PTod as read
+							  from Palm or -1 */
+#endif
 };
 typedef struct PalmData PalmData;
 
@@ -75,10 +98,19 @@ int palm_open(char * device);
    Read next databases: DatebookDB, MemoDB, ToDoDB, writes it's contents to
    temporary files and fill PalmData structure with paths to these files.
 
+   If cacheDir is not NULL, copy of each database, written to Palm, is
+   kept there. When cached copy exists and belongs to the same database,
+   only modified records are fetched from Palm and merged with cached
+   copy. Otherwise the whole database is downloaded. Cached copies are
+   used only if Palm was synchronized with this PC last time: other PC
+   resets flags of modified records.
+
    @param[in] sd Palm device descriptor.
+   @param[in] cacheDir Directory with cached copies of databases, with
+   trailing slash, or NULL.
    @return Initialized PalmData structure or NULL on error.
 */
-PalmData * palm_read(int sd);
+PalmData * palm_read(int sd, const char * cacheDir);
 
 /**
    Write Palm databases to Palm PDA.
@@ -87,9 +119,19 @@ PalmData * palm_read(int sd);
    corresponding PDB-file will be taken from given pointer to PalmData
    structure.
 
+   Only records which differ from database as it was read by palm_read()
+   are written to Palm, removed records are deleted and application info
+   is written only if it is changed. Databases without changes are
+   skipped. If database cannot be written this way, the whole database
+   is installed. Header of each written PDB-file gets modification number
+   and modification datetime of database on Palm after write, and cached
+   copies of databases are saved once, after write. If all databases are
+   written, Palm is marked as synchronized with this PC.
+
    @param[in] sd Palm device descriptor.
    @param[in] data PalmData structure with paths to PDB files.
-   @return 0 if write successfull, otherwise -1.
+   @return 0 if all databases are written, otherwise -1. Other databases
+   are still written if one of them fails.
 */
 int palm_write(int sd, const PalmData * data);
 
@@ -128,4 +170,22 @@ void palm_free(PalmData * data);
 */
 void palm_log(int sd, char * message);
 
+/**
+   Check whether database on Palm is changed since previous synchronization.
+
+   Only information about database is read from Palm, records are not
+   transferred. Creation datetime, modification datetime and
+   modification number of database are compared with the header of PDB
+   file from previous synchronization.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] dbname Name of database.
+   @param[in] prevPdbPath Path to PDB file from previous synchronization or
+   NULL.
+   @return 0 if database is not changed, 1 if it is changed or there is no
+   PDB file from previous synchronization, -1 on error.
+*/
+int palm_database_changed(int sd, const char * dbname,
+						  const char * prevPdbPath);
+
 #endif
@@ -43,6 +43,8 @@
 
 #include <stdint.h>
 #include <sys/queue.h>
+#include "arena.h"
+#include "hash_index.h"
 #include "pdb/pdb.h"
 
 
@@ -65,7 +67,9 @@ struct Memo
 	uint32_t id;                /**< Unique ID of memo */
 	char * header;              /**< Header of memo in UTF8 */
 	char * text;                /**< Memo text */
-	char * category;            /**< Memo category */
+	uint8_t categoryId;         /**< Category ID of memo */
+	const char * category;      /**< Category name, points to categories of
+								   PDB file */
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 	TAILQ_ENTRY(Memo) pointers; /**< Connection between elements in tail
 								   queue */
@@ -85,9 +89,14 @@ typedef struct MemosQueue MemosQueue;
 */
 struct Memos
 {
-	MemosQueue queue; /**< Memos queue */
+	MemosQueue queue;          /**< Memos queue */
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
-	PDB * _pdb;       /**< PDB structure from file */
+	PDB * _pdb;                /**< PDB structure from file */
+	Arena * _arena;            /**< Arena for memos and their strings */
+	HashIndex _byId;           /**< Index of memos by ID */
+	HashIndex _byHeader;       /**< Index of memos by header hash */
+	HashIndex _byHeaderText;   /**< Index of memos by header and text
+								  hash */
 #endif
 };
 typedef struct Memos Memos;
@@ -118,17 +127,24 @@ int memos_open(const char * path);
    freed by memos_free().
 
    Every memo will be read by it's offset from record list (see PDBRecord).
+   Memos, their strings and memos added later with memos_memo_add() are
+   allocated from given arena and are released with arena_reset().
 
    @param[in] fd File with memos descriptor.
+   @param[in] arena Arena for memos. Should live longer than Memos.
    @return Memos structure on success, NULL on error.
 */
-Memos * memos_read(int fd);
+Memos * memos_read(int fd, Arena * arena);
 
 /**
    Write data from Memos structure to PDB file.
 
    Function will write data from Memos structure to file.
 
+   Memos functions, which change memos, do not update offsets in record
+   list — offsets of all records are calculated here, while memos are
+   laid out in file contents.
+
    @param[in] fd File with memos descriptor.
    @param[in] memos Pointer to Memos structure.
    @return 0 on success or non-zero if error.
@@ -145,6 +161,8 @@ void memos_close(int fd);
 /**
    Clear internal data structures of Memos structure.
 
+   Memos itself are allocated from arena and are not freed here.
+
    @param[in] memos Memos structure.
 */
 void memos_free(Memos * memos);
@@ -170,6 +188,10 @@ void memos_free(Memos * memos);
    it's ID. If there are no memo or multiple memos, then an error will
    be returned.
 
+   Search uses hash index, kept in Memos structure, so it does not depend
+   on the count of memos. Memo without text is treated as memo with empty
+   text when searching by header and text.
+
    @param[in] memos Memos structure.
    @param[in] header Will search memo with this header.
    @param[in] text Optional. Will search memo with this text. May be NULL, then
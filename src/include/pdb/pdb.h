@@ -12,8 +12,11 @@
    data from header. All application specific data should be read in
    application specific modules.
 
-   File descriptor from pdb_read() can be used in other modules to
-   read remaining application data in other modules.
+   Contents of PDB file are mapped to memory by pdb_read() and remain
+   available until pdb_write() or pdb_free(). Application data for
+   each record can be taken from this mapping by pdb_record_data() —
+   application specific modules should not read the file descriptor
+   by themselves.
 
    All mutli-byte numbers (offsets, timestamps, etc) will be saved to
    PDB in host system endianess!
@@ -34,6 +37,13 @@
    categories — add, delete and edit it. Each function will change
    application info offset and records qty fields in PDB structure to
    remain consistency of this structure.
+
+   Records are stored in arrays of fixed-size entries: records from
+   file are in one array, added records are appended to additional
+   arrays of growing size. Entries are never moved, so pointers to
+   records remain valid until pdb_free(). Deleted records are marked
+   as removed and skipped by iteration and by pdb_write(). Records can
+   be found by unique ID with pdb_record_get() through hash index.
 */
 
 /**
@@ -45,9 +55,18 @@
    functions:
    - pdb_open()
    - pdb_read()
+   - pdb_read_header()
    - pdb_write()
    - pdb_close()
    - pdb_free()
+   - pdb_record_data()
+   - pdb_app_info_data()
+
+   To write the whole PDB file with records data at once:
+   - pdb_image_init()
+   - pdb_image_add_record()
+   - pdb_image_write()
+   - pdb_image_free()
 
    To edit record list, when we add/edit/delete some application data in other
    module:
@@ -55,6 +74,14 @@
    - pdb_record_delete()
    - pdb_record_get_unique_id()
 
+   To iterate over record list and to find records:
+   - PDB_RECORD_FOREACH()
+   - pdb_record_first()
+   - pdb_record_last()
+   - pdb_record_next()
+   - pdb_record_prev()
+   - pdb_record_get()
+
    To operate with standard Palm OS categories:
    - pdb_category_get_id()
    - pdb_category_get_name()
@@ -69,7 +96,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include <sys/queue.h>
+#include "hash_index.h"
 
 
 /**
@@ -106,6 +133,18 @@
    Length of category string, including null-termination byte.
 */
 #define PDB_CATEGORY_LEN       16
+/**
+   Size of standard Palm OS category information in application info
+   block.
+
+   - Renamed categories: 16 bits
+   - Category names: 16 * 16 bytes
+   - Category IDs: 16 * 8 bits
+   - Last unique ID: 8 bits
+   - Padding: 8 bits
+*/
+#define PDB_CATEGORIES_SIZE    (2 + PDB_CATEGORIES_STD_QTY * \
+								(PDB_CATEGORY_LEN + 1) + 2)
 /**
    Default category on Palm PDA
 */
@@ -122,23 +161,28 @@
 
 
 /**
-   One record from record queue.
+   One record from record list.
 */
 struct PDBRecord
 {
-	uint32_t offset;                 /**< Offset to record data */
-	uint8_t attributes;              /**< Record attributes */
-	uint8_t id[3];                   /**< Record unique ID */
-#ifndef DOXYGEN_SHOULD_SKIP_THIS
-	TAILQ_ENTRY(PDBRecord) pointers; /**< Connection between elements in tail
-										queue */
-#endif
-	void * data;                     /**< Application specific data */
+	uint32_t offset;     /**< Offset to record data */
+	uint8_t attributes;  /**< Record attributes */
+	uint8_t id[3];       /**< Record unique ID */
+	void * data;         /**< Application specific data */
 };
+typedef struct PDBRecord PDBRecord;
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
-TAILQ_HEAD(RecordQueue, PDBRecord);
+/**
+   Array of records. Array is not reallocated, so records are not moved.
+*/
+struct __PDBRecordBlock
+{
+	PDBRecord * records; /**< Records */
+	size_t length;       /**< Qty of used entries, including deleted */
+	size_t capacity;     /**< Qty of allocated entries */
+};
 #endif
-typedef struct PDBRecord PDBRecord;
 
 /**
    Application info with standard Palm OS categories.
@@ -174,13 +218,42 @@ struct PDB
 	uint32_t nextRecordListOffset; /**< Offset to next record list.
 									  Should be 0x00000000 */
 	uint16_t recordsQty;           /**< Qty of records */
-	struct RecordQueue records;    /**< Record list */
 	uint16_t recordListPadding;    /**< Padding bytes after record list */
 	PDBCategories * categories;    /**< Categories from PDB file. May be NULL
 									  if not applicable */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	const uint8_t * _file;         /**< Contents of PDB file in memory */
+	size_t _fileSize;              /**< Size of PDB file in memory */
+	bool _fileMapped;              /**< True if contents are mapped with
+									  mmap(), false if read to heap */
+	struct __PDBRecordBlock * _blocks; /**< Arrays with record list */
+	size_t _blocksQty;             /**< Qty of arrays with record list */
+	HashIndex _byId;               /**< Records by unique ID */
+	uint8_t _categoriesByName[PDB_CATEGORIES_STD_QTY];
+								   /**< IDs of named categories, sorted by
+									  name */
+	uint8_t _categoriesNamed;      /**< Qty of named categories */
+#endif
 };
 typedef struct PDB PDB;
 
+/**
+   Contents of PDB file, laid out in memory before writing.
+*/
+struct PDBImage
+{
+	uint8_t * data;              /**< Contents of PDB file */
+	size_t length;               /**< Length of contents in bytes */
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+	size_t _capacity;            /**< Size of allocated memory */
+	PDB * _pdb;                  /**< PDB structure with record list */
+	PDBRecord * _nextRecord;     /**< Next record to add data of */
+	size_t _nextItem;            /**< Position of record list item for
+									next record */
+#endif
+};
+typedef struct PDBImage PDBImage;
+
 
 /**
    \defgroup pdb_file_ops Operations with PDB files
@@ -219,6 +292,23 @@ int pdb_open(const char * path);
 */
 PDB * pdb_read(const int fd, bool stdCatInfo);
 
+/**
+   Read only header of PDB file to given PDB structure.
+
+   Only fixed-size header is read from file, file is not loaded to memory
+   and record list is not parsed. Record list in PDB structure will be
+   empty and categories will be NULL, so PDB structure should not be
+   passed to pdb_write() or pdb_free().
+
+   Like in pdb_read(), all timestamps will be converted to Unix
+   timestamps.
+
+   @param[in] fd PDB file descriptor.
+   @param[out] pdb PDB structure to fill.
+   @return Zero on success or non-zero value on error.
+*/
+int pdb_read_header(const int fd, PDB * pdb);
+
 /**
    Write header and other standard information to PDB file.
 
@@ -227,6 +317,10 @@ PDB * pdb_read(const int fd, bool stdCatInfo);
    records in PDB structure with dirty flag set — this flag will be
    cleared.
 
+   Header, record list and categories are laid out in memory and
+   written to the start of file with one call. Records data in file
+   is not changed.
+
    @param[in] fd File descriptor, already opened by pdb_open().
    @param[in] pdb Pointer to the PDB structure with data.
    @return Zero if write successfull, otherwise non-zero.
@@ -247,6 +341,107 @@ void pdb_close(int fd);
 */
 void pdb_free(PDB * pdb);
 
+/**
+   Returns pointer to application data of record in PDB file.
+
+   Data is taken directly from PDB file contents, loaded to memory by
+   pdb_read(), without copying. Returned pointer is valid until
+   pdb_write() or pdb_free() is called for given PDB structure.
+
+   Record ends at the offset of the next record from record list or at
+   the end of PDB file for the last record.
+
+   @param[in] pdb PDB structure, filled by pdb_read().
+   @param[in] record Record from PDB structure.
+   @param[out] length Length of record data in bytes.
+   @return Pointer to record data or NULL on error.
+*/
+const uint8_t * pdb_record_data(PDB * pdb, PDBRecord * record,
+								size_t * length);
+
+/**
+   Returns pointer to application info block in PDB file.
+
+   Like pdb_record_data(), block is taken from PDB file contents in
+   memory. Block ends at the sort info or at the first record.
+
+   @param[in] pdb PDB structure, filled by pdb_read().
+   @param[out] length Length of application info in bytes.
+   @return Pointer to application info or NULL if there is no application
+   info in file or on error.
+*/
+const uint8_t * pdb_app_info_data(PDB * pdb, size_t * length);
+
+/**
+   @}
+*/
+
+
+/**
+   \defgroup pdb_image Write PDB file in one pass
+
+   Whole PDB file is laid out in memory: header, record list,
+   application info and data of each record. Offsets of records are
+   computed while their data is added. Then the file is written with
+   one call.
+
+   @{
+*/
+
+/**
+   Lay out header, record list and application info of PDB file.
+
+   Application info block of given length follows record list. If PDB
+   structure has categories, they are stored at the start of this
+   block, the rest of block is filled with zeroes.
+
+   @param[out] image PDB image to initialize.
+   @param[in] pdb PDB structure.
+   @param[in] appInfoLength Length of application info block in bytes.
+   @param[in] dataLength Expected length of all records data in
+   bytes. Memory is allocated in advance, so it is better to pass exact
+   length.
+   @return Zero on success or non-zero value on error.
+*/
+int pdb_image_init(PDBImage * image, PDB * pdb, size_t appInfoLength,
+				   size_t dataLength);
+
+/**
+   Add data of next record to PDB image.
+
+   Records should be added in the order of record list. Offset of
+   record is set to the current end of image.
+
+   @param[in] image PDB image.
+   @param[in] record Record from PDB structure.
+   @param[in] length Length of record data in bytes.
+   @return Pointer to memory for record data, which should be filled by
+   caller before the next call, or NULL on error.
+*/
+uint8_t * pdb_image_add_record(PDBImage * image, PDBRecord * record,
+							   size_t length);
+
+/**
+   Write PDB image to file.
+
+   All records should be added to image. File is truncated to the length
+   of image. Like pdb_write(), contents of file, loaded by pdb_read(),
+   are released.
+
+   @param[in] fd File descriptor, already opened by pdb_open().
+   @param[in] pdb PDB structure, used to initialize image.
+   @param[in] image PDB image.
+   @return Zero on success or non-zero value on error.
+*/
+int pdb_image_write(int fd, PDB * pdb, PDBImage * image);
+
+/**
+   Free memory of PDB image.
+
+   @param[in] image PDB image.
+*/
+void pdb_image_free(PDBImage * image);
+
 /**
    @}
 */
@@ -264,7 +459,8 @@ void pdb_free(PDB * pdb);
 /**
    Add new record to the end of record list.
 
-   Record unique ID will be generated inside this function.
+   Record unique ID will be generated inside this function, it differs
+   from IDs of other records in PDB structure.
 
    @param[in] pdb Pointer to PDB structure.
    @param[in] offset Offset to record's data.
@@ -292,12 +488,72 @@ PDBRecord * pdb_record_create_with_id(PDB * pdb, uint32_t offset,
 /**
    Delete given record from the records list.
 
+   Application specific data of record is freed. Entry of record is
+   marked as deleted and is not moved, so pointers to other records
+   remain valid.
+
    @param[in] pdb Pointer to PDB structure.
    @param[in] uniqueRecordId Unique record ID.
    @return Zero if success or non-zero value on error.
 */
 int pdb_record_delete(PDB * pdb, long uniqueRecordId);
 
+/**
+   Find record by unique ID.
+
+   @param[in] pdb Pointer to PDB structure.
+   @param[in] uniqueRecordId Unique record ID.
+   @return Record or NULL if not found.
+*/
+PDBRecord * pdb_record_get(PDB * pdb, uint32_t uniqueRecordId);
+
+/**
+   Returns first record from record list.
+
+   @param[in] pdb Pointer to PDB structure.
+   @return First record or NULL if record list is empty.
+*/
+PDBRecord * pdb_record_first(PDB * pdb);
+
+/**
+   Returns last record from record list.
+
+   @param[in] pdb Pointer to PDB structure.
+   @return Last record or NULL if record list is empty.
+*/
+PDBRecord * pdb_record_last(PDB * pdb);
+
+/**
+   Returns record, following the given one in record list.
+
+   @param[in] pdb Pointer to PDB structure.
+   @param[in] record Record from PDB structure.
+   @return Next record or NULL if given record is the last.
+*/
+PDBRecord * pdb_record_next(PDB * pdb, PDBRecord * record);
+
+/**
+   Returns record, preceding the given one in record list.
+
+   @param[in] pdb Pointer to PDB structure.
+   @param[in] record Record from PDB structure.
+   @return Previous record or NULL if given record is the first.
+*/
+PDBRecord * pdb_record_prev(PDB * pdb, PDBRecord * record);
+
+/**
+   Iterate over records in order of record list.
+
+   Record, pointed by record variable, should not be deleted inside the
+   loop.
+
+   @param[out] record Variable for the current record.
+   @param[in] pdb Pointer to PDB structure.
+*/
+#define PDB_RECORD_FOREACH(record, pdb)								\
+	for((record) = pdb_record_first(pdb); (record) != NULL;			\
+		(record) = pdb_record_next((pdb), (record)))
+
 /**
    Get unique record ID.
 
@@ -326,6 +582,11 @@ uint32_t pdb_record_get_unique_id(PDBRecord * record);
 
    Category ID starts from zero to PDB_CATEGORIES_STD_LEN - 1.
 
+   Pointer points into categories of PDB structure and is valid until
+   pdb_free(), so it can be shared between records instead of copying the
+   name. Name should not be changed through this pointer — use
+   pdb_category_add() and pdb_category_delete() instead.
+
    @param[in] pdb Pointer to PDB structure.
    @param[in] id Category ID. Starts from zero.
    @return Pointer to category name or NULL on error.
@@ -335,11 +596,15 @@ char * pdb_category_get_name(PDB * pdb, uint8_t id);
 /**
    Returns category ID by category name.
 
+   Category ID is the index of category (lower 4 bits of record
+   attributes). Categories are sorted by name once, when they are read,
+   added or deleted, so search does not depend on the qty of calls.
+
    @param[in] pdb Pointer to PDB structure.
    @param[in] name Category name.
    @return Category ID. Returns UINT8_MAX if category not found.
 */
-uint8_t pdb_category_get_id(PDB * pdb, char * name);
+uint8_t pdb_category_get_id(PDB * pdb, const char * name);
 
 /**
    Add new category.
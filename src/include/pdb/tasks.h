@@ -42,6 +42,7 @@
 #include <stdint.h>
 #include <sys/queue.h>
 #include <sys/time.h>
+#include "hash_index.h"
 #include "pdb/pdb.h"
 
 
@@ -106,7 +107,9 @@ struct Task
 {
 	char * header;         /**< Task header */
 	char * text;           /**< Task note */
-	char * category;       /**< Human-readable category of task */
+	uint8_t categoryId;    /**< Category ID of task */
+	const char * category; /**< Human-readable category of task, points to
+							  categories of ToDoDB PDB file */
 	TaskPriority priority; /**< Priority (from 1 to 5) */
 	uint8_t dueDay;        /**< Day of due date. 0 if no due date. */
 	uint8_t dueMonth;      /**< Month of due date. 0 if no due date. */
@@ -130,10 +133,12 @@ typedef struct TasksQueue TasksQueue;
 */
 struct Tasks
 {
-	TasksQueue queue;  /**< Tasks queue */
+	TasksQueue queue;    /**< Tasks queue */
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
-	PDB * _pdb_tododb; /**< PDB structure from ToDoDB file */
-	PDB * _pdb_tasks;  /**< PDB structure from TasksDB-PTod file */
+	PDB * _pdb_tododb;   /**< PDB structure from ToDoDB file */
+	PDB * _pdb_tasks;    /**< PDB structure from TasksDB-PTod file */
+	HashIndex _byId;     /**< Index of tasks by unique ID of ToDoDB record */
+	HashIndex _byHeader; /**< Index of tasks by header hash */
 #endif
 };
 typedef struct Tasks Tasks;
@@ -175,6 +180,11 @@ TasksFD tasks_open(const char * pathToDoDB, const char * pathTasksDB);
    files. Memory for Tasks structure will be initialized inside this
    function and can be freed by tasks_free().
 
+   Data from TasksDB-PTod records is joined to tasks from ToDoDB by
+   unique record ID. If there is no task with the same ID and header —
+   first task with the same header, which has no TasksDB-PTod data yet,
+   will be used.
+
    @param[in] tfd Initialized TasksFD with valid file descriptors inside.
    @return Tasks structure on success, NULL on error.
 */
@@ -258,37 +268,40 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 
    Can set due date or remove it if zero parameters are passed.
 
+   @param[in] tasks Tasks structure.
    @param[in] task Task to edit.
    @param[in] dueYear Due year for task or 0 to delete due date.
    @param[in] dueMonth Due month for task or 0 to delete due date.
    @param[in] dueDay Due day for task or 0 to delete due date.
    @return Zero on success or non-zero on error.
 */
-int tasks_task_set_due(Task * task, uint16_t dueYear, uint8_t dueMonth,
-					   uint8_t dueDay);
+int tasks_task_set_due(Tasks * tasks, Task * task, uint16_t dueYear,
+					   uint8_t dueMonth, uint8_t dueDay);
 
 /**
    Set alarm time for existing task.
 
    Can set alarm time or remove it if NULL parameter is passed.
 
+   @param[in] tasks Tasks structure.
    @param[in] task Task to edit.
    @param[in] alarm Alarm structure or NULL to delete alarm time from task.
    @return Zero on success or non-zero on error.
 */
-int tasks_task_set_alarm(Task * task, Alarm * alarm);
+int tasks_task_set_alarm(Tasks * tasks, Task * task, Alarm * alarm);
 
 /**
    Set repeat interval for existing task.
 
    Can set repeat interval or remove it if NULL parameter is passed.
 
+   @param[in] tasks Tasks structure.
    @param[in] task Task to edit.
    @param[in] repeat Repeat structure or NULL to delete repeat interval from
    task.
    @return Zero on success or non-zero on error.
 */
-int tasks_task_set_repeat(Task * task, Repeat * repeat);
+int tasks_task_set_repeat(Tasks * tasks, Task * task, Repeat * repeat);
 
 /**
    Edit main data on existing task.
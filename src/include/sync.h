@@ -15,6 +15,8 @@
 #ifndef _SYNC_H_
 #define _SYNC_H_
 
+#include "org_watch.h"
+
 /**
    Special return value for sync() - returns if Palm PDA
    not connected and sync impossible. In that case program
@@ -45,6 +47,8 @@ struct SyncSettings
 							   iteration. */
 	char * prevTasksPDB;    /**< Path to PDB file with TasksDB-PTod from
 							   previous iteration. */
+	OrgWatch * notesWatch;  /**< Watcher with notes, parsed before
+							   synchronization. May be NULL. */
 };
 typedef struct SyncSettings SyncSettings;
 
@@ -57,4 +61,29 @@ typedef struct SyncSettings SyncSettings;
 */
 int sync_this(SyncSettings * syncSettings);
 
+/**
+   Start watching OrgMode files to parse them before synchronization.
+
+   @param[in] syncSettings settings for synchronization.
+   @return Zero on success, non-zero value if files will be parsed only
+   while synchronizing.
+*/
+int sync_watch_init(SyncSettings * syncSettings);
+
+/**
+   Parse changed OrgMode files while Palm PDA is not connected.
+
+   @param[in] syncSettings settings for synchronization.
+   @return Descriptor, which becomes readable when OrgMode files are
+   changed, or -1 if there is no such descriptor.
+*/
+int sync_watch_update(SyncSettings * syncSettings);
+
+/**
+   Stop watching OrgMode files.
+
+   @param[in] syncSettings settings for synchronization.
+*/
+void sync_watch_free(SyncSettings * syncSettings);
+
 #endif
@@ -37,7 +37,6 @@ void log_write(int priority, const char * format, ...)
 	{
 		const char * priorityStr = "";
 		char timeStr[LOG_BUFFER_SIZE] = "\0";
-		char messageStr[LOG_BUFFER_SIZE] = "\0";
 		time_t currentTime;
 
 		switch(priority)
@@ -73,7 +72,7 @@ void log_write(int priority, const char * format, ...)
 		time(&currentTime);
 		if(currentTime == ((time_t) -1))
 		{
-			sprintf(messageStr, "UNKNOWN TIME");
+			sprintf(timeStr, "UNKNOWN TIME");
 			fprintf(stderr, "%s: Cannot get current time: %s", PACKAGE_NAME,
 					strerror(errno));
 		}
@@ -83,8 +82,9 @@ void log_write(int priority, const char * format, ...)
 			timeStr[strlen(timeStr) - 1] = '\0';
 		}
 		fprintf(stderr, "%s [%s]: ", timeStr, priorityStr);
-		vsprintf(messageStr, format, vlist);
-		fprintf(stderr, "%s\n", messageStr);
+		/* Message may be longer than buffer (e.g. long note text) */
+		vfprintf(stderr, format, vlist);
+		fputc('\n', stderr);
 	}
 	else
 	{
@@ -0,0 +1,697 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hash_index.h"
+#include "helper.h"
+#include "log.h"
+#include "org_index.h"
+
+
+/**
+   Signature and version of index file.
+*/
+#define ORG_INDEX_MAGIC "PSDORG01"
+
+/**
+   Length of string in index record, if there is no such string.
+*/
+#define ORG_INDEX_NO_STRING UINT32_MAX
+
+
+/**
+   Header of index file.
+*/
+struct __OrgIndexHeader
+{
+	char magic[8];      /**< ORG_INDEX_MAGIC without trailing zero */
+	int64_t size;       /**< Size of OrgMode file */
+	int64_t mtimeSec;   /**< Modification time of OrgMode file, seconds */
+	int64_t mtimeNsec;  /**< Modification time, nanoseconds */
+	int64_t zone[2];    /**< Local times, used to check timezone */
+	uint64_t qty;       /**< Qty of records after header */
+};
+
+/**
+   Record of index for one block of OrgMode file.
+
+   Record is followed by header, tag and text of headline, without
+   trailing zeroes.
+*/
+struct __OrgIndexRecord
+{
+	uint64_t offset;       /**< Offset of block in OrgMode file */
+	uint64_t length;       /**< Length of block in bytes */
+	uint64_t hash[2];      /**< UMASH fingerprint of block */
+	int64_t datetime1;     /**< Datetime of headline */
+	int64_t datetime2;     /**< Second part of time range */
+	uint32_t headerLength; /**< Length of header or ORG_INDEX_NO_STRING for
+							  text before the first headline */
+	uint32_t tagLength;    /**< Length of tag or ORG_INDEX_NO_STRING */
+	uint32_t textLength;   /**< Length of text or ORG_INDEX_NO_STRING */
+	uint8_t priority;      /**< Priority of headline */
+	uint8_t keyword;       /**< TODO-keyword of headline */
+	uint8_t repeaterValue; /**< Repeater value */
+	uint8_t repeaterRange; /**< Repeater range */
+};
+
+/**
+   Index, loaded from file.
+*/
+struct __OrgIndex
+{
+	char * data;                    /**< Contents of index file, mapped to
+									   memory */
+	size_t size;                    /**< Size of index file */
+	struct __OrgIndexHeader header; /**< Header of index */
+	HashIndex records;              /**< Records by the first half of
+									   fingerprint */
+};
+
+/**
+   Block of OrgMode file: text before the first headline or first-level
+   headline with text below it.
+*/
+struct __OrgIndexBlock
+{
+	size_t offset;         /**< Offset of block in file */
+	size_t length;         /**< Length of block in bytes */
+	int lines;             /**< Qty of newlines in block */
+	struct umash_fp hash;  /**< Fingerprint of block */
+	OrgModeEntry * entry;  /**< Headline from block or NULL */
+};
+
+static int _org_index_load(const char * indexPath, struct __OrgIndex * index);
+static void _org_index_free(struct __OrgIndex * index);
+static void _org_index_zone(int64_t zone[2]);
+static size_t _org_index_record_size(const struct __OrgIndexRecord * record);
+static const char * _org_index_find(struct __OrgIndex * index,
+									struct umash_fp hash, size_t length);
+static int _org_index_entry(const char * record, OrgModeEntry ** entry);
+static OrgModeEntries * _org_index_entries(struct __OrgIndex * index);
+static struct __OrgIndexBlock * _org_index_split(const char * buffer,
+												 size_t size, size_t * qty);
+static int _org_index_save(const char * indexPath, const struct stat * st,
+						   const int64_t zone[2],
+						   const struct __OrgIndexBlock * blocks, size_t qty);
+
+
+OrgModeEntries * org_index_parse(const char * path, const char * indexPath,
+								 unsigned int * errors, struct stat * fileStat)
+{
+	int64_t zone[2];
+	_org_index_zone(zone);
+
+	struct __OrgIndex index;
+	bool indexLoaded = _org_index_load(indexPath, &index) == 0;
+	if(indexLoaded && (index.header.zone[0] != zone[0] ||
+					   index.header.zone[1] != zone[1]))
+	{
+		log_write(LOG_DEBUG, "Timezone is changed, index %s is not used",
+				  indexPath);
+		_org_index_free(&index);
+		indexLoaded = false;
+	}
+
+	struct stat st;
+	if(indexLoaded && stat(path, &st) == 0 &&
+	   st.st_size == index.header.size &&
+	   st.st_mtim.tv_sec == index.header.mtimeSec &&
+	   st.st_mtim.tv_nsec == index.header.mtimeNsec)
+	{
+		log_write(LOG_DEBUG, "File %s is not changed, take all headlines "
+				  "from index", path);
+		OrgModeEntries * entries = _org_index_entries(&index);
+		_org_index_free(&index);
+		if(entries != NULL && errors != NULL)
+		{
+			*errors = 0;
+		}
+		if(entries != NULL && fileStat != NULL)
+		{
+			*fileStat = st;
+		}
+		return entries;
+	}
+
+	char * buffer;
+	size_t size;
+	if((buffer = read_orgmode_file(path, &size, &st)) == NULL)
+	{
+		if(indexLoaded)
+		{
+			_org_index_free(&index);
+		}
+		return NULL;
+	}
+	struct __OrgIndexBlock * blocks;
+	size_t qty;
+	OrgModeEntries * entries;
+	if((blocks = _org_index_split(buffer, size, &qty)) == NULL ||
+	   (entries = calloc(1, sizeof(OrgModeEntries))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory to parse %s: %s", path,
+				  strerror(errno));
+		free(blocks);
+		free(buffer);
+		if(indexLoaded)
+		{
+			_org_index_free(&index);
+		}
+		return NULL;
+	}
+	TAILQ_INIT(entries);
+
+	unsigned int totalErrors = 0;
+	size_t reused = 0;
+	int line = 1;
+	for(size_t i = 0; i < qty; i++)
+	{
+		const char * block = buffer + blocks[i].offset;
+		blocks[i].hash = str_fingerprint(block, blocks[i].length);
+		const char * record = indexLoaded ?
+			_org_index_find(&index, blocks[i].hash, blocks[i].length) : NULL;
+		if(record != NULL)
+		{
+			if(_org_index_entry(record, &blocks[i].entry))
+			{
+				goto org_index_parse_error;
+			}
+			if(blocks[i].entry != NULL)
+			{
+				/* Block may be moved since the index was saved */
+				blocks[i].entry->offset = blocks[i].offset;
+				blocks[i].entry->length = blocks[i].length;
+				TAILQ_INSERT_TAIL(entries, blocks[i].entry, pointers);
+			}
+			reused++;
+			line += blocks[i].lines;
+			continue;
+		}
+
+		/* Scanner needs two zero bytes after the block */
+		char * copy;
+		if((copy = malloc(blocks[i].length + 2)) == NULL)
+		{
+			log_write(LOG_ERR, "Cannot allocate memory for block of %s: %s",
+					  path, strerror(errno));
+			goto org_index_parse_error;
+		}
+		memcpy(copy, block, blocks[i].length);
+		copy[blocks[i].length] = '\0';
+		copy[blocks[i].length + 1] = '\0';
+		unsigned int blockErrors = 0;
+		OrgModeEntries * parsed = parse_orgmode_buffer(path, copy,
+													   blocks[i].length, line,
+													   blocks[i].offset,
+													   &blockErrors);
+		free(copy);
+		if(parsed == NULL)
+		{
+			goto org_index_parse_error;
+		}
+		totalErrors += blockErrors;
+		blocks[i].entry = TAILQ_FIRST(parsed);
+		TAILQ_CONCAT(entries, parsed, pointers);
+		free(parsed);
+		line += blocks[i].lines;
+	}
+	log_write(LOG_DEBUG, "Took %lu of %lu blocks of %s from index", reused,
+			  qty, path);
+
+	if(indexLoaded)
+	{
+		_org_index_free(&index);
+	}
+	/* Broken headlines are not in the list, so index cannot be built */
+	if(totalErrors == 0 &&
+	   _org_index_save(indexPath, &st, zone, blocks, qty))
+	{
+		log_write(LOG_WARNING, "Cannot save index of %s to %s", path,
+				  indexPath);
+		unlink(indexPath);
+	}
+	free(blocks);
+	free(buffer);
+	if(errors != NULL)
+	{
+		*errors = totalErrors;
+	}
+	if(fileStat != NULL)
+	{
+		*fileStat = st;
+	}
+	return entries;
+
+org_index_parse_error:
+	free_orgmode_parser(entries);
+	free(blocks);
+	free(buffer);
+	if(indexLoaded)
+	{
+		_org_index_free(&index);
+	}
+	return NULL;
+}
+
+
+/**
+   Load index from file.
+
+   @param[in] indexPath Path to index file.
+   @param[out] index Loaded index. Should be freed with _org_index_free().
+   @return 0 on success or -1 if there is no index or it cannot be used.
+*/
+static int _org_index_load(const char * indexPath, struct __OrgIndex * index)
+{
+	int fd;
+	if((fd = open(indexPath, O_RDONLY)) == -1)
+	{
+		log_write(LOG_DEBUG, "Cannot open index %s: %s", indexPath,
+				  strerror(errno));
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd, &st) == -1 ||
+	   (size_t)st.st_size < sizeof(struct __OrgIndexHeader))
+	{
+		log_write(LOG_WARNING, "Index %s is malformed", indexPath);
+		close(fd);
+		return -1;
+	}
+	index->size = st.st_size;
+	if((index->data = mmap(NULL, index->size, PROT_READ, MAP_PRIVATE, fd,
+						   0)) == MAP_FAILED)
+	{
+		log_write(LOG_WARNING, "Cannot map index %s to memory: %s",
+				  indexPath, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	close(fd);
+
+	memcpy(&index->header, index->data, sizeof(struct __OrgIndexHeader));
+	if(memcmp(index->header.magic, ORG_INDEX_MAGIC,
+			  sizeof(index->header.magic)) ||
+	   index->header.qty > index->size / sizeof(struct __OrgIndexRecord) ||
+	   hash_index_init(&index->records, index->header.qty))
+	{
+		log_write(LOG_WARNING, "Index %s is malformed", indexPath);
+		munmap(index->data, index->size);
+		return -1;
+	}
+
+	/* Check bounds of all records before using them */
+	const char * pointer = index->data + sizeof(struct __OrgIndexHeader);
+	const char * end = index->data + index->size;
+	for(uint64_t i = 0; i < index->header.qty; i++)
+	{
+		struct __OrgIndexRecord record;
+		if((size_t)(end - pointer) < sizeof(record))
+		{
+			break;
+		}
+		memcpy(&record, pointer, sizeof(record));
+		size_t size = _org_index_record_size(&record);
+		if(size == 0 || (size_t)(end - pointer) < size ||
+		   hash_index_insert(&index->records, record.hash[0],
+							 (void *)pointer))
+		{
+			break;
+		}
+		pointer += size;
+	}
+	if(pointer != end || index->records.count != index->header.qty)
+	{
+		log_write(LOG_WARNING, "Index %s is malformed", indexPath);
+		_org_index_free(index);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+   Free memory of loaded index.
+
+   @param[in] index Index.
+*/
+static void _org_index_free(struct __OrgIndex * index)
+{
+	hash_index_free(&index->records);
+	munmap(index->data, index->size);
+	index->data = NULL;
+}
+
+/**
+   Get Unix-time of two local dates, which are changed with timezone.
+
+   @param[out] zone Unix-time of local noons of 1st January and 1st July.
+*/
+static void _org_index_zone(int64_t zone[2])
+{
+	struct tm winter = {.tm_year = 100, .tm_mon = 0, .tm_mday = 1,
+						.tm_hour = 12, .tm_isdst = -1};
+	struct tm summer = {.tm_year = 100, .tm_mon = 6, .tm_mday = 1,
+						.tm_hour = 12, .tm_isdst = -1};
+	zone[0] = mktime(&winter);
+	zone[1] = mktime(&summer);
+}
+
+/**
+   Get size of record with its strings.
+
+   @param[in] record Record of index.
+   @return Size of record in bytes or 0 if record is malformed.
+*/
+static size_t _org_index_record_size(const struct __OrgIndexRecord * record)
+{
+	size_t size = sizeof(struct __OrgIndexRecord);
+	const uint32_t lengths[] = {record->headerLength, record->tagLength,
+								record->textLength};
+	for(size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		if(lengths[i] != ORG_INDEX_NO_STRING)
+		{
+			size += lengths[i];
+		}
+	}
+	if(record->headerLength == ORG_INDEX_NO_STRING &&
+	   (record->tagLength != ORG_INDEX_NO_STRING ||
+		record->textLength != ORG_INDEX_NO_STRING))
+	{
+		return 0;
+	}
+	return size;
+}
+
+/**
+   Find record of block with given fingerprint.
+
+   @param[in] index Index.
+   @param[in] hash Fingerprint of block.
+   @param[in] length Length of block.
+   @return Pointer to record in index data or NULL if there is no such
+   block in index.
+*/
+static const char * _org_index_find(struct __OrgIndex * index,
+									struct umash_fp hash, size_t length)
+{
+	size_t cursor = 0;
+	const char * pointer;
+	while((pointer = hash_index_find(&index->records, hash.hash[0], &cursor))
+		  != NULL)
+	{
+		struct __OrgIndexRecord record;
+		memcpy(&record, pointer, sizeof(record));
+		if(record.hash[1] == hash.hash[1] && record.length == length)
+		{
+			return pointer;
+		}
+	}
+	return NULL;
+}
+
+/**
+   Create headline from index record.
+
+   @param[in] record Pointer to record in index data.
+   @param[out] entry New headline or NULL if block has no headline.
+   @return 0 on success or -1 on error.
+*/
+static int _org_index_entry(const char * record, OrgModeEntry ** entry)
+{
+	struct __OrgIndexRecord data;
+	memcpy(&data, record, sizeof(data));
+	*entry = NULL;
+	if(data.headerLength == ORG_INDEX_NO_STRING)
+	{
+		return 0;
+	}
+
+	OrgModeEntry * result;
+	if((result = calloc(1, sizeof(OrgModeEntry))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for headline from index: "
+				  "%s", strerror(errno));
+		return -1;
+	}
+	const char * strings = record + sizeof(data);
+	if((result->header = strndup(strings, data.headerLength)) == NULL)
+	{
+		goto org_index_entry_error;
+	}
+	strings += data.headerLength;
+	if(data.tagLength != ORG_INDEX_NO_STRING)
+	{
+		if((result->tag = strndup(strings, data.tagLength)) == NULL)
+		{
+			goto org_index_entry_error;
+		}
+		strings += data.tagLength;
+	}
+	if(data.textLength != ORG_INDEX_NO_STRING &&
+	   (result->text = strndup(strings, data.textLength)) == NULL)
+	{
+		goto org_index_entry_error;
+	}
+	result->priority = data.priority;
+	result->keyword = data.keyword;
+	result->datetime1 = data.datetime1;
+	result->datetime2 = data.datetime2;
+	result->repeaterValue = data.repeaterValue;
+	result->repeaterRange = data.repeaterRange;
+	result->offset = data.offset;
+	result->length = data.length;
+	*entry = result;
+	return 0;
+
+org_index_entry_error:
+	log_write(LOG_ERR, "Cannot copy headline from index: %s",
+			  strerror(errno));
+	free(result->header);
+	free(result->tag);
+	free(result);
+	return -1;
+}
+
+/**
+   Create all headlines from index.
+
+   @param[in] index Index.
+   @return Headlines or NULL on error.
+*/
+static OrgModeEntries * _org_index_entries(struct __OrgIndex * index)
+{
+	OrgModeEntries * entries;
+	if((entries = calloc(1, sizeof(OrgModeEntries))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for headlines from index: "
+				  "%s", strerror(errno));
+		return NULL;
+	}
+	TAILQ_INIT(entries);
+
+	const char * pointer = index->data + sizeof(struct __OrgIndexHeader);
+	for(uint64_t i = 0; i < index->header.qty; i++)
+	{
+		OrgModeEntry * entry;
+		if(_org_index_entry(pointer, &entry))
+		{
+			free_orgmode_parser(entries);
+			return NULL;
+		}
+		if(entry != NULL)
+		{
+			TAILQ_INSERT_TAIL(entries, entry, pointers);
+		}
+		struct __OrgIndexRecord record;
+		memcpy(&record, pointer, sizeof(record));
+		pointer += _org_index_record_size(&record);
+	}
+	return entries;
+}
+
+/**
+   Split contents of OrgMode file to blocks.
+
+   Every first-level headline starts the new block.
+
+   @param[in] buffer Contents of file.
+   @param[in] size Size of contents.
+   @param[out] qty Qty of blocks.
+   @return Array of blocks, which should be freed with free(), or NULL on
+   error.
+*/
+static struct __OrgIndexBlock * _org_index_split(const char * buffer,
+												 size_t size, size_t * qty)
+{
+	size_t capacity = 64;
+	struct __OrgIndexBlock * blocks;
+	if((blocks = calloc(capacity, sizeof(struct __OrgIndexBlock))) == NULL)
+	{
+		return NULL;
+	}
+
+	*qty = 0;
+	size_t start = 0;
+	int lines = 0;
+	const char * end = buffer + size;
+	for(const char * line = buffer; line < end;)
+	{
+		if(line != buffer + start && end - line > 1 && line[0] == '*' &&
+		   line[1] == ' ')
+		{
+			if(*qty == capacity)
+			{
+				struct __OrgIndexBlock * newBlocks;
+				if((newBlocks = realloc(blocks, capacity * 2 *
+										sizeof(struct __OrgIndexBlock))) ==
+				   NULL)
+				{
+					free(blocks);
+					return NULL;
+				}
+				blocks = newBlocks;
+				capacity *= 2;
+			}
+			blocks[*qty] = (struct __OrgIndexBlock){
+				.offset = start, .length = line - buffer - start,
+				.lines = lines};
+			(*qty)++;
+			start = line - buffer;
+			lines = 0;
+		}
+		const char * newline = memchr(line, '\n', end - line);
+		if(newline == NULL)
+		{
+			break;
+		}
+		lines++;
+		line = newline + 1;
+	}
+
+	if(start < size)
+	{
+		if(*qty == capacity)
+		{
+			struct __OrgIndexBlock * newBlocks;
+			if((newBlocks = realloc(blocks, (capacity + 1) *
+									sizeof(struct __OrgIndexBlock))) == NULL)
+			{
+				free(blocks);
+				return NULL;
+			}
+			blocks = newBlocks;
+		}
+		blocks[*qty] = (struct __OrgIndexBlock){
+			.offset = start, .length = size - start, .lines = lines};
+		(*qty)++;
+	}
+	return blocks;
+}
+
+/**
+   Save index of OrgMode file.
+
+   Index is saved atomically with save_data().
+
+   @param[in] indexPath Path to index file.
+   @param[in] st Status of OrgMode file, when it was read.
+   @param[in] zone Local times to check timezone.
+   @param[in] blocks Blocks of OrgMode file with parsed headlines.
+   @param[in] qty Qty of blocks.
+   @return 0 on success or -1 on error.
+*/
+static int _org_index_save(const char * indexPath, const struct stat * st,
+						   const int64_t zone[2],
+						   const struct __OrgIndexBlock * blocks, size_t qty)
+{
+	size_t size = sizeof(struct __OrgIndexHeader);
+	for(size_t i = 0; i < qty; i++)
+	{
+		size += sizeof(struct __OrgIndexRecord);
+		const OrgModeEntry * entry = blocks[i].entry;
+		if(entry != NULL)
+		{
+			size += strlen(entry->header);
+			size += entry->tag != NULL ? strlen(entry->tag) : 0;
+			size += entry->text != NULL ? strlen(entry->text) : 0;
+		}
+	}
+
+	char * data;
+	if((data = malloc(size)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for index: %s",
+				  strerror(errno));
+		return -1;
+	}
+	struct __OrgIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ORG_INDEX_MAGIC, sizeof(header.magic));
+	header.size = st->st_size;
+	header.mtimeSec = st->st_mtim.tv_sec;
+	header.mtimeNsec = st->st_mtim.tv_nsec;
+	header.zone[0] = zone[0];
+	header.zone[1] = zone[1];
+	header.qty = qty;
+	memcpy(data, &header, sizeof(header));
+
+	char * pointer = data + sizeof(header);
+	for(size_t i = 0; i < qty; i++)
+	{
+		const OrgModeEntry * entry = blocks[i].entry;
+		struct __OrgIndexRecord record;
+		memset(&record, 0, sizeof(record));
+		record.offset = blocks[i].offset;
+		record.length = blocks[i].length;
+		record.hash[0] = blocks[i].hash.hash[0];
+		record.hash[1] = blocks[i].hash.hash[1];
+		record.headerLength = ORG_INDEX_NO_STRING;
+		record.tagLength = ORG_INDEX_NO_STRING;
+		record.textLength = ORG_INDEX_NO_STRING;
+		if(entry != NULL)
+		{
+			record.datetime1 = entry->datetime1;
+			record.datetime2 = entry->datetime2;
+			record.headerLength = strlen(entry->header);
+			record.tagLength = entry->tag != NULL ? strlen(entry->tag) :
+				ORG_INDEX_NO_STRING;
+			record.textLength = entry->text != NULL ? strlen(entry->text) :
+				ORG_INDEX_NO_STRING;
+			record.priority = entry->priority;
+			record.keyword = entry->keyword;
+			record.repeaterValue = entry->repeaterValue;
+			record.repeaterRange = entry->repeaterRange;
+		}
+		memcpy(pointer, &record, sizeof(record));
+		pointer += sizeof(record);
+		if(entry != NULL)
+		{
+			memcpy(pointer, entry->header, record.headerLength);
+			pointer += record.headerLength;
+			if(entry->tag != NULL)
+			{
+				memcpy(pointer, entry->tag, record.tagLength);
+				pointer += record.tagLength;
+			}
+			if(entry->text != NULL)
+			{
+				memcpy(pointer, entry->text, record.textLength);
+				pointer += record.textLength;
+			}
+		}
+	}
+
+	int result = save_data(indexPath, data, size, S_IRUSR | S_IWUSR);
+	free(data);
+	return result;
+}
@@ -1,31 +1,108 @@
 #include <errno.h>
-#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include "helper.h"
 #include "log.h"
+#include "org_index.h"
 #include "org_notes.h"
 #include "orgmode_parser.h"
 #include "parser.h"
 #include "pdb/pdb.h"
 
 
-OrgNotes * org_notes_parse(const char * path)
+/**
+   Initial size of buffer for new notes.
+*/
+#define ORG_NOTES_BUFFER_SIZE 4096
+
+
+/**
+   Note, which replaces note in OrgMode file.
+*/
+struct __OrgNotesReplacement
+{
+	size_t offset;      /**< Offset of replaced note in file */
+	size_t length;      /**< Length of replaced note in file */
+	const char * note;  /**< New note in OrgMode format */
+	size_t noteLength;  /**< Length of new note */
+};
+
+/**
+   Changes of OrgMode file, collected during synchronization.
+*/
+struct __OrgNotesWriter
+{
+	const char * path;      /**< Path to OrgMode file */
+	Arena * arena;          /**< Arena for new notes */
+	off_t size;             /**< Size of file when notes were parsed */
+	struct timespec mtime;  /**< Modification time of file when notes were
+							   parsed */
+	char * added;           /**< New notes to add to the end of file */
+	size_t addedLength;     /**< Length of new notes */
+	size_t addedCapacity;   /**< Size of buffer for new notes */
+	struct __OrgNotesReplacement * replacements; /**< Replaced notes */
+	size_t qty;             /**< Qty of replaced notes */
+	size_t capacity;        /**< Size of array for replaced notes */
+};
+
+static void _org_notes_hash_headers(OrgNotes * notes, size_t qty);
+static char * _org_notes_format(Arena * arena, const char * header,
+								const char * text, const char * category,
+								size_t * length);
+static int _org_notes_compare(const void * first, const void * second);
+static bool _org_notes_headline(const char * buffer, size_t size,
+								size_t offset);
+static size_t _org_notes_length(const char * note, size_t length);
+static int _org_notes_save(OrgNotesWriter * writer);
+
+
+OrgNotes * org_notes_parse(const char * path, const char * indexPath,
+						   Arena * arena, struct stat * fileStat)
 {
 	OrgModeEntries * parseResult;
-	if((parseResult = parse_orgmode_file(path)) == NULL)
+	unsigned int errors = 0;
+	if(indexPath != NULL)
+	{
+		parseResult = org_index_parse(path, indexPath, &errors, fileStat);
+	}
+	else
+	{
+		/* Status is taken from the same read, which offsets of notes
+		   belong to */
+		char * buffer;
+		size_t size;
+		if((buffer = read_orgmode_file(path, &size, fileStat)) == NULL)
+		{
+			return NULL;
+		}
+		parseResult = parse_orgmode_buffer(path, buffer, size, 1, 0, &errors);
+		free(buffer);
+	}
+	if(parseResult == NULL)
 	{
 		return NULL;
 	}
 
+	/* Skipped note would look like deleted on desktop, so do not sync
+	   until file is fixed */
+	if(errors > 0)
+	{
+		log_write(LOG_ERR, "There are %u broken notes in %s file, fix them "
+				  "to synchronize notes", errors, path);
+		free_orgmode_parser(parseResult);
+		return NULL;
+	}
+
 	OrgNotes * result;
-	if((result = calloc(1, sizeof(OrgNotes))) == NULL)
+	if((result = arena_alloc(arena, sizeof(OrgNotes))) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for notes from OrgMode: %s",
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot allocate memory for notes from OrgMode");
+		free_orgmode_parser(parseResult);
 		return NULL;
 	}
 	TAILQ_INIT(result);
@@ -37,143 +114,419 @@ OrgNotes * org_notes_parse(const char * path)
 		return result;
 	}
 
+	size_t notesQty = 0;
 	OrgModeEntry * entry;
 	TAILQ_FOREACH(entry, parseResult, pointers)
 	{
+		/* Skipped note would look like deleted on desktop too */
 		OrgNote * note;
-		if((note = calloc(1, sizeof(OrgNote))) == NULL)
+		if((note = arena_alloc(arena, sizeof(OrgNote))) == NULL)
 		{
 			log_write(LOG_ERR, "Failed to allocate memory for note: \"%s\"",
 					  entry->header);
-			continue;
+			free_orgmode_parser(parseResult);
+			return NULL;
 		}
-		note->header = iconv_utf8_to_cp1251(entry->header);
-		note->text = entry->text != NULL ? iconv_utf8_to_cp1251(entry->text) : NULL;
-		note->category = entry->tag != NULL ? strdup(entry->tag) : NULL;
-		note->header_hash = str_hash(note->header, strlen(note->header));
-
-		if(TAILQ_EMPTY(result))
+		note->header = iconv_utf8_to_cp1251_arena(arena, entry->header);
+		note->text = entry->text != NULL ?
+			iconv_utf8_to_cp1251_arena(arena, entry->text) : NULL;
+		note->category = entry->tag != NULL ?
+			arena_strdup(arena, entry->tag) : NULL;
+		note->offset = entry->offset;
+		note->length = entry->length;
+		if(note->header == NULL ||
+		   (entry->text != NULL && note->text == NULL) ||
+		   (entry->tag != NULL && note->category == NULL))
 		{
-			TAILQ_INSERT_HEAD(result, note, pointers);
-		}
-		else
-		{
-			TAILQ_INSERT_TAIL(result, note, pointers);
+			log_write(LOG_ERR, "Failed to convert note \"%s\" to CP1251, fix "
+					  "it to synchronize notes", entry->header);
+			free_orgmode_parser(parseResult);
+			return NULL;
 		}
+		notesQty++;
+		TAILQ_INSERT_TAIL(result, note, pointers);
 	}
 
 	free_orgmode_parser(parseResult);
+	_org_notes_hash_headers(result, notesQty);
 	return result;
 }
 
-void org_notes_free(OrgNotes * notes)
+OrgNotesWriter * org_notes_open(const char * path,
+								const struct stat * fileStat, Arena * arena)
 {
-	if(TAILQ_EMPTY(notes))
+	OrgNotesWriter * writer;
+	if((writer = arena_alloc(arena, sizeof(OrgNotesWriter))) == NULL ||
+	   (writer->path = arena_strdup(arena, path)) == NULL)
 	{
-		free(notes);
-		return;
+		log_write(LOG_ERR, "Cannot allocate memory for writer of OrgMode file "
+				  "\"%s\"", path);
+		return NULL;
 	}
+	writer->arena = arena;
+	writer->size = fileStat->st_size;
+	writer->mtime = fileStat->st_mtim;
+	return writer;
+}
 
-	OrgNote * note;
-	TAILQ_FOREACH(note, notes, pointers)
+int org_notes_write(OrgNotesWriter * writer, const char * header,
+					const char * text, const char * category)
+{
+	size_t length;
+	char * note;
+	if((note = _org_notes_format(writer->arena, header, text, category,
+								 &length)) == NULL)
+	{
+		return -1;
+	}
+
+	if(writer->addedLength + length > writer->addedCapacity)
 	{
-		if(note->category != NULL)
+		size_t capacity = writer->addedCapacity > 0 ?
+			writer->addedCapacity : ORG_NOTES_BUFFER_SIZE;
+		while(capacity < writer->addedLength + length)
 		{
-			free(note->category);
+			capacity *= 2;
 		}
-		if(note->text != NULL)
+		char * added;
+		if((added = realloc(writer->added, capacity)) == NULL)
 		{
-			free(note->text);
+			log_write(LOG_ERR, "Cannot allocate memory for new notes: %s",
+					  strerror(errno));
+			return -1;
 		}
-		free(note->header);
-		free(note);
+		writer->added = added;
+		writer->addedCapacity = capacity;
 	}
-	free(notes);
-	return;
+	memcpy(writer->added + writer->addedLength, note, length);
+	writer->addedLength += length;
+	return 0;
 }
 
-int org_notes_open(const char * path)
+int org_notes_replace(OrgNotesWriter * writer, const OrgNote * note,
+					  const char * header, const char * text,
+					  const char * category)
 {
-	int fd;
-	if((fd = open(path, O_WRONLY | O_APPEND)) == -1)
+	if(writer->qty == writer->capacity)
+	{
+		size_t capacity = writer->capacity > 0 ? writer->capacity * 2 : 16;
+		struct __OrgNotesReplacement * replacements;
+		if((replacements = realloc(writer->replacements, capacity *
+								   sizeof(struct __OrgNotesReplacement))) ==
+		   NULL)
+		{
+			log_write(LOG_ERR, "Cannot allocate memory for replaced notes: %s",
+					  strerror(errno));
+			return -1;
+		}
+		writer->replacements = replacements;
+		writer->capacity = capacity;
+	}
+
+	struct __OrgNotesReplacement * replacement =
+		&writer->replacements[writer->qty];
+	if((replacement->note = _org_notes_format(writer->arena, header, text,
+											  category,
+											  &replacement->noteLength)) ==
+	   NULL)
 	{
-		log_write(LOG_ERR, "Cannot open OrgMode file \"%s\" for writing: %s",
-				  path, strerror(errno));
 		return -1;
 	}
-	return fd;
+	replacement->offset = note->offset;
+	replacement->length = note->length;
+	writer->qty++;
+	return 0;
+}
+
+int org_notes_close(OrgNotesWriter * writer)
+{
+	int result = 0;
+	if(writer->addedLength > 0 || writer->qty > 0)
+	{
+		result = _org_notes_save(writer);
+	}
+	free(writer->added);
+	free(writer->replacements);
+	return result;
 }
 
-int org_notes_write(int fd, char * header, char * text, char * category)
+
+/**
+   Format note for OrgMode file.
+
+   @param[in] arena Arena for formatted note.
+   @param[in] header Header of note in CP1251.
+   @param[in] text Text of note in CP1251. May be NULL.
+   @param[in] category Category of note. May be NULL.
+   @param[out] length Length of formatted note.
+   @return Note in UTF-8, allocated from arena, or NULL on error.
+*/
+static char * _org_notes_format(Arena * arena, const char * header,
+								const char * text, const char * category,
+								size_t * length)
 {
-	char * conv_header = iconv_cp1251_to_utf8(header);
-	char * conv_text = text != NULL ? iconv_cp1251_to_utf8(text) : NULL;
+	char * convHeader = iconv_cp1251_to_utf8_arena(arena, header);
+	char * convText = text != NULL ?
+		iconv_cp1251_to_utf8_arena(arena, text) : NULL;
+	if(convHeader == NULL || (text != NULL && convText == NULL))
+	{
+		log_write(LOG_ERR, "Cannot convert note \"%s\" to UTF-8", header);
+		return NULL;
+	}
 	if(category != NULL && strncmp(PDB_DEFAULT_CATEGORY, category,
 								   strlen(PDB_DEFAULT_CATEGORY)) == 0)
 	{
 		category = NULL;
 	}
 
-	unsigned int noteLen = strlen(conv_header);
-	noteLen += conv_text != NULL ? strlen(conv_text) : 0;
+	size_t noteLen = strlen(convHeader);
+	noteLen += convText != NULL ? strlen(convText) : 0;
 	noteLen += category != NULL ? strlen(category) : 0;
 	noteLen += 3                       /* For "* " before header + '\n' after header */
 		+ (category != NULL ? 4 : 0)   /* For "\t\t:" before tag + ':' after tag */
-		+ (conv_text != NULL ? 1 : 0)  /* For '\n' after text */
+		+ (convText != NULL ? 1 : 0)   /* For '\n' after text */
 		+ 1;                           /* For '\0' at the end of string */
 
 	char * note;
-
-	if((note = calloc(noteLen, sizeof(char))) == NULL)
+	if((note = arena_alloc(arena, noteLen)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for new OrgMode note: %s",
-				  strerror(errno));
-		free(conv_header);
-		if(conv_text != NULL)
-		{
-			free(conv_text);
-		}
-		return -1;
+		log_write(LOG_ERR, "Cannot allocate memory for new OrgMode note");
+		return NULL;
 	}
 
-	if(conv_text != NULL && category != NULL)
+	if(convText != NULL && category != NULL)
 	{
-		snprintf(note, noteLen, "* %s\t\t:%s:\n%s\n", conv_header, category, conv_text);
+		snprintf(note, noteLen, "* %s\t\t:%s:\n%s\n", convHeader, category,
+				 convText);
 	}
-	else if(conv_text != NULL)
+	else if(convText != NULL)
 	{
-		snprintf(note, noteLen, "* %s\n%s\n", conv_header, conv_text);
+		snprintf(note, noteLen, "* %s\n%s\n", convHeader, convText);
 	}
 	else if(category != NULL)
 	{
-		snprintf(note, noteLen, "* %s\t\t:%s:\n", conv_header, category);
+		snprintf(note, noteLen, "* %s\t\t:%s:\n", convHeader, category);
 	}
 	else
 	{
-		snprintf(note, noteLen, "* %s\n", conv_header);
+		snprintf(note, noteLen, "* %s\n", convHeader);
 	}
+	*length = strlen(note);
+	return note;
+}
+
+/**
+   Compare replaced notes by their offsets in file, for qsort().
 
-	if(write_chunks(fd, note, strlen(note)))
+   @param[in] first First replaced note.
+   @param[in] second Second replaced note.
+   @return Negative, zero or positive value like strcmp().
+*/
+static int _org_notes_compare(const void * first, const void * second)
+{
+	size_t firstOffset = ((const struct __OrgNotesReplacement *)first)->offset;
+	size_t secondOffset =
+		((const struct __OrgNotesReplacement *)second)->offset;
+	return (firstOffset > secondOffset) - (firstOffset < secondOffset);
+}
+
+/**
+   Check that first-level headline starts at given offset.
+
+   @param[in] buffer Contents of OrgMode file.
+   @param[in] size Size of contents.
+   @param[in] offset Offset in contents.
+   @return True if there is headline at offset.
+*/
+static bool _org_notes_headline(const char * buffer, size_t size,
+								size_t offset)
+{
+	return offset + 1 < size && (offset == 0 || buffer[offset - 1] == '\n') &&
+		buffer[offset] == '*' && buffer[offset + 1] == ' ';
+}
+
+/**
+   Compute length of note without lines, which are skipped by scanner.
+
+   Note lasts up to the next headline, so blank lines and OrgMode
+   directives after its text are not a part of it and should be kept.
+
+   @param[in] note Note in OrgMode file, starting from headline.
+   @param[in] length Length of note up to the next headline.
+   @return Length of headline and text of note.
+*/
+static size_t _org_notes_length(const char * note, size_t length)
+{
+	const char * headlineEnd = memchr(note, '\n', length);
+	size_t headlineLength = headlineEnd != NULL ?
+		(size_t)(headlineEnd - note) + 1 : length;
+	while(length > headlineLength)
 	{
-		log_write(LOG_ERR, "Failed to write note to OrgMode file.\nNote: \"%s\"",
-				  note);
-		free(conv_header);
-		if(conv_text != NULL)
+		size_t line = note[length - 1] == '\n' ? length - 1 : length;
+		while(note[line - 1] != '\n')
 		{
-			free(conv_text);
+			line--;
 		}
-		return -1;
+		bool blank = line + strspn(note + line, " \t\n") >= length;
+		bool directive = line + 2 < length && note[line] == '#' &&
+			note[line + 1] == '+' && note[line + 2] != '\n';
+		if(!blank && !directive)
+		{
+			break;
+		}
+		length = line;
 	}
-	return 0;
+	return length;
 }
 
-int org_notes_close(int fd)
+/**
+   Write collected changes to OrgMode file atomically.
+
+   @param[in] writer Writer of OrgMode file.
+   @return 0 on success or -1 on error.
+*/
+static int _org_notes_save(OrgNotesWriter * writer)
 {
-	if(close(fd) == -1)
+	/* File is replaced by rename, so do not replace symbolic link */
+	char * path;
+	if((path = realpath(writer->path, NULL)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot close OrgMode file: %s",
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot resolve path to OrgMode file \"%s\": %s",
+				  writer->path, strerror(errno));
 		return -1;
 	}
+	char * buffer;
+	size_t size;
+	struct stat st;
+	if((buffer = read_orgmode_file(path, &size, &st)) == NULL)
+	{
+		free(path);
+		return -1;
+	}
+	char * data = NULL;
+	if(st.st_size != writer->size ||
+	   st.st_mtim.tv_sec != writer->mtime.tv_sec ||
+	   st.st_mtim.tv_nsec != writer->mtime.tv_nsec)
+	{
+		log_write(LOG_ERR, "OrgMode file \"%s\" is changed while "
+				  "synchronizing, notes are not written to it", writer->path);
+		goto org_notes_save_error;
+	}
+
+	/* Replaced notes should be still in place and should not overlap */
+	qsort(writer->replacements, writer->qty,
+		  sizeof(struct __OrgNotesReplacement), _org_notes_compare);
+	size_t newSize = size + writer->addedLength + 1;
+	size_t end = 0;
+	for(size_t i = 0; i < writer->qty; i++)
+	{
+		struct __OrgNotesReplacement * replacement = &writer->replacements[i];
+		if(replacement->offset < end || replacement->offset > size ||
+		   replacement->length > size - replacement->offset ||
+		   !_org_notes_headline(buffer, size, replacement->offset))
+		{
+			log_write(LOG_ERR, "Cannot find note at offset %lu in OrgMode "
+					  "file \"%s\"", replacement->offset, writer->path);
+			goto org_notes_save_error;
+		}
+		replacement->length = _org_notes_length(buffer + replacement->offset,
+												replacement->length);
+		end = replacement->offset + replacement->length;
+		newSize = newSize - replacement->length + replacement->noteLength;
+	}
+
+	if((data = malloc(newSize)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for new contents of "
+				  "OrgMode file \"%s\": %s", writer->path, strerror(errno));
+		goto org_notes_save_error;
+	}
+	size_t length = 0;
+	size_t position = 0;
+	for(size_t i = 0; i < writer->qty; i++)
+	{
+		struct __OrgNotesReplacement * replacement = &writer->replacements[i];
+		memcpy(data + length, buffer + position,
+			   replacement->offset - position);
+		length += replacement->offset - position;
+		memcpy(data + length, replacement->note, replacement->noteLength);
+		length += replacement->noteLength;
+		position = replacement->offset + replacement->length;
+	}
+	memcpy(data + length, buffer + position, size - position);
+	length += size - position;
+	if(writer->addedLength > 0)
+	{
+		/* New note should start from the new line */
+		if(length > 0 && data[length - 1] != '\n')
+		{
+			data[length++] = '\n';
+		}
+		memcpy(data + length, writer->added, writer->addedLength);
+		length += writer->addedLength;
+	}
+
+	if(save_data(path, data, length, st.st_mode & 07777))
+	{
+		log_write(LOG_ERR, "Cannot write notes to OrgMode file \"%s\"",
+				  writer->path);
+		goto org_notes_save_error;
+	}
+	free(data);
+	free(buffer);
+	free(path);
 	return 0;
+
+org_notes_save_error:
+	free(data);
+	free(buffer);
+	free(path);
+	return -1;
+}
+
+/**
+   Compute hashes of all note headers in one batch.
+
+   @param[in] notes Parsed notes.
+   @param[in] qty Qty of notes.
+*/
+static void _org_notes_hash_headers(OrgNotes * notes, size_t qty)
+{
+	if(qty == 0)
+	{
+		return;
+	}
+
+	HashString * headers = calloc(qty, sizeof(HashString));
+	uint64_t * hashes = calloc(qty, sizeof(uint64_t));
+	OrgNote * note;
+	if(headers == NULL || hashes == NULL)
+	{
+		/* Fallback to hashing one header at a time */
+		TAILQ_FOREACH(note, notes, pointers)
+		{
+			note->header_hash = note->header != NULL ?
+				str_hash(note->header, strlen(note->header)) : 0;
+		}
+		free(headers);
+		free(hashes);
+		return;
+	}
+
+	size_t i = 0;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		headers[i].string = note->header != NULL ? note->header : "";
+		headers[i].length = strlen(headers[i].string);
+		i++;
+	}
+	str_hash_batch(headers, qty, hashes);
+	i = 0;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		note->header_hash = hashes[i++];
+	}
+
+	free(headers);
+	free(hashes);
 }
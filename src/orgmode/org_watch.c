@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include "log.h"
+#include "org_watch.h"
+
+
+#if defined(__linux__)
+/**
+   Size of buffer for inotify events.
+*/
+#define ORG_WATCH_EVENTS_BUFFER_LEN (16 * (sizeof(struct inotify_event) + \
+										   NAME_MAX + 1))
+
+static void _org_watch_add(OrgWatch * watch);
+static void _org_watch_read_events(OrgWatch * watch);
+#endif
+
+
+int org_watch_init(OrgWatch * watch, const char * path,
+				   const char * indexPath)
+{
+	memset(watch, 0, sizeof(OrgWatch));
+	watch->fd = -1;
+	if((watch->_path = strdup(path)) == NULL ||
+	   (indexPath != NULL && (watch->_indexPath = strdup(indexPath)) == NULL))
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for watcher of %s: %s",
+				  path, strerror(errno));
+		org_watch_free(watch);
+		return -1;
+	}
+	const char * name = strrchr(watch->_path, '/');
+	watch->_name = name != NULL ? name + 1 : watch->_path;
+
+#if defined(__linux__)
+	_org_watch_add(watch);
+#endif
+	return 0;
+}
+
+int org_watch_update(OrgWatch * watch)
+{
+#if defined(__linux__)
+	_org_watch_read_events(watch);
+#endif
+
+	struct stat st;
+	if(stat(watch->_path, &st))
+	{
+		log_write(LOG_WARNING, "Cannot get status of %s: %s", watch->_path,
+				  strerror(errno));
+		arena_reset(&watch->_arena);
+		watch->_notes = NULL;
+		watch->_parsed = false;
+		return -1;
+	}
+	if(watch->_parsed && !watch->_changed && st.st_size == watch->_size &&
+	   st.st_mtim.tv_sec == watch->_mtimeSec &&
+	   st.st_mtim.tv_nsec == watch->_mtimeNsec)
+	{
+		return watch->_notes != NULL ? 0 : -1;
+	}
+
+	/* Status is taken before parsing, so change while parsing will be
+	   noticed by the next call */
+	arena_reset(&watch->_arena);
+	watch->_changed = false;
+	watch->_parsed = true;
+	watch->_size = st.st_size;
+	watch->_mtimeSec = st.st_mtim.tv_sec;
+	watch->_mtimeNsec = st.st_mtim.tv_nsec;
+	if((watch->_notes = org_notes_parse(watch->_path, watch->_indexPath,
+										&watch->_arena,
+										&watch->_fileStat)) == NULL)
+	{
+		log_write(LOG_WARNING, "Cannot parse %s before synchronization, wait "
+				  "for its change", watch->_path);
+		return -1;
+	}
+	log_write(LOG_DEBUG, "Parsed %s before synchronization", watch->_path);
+	return 0;
+}
+
+OrgNotes * org_watch_notes(OrgWatch * watch, struct stat * fileStat)
+{
+	if(org_watch_update(watch))
+	{
+		return NULL;
+	}
+	if(fileStat != NULL)
+	{
+		*fileStat = watch->_fileStat;
+	}
+	return watch->_notes;
+}
+
+void org_watch_free(OrgWatch * watch)
+{
+	if(watch->fd != -1)
+	{
+		close(watch->fd);
+	}
+	free(watch->_path);
+	free(watch->_indexPath);
+	arena_free(&watch->_arena);
+	memset(watch, 0, sizeof(OrgWatch));
+	watch->fd = -1;
+}
+
+
+#if defined(__linux__)
+/**
+   Watch directory with OrgMode file with inotify.
+
+   Directory is watched instead of file, because editors usually save file
+   by renaming new file over the old one.
+
+   @param[in] watch Watcher of OrgMode file. Its descriptor remains -1 if
+   directory cannot be watched.
+*/
+static void _org_watch_add(OrgWatch * watch)
+{
+	char * directory;
+	if((directory = watch->_name == watch->_path ? strdup(".") :
+		strndup(watch->_path, watch->_name - 1 == watch->_path ? 1 :
+				watch->_name - 1 - watch->_path)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for directory of %s: %s",
+				  watch->_path, strerror(errno));
+		return;
+	}
+
+	int fd;
+	if((fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		log_write(LOG_WARNING, "Cannot initialize inotify: %s",
+				  strerror(errno));
+		free(directory);
+		return;
+	}
+	if(inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO |
+						 IN_MOVED_FROM | IN_DELETE) == -1)
+	{
+		log_write(LOG_WARNING, "Cannot watch %s directory: %s", directory,
+				  strerror(errno));
+		free(directory);
+		close(fd);
+		return;
+	}
+	free(directory);
+	watch->fd = fd;
+}
+
+/**
+   Read pending inotify events without blocking.
+
+   @param[in] watch Watcher of OrgMode file. It is marked as changed if
+   there are events for OrgMode file.
+*/
+static void _org_watch_read_events(OrgWatch * watch)
+{
+	if(watch->fd == -1)
+	{
+		return;
+	}
+
+	char buffer[ORG_WATCH_EVENTS_BUFFER_LEN]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t length;
+	while((length = read(watch->fd, buffer, sizeof(buffer))) > 0)
+	{
+		for(char * event = buffer; event < buffer + length;
+			event += sizeof(struct inotify_event) +
+				((struct inotify_event *)event)->len)
+		{
+			struct inotify_event * ievent = (struct inotify_event *)event;
+			/* Some events may be lost on overflow, so parse file again */
+			if(ievent->mask & IN_Q_OVERFLOW ||
+			   (ievent->len > 0 && strcmp(ievent->name, watch->_name) == 0))
+			{
+				watch->_changed = true;
+			}
+		}
+	}
+}
+#endif
@@ -25,8 +25,30 @@
    Assume what all datetimes in OrgMode file were written in the same timezone
    and this timezone is using on the Palm device.
 
-   If parsing process is failed parse_orgmode_file() will return NULL instead of
-   initialized and filled OrgModeEntries queue.
+   File is read to memory at once and scanner returns tokens as spans of
+   it, so there are no limits for length of lines. Headers, tags and note
+   texts are copied from the file only when the whole entry is parsed. Text
+   of entry is kept as it is written in file, with all spaces between words
+   and all empty lines inside it.
+
+   Timestamps are recognized without regular expressions, in one pass over
+   the timestamp string: date, optional time or time range and optional
+   repeater ("+", "++" and ".+" repeaters are treated the same). Other parts
+   of timestamp (day name, warning delay) are ignored.
+
+   Parser is reentrant — all its state is kept in the call of
+   parse_orgmode_file(), so different files can be parsed at the same time.
+
+   First-level headline with syntax error is skipped up to the next
+   headline: error is logged with line number and parsing continues. If
+   parsing process is failed completely (e.g. no memory or file is not
+   readable) parse_orgmode_file() will return NULL instead of initialized
+   and filled OrgModeEntries queue.
+
+   Every entry keeps its byte range in file: from the start of headline
+   up to the start of the next entry, with empty lines and skipped broken
+   entries after it. So entry can be rewritten in file without parsing
+   it again.
 
    To free initialized OrgModeEntries queue — use free_orgmode_parser() function.
 */
@@ -34,7 +56,9 @@
 #ifndef _ORGMODE_PARSER_H_
 #define _ORGMODE_PARSER_H_
 
+#include <stddef.h>
 #include <sys/queue.h>
+#include <sys/stat.h>
 #include <time.h>
 
 
@@ -102,6 +126,9 @@ struct OrgModeEntry
 	unsigned char repeaterValue;      /**< Repeater value or 0 if no repeater
 										 interval. */
 	enum RepeaterRange repeaterRange; /**< Repeater range. */
+	size_t offset;                    /**< Offset of headline in file. */
+	size_t length;                    /**< Length of entry in file, up to
+										 the next entry. */
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 	TAILQ_ENTRY(OrgModeEntry) pointers;
 #endif
@@ -121,13 +148,50 @@ typedef struct OrgModeEntries OrgModeEntries;
 /**
    Start parsing process.
 
-   Contents of OrgMode file will be stored in OrgModeEntries queue.
+   Contents of OrgMode file will be stored in OrgModeEntries queue. Entries
+   with syntax errors are not stored.
 
    @param[in] path Path to OrgMode file.
+   @param[out] errors Qty of skipped entries with syntax errors. May be NULL.
    @return Initialized and filled OrgModeEntries structure or NULL if parsing
    failed.
 */
-OrgModeEntries * parse_orgmode_file(const char * path);
+OrgModeEntries * parse_orgmode_file(const char * path, unsigned int * errors);
+
+/**
+   Parse part of OrgMode file, which is already in memory.
+
+   Part should start from the beginning of line. Buffer is changed by
+   scanner while parsing, but its contents is restored after the end of
+   parsing.
+
+   @param[in] path Path to OrgMode file, for error messages.
+   @param[in] buffer Contents of file with two zero bytes after it, like
+   buffer from read_orgmode_file().
+   @param[in] size Size of contents, without zero bytes.
+   @param[in] line Number of line in file, where buffer starts.
+   @param[in] offset Offset of buffer in file.
+   @param[out] errors Qty of skipped entries with syntax errors. May be NULL.
+   @return Initialized and filled OrgModeEntries structure or NULL if parsing
+   failed.
+*/
+OrgModeEntries * parse_orgmode_buffer(const char * path, char * buffer,
+									  size_t size, int line, size_t offset,
+									  unsigned int * errors);
+
+/**
+   Read the whole OrgMode file to memory.
+
+   Two zero bytes are added after the file contents, as scanner requires.
+
+   @param[in] path Path to OrgMode file.
+   @param[out] size Size of file contents in bytes.
+   @param[out] fileStat Status of file before reading. May be NULL.
+   @return Buffer with file contents, which should be freed with free(), or
+   NULL on error.
+*/
+char * read_orgmode_file(const char * path, size_t * size,
+						 struct stat * fileStat);
 
 /**
    Free initialized and filled OrgModeEntries structure.
@@ -1,71 +1,160 @@
+%code requires {
+#include <stddef.h>
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void * yyscan_t;
+#endif
+
+struct __OrgModeParser;
+
+/**
+   Part of the parsed file, which is kept in memory during parsing.
+*/
+struct __OrgModeSpan
+{
+    const char * start; /**< First symbol of span */
+    size_t length;      /**< Qty of bytes in span */
+};
+}
+
 %{
 #define _XOPEN_SOURCE 500
 #include <errno.h>
-#include <regex.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "log.h"
 #include "orgmode_parser.h"
 
-#define LINE_LEN 500
 #define EMPTY_PRIORITY '-'
+#define DAYS_CACHE_SIZE 64
 
 
-extern int yylex();
-extern int yyparse();
-extern FILE * yyin;
-
-void yyerror(const char* s);
-
-static OrgModeEntries * entries;
-static OrgModeEntry * entry;
-
-static char parsedLine[LINE_LEN];
-static char * pointerLine;
-
-static int _create_entry(const char * header, const char * keyword,
-						 const char priority, const char * tag);
-static int _insert_text(const char * text);
-static int _append_text(const char * text);
-static int _insert_datetime(const char * datetime);
+/**
+   Start of the day in local time, cached to not call mktime() for every
+   timestamp.
+*/
+struct __OrgModeDay
+{
+	long dayNumber; /**< Days from the Unix epoch */
+	time_t start;   /**< Unix-time of the day start */
+	bool uniform;   /**< True if the day is 24 hours long (no DST switch) */
+	bool valid;     /**< True if cache entry is filled */
+};
+
+/**
+   State of one parsing process.
+
+   Every call of parse_orgmode_file() has its own state, so several files
+   can be parsed at the same time.
+*/
+struct __OrgModeParser
+{
+	const char * path;         /**< Path to parsed file */
+	const char * buffer;       /**< Parsed part of file */
+	size_t offset;             /**< Offset of buffer in file */
+	OrgModeEntries * entries;  /**< Parsed entries */
+	OrgModeEntry * entry;      /**< Entry, which is parsed now. NULL if
+								  the last entry is complete. */
+	int line;                  /**< Line of file, where buffer starts */
+	bool skipping;             /**< True while skipping broken entry */
+	unsigned int errors;       /**< Qty of skipped broken entries */
+	struct __OrgModeDay days[DAYS_CACHE_SIZE]; /**< Cache of day starts */
+};
 %}
 
+%define api.pure full
+%define parse.error verbose
+%locations
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {struct __OrgModeParser * parser}
+%initial-action
+{
+    @$.first_line = @$.last_line = parser->line;
+}
+
 %union {
-    char * keyword;
+    struct __OrgModeSpan span;
     char priority;
-    char * tag;
-    char * word;
-    char * datetime;
+}
+
+%code {
+int yylex(YYSTYPE * yylval, YYLTYPE * yylloc, yyscan_t scanner);
+int yylex_init(yyscan_t * scanner);
+int yylex_destroy(yyscan_t scanner);
+struct yy_buffer_state * yy_scan_buffer(char * base, size_t size,
+										yyscan_t scanner);
+char * yyget_text(yyscan_t scanner);
+
+static void yyerror(YYLTYPE * location, yyscan_t scanner,
+					struct __OrgModeParser * parser, const char * message);
+
+static int _create_entry(struct __OrgModeParser * parser,
+						 struct __OrgModeSpan header,
+						 const struct __OrgModeSpan * keyword,
+						 const char priority,
+						 const struct __OrgModeSpan * tag);
+static void _skip_entry(struct __OrgModeParser * parser, int line);
+static int _insert_text(struct __OrgModeParser * parser,
+						struct __OrgModeSpan text);
+static int _insert_datetime(struct __OrgModeParser * parser,
+							struct __OrgModeSpan datetime);
+static char * __span_copy(struct __OrgModeSpan span);
+static bool __span_equals(struct __OrgModeSpan span, const char * string);
 }
 
 %token T_HEADLINE_STAR
-%token <keyword> T_TODO_KEYWORD
+%token <span> T_TODO_KEYWORD
 %token <priority> T_PRIORITY
-%token <tag> T_TAG
-%token <word> T_WORD
+%token <span> T_TAG
+%token <span> T_WORD
 %token T_SCHEDULED
-%token <datetime> T_DATETIME;
-%token T_NEWLINE
+%token <span> T_DATETIME;
+%token <span> T_NEWLINE
+
+%type <span> line text
 
-%start entries
+%start file
 %%
+file : %empty
+     | T_NEWLINE
+     | entries
+     | T_NEWLINE entries
+     ;
+
 entries : entry
-        | T_NEWLINE entry
         | entries entry
         ;
 
 entry : header
+      {
+         parser->entry = NULL;
+      }
       | header text
+      {
+         if(_insert_text(parser, $2))
+         {
+             YYERROR;
+         }
+         parser->entry = NULL;
+      }
+      | error
+      {
+         _skip_entry(parser, @1.first_line);
+      }
       ;
 
 header : headline T_NEWLINE
        | headline T_NEWLINE T_SCHEDULED T_DATETIME T_NEWLINE
        {
-          if(_insert_datetime($4))
+          if(_insert_datetime(parser, $4))
           {
               YYERROR;
           }
@@ -74,131 +163,247 @@ header : headline T_NEWLINE
 
 headline : T_HEADLINE_STAR line
          {
-            if(_create_entry(parsedLine, NULL, EMPTY_PRIORITY, NULL))
+            if(_create_entry(parser, $2, NULL, EMPTY_PRIORITY, NULL))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR line T_TAG
          {
-            if(_create_entry(parsedLine, NULL, EMPTY_PRIORITY, $3))
+            if(_create_entry(parser, $2, NULL, EMPTY_PRIORITY, &$3))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_TODO_KEYWORD line
          {
-            if(_create_entry(parsedLine, $2, EMPTY_PRIORITY, NULL))
+            if(_create_entry(parser, $3, &$2, EMPTY_PRIORITY, NULL))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_TODO_KEYWORD line T_TAG
          {
-            if(_create_entry(parsedLine, $2, EMPTY_PRIORITY, $4))
+            if(_create_entry(parser, $3, &$2, EMPTY_PRIORITY, &$4))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_PRIORITY line
          {
-            if(_create_entry(parsedLine, NULL, $2, NULL))
+            if(_create_entry(parser, $3, NULL, $2, NULL))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_PRIORITY line T_TAG
          {
-            if(_create_entry(parsedLine, NULL, $2, $4))
+            if(_create_entry(parser, $3, NULL, $2, &$4))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_TODO_KEYWORD T_PRIORITY line
          {
-            if(_create_entry(parsedLine, $2, $3, NULL))
+            if(_create_entry(parser, $4, &$2, $3, NULL))
             {
                 YYERROR;
             }
          }
          | T_HEADLINE_STAR T_TODO_KEYWORD T_PRIORITY line T_TAG
          {
-            if(_create_entry(parsedLine, $2, $3, $5))
+            if(_create_entry(parser, $4, &$2, $3, &$5))
             {
                 YYERROR;
             }
          }
          ;
 
+/* Text is a span of the file from the first word of text up to the last
+   newline, so it is copied only once — when the whole entry is parsed */
 text : line T_NEWLINE
      {
-        _insert_text(parsedLine);
+        $$ = $1;
      }
      | text T_NEWLINE
      {
-        _append_text("");
+        $$.start = $1.start;
+        $$.length = $2.start - $1.start;
      }
      | text line T_NEWLINE
      {
-        _append_text(parsedLine);
+        $$.start = $1.start;
+        $$.length = $2.start + $2.length - $1.start;
      }
      ;
 
 line : T_WORD
      {
-        memset(parsedLine, 0, LINE_LEN);
-        pointerLine = parsedLine;
-        strncpy(pointerLine, $1, strlen($1));
-        pointerLine += strlen($1);
+        $$ = $1;
      }
      | line T_WORD
      {
-        *pointerLine = ' ';
-        pointerLine++;
-        strncpy(pointerLine, $2, strlen($2));
-        pointerLine += strlen($2);
+        $$.start = $1.start;
+        $$.length = $2.start + $2.length - $1.start;
      }
      ;
 %%
-OrgModeEntries * parse_orgmode_file(const char * path)
+OrgModeEntries * parse_orgmode_file(const char * path, unsigned int * errors)
 {
-    if(access(path, R_OK))
+    char * buffer;
+    size_t size;
+    if((buffer = read_orgmode_file(path, &size, NULL)) == NULL)
     {
-        log_write(LOG_ERR, "No access to %s OrgMode file: %s", path,
+        return NULL;
+    }
+    OrgModeEntries * entries = parse_orgmode_buffer(path, buffer, size, 1, 0,
+													errors);
+    free(buffer);
+    return entries;
+}
+
+OrgModeEntries * parse_orgmode_buffer(const char * path, char * buffer,
+									  size_t size, int line, size_t offset,
+									  unsigned int * errors)
+{
+    struct __OrgModeParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.path = path;
+    parser.buffer = buffer;
+    parser.offset = offset;
+    parser.line = line;
+    if((parser.entries = calloc(1, sizeof(OrgModeEntries))) == NULL)
+    {
+        log_write(LOG_ERR, "Cannot allocate memory for parsed org mode "
+				  "entries: %s", strerror(errno));
+        return NULL;
+    }
+    TAILQ_INIT(parser.entries);
+
+    yyscan_t scanner;
+    if(yylex_init(&scanner))
+    {
+        log_write(LOG_ERR, "Cannot initialize OrgMode scanner: %s",
 				  strerror(errno));
+        free_orgmode_parser(parser.entries);
+        return NULL;
+    }
+    /* Scanner works directly on the buffer, so tokens are spans of it */
+    if(yy_scan_buffer(buffer, size + 2, scanner) == NULL)
+    {
+        log_write(LOG_ERR, "Cannot set buffer for OrgMode scanner");
+        yylex_destroy(scanner);
+        free_orgmode_parser(parser.entries);
+        return NULL;
+    }
+
+    /* Broken entries are skipped by parser, so non-zero result means
+       that parsing cannot be continued at all (e.g. no memory) */
+    int result = yyparse(scanner, &parser);
+    yylex_destroy(scanner);
+    if(result)
+    {
+        log_write(LOG_ERR, "Failed to parse OrgMode file %s", path);
+        free_orgmode_parser(parser.entries);
         return NULL;
     }
 
-    if((yyin = fopen(path, "r")) == NULL)
+    /* Entry lasts up to the next entry, so skipped broken entries belong
+       to the previous one */
+    OrgModeEntry * entry;
+    TAILQ_FOREACH(entry, parser.entries, pointers)
+    {
+        OrgModeEntry * next = TAILQ_NEXT(entry, pointers);
+        entry->length = (next != NULL ? next->offset : offset + size) -
+			entry->offset;
+    }
+
+    if(parser.errors > 0)
+    {
+        log_write(LOG_WARNING, "Skipped %u broken entries in OrgMode file %s",
+				  parser.errors, path);
+    }
+    if(errors != NULL)
+    {
+        *errors = parser.errors;
+    }
+    return parser.entries;
+}
+
+char * read_orgmode_file(const char * path, size_t * size,
+						 struct stat * fileStat)
+{
+    int fd;
+    if((fd = open(path, O_RDONLY)) == -1)
     {
         log_write(LOG_ERR, "No access to %s OrgMode file, cannot open: %s",
 				  path, strerror(errno));
         return NULL;
     }
 
-    if((entries = calloc(1, sizeof(OrgModeEntries))) == NULL)
+    struct stat st;
+    if(fstat(fd, &st) == -1)
     {
-        log_write(LOG_ERR, "Cannot allocate memory for parsed org mode entries",
+        log_write(LOG_ERR, "Cannot get size of %s OrgMode file: %s", path,
 				  strerror(errno));
-        fclose(yyin);
+        close(fd);
         return NULL;
     }
+    if(fileStat != NULL)
+    {
+        *fileStat = st;
+    }
 
-    TAILQ_INIT(entries);
-    entry = NULL;
-
-    do
+    char * buffer;
+    size_t capacity = st.st_size > 0 ? st.st_size : 4096;
+    if((buffer = malloc(capacity + 2)) == NULL)
     {
-        yyparse();
+        log_write(LOG_ERR, "Cannot allocate %lu bytes for %s OrgMode file: "
+				  "%s", capacity + 2, path, strerror(errno));
+        close(fd);
+        return NULL;
     }
-    while(!feof(yyin));
 
-    if(fclose(yyin))
+    /* File may grow while reading, so read it up to the end */
+    size_t length = 0;
+    ssize_t result;
+    while((result = read(fd, buffer + length, capacity - length)) != 0)
     {
-        log_write(LOG_ERR, "Cannot close OrgMode file %s: %s",
-				  path, strerror(errno));
+        if(result == -1)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            log_write(LOG_ERR, "Cannot read %s OrgMode file: %s", path,
+					  strerror(errno));
+            free(buffer);
+            close(fd);
+            return NULL;
+        }
+        length += result;
+        if(length == capacity)
+        {
+            char * newBuffer;
+            if((newBuffer = realloc(buffer, capacity * 2 + 2)) == NULL)
+            {
+                log_write(LOG_ERR, "Cannot allocate %lu bytes for %s OrgMode "
+						  "file: %s", capacity * 2 + 2, path,
+						  strerror(errno));
+                free(buffer);
+                close(fd);
+                return NULL;
+            }
+            buffer = newBuffer;
+            capacity *= 2;
+        }
     }
-    return entries;
+    close(fd);
+
+    buffer[length] = '\0';
+    buffer[length + 1] = '\0';
+    *size = length;
+    return buffer;
 }
 
 void free_orgmode_parser(OrgModeEntries * entries)
@@ -226,21 +431,56 @@ void free_orgmode_parser(OrgModeEntries * entries)
     }
     TAILQ_INIT(entries);
     free(entries);
-    entries = NULL;
 }
 
-void yyerror(const char* s)
+static void yyerror(YYLTYPE * location, yyscan_t scanner,
+					struct __OrgModeParser * parser, const char * message)
 {
-    extern int yylineno;
-    extern char * yytext;
-    log_write(LOG_ERR, "OrgMode parse error: %s at line %d, symbols: \"%s\"",
-			  s, yylineno, yytext);
-	exit(1);
+    log_write(LOG_ERR, "OrgMode parse error in %s: %s at line %d, symbols: "
+			  "\"%s\"", parser->path, message, location->first_line,
+			  yyget_text(scanner));
 }
 
-static int _create_entry(const char * header, const char * keyword,
-						 const char priority, const char * tag)
+/**
+   Skip entry with syntax error.
+
+   Entry, which was parsed when error occurred, is removed from
+   result. Parser calls this function for every token, skipped after
+   error, so error is counted only once per entry.
+
+   @param[in] parser State of parser.
+   @param[in] line Line, where broken entry starts.
+*/
+static void _skip_entry(struct __OrgModeParser * parser, int line)
 {
+    if(!parser->skipping)
+    {
+        log_write(LOG_WARNING, "Skip broken OrgMode entry at line %d of %s",
+				  line, parser->path);
+        parser->skipping = true;
+        parser->errors++;
+    }
+
+    OrgModeEntry * entry = parser->entry;
+    if(entry == NULL)
+    {
+        return;
+    }
+    TAILQ_REMOVE(parser->entries, entry, pointers);
+    free(entry->header);
+    free(entry->tag);
+    free(entry->text);
+    free(entry);
+    parser->entry = NULL;
+}
+
+static int _create_entry(struct __OrgModeParser * parser,
+						 struct __OrgModeSpan header,
+						 const struct __OrgModeSpan * keyword,
+						 const char priority,
+						 const struct __OrgModeSpan * tag)
+{
+    OrgModeEntry * entry;
     if((entry = calloc(1, sizeof(OrgModeEntry))) == NULL)
     {
         log_write(LOG_ERR, "Cannot allocate memory for new OrgMode entry");
@@ -248,56 +488,39 @@ static int _create_entry(const char * header, const char * keyword,
     }
 
     /* Insert header */
-    if(header == NULL)
+    if((entry->header = __span_copy(header)) == NULL)
     {
-        log_write(LOG_ERR, "Got NULL entry header");
+        log_write(LOG_ERR, "Cannot copy new header \"%.*s\" to memory: %s",
+				  (int)header.length, header.start, strerror(errno));
         free(entry);
         return -1;
     }
-    if((entry->header = strdup(header)) == NULL)
-    {
-        log_write(LOG_ERR, "Cannot copy new header \"%s\" to memory: %s",
-				  header, strerror(errno));
-        return -1;
-    }
 
     /* Insert key (if exists) */
-    if(keyword != NULL)
+    if(keyword == NULL)
     {
-        if(strlen(keyword) == strlen("TODO"))
-        {
-            if(!strcmp("TODO", keyword))
-            {
-                entry->keyword = TODO;
-            }
-            else if(!strcmp("DONE", keyword))
-            {
-                entry->keyword = DONE;
-            }
-            else
-            {
-                log_write(LOG_WARNING, "Unknown TODO keyword: %s", keyword);
-                entry->keyword = NO_TODO_KEYWORD;
-            }
-        }
-        else if((strlen(keyword) == strlen("VERIFIED")) &&
-				!strcmp("VERIFIED", keyword))
-        {
-            entry->keyword = VERIFIED;
-        }
-        else if((strlen(keyword) == strlen("CANCELLED")) &&
-				!strcmp("CANCELLED", keyword))
-        {
-            entry->keyword = CANCELLED;
-        }
-        else
-        {
-            log_write(LOG_WARNING, "Unknown TODO-keyword: %s", keyword);
-            entry->keyword = NO_TODO_KEYWORD;
-        }
+        entry->keyword = NO_TODO_KEYWORD;
+    }
+    else if(__span_equals(*keyword, "TODO"))
+    {
+        entry->keyword = TODO;
+    }
+    else if(__span_equals(*keyword, "DONE"))
+    {
+        entry->keyword = DONE;
+    }
+    else if(__span_equals(*keyword, "VERIFIED"))
+    {
+        entry->keyword = VERIFIED;
+    }
+    else if(__span_equals(*keyword, "CANCELLED"))
+    {
+        entry->keyword = CANCELLED;
     }
     else
     {
+        log_write(LOG_WARNING, "Unknown TODO-keyword: %.*s",
+				  (int)keyword->length, keyword->start);
         entry->keyword = NO_TODO_KEYWORD;
     }
 
@@ -324,10 +547,12 @@ static int _create_entry(const char * header, const char * keyword,
     /* Insert tag (if exists) */
     if(tag != NULL)
     {
-        if((entry->tag = strdup(tag)) == NULL)
+        if((entry->tag = __span_copy(*tag)) == NULL)
         {
-            log_write(LOG_ERR, "Cannot copy new tag \"%s\" to memory: %s",
-                      tag, strerror(errno));
+            log_write(LOG_ERR, "Cannot copy new tag \"%.*s\" to memory: %s",
+                      (int)tag->length, tag->start, strerror(errno));
+            free(entry->header);
+            free(entry);
             return -1;
         }
     }
@@ -342,20 +567,24 @@ static int _create_entry(const char * header, const char * keyword,
     entry->repeaterValue = 0;
     entry->repeaterRange = NO_RANGE;
 
-    if(TAILQ_EMPTY(entries))
+    /* Headline star is at the start of line with header */
+    const char * headline = header.start;
+    while(headline > parser->buffer && headline[-1] != '\n')
     {
-        TAILQ_INSERT_HEAD(entries, entry, pointers);
-    }
-    else
-    {
-        TAILQ_INSERT_TAIL(entries, entry, pointers);
+        headline--;
     }
+    entry->offset = parser->offset + (headline - parser->buffer);
 
+    TAILQ_INSERT_TAIL(parser->entries, entry, pointers);
+    parser->entry = entry;
+    parser->skipping = false;
     return 0;
 }
 
-static int _insert_text(const char * text)
+static int _insert_text(struct __OrgModeParser * parser,
+						struct __OrgModeSpan text)
 {
+    OrgModeEntry * entry = parser->entry;
     if(entry == NULL)
     {
         return -1;
@@ -364,303 +593,302 @@ static int _insert_text(const char * text)
     {
         free(entry->text);
     }
-    if((entry->text = strdup(text)) == NULL)
+    if((entry->text = __span_copy(text)) == NULL)
     {
-        log_write(LOG_ERR, "Cannot copy new text \"%s\" to memory: %s",
-				  text, strerror(errno));
+        log_write(LOG_ERR, "Cannot copy new text (%lu bytes) to memory: %s",
+				  text.length, strerror(errno));
         return -1;
     }
     return 0;
 }
 
-static int _append_text(const char * text)
+/**
+   Copy span of parsed file to the new string.
+
+   @param[in] span Span of parsed file.
+   @return Null-terminated copy of span or NULL on error.
+*/
+static char * __span_copy(struct __OrgModeSpan span)
 {
-    if(entry == NULL)
-    {
-        return -1;
-    }
-    if(entry->text == NULL)
+    char * string;
+    if((string = malloc(span.length + 1)) == NULL)
     {
-        log_write(LOG_ERR, "Cannot append new text (\"%s\") - pointer to "
-				  "existing text in memory is NULL");
-        return -1;
+        return NULL;
     }
+    memcpy(string, span.start, span.length);
+    string[span.length] = '\0';
+    return string;
+}
 
-    char * oldPointer = entry->text;
-    size_t oldTextLen = strlen(oldPointer);
+/**
+   Compare span of parsed file with string.
 
-    /* 1st byte for \n, 2nd byte for trailing \0. */
-    if((entry->text = realloc(oldPointer,
-							  oldTextLen + strlen(text) + 2)) == NULL)
-    {
-        log_write(LOG_ERR, "Cannot append new string \"%s\" to existing: %s",
-				  text, strerror(errno));
-        return -1;
-    }
-    entry->text[oldTextLen] = '\n';
-    char * newStringPosition = entry->text + oldTextLen + 1;
-    strncpy(newStringPosition, text, strlen(text));
-    *(entry->text + oldTextLen + 1 + strlen(text)) = '\0';
-    return 0;
+   @param[in] span Span of parsed file.
+   @param[in] string Null-terminated string.
+   @return True if span is equal to string.
+*/
+static bool __span_equals(struct __OrgModeSpan span, const char * string)
+{
+    return strlen(string) == span.length &&
+        memcmp(span.start, string, span.length) == 0;
 }
 
 
-static void __regerror(int regErrorCode, const regex_t * reg)
-{
-    char * buffer;
-    size_t buflen;
+/**
+   Read fixed-width decimal number.
 
-    buflen = regerror(regErrorCode, reg, NULL, 0);
-    if((buffer = calloc(buflen, sizeof(char))) == NULL)
+   @param[in,out] string Pointer to string, moved after the number.
+   @param[in] digits Qty of digits.
+   @param[out] value Read number.
+   @return 0 on success or -1 if there are no enough digits.
+*/
+static int __read_number(const char ** string, int digits, int * value)
+{
+    *value = 0;
+    for(int i = 0; i < digits; i++)
     {
-        log_write(LOG_ERR, "Cannot allocate buffer for error message: %s",
-                  strerror(errno));
-        return;
+        char symbol = (*string)[i];
+        if(symbol < '0' || symbol > '9')
+        {
+            return -1;
+        }
+        *value = *value * 10 + (symbol - '0');
     }
-    regerror(regErrorCode, reg, buffer, buflen);
-    log_write(LOG_ERR, "Regex error: %s", buffer);
-    free(buffer);
+    *string += digits;
+    return 0;
 }
 
-static int __insert_datetime(const char * datetime, int nsub,
-							 regmatch_t * regMatch, int regexNo)
+/**
+   Read time in HH:MM format.
+
+   @param[in,out] string Pointer to string, moved after the time.
+   @param[out] minutes Minutes from the start of the day.
+   @return 0 on success or -1 if there are no valid time.
+*/
+static int __read_time(const char ** string, int * minutes)
 {
-    const char REGEX_N_SUBS[] = {5, 4, 3, 2, 1};
-    if(REGEX_N_SUBS[regexNo] != nsub)
+    const char * pointer = *string;
+    int hour;
+    int minute;
+    if(__read_number(&pointer, 2, &hour) || *pointer++ != ':' ||
+       __read_number(&pointer, 2, &minute) || hour > 23 || minute > 59)
     {
-        log_write(LOG_ERR, "Real regex subst groups count (%d) not matched "
-				  "with desired (%d)", nsub, REGEX_N_SUBS[regexNo]);
         return -1;
     }
+    *minutes = hour * 60 + minute;
+    *string = pointer;
+    return 0;
+}
 
-    time_t zerotime = 0;
-    struct tm time;
-    size_t matchlen;
-    char * buffer;
+/**
+   Convert date to the number of days from the Unix epoch.
 
-    /* Extract date */
-    if(nsub == 1)
-    {
-        if(regMatch[1].rm_so == -1)
-        {
-            log_write(LOG_ERR, "Cannot cut date from %s", datetime);
-            return -1;
-        }
-        const char * zeroTime = " 00:00";
-        matchlen = regMatch[1].rm_eo - regMatch[1].rm_so;
-        buffer = calloc(matchlen + strlen(zeroTime), sizeof(char));
-        strncpy(buffer, datetime + regMatch[1].rm_so, matchlen);
-        strncpy(buffer + matchlen, zeroTime, strlen(zeroTime));
-
-        localtime_r(&zerotime, &time);
-        if(strptime(buffer, "%Y-%m-%d %H:%M", &time) == NULL)
-        {
-            log_write(LOG_ERR, "Cannot parse \"%s\" date", buffer);
-            free(buffer);
-            return -1;
-        }
-        if((entry->datetime1 = mktime(&time)) == (time_t)-1)
-        {
-            log_write(LOG_ERR, "Fail convert \"%s\" to Unix-time: %s", buffer,
-					  strerror(errno));
-            free(buffer);
-            return -1;
-        }
-        free(buffer);
-    }
-    /* Extract datetime */
-    else
-    {
-        if(regMatch[1].rm_so == -1 || regMatch[2].rm_so == -1)
-        {
-            log_write(LOG_ERR, "Cannot cut datetime from %s", datetime);
-            return -1;
-        }
-        matchlen = (regMatch[1].rm_eo - regMatch[1].rm_so) +
-            (regMatch[2].rm_eo - regMatch[2].rm_so) + 1 /* For space symbol */;
-        buffer = calloc(matchlen, sizeof(char));
-        matchlen = regMatch[1].rm_eo - regMatch[1].rm_so;
-        strncpy(buffer, datetime + regMatch[1].rm_so, matchlen);
+   Works for proleptic Gregorian calendar, see
+   http://howardhinnant.github.io/date_algorithms.html#days_from_civil
 
-        *(buffer + matchlen) = ' ';
+   @param[in] year Year.
+   @param[in] month Month (1-12).
+   @param[in] day Day of month (1-31).
+   @return Day number, 0 for 1970-01-01.
+*/
+static long __days_from_civil(int year, int month, int day)
+{
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+        day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+        dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
 
-        size_t matchlen2 = regMatch[2].rm_eo - regMatch[2].rm_so;
-        strncpy(buffer + matchlen + 1, datetime + regMatch[2].rm_so, matchlen2);
+/**
+   Convert local date and time to Unix-time.
+
+   mktime() is called only once for every new day: start of the day is
+   kept in cache of parser and time inside the day is added to it. Days
+   with DST switch (their length is not 24 hours) are converted by
+   mktime() every time.
+
+   @param[in] parser State of parser.
+   @param[in] year Year.
+   @param[in] month Month (1-12).
+   @param[in] day Day of month.
+   @param[in] minutes Minutes from the start of the day.
+   @return Unix-time or (time_t)-1 on error.
+*/
+static time_t __local_time(struct __OrgModeParser * parser, int year,
+                           int month, int day, int minutes)
+{
+    long dayNumber = __days_from_civil(year, month, day);
+    struct __OrgModeDay * cached =
+        &parser->days[(unsigned long)dayNumber % DAYS_CACHE_SIZE];
 
-        localtime_r(&zerotime, &time);
-        if(strptime(buffer, "%Y-%m-%d %H:%M", &time) == NULL)
-        {
-            log_write(LOG_ERR, "Cannot parse \"%s\" datetime", buffer);
-            free(buffer);
-            return -1;
-        }
-        if((entry->datetime1 = mktime(&time)) == (time_t)-1)
+    if(!cached->valid || cached->dayNumber != dayNumber)
+    {
+        struct tm time = {.tm_year = year - 1900, .tm_mon = month - 1,
+                          .tm_mday = day, .tm_isdst = -1};
+        struct tm nextTime = {.tm_year = year - 1900, .tm_mon = month - 1,
+                              .tm_mday = day + 1, .tm_isdst = -1};
+        time_t next;
+        if((cached->start = mktime(&time)) == (time_t)-1 ||
+           (next = mktime(&nextTime)) == (time_t)-1)
         {
-            log_write(LOG_ERR, "Fail convert \"%s\" to Unix-time: %s", buffer,
-					  strerror(errno));
-            free(buffer);
-            return -1;
+            cached->valid = false;
+            return (time_t)-1;
         }
-        free(buffer);
+        cached->dayNumber = dayNumber;
+        cached->uniform = next - cached->start == 24 * 60 * 60;
+        cached->valid = true;
     }
 
-    /* Extract second part of time range */
-    if(nsub == 3 || nsub == 5)
+    if(cached->uniform)
     {
-        if(regMatch[1].rm_so == -1 || regMatch[3].rm_so == -1)
-        {
-            log_write(LOG_ERR, "Cannot cut datetime from %s", datetime);
-            return -1;
-        }
-        matchlen = (regMatch[1].rm_eo - regMatch[1].rm_so) +
-            (regMatch[3].rm_eo - regMatch[3].rm_so) + 1 /* For space symbol */;
-        buffer = calloc(matchlen, sizeof(char));
-        matchlen = regMatch[1].rm_eo - regMatch[1].rm_so;
-        strncpy(buffer, datetime + regMatch[1].rm_so, matchlen);
+        return cached->start + minutes * 60;
+    }
+    struct tm time = {.tm_year = year - 1900, .tm_mon = month - 1,
+                      .tm_mday = day, .tm_hour = minutes / 60,
+                      .tm_min = minutes % 60, .tm_isdst = -1};
+    return mktime(&time);
+}
 
-        *(buffer + matchlen) = ' ';
+/**
+   Parse OrgMode timestamp in one pass.
 
-        size_t matchlen2 = regMatch[3].rm_eo - regMatch[3].rm_so;
-        strncpy(buffer + matchlen + 1, datetime + regMatch[3].rm_so, matchlen2);
+   Timestamp (without angle brackets) looks like:
+   YYYY-MM-DD [day name] [HH:MM[-HH:MM]] [+N(h|d|w|m|y)]. Repeater may be
+   written as "++N" and ".+N" too. Other words (like warning delay) are
+   ignored.
 
-        localtime_r(&zerotime, &time);
-        if(strptime(buffer, "%Y-%m-%d %H:%M", &time) == NULL)
-        {
-            log_write(LOG_ERR, "Cannot parse \"%s\" datetime", buffer);
-            free(buffer);
-            return -1;
-        }
-        if((entry->datetime2 = mktime(&time)) == (time_t)-1)
-        {
-            log_write(LOG_ERR, "Fail convert \"%s\" to Unix-time: %s", buffer,
-					  strerror(errno));
-            free(buffer);
-            return -1;
-        }
-        free(buffer);
-    }
+   Span of timestamp is followed by '>' in parsed file, so digits are never
+   read after the end of span.
 
-    /* Extract repetitive interval */
-    if(nsub == 4 || nsub == 5)
+   @param[in] parser State of parser.
+   @param[in] datetime Span of timestamp.
+   @return 0 on success, 1 if timestamp is not valid, -1 if it cannot be
+   converted to Unix-time.
+*/
+static int _insert_datetime(struct __OrgModeParser * parser,
+                            struct __OrgModeSpan datetime)
+{
+    static const int DAYS_IN_MONTH[] =
+        {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    OrgModeEntry * entry = parser->entry;
+    const char * pointer = datetime.start;
+    const char * end = datetime.start + datetime.length;
+    int year;
+    int month;
+    int day;
+
+    if(__read_number(&pointer, 4, &year) || *pointer++ != '-' ||
+       __read_number(&pointer, 2, &month) || *pointer++ != '-' ||
+       __read_number(&pointer, 2, &day) ||
+       month < 1 || month > 12 || day < 1 || day > DAYS_IN_MONTH[month - 1] ||
+       (month == 2 && day == 29 &&
+        (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0))) ||
+       (pointer < end && *pointer != ' '))
     {
-        unsigned char repeaterValuePos = nsub == 4 ? 3 : 4;
-        unsigned char repeaterRangePos = repeaterValuePos + 1;
-
-        if(regMatch[repeaterValuePos].rm_so == -1 ||
-		   regMatch[repeaterRangePos].rm_so == -1)
-        {
-            log_write(LOG_ERR, "Cannot cut repetitive interval from: %s",
-					  datetime);
-            return -1;
-        }
-        matchlen = regMatch[repeaterValuePos].rm_eo - regMatch[repeaterValuePos].rm_so;
-        buffer = calloc(matchlen, sizeof(char));
-        strncpy(buffer, datetime + regMatch[repeaterValuePos].rm_so, matchlen);
-        entry->repeaterValue = atoi(buffer);
-        free(buffer);
-
-        matchlen = regMatch[repeaterRangePos].rm_eo - regMatch[repeaterRangePos].rm_so;
-        buffer = calloc(matchlen, sizeof(char));
-        strncpy(buffer, datetime + regMatch[repeaterRangePos].rm_so, matchlen);
-        switch(buffer[0])
-        {
-        case 'h':
-            entry->repeaterRange = HOUR;
-            break;
-        case 'd':
-            entry->repeaterRange = DAY;
-            break;
-        case 'w':
-            entry->repeaterRange = WEEK;
-            break;
-        case 'm':
-            entry->repeaterRange = MONTH;
-            break;
-        case 'y':
-            entry->repeaterRange = YEAR;
-            break;
-        default:
-            log_write(LOG_ERR, "Unknown repeater range \"%s\" in \"%s\"",
-					  buffer, datetime);
-            free(buffer);
-            return -1;
-        }
-        free(buffer);
+        log_write(LOG_ERR, "\"%.*s\" is not a valid OrgMode timestamp",
+                  (int)datetime.length, datetime.start);
+        return 1;
     }
 
-    return 0;
-}
-
-static int _insert_datetime(const char * datetime)
-{
-    const unsigned char REGEX_QTY = 5;
-    char * regexToCheck[] = {
-        /* Datetime with range and repetitive interval */
-        "([0-9]{4}-[0-9]{2}-[0-9]{2}) .+ "
-		"([0-9]{2}:[0-9]{2})-([0-9]{2}:[0-9]{2}) "
-		"\\+([0-9]+)([hdwmy])",
-        /* Datetime with repetitive interval */
-        "([0-9]{4}-[0-9]{2}-[0-9]{2}) .+ ([0-9]{2}:[0-9]{2}) \\+([0-9]+)"
-		"([hdwmy])",
-        /* Datetime with range */
-        "([0-9]{4}-[0-9]{2}-[0-9]{2}) .+ ([0-9]{2}:[0-9]{2})-"
-		"([0-9]{2}:[0-9]{2})",
-        /* Datetime */
-        "([0-9]{4}-[0-9]{2}-[0-9]{2}) .+ ([0-9]{2}:[0-9]{2})",
-        /* Date */
-        "([0-9]{4}-[0-9]{2}-[0-9]{2}) .+"
-    };
-
-    for(int i = 0; i < REGEX_QTY; i++)
-    {
-        regex_t regex;
-        regmatch_t * regMatch;
-        int regError;
-
-        if((regError = regcomp(&regex, regexToCheck[i],
-							   REG_EXTENDED | REG_NEWLINE)) != 0)
+    int minutes1 = 0;
+    int minutes2 = -1;
+    bool hasTime = false;
+    bool hasRepeater = false;
+    while(pointer < end)
+    {
+        while(pointer < end && *pointer == ' ')
         {
-            __regerror(regError, &regex);
-            return -1;
+            pointer++;
         }
-        if((regMatch = calloc((regex.re_nsub + 1), sizeof(regmatch_t))) == NULL)
+        const char * word = pointer;
+        while(pointer < end && *pointer != ' ')
         {
-            log_write(LOG_ERR, "Cannot allocate memory for regex matching "
-					  "groups when parsing datetime: %s", strerror(errno));
-            regfree(&regex);
-            return -1;
+            pointer++;
         }
 
-        if((regError = regexec(&regex, datetime, regex.re_nsub + 1,
-							   regMatch, 0)) != 0)
+        const char * field = word;
+        if(!hasTime && !__read_time(&field, &minutes1))
         {
-            if(regError == REG_NOMATCH)
+            if(*field == '-')
             {
-                /* Continue to check for next regex */
-                free(regMatch);
-                regfree(&regex);
-                continue;
+                field++;
+                if(__read_time(&field, &minutes2))
+                {
+                    field = NULL;
+                }
             }
-            else
+            if(field != pointer)
             {
-                __regerror(regError, &regex);
-                free(regMatch);
-                regfree(&regex);
-                return -1;
+                log_write(LOG_ERR, "Wrong time in \"%.*s\" timestamp",
+                          (int)datetime.length, datetime.start);
+                return 1;
             }
+            hasTime = true;
         }
-
-        if(__insert_datetime(datetime, regex.re_nsub, regMatch, i))
+        else if(!hasRepeater && (*word == '+' || *word == '.'))
         {
-            free(regMatch);
-            regfree(&regex);
-            return -1;
+            field = word[1] == '+' ? word + 2 : word + 1;
+            if(*word == '.' && field == word + 1)
+            {
+                continue;
+            }
+            int value = 0;
+            for(; *field >= '0' && *field <= '9'; field++)
+            {
+                value = value * 10 + (*field - '0');
+            }
+            if(field + 1 != pointer || field[-1] < '0' || field[-1] > '9')
+            {
+                log_write(LOG_ERR, "Wrong repeater in \"%.*s\" timestamp",
+                          (int)datetime.length, datetime.start);
+                return 1;
+            }
+            switch(*field)
+            {
+            case 'h':
+                entry->repeaterRange = HOUR;
+                break;
+            case 'd':
+                entry->repeaterRange = DAY;
+                break;
+            case 'w':
+                entry->repeaterRange = WEEK;
+                break;
+            case 'm':
+                entry->repeaterRange = MONTH;
+                break;
+            case 'y':
+                entry->repeaterRange = YEAR;
+                break;
+            default:
+                log_write(LOG_ERR, "Unknown repeater range \"%c\" in "
+                          "\"%.*s\"", *field, (int)datetime.length,
+                          datetime.start);
+                return 1;
+            }
+            entry->repeaterValue = value;
+            hasRepeater = true;
         }
-        free(regMatch);
-        regfree(&regex);
-        return 0;
-    } /* for(int i = 0; i < REGEX_QTY; i++) */
+    }
 
-    log_write(LOG_ERR, "\"%s\" is not a valid OrgMode timestamp", datetime);
-    return 1;
+    if((entry->datetime1 = __local_time(parser, year, month, day,
+                                        minutes1)) == (time_t)-1)
+    {
+        log_write(LOG_ERR, "Fail convert \"%.*s\" to Unix-time: %s",
+                  (int)datetime.length, datetime.start, strerror(errno));
+        return -1;
+    }
+    if(minutes2 != -1 &&
+       (entry->datetime2 = __local_time(parser, year, month, day,
+                                        minutes2)) == (time_t)-1)
+    {
+        log_write(LOG_ERR, "Fail convert \"%.*s\" to Unix-time: %s",
+                  (int)datetime.length, datetime.start, strerror(errno));
+        return -1;
+    }
+    return 0;
 }
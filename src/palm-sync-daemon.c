@@ -28,6 +28,8 @@
 #include <unistd.h>
 #include <wordexp.h>
 #include "config.h"
+#include "device_watch.h"
+#include "helper.h"
 #include "log.h"
 #include "sync.h"
 
@@ -44,6 +46,10 @@
    Environment variable with path to todo/calendar org-file
 */
 #define ENV_TODO_FILE "PALM_SYNC_TODO_ORG"
+/**
+   Maximal time to wait for device in one iteration of main loop, seconds
+*/
+#define DEVICE_WAIT_SEC 60
 /**
    Path to lock-file
 */
@@ -134,7 +140,8 @@ int main(int argc, const char * argv[])
 		.prevDatebookPDB = NULL,
 		.prevMemosPDB = NULL,
 		.prevTodoPDB = NULL,
-		.prevTasksPDB = NULL
+		.prevTasksPDB = NULL,
+		.notesWatch = NULL
 	};
 	/* Parse command-line arguments */
 	int foreground = 0;
@@ -206,6 +213,7 @@ int main(int argc, const char * argv[])
 	{
 		return 1;
 	}
+	str_hash_init();
 
 	/* Unexpand ~ in directory path and add trailing slash if not exists */
 	wordexp_t we;
@@ -272,17 +280,33 @@ int main(int argc, const char * argv[])
 		log_write(LOG_DEBUG, "--dry-run is enabled. No real sync will be done!");
 	}
 
+	/* Notes are parsed while waiting for Palm, so HotSync session is not
+	   held open while parsing */
+	if(sync_watch_init(&syncSettings))
+	{
+		log_write(LOG_WARNING, "OrgMode files will be parsed only while "
+				  "synchronizing");
+	}
+
 	while(1)
 	{
 		if(_processTerminate)
 		{
+			sync_watch_free(&syncSettings);
 			exit(0);
 		}
 
 		int syncResult = sync_this(&syncSettings);
 		if(syncResult == PALM_NOT_CONNECTED)
 		{
-			sleep(1);
+			/* Sleep until device appears or OrgMode files are changed, poll
+			   if device cannot be watched */
+			int eventFd = sync_watch_update(&syncSettings);
+			if(device_wait_appear(syncSettings.device, DEVICE_WAIT_SEC,
+								  eventFd) == -1)
+			{
+				sleep(1);
+			}
 			continue;
 		}
 		else if(syncResult)
@@ -291,8 +315,6 @@ int main(int argc, const char * argv[])
 			sleep(1);
 			continue;
 		}
-
-		sleep(1);
 	} /* while(1) */
 
 	return 0;
@@ -1,8 +1,13 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* For memfd_create() */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #if defined(__FreeBSD__)
 #include <pi-dlp.h>
@@ -13,22 +18,82 @@
 #include <libpisock/pi-file.h>
 #include <libpisock/pi-socket.h>
 #endif
+#include "device_watch.h"
+#include "hash_index.h"
+#include "helper.h"
 #include "log.h"
 #include "palm.h"
 #include "pdb/pdb.h"
 
 #define PALM_PDB_FNAME_BUFFER_LEN 128 /* Maximal length for PDB filename */
 #define PALM_PDB_TMP_DIR "/tmp"       /* Directory to store temporary
-										 PDB files */
+										 PDB files if they cannot be kept
+										 in memory */
+#define PALM_PDB_MEMFD_PATH "/proc/self/fd/%d" /* Path to in-memory
+												  PDB file */
 #define PALM_SYNCLOG_ENTRY_LEN 512    /* Maximal length for synclog string */
 #define PALM_CLOSE_WAIT_SEC 5         /* Seconds to wait while device
 										 disappering after close */
 #define PALM_CANNOT_BIND_MAX_ERRORS 3 /* Count of sequental logged errors
 										 from pi_bind */
+#define PALM_CACHE_PREFIX "cached"    /* Prefix for filenames of cached
+										 databases in data directory */
+#define PALM_READ_COPY_SUFFIX "-read" /* Suffix for names of databases as
+										 read from Palm */
+#define PALM_RECORD_IDS_CHUNK 500     /* Count of record IDs to read with one
+										 dlp_ReadRecordIDList() call */
+#define PALM_RECORD_BUFFER_LEN 0xffff /* Initial size of buffer for record */
+#define PALM_MODIFIED_RECORD_BUFFER_LEN 256 /* Initial size of buffer for
+											   modified record, it grows
+											   for longer records */
+
+/**
+   Record, fetched from Palm with dlp_ReadNextModifiedRec().
+*/
+struct __PalmModifiedRecord
+{
+	recordid_t id;      /**< Unique record ID */
+	int attributes;     /**< Record attributes */
+	int category;       /**< Record category */
+	pi_buffer_t * data; /**< Record data */
+};
 
 static void _palm_log_system_info(struct SysInfo * info);
-static void _palm_read_database(int sd, const char * dbname, char ** path);
-static void _palm_write_database(int sd, const char * dbname, const char * path);
+static bool _palm_last_synced(int sd);
+static void _palm_set_last_synced(int sd);
+static void _palm_read_database(int sd, const char * dbname, char ** path,
+								int * fd, char ** readPath, int * readFd,
+								const char * cacheDir, bool incremental);
+static char * _palm_tmp_file(const char * dbname, int * fd);
+static void _palm_read_copy(const char * dbname, const char * path,
+							char ** readPath, int * readFd);
+static void _palm_tmp_file_remove(char ** path, int * fd);
+static int _palm_read_database_cached(int sd, struct DBInfo * info,
+									  const char * cachePath, const char * path,
+									  int fd);
+static int _palm_merge_database(int sd, struct DBInfo * info, PDB * cache,
+								const char * path);
+static recordid_t * _palm_read_record_ids(int sd, int db, int * qty);
+static struct __PalmModifiedRecord * _palm_read_modified_records(int sd, int db,
+																 int * qty);
+static void _palm_free_modified_records(struct __PalmModifiedRecord * records,
+										int qty);
+static char * _palm_cache_path(const char * cacheDir, const char * dbname);
+static bool _palm_cache_current(const char * path, const char * cachePath);
+static int _palm_update_header(int sd, const char * dbname,
+							   const char * path);
+static void _palm_cache_update(const char * dbname, const char * path,
+							   const char * cacheDir);
+static int _palm_write_database(int sd, const char * dbname, const char * path,
+								const char * readPath, const char * cacheDir);
+static int _palm_write_changes(int sd, const char * dbname, const char * path,
+							   const char * readPath);
+static int _palm_write_records(int sd, const char * dbname, PDB * pdb,
+							   PDBRecord ** writes, size_t writesQty,
+							   PDBRecord ** deletes, size_t deletesQty,
+							   const uint8_t * appInfo, size_t appInfoLength);
+static int _palm_install_database(int sd, const char * dbname,
+								  const char * path);
 
 static unsigned char cannotBindErrorsCount = 0;
 
@@ -98,7 +163,7 @@ int palm_open(char * device)
 	return sd;
 }
 
-PalmData * palm_read(int sd)
+PalmData * palm_read(int sd, const char * cacheDir)
 {
 	if(sd < 0)
 	{
@@ -113,10 +178,33 @@ PalmData * palm_read(int sd)
 		return NULL;
 	}
 
-	_palm_read_database(sd, "DatebookDB",   &data->datebookDBPath);
-	_palm_read_database(sd, "MemoDB",       &data->memoDBPath);
-	_palm_read_database(sd, "ToDoDB",       &data->todoDBPath);
-	_palm_read_database(sd, "TasksDB-PTod", &data->tasksDBPath);
+	data->cacheDir = cacheDir;
+	data->_datebookDBFd = -1;
+	data->_memoDBFd = -1;
+	data->_todoDBFd = -1;
+	data->_tasksDBFd = -1;
+	data->_datebookDBReadFd = -1;
+	data->_memoDBReadFd = -1;
+	data->_todoDBReadFd = -1;
+	data->_tasksDBReadFd = -1;
+
+	/* Modified records are known only relative to the last
+	   synchronization, so cached copies are useless after synchronization
+	   with other PC */
+	bool incremental = cacheDir != NULL && _palm_last_synced(sd);
+
+	_palm_read_database(sd, "DatebookDB", &data->datebookDBPath,
+						&data->_datebookDBFd, &data->_datebookDBReadPath,
+						&data->_datebookDBReadFd, cacheDir, incremental);
+	_palm_read_database(sd, "MemoDB", &data->memoDBPath, &data->_memoDBFd,
+						&data->_memoDBReadPath, &data->_memoDBReadFd, cacheDir,
+						incremental);
+	_palm_read_database(sd, "ToDoDB", &data->todoDBPath, &data->_todoDBFd,
+						&data->_todoDBReadPath, &data->_todoDBReadFd, cacheDir,
+						incremental);
+	_palm_read_database(sd, "TasksDB-PTod", &data->tasksDBPath,
+						&data->_tasksDBFd, &data->_tasksDBReadPath,
+						&data->_tasksDBReadFd, cacheDir, incremental);
 
 	return data;
 }
@@ -142,11 +230,33 @@ int palm_write(int sd, const PalmData * data)
 		return -1;
 	}
 
-	_palm_write_database(sd, "DatebookDB", data->datebookDBPath);
-	_palm_write_database(sd, "MemoDB", data->memoDBPath);
-	_palm_write_database(sd, "ToDoDB", data->todoDBPath);
-	_palm_write_database(sd, "TasksDB-PTod", data->tasksDBPath);
+	int errors = 0;
+	errors += _palm_write_database(sd, "DatebookDB", data->datebookDBPath,
+								   data->_datebookDBReadPath,
+								   data->cacheDir) ? 1 : 0;
+	errors += _palm_write_database(sd, "MemoDB", data->memoDBPath,
+								   data->_memoDBReadPath,
+								   data->cacheDir) ? 1 : 0;
+	errors += _palm_write_database(sd, "ToDoDB", data->todoDBPath,
+								   data->_todoDBReadPath,
+								   data->cacheDir) ? 1 : 0;
+	errors += _palm_write_database(sd, "TasksDB-PTod", data->tasksDBPath,
+								   data->_tasksDBReadPath,
+								   data->cacheDir) ? 1 : 0;
 
+	/* Snapshots of databases should not be saved after failed write,
+	   otherwise unwritten changes look synchronized */
+	if(errors > 0)
+	{
+		log_write(LOG_ERR, "Failed to write %d databases to Palm", errors);
+		return -1;
+	}
+
+	/* Now cached copies are the same as databases on Palm */
+	if(data->cacheDir != NULL)
+	{
+		_palm_set_last_synced(sd);
+	}
 	return 0;
 }
 
@@ -155,6 +265,19 @@ int palm_close(int sd, char * device)
 	pi_close(sd);
 
 	/* Wait while device disconnects */
+	int waitResult = device_wait_disappear(device, PALM_CLOSE_WAIT_SEC);
+	if(waitResult == 1 && access(device, F_OK) == 0)
+	{
+		log_write(LOG_CRIT, "Timeout when waiting %s to disappear from system",
+				  device);
+		return -1;
+	}
+	else if(waitResult != -1)
+	{
+		return 0;
+	}
+
+	/* Device cannot be watched - poll it */
 	int secondsToWait = PALM_CLOSE_WAIT_SEC;
 	while((secondsToWait > 0) && (access(device, F_OK) == 0))
 	{
@@ -177,63 +300,66 @@ int palm_close(int sd, char * device)
 
 void palm_free(PalmData * data)
 {
-	if(data->datebookDBPath == NULL &&
-	   data->memoDBPath == NULL &&
-	   data->todoDBPath == NULL &&
-	   data->tasksDBPath == NULL)
+	_palm_tmp_file_remove(&data->datebookDBPath, &data->_datebookDBFd);
+	_palm_tmp_file_remove(&data->memoDBPath, &data->_memoDBFd);
+	_palm_tmp_file_remove(&data->todoDBPath, &data->_todoDBFd);
+	_palm_tmp_file_remove(&data->tasksDBPath, &data->_tasksDBFd);
+	_palm_tmp_file_remove(&data->_datebookDBReadPath,
+						  &data->_datebookDBReadFd);
+	_palm_tmp_file_remove(&data->_memoDBReadPath, &data->_memoDBReadFd);
+	_palm_tmp_file_remove(&data->_todoDBReadPath, &data->_todoDBReadFd);
+	_palm_tmp_file_remove(&data->_tasksDBReadPath, &data->_tasksDBReadFd);
+	free(data);
+}
+
+void palm_log(int sd, char * message)
+{
+	dlp_AddSyncLogEntry(sd, message);
+}
+
+int palm_database_changed(int sd, const char * dbname,
+						  const char * prevPdbPath)
+{
+	if(prevPdbPath == NULL)
 	{
-		free(data);
-		// Nothing to clean.
-		return;
+		log_write(LOG_DEBUG, "No PDB file of %s from previous synchronization",
+				  dbname);
+		return 1;
 	}
 
- 	if(data->datebookDBPath != NULL)
+	struct DBInfo info;
+	if(dlp_FindDBInfo(sd, 0, 0, dbname, 0, 0, &info) < 0)
 	{
-		if(unlink(data->datebookDBPath))
-		{
-			log_write(LOG_ERR, "Cannot delete %s: %s", data->datebookDBPath,
-					  strerror(errno));
-		}
-		free(data->datebookDBPath);
-		data->datebookDBPath = NULL;
+		log_write(LOG_ERR, "Unable to locate database %s on the Palm", dbname);
+		return -1;
 	}
-	if(data->memoDBPath != NULL)
+
+	int fd;
+	PDB prev;
+	if((fd = pdb_open(prevPdbPath)) == -1)
 	{
-		if(unlink(data->memoDBPath))
-		{
-			log_write(LOG_ERR, "Cannot delete %s: %s", data->memoDBPath,
-					  strerror(errno));
-		}
-		free(data->memoDBPath);
-		data->memoDBPath = NULL;
+		return -1;
 	}
-	if(data->todoDBPath != NULL)
+	if(pdb_read_header(fd, &prev))
 	{
-		if(unlink(data->todoDBPath))
-		{
-			log_write(LOG_ERR, "Cannot delete %s: %s", data->todoDBPath,
-					  strerror(errno));
-		}
-		free(data->todoDBPath);
-		data->todoDBPath = NULL;
+		log_write(LOG_WARNING, "Cannot read header of %s", prevPdbPath);
+		pdb_close(fd);
+		return -1;
 	}
-	if(data->tasksDBPath != NULL)
+	pdb_close(fd);
+
+	if((time_t)prev.ctime != info.createDate ||
+	   (time_t)prev.mtime != info.modifyDate ||
+	   prev.modificationNumber != info.modnum)
 	{
-		if(unlink(data->tasksDBPath))
-		{
-			log_write(LOG_ERR, "Cannot delete %s: %s", data->tasksDBPath,
-					  strerror(errno));
-		}
-		free(data->tasksDBPath);
-		data->tasksDBPath = NULL;
+		log_write(LOG_DEBUG, "Database %s is changed since previous "
+				  "synchronization: modification number %u -> %lu",
+				  dbname, prev.modificationNumber, info.modnum);
+		return 1;
 	}
-
-	free(data);
-}
-
-void palm_log(int sd, char * message)
-{
-	dlp_AddSyncLogEntry(sd, message);
+	log_write(LOG_DEBUG, "Database %s is not changed since previous "
+			  "synchronization", dbname);
+	return 0;
 }
 
 /**
@@ -258,15 +384,81 @@ static void _palm_log_system_info(struct SysInfo * info)
 			  info->compatMinorVersion);
 }
 
+/**
+   Check whether Palm was synchronized with this PC last time.
+
+   Only in this case cached copies of databases are the last state of
+   databases, known to Palm: other PC may reset flags of modified records.
+
+   @param[in] sd Palm device descriptor.
+   @return True if Palm was synchronized with this PC last time.
+*/
+static bool _palm_last_synced(int sd)
+{
+	struct PilotUser user;
+	if(dlp_ReadUserInfo(sd, &user) < 0)
+	{
+		log_write(LOG_WARNING, "Cannot read user info from Palm, read "
+				  "databases completely");
+		return false;
+	}
+	if(user.lastSyncPC != (unsigned long)gethostid())
+	{
+		log_write(LOG_INFO, "Palm was synchronized with other PC (0x%08lx), "
+				  "read databases completely", user.lastSyncPC);
+		return false;
+	}
+	return true;
+}
+
+/**
+   Mark Palm as synchronized with this PC.
+
+   @param[in] sd Palm device descriptor.
+*/
+static void _palm_set_last_synced(int sd)
+{
+	struct PilotUser user;
+	if(dlp_ReadUserInfo(sd, &user) < 0)
+	{
+		log_write(LOG_WARNING, "Cannot read user info from Palm");
+		return;
+	}
+	user.lastSyncPC = (unsigned long)gethostid();
+	user.successfulSyncDate = time(NULL);
+	user.lastSyncDate = user.successfulSyncDate;
+	if(dlp_WriteUserInfo(sd, &user) < 0)
+	{
+		log_write(LOG_WARNING, "Cannot write user info to Palm, databases "
+				  "will be read completely next time");
+	}
+}
+
 /**
    Read database from Palm to temporary file.
 
+   If there is a cached copy of database in cacheDir and incremental read
+   is allowed, only modified records are fetched from Palm and merged with
+   cached copy. Otherwise the whole database is downloaded. Cached copy is
+   not changed here, it is saved after write to Palm.
+
+   Database is also copied to other temporary file, which is compared
+   with changed database by palm_write().
+
    @param[in] sd Palm device descriptor.
    @param[in] dbname Name of database to fetch.
    @param[out] path Path to temporary PDB-file where Palm DB is saved.
+   @param[out] fd Descriptor of in-memory PDB-file or -1.
+   @param[out] readPath Path to copy of database as read from Palm or NULL.
+   @param[out] readFd Descriptor of in-memory copy or -1.
+   @param[in] cacheDir Directory with cached databases or NULL.
+   @param[in] incremental True if cached copy may be merged with modified
+   records.
    @return Void.
 */
-static void _palm_read_database(int sd, const char * dbname, char ** path)
+static void _palm_read_database(int sd, const char * dbname, char ** path,
+								int * fd, char ** readPath, int * readFd,
+								const char * cacheDir, bool incremental)
 {
 	struct DBInfo info;
 	struct pi_file * f;
@@ -288,22 +480,28 @@ static void _palm_read_database(int sd, const char * dbname, char ** path)
 	/* Some magic from pilot-link/src/pilot-xfer.c:682 */
 	info.flags &= 0x2fd;
 
-	*path = calloc(PALM_PDB_FNAME_BUFFER_LEN, sizeof(char));
-	if(*path == NULL)
+	if((*path = _palm_tmp_file(dbname, fd)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for path to PDB file "
-				  "for %s", dbname);
 		return;
 	}
-	pid_t pid = getpid();
-	sprintf(*path, PALM_PDB_TMP_DIR "/%s.%d.pdb", dbname, pid);
+
+	char * cachePath = cacheDir != NULL ? _palm_cache_path(cacheDir, dbname) :
+		NULL;
+	if(cachePath != NULL && incremental &&
+	   !_palm_read_database_cached(sd, &info, cachePath, *path, *fd))
+	{
+		log_write(LOG_INFO, "Read %s to %s (incremental)", dbname, *path);
+		free(cachePath);
+		_palm_read_copy(dbname, *path, readPath, readFd);
+		return;
+	}
+	free(cachePath);
 
 	f = pi_file_create(*path, &info);
 	if(f == 0)
 	{
 		log_write(LOG_ERR, "Unable to create file %s", *path);
-		free(*path);
-		*path = NULL;
+		_palm_tmp_file_remove(path, fd);
 		return;
 	}
 
@@ -312,9 +510,7 @@ static void _palm_read_database(int sd, const char * dbname, char ** path)
 		log_write(LOG_ERR, "Unable to fetch database %s from Palm to %s",
 				  dbname, *path);
 		pi_file_close(f);
-		unlink(*path);
-		free(*path);
-		*path = NULL;
+		_palm_tmp_file_remove(path, fd);
 		return;
 	}
 	log_write(LOG_INFO, "Read %s to %s", dbname, *path);
@@ -323,31 +519,864 @@ static void _palm_read_database(int sd, const char * dbname, char ** path)
 	snprintf(synclog, sizeof(synclog) - 1, "Read %s to PC\n", dbname);
 	palm_log(sd, synclog);
 	pi_file_close(f);
+	_palm_read_copy(dbname, *path, readPath, readFd);
+}
+
+/**
+   Create temporary PDB-file for database.
+
+   On Linux file is created in memory with memfd_create() and is accessed
+   by path in /proc, so it can be opened by pilot-link functions and by
+   PDB modules like a usual file. If it is impossible, file is created in
+   PALM_PDB_TMP_DIR.
+
+   @param[in] dbname Name of database.
+   @param[out] fd Descriptor of in-memory file or -1 if file is created in
+   filesystem.
+   @return Path to temporary file or NULL on error.
+*/
+static char * _palm_tmp_file(const char * dbname, int * fd)
+{
+	char * path;
+	if((path = calloc(PALM_PDB_FNAME_BUFFER_LEN, sizeof(char))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for path to PDB file "
+				  "for %s", dbname);
+		return NULL;
+	}
+
+	*fd = -1;
+#if defined(__linux__)
+	if((*fd = memfd_create(dbname, MFD_CLOEXEC)) != -1)
+	{
+		snprintf(path, PALM_PDB_FNAME_BUFFER_LEN, PALM_PDB_MEMFD_PATH, *fd);
+		return path;
+	}
+	log_write(LOG_DEBUG, "Cannot create in-memory file for %s: %s", dbname,
+			  strerror(errno));
+#endif
+	snprintf(path, PALM_PDB_FNAME_BUFFER_LEN, PALM_PDB_TMP_DIR "/%s.%d.pdb",
+			 dbname, getpid());
+	return path;
+}
+
+/**
+   Copy database as read from Palm to other temporary PDB-file.
+
+   @param[in] dbname Name of database.
+   @param[in] path Path to temporary PDB-file with database.
+   @param[out] readPath Path to copy or NULL if database cannot be copied.
+   Then database will be installed to Palm completely.
+   @param[out] readFd Descriptor of in-memory copy or -1.
+   @return Void.
+*/
+static void _palm_read_copy(const char * dbname, const char * path,
+							char ** readPath, int * readFd)
+{
+	char name[PDB_DBNAME_LEN + sizeof(PALM_READ_COPY_SUFFIX)];
+	snprintf(name, sizeof(name), "%s" PALM_READ_COPY_SUFFIX, dbname);
+	if((*readPath = _palm_tmp_file(name, readFd)) == NULL)
+	{
+		return;
+	}
+	if(copy_file(path, *readPath))
+	{
+		log_write(LOG_WARNING, "Cannot copy %s, it will be written to Palm "
+				  "completely", dbname);
+		_palm_tmp_file_remove(readPath, readFd);
+	}
+}
+
+/**
+   Remove temporary PDB-file, created by _palm_tmp_file().
+
+   @param[in] path Path to temporary file. Will be freed and set to NULL.
+   @param[in] fd Descriptor of in-memory file or -1. Will be set to -1.
+*/
+static void _palm_tmp_file_remove(char ** path, int * fd)
+{
+	if(*fd != -1)
+	{
+		close(*fd);
+		*fd = -1;
+	}
+	else if(*path != NULL && unlink(*path) && errno != ENOENT)
+	{
+		log_write(LOG_ERR, "Cannot delete %s: %s", *path, strerror(errno));
+	}
+	free(*path);
+	*path = NULL;
+}
+
+/**
+   Read database from cached copy and modified records from Palm.
+
+   Cached copy is used only if it has the same creation time as database
+   on Palm and its modification number is not greater than modification
+   number of database on Palm. If modification numbers are equal, database
+   was not changed and cached copy is used as is.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] info Information about database on Palm.
+   @param[in] cachePath Path to cached copy of database.
+   @param[in] path Path to temporary PDB-file where Palm DB should be saved.
+   @param[in] fd Descriptor of in-memory PDB-file or -1.
+   @return 0 on success or -1 if the whole database should be downloaded.
+*/
+static int _palm_read_database_cached(int sd, struct DBInfo * info,
+									  const char * cachePath, const char * path,
+									  int fd)
+{
+	if(access(cachePath, R_OK))
+	{
+		log_write(LOG_DEBUG, "No cached copy of %s in %s", info->name,
+				  cachePath);
+		return -1;
+	}
+
+	int cacheFd;
+	PDB * cache;
+	if((cacheFd = pdb_open(cachePath)) == -1)
+	{
+		return -1;
+	}
+	if((cache = pdb_read(cacheFd, false)) == NULL)
+	{
+		log_write(LOG_WARNING, "Cannot read cached copy of %s", info->name);
+		pdb_close(cacheFd);
+		return -1;
+	}
+
+	int result = -1;
+	bool changed = cache->modificationNumber != info->modnum;
+	if((time_t)cache->ctime != info->createDate ||
+	   cache->modificationNumber > info->modnum)
+	{
+		log_write(LOG_DEBUG, "Cached copy of %s is from other database "
+				  "(modification number %u, on Palm: %lu)", info->name,
+				  cache->modificationNumber, info->modnum);
+	}
+	else if(!changed)
+	{
+		log_write(LOG_DEBUG, "Database %s is not changed since modification "
+				  "number %lu", info->name, info->modnum);
+		result = copy_file(cachePath, path) ? -1 : 0;
+	}
+	else
+	{
+		log_write(LOG_DEBUG, "Database %s is changed: modification number %u "
+				  "-> %lu", info->name, cache->modificationNumber,
+				  info->modnum);
+		result = _palm_merge_database(sd, info, cache, path);
+	}
+	pdb_free(cache);
+	pdb_close(cacheFd);
+
+	/* In-memory file cannot be unlinked by its path in /proc, so it is
+	   emptied for the whole database */
+	if(result != 0 && (fd != -1 ? ftruncate(fd, 0) : unlink(path)) &&
+	   errno != ENOENT)
+	{
+		log_write(LOG_WARNING, "Cannot remove partially read %s: %s", path,
+				  strerror(errno));
+	}
+	return result;
+}
+
+/**
+   Write database, merged from cached copy and modified records from Palm.
+
+   Records are written in the same order as on Palm. Unchanged records are
+   taken from cached copy, changed ones are fetched from Palm. Deleted and
+   archived records are skipped, as pi_file_retrieve() does.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] info Information about database on Palm.
+   @param[in] cache Cached copy of database.
+   @param[in] path Path to temporary PDB-file where Palm DB should be saved.
+   @return 0 on success or -1 if the whole database should be downloaded.
+*/
+static int _palm_merge_database(int sd, struct DBInfo * info, PDB * cache,
+								const char * path)
+{
+	int db;
+	if(dlp_OpenDB(sd, 0, dlpOpenRead, info->name, &db) < 0)
+	{
+		log_write(LOG_ERR, "Cannot open %s database on Palm", info->name);
+		return -1;
+	}
+
+	int idsQty = 0;
+	int modifiedQty = 0;
+	recordid_t * ids = _palm_read_record_ids(sd, db, &idsQty);
+	struct __PalmModifiedRecord * modified = _palm_read_modified_records(
+		sd, db, &modifiedQty);
+	pi_buffer_t * appInfo = pi_buffer_new(PALM_RECORD_BUFFER_LEN);
+	if(ids == NULL || modified == NULL || appInfo == NULL ||
+	   dlp_ReadAppBlock(sd, db, 0, -1, appInfo) < 0)
+	{
+		log_write(LOG_ERR, "Cannot read changes in %s database from Palm",
+				  info->name);
+		dlp_CloseDB(sd, db);
+		free(ids);
+		_palm_free_modified_records(modified, modifiedQty);
+		if(appInfo != NULL)
+		{
+			pi_buffer_free(appInfo);
+		}
+		return -1;
+	}
+	dlp_CloseDB(sd, db);
+	log_write(LOG_DEBUG, "Database %s: %d records, %d modified", info->name,
+			  idsQty, modifiedQty);
+
+	/* Index fetched records by unique ID, cached records are already
+	   indexed in PDB structure */
+	HashIndex modifiedById;
+	int result = -1;
+	struct pi_file * f = NULL;
+	if(hash_index_init(&modifiedById, modifiedQty))
+	{
+		goto palm_merge_database_end;
+	}
+	for(int i = 0; i < modifiedQty; i++)
+	{
+		if(hash_index_insert(&modifiedById, modified[i].id, &modified[i]))
+		{
+			goto palm_merge_database_end;
+		}
+	}
+	PDBRecord * record;
+
+	if((f = pi_file_create(path, info)) == NULL)
+	{
+		log_write(LOG_ERR, "Unable to create file %s", path);
+		goto palm_merge_database_end;
+	}
+	if(appInfo->used > 0 &&
+	   pi_file_set_app_info(f, appInfo->data, appInfo->used) < 0)
+	{
+		log_write(LOG_ERR, "Cannot set application info for %s", path);
+		goto palm_merge_database_end;
+	}
+
+	for(int i = 0; i < idsQty; i++)
+	{
+		size_t cursor = 0;
+		struct __PalmModifiedRecord * changed = hash_index_find(
+			&modifiedById, ids[i], &cursor);
+		if(changed != NULL)
+		{
+			if(changed->attributes & (dlpRecAttrDeleted | dlpRecAttrArchived))
+			{
+				continue;
+			}
+			if(pi_file_append_record(f, changed->data->data,
+									 changed->data->used, changed->attributes,
+									 changed->category, changed->id) < 0)
+			{
+				log_write(LOG_ERR, "Cannot append record %lu to %s", ids[i],
+						  path);
+				goto palm_merge_database_end;
+			}
+			continue;
+		}
+
+		if((record = pdb_record_get(cache, ids[i])) == NULL)
+		{
+			log_write(LOG_DEBUG, "Unchanged record %lu of %s is not cached",
+					  ids[i], info->name);
+			goto palm_merge_database_end;
+		}
+		size_t length;
+		const uint8_t * data;
+		if((data = pdb_record_data(cache, record, &length)) == NULL ||
+		   pi_file_append_record(f, (void *)data, length,
+								 record->attributes & 0xf0,
+								 record->attributes & 0x0f, ids[i]) < 0)
+		{
+			log_write(LOG_ERR, "Cannot append cached record %lu to %s", ids[i],
+					  path);
+			goto palm_merge_database_end;
+		}
+	}
+	result = 0;
+
+	char synclog[PALM_SYNCLOG_ENTRY_LEN];
+	snprintf(synclog, sizeof(synclog) - 1, "Read %d changed records of %s to "
+			 "PC\n", modifiedQty, info->name);
+	palm_log(sd, synclog);
+
+palm_merge_database_end:
+	if(f != NULL && pi_file_close(f) < 0)
+	{
+		log_write(LOG_ERR, "Cannot write %s", path);
+		result = -1;
+	}
+	hash_index_free(&modifiedById);
+	free(ids);
+	_palm_free_modified_records(modified, modifiedQty);
+	pi_buffer_free(appInfo);
+	return result;
+}
+
+/**
+   Read unique IDs of all records in opened database on Palm.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] db Handle of opened database.
+   @param[out] qty Qty of record IDs.
+   @return Array of record IDs in order of records in database or NULL on
+   error.
+*/
+static recordid_t * _palm_read_record_ids(int sd, int db, int * qty)
+{
+	int recordsQty;
+	if(dlp_ReadOpenDBInfo(sd, db, &recordsQty) < 0)
+	{
+		log_write(LOG_ERR, "Cannot read qty of records in database");
+		return NULL;
+	}
+
+	recordid_t * ids;
+	if((ids = calloc(recordsQty + 1, sizeof(recordid_t))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for record IDs: %s",
+				  strerror(errno));
+		return NULL;
+	}
+
+	*qty = 0;
+	while(*qty < recordsQty)
+	{
+		int count = 0;
+		int max = recordsQty - *qty < PALM_RECORD_IDS_CHUNK ?
+			recordsQty - *qty : PALM_RECORD_IDS_CHUNK;
+		if(dlp_ReadRecordIDList(sd, db, 0, *qty, max, ids + *qty, &count) < 0)
+		{
+			log_write(LOG_ERR, "Cannot read record IDs from database");
+			free(ids);
+			return NULL;
+		}
+		if(count == 0)
+		{
+			break;
+		}
+		*qty += count;
+	}
+	return ids;
+}
+
+/**
+   Read all modified records from opened database on Palm.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] db Handle of opened database.
+   @param[out] qty Qty of modified records.
+   @return Array of modified records or NULL on error.
+*/
+static struct __PalmModifiedRecord * _palm_read_modified_records(int sd, int db,
+																 int * qty)
+{
+	size_t capacity = 16;
+	struct __PalmModifiedRecord * records;
+	*qty = 0;
+	if((records = calloc(capacity, sizeof(struct __PalmModifiedRecord))) ==
+	   NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for modified records: %s",
+				  strerror(errno));
+		return NULL;
+	}
+
+	if(dlp_ResetDBIndex(sd, db) < 0)
+	{
+		log_write(LOG_ERR, "Cannot reset modified records index");
+		free(records);
+		return NULL;
+	}
+
+	while(true)
+	{
+		if((size_t)*qty == capacity)
+		{
+			struct __PalmModifiedRecord * newRecords;
+			if((newRecords = realloc(records, capacity * 2 *
+									 sizeof(struct __PalmModifiedRecord))) ==
+			   NULL)
+			{
+				log_write(LOG_ERR, "Cannot allocate memory for modified "
+						  "records: %s", strerror(errno));
+				_palm_free_modified_records(records, *qty);
+				return NULL;
+			}
+			records = newRecords;
+			capacity *= 2;
+		}
+
+		struct __PalmModifiedRecord * record = &records[*qty];
+		if((record->data = pi_buffer_new(PALM_MODIFIED_RECORD_BUFFER_LEN)) ==
+		   NULL)
+		{
+			log_write(LOG_ERR, "Cannot allocate buffer for record");
+			_palm_free_modified_records(records, *qty);
+			return NULL;
+		}
+		int index;
+		if(dlp_ReadNextModifiedRec(sd, db, record->data, &record->id, &index,
+								   &record->attributes,
+								   &record->category) < 0)
+		{
+			/* No more modified records */
+			pi_buffer_free(record->data);
+			break;
+		}
+		(*qty)++;
+	}
+	return records;
+}
+
+/**
+   Free modified records, read by _palm_read_modified_records().
+
+   @param[in] records Array of modified records. May be NULL.
+   @param[in] qty Qty of records in array.
+*/
+static void _palm_free_modified_records(struct __PalmModifiedRecord * records,
+										int qty)
+{
+	if(records == NULL)
+	{
+		return;
+	}
+	for(int i = 0; i < qty; i++)
+	{
+		pi_buffer_free(records[i].data);
+	}
+	free(records);
+}
+
+/**
+   Returns path to cached copy of database.
+
+   @param[in] cacheDir Directory with cached databases, with trailing slash.
+   @param[in] dbname Name of database.
+   @return Path to cached copy or NULL on error.
+*/
+static char * _palm_cache_path(const char * cacheDir, const char * dbname)
+{
+	size_t length = strlen(cacheDir) + strlen(PALM_CACHE_PREFIX) +
+		strlen(dbname) + strlen(".pdb") + 1;
+	char * path;
+	if((path = calloc(length, sizeof(char))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for path to cached copy "
+				  "of %s", dbname);
+		return NULL;
+	}
+	snprintf(path, length, "%s" PALM_CACHE_PREFIX "%s.pdb", cacheDir, dbname);
+	return path;
+}
+
+/**
+   Check whether cached copy is the same database version as given file.
+
+   @param[in] path Path to PDB-file with database.
+   @param[in] cachePath Path to cached copy of database.
+   @return True if cached copy has the same creation time and modification
+   number as given file.
+*/
+static bool _palm_cache_current(const char * path, const char * cachePath)
+{
+	int fd;
+	PDB pdb;
+	PDB cache;
+	if((fd = pdb_open(path)) == -1)
+	{
+		return false;
+	}
+	int result = pdb_read_header(fd, &pdb);
+	pdb_close(fd);
+	if(result || access(cachePath, R_OK) || (fd = pdb_open(cachePath)) == -1)
+	{
+		return false;
+	}
+	result = pdb_read_header(fd, &cache);
+	pdb_close(fd);
+	return result == 0 && pdb.ctime == cache.ctime &&
+		pdb.modificationNumber == cache.modificationNumber;
+}
+
+/**
+   Store header fields of database on Palm to PDB-file, written to Palm.
+
+   Modification number and modification datetime of database on Palm are
+   changed after write, so they are stored to the header of PDB-file.
+   This way PDB-file, saved as cached copy or as PDB from previous
+   synchronization, describes current state of database on Palm.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] dbname Name of database.
+   @param[in] path Path to PDB-file, written to Palm.
+   @return 0 on success or -1 on error.
+*/
+static int _palm_update_header(int sd, const char * dbname, const char * path)
+{
+	struct DBInfo info;
+	if(dlp_FindDBInfo(sd, 0, 0, dbname, 0, 0, &info) < 0)
+	{
+		log_write(LOG_WARNING, "Unable to locate database %s on the Palm",
+				  dbname);
+		return -1;
+	}
+
+	int fd;
+	PDB * pdb;
+	if((fd = pdb_open(path)) == -1)
+	{
+		return -1;
+	}
+	if((pdb = pdb_read(fd, false)) == NULL)
+	{
+		pdb_close(fd);
+		return -1;
+	}
+
+	pdb->ctime = info.createDate;
+	pdb->mtime = info.modifyDate;
+	pdb->modificationNumber = info.modnum;
+	int result = pdb_write(fd, pdb) ? -1 : 0;
+	pdb_free(pdb);
+	pdb_close(fd);
+	return result;
+}
+
+/**
+   Replace cached copy of database with database, written to Palm.
+
+   @param[in] dbname Name of database.
+   @param[in] path Path to PDB-file, written to Palm, with header from
+   _palm_update_header() or NULL if header cannot be updated.
+   @param[in] cacheDir Directory with cached databases or NULL.
+*/
+static void _palm_cache_update(const char * dbname, const char * path,
+							   const char * cacheDir)
+{
+	if(cacheDir == NULL)
+	{
+		return;
+	}
+
+	char * cachePath;
+	if((cachePath = _palm_cache_path(cacheDir, dbname)) == NULL)
+	{
+		return;
+	}
+	if(path == NULL || save_file(path, cachePath))
+	{
+		log_write(LOG_WARNING, "Cannot update cached copy of %s, it will be "
+				  "downloaded again", dbname);
+		unlink(cachePath);
+	}
+	free(cachePath);
 }
 
 /**
    Write Palm database from given file to Palm device.
 
+   If there is a copy of database, which was read from Palm in this
+   synchronization cycle, only records which differ from it are written to
+   Palm. Otherwise the whole database is installed to Palm.
+
+   Cached copy is saved only here, once per synchronization cycle.
+
    @param[in] sd Palm device descriptor.
    @param[in] dbname Database name to write.
    @param[in] path Path to PDB file with database data.
-   @return Void.
+   @param[in] readPath Path to database as it was read from Palm or NULL.
+   @param[in] cacheDir Directory with cached databases or NULL.
+   @return 0 on success or -1 on error.
 */
-static void _palm_write_database(int sd, const char * dbname, const char * path)
+static int _palm_write_database(int sd, const char * dbname, const char * path,
+								const char * readPath, const char * cacheDir)
 {
 	if(strlen(dbname) > PDB_DBNAME_LEN - 1)
 	{
 		log_write(LOG_ERR, "Given Palm DB name (%s) has more than %s "
 				  "characters!", dbname, PDB_DBNAME_LEN - 1);
 		log_write(LOG_ERR, "Cannot write data to %s database", dbname);
-		return;
+		return -1;
 	}
 
+	int result = readPath != NULL ?
+		_palm_write_changes(sd, dbname, path, readPath) : -1;
+	if(result == 1)
+	{
+		log_write(LOG_INFO, "Database %s is not changed, skip writing",
+				  dbname);
+		/* Database, downloaded completely, may differ from cached copy */
+		char * cachePath = cacheDir != NULL ?
+			_palm_cache_path(cacheDir, dbname) : NULL;
+		if(cachePath != NULL && !_palm_cache_current(path, cachePath))
+		{
+			_palm_cache_update(dbname, path, cacheDir);
+		}
+		free(cachePath);
+		return 0;
+	}
+	if(result == -1)
+	{
+		if(_palm_install_database(sd, dbname, path))
+		{
+			return -1;
+		}
+	}
+	if(_palm_update_header(sd, dbname, path))
+	{
+		log_write(LOG_WARNING, "Cannot store modification number of %s "
+				  "after write", dbname);
+		_palm_cache_update(dbname, NULL, cacheDir);
+		return 0;
+	}
+	_palm_cache_update(dbname, path, cacheDir);
+	return 0;
+}
+
+/**
+   Write to Palm only records, which differ from database as it was read.
+
+   Copy of database, read from Palm in this synchronization cycle, is
+   compared with given file. New and changed records are written, records
+   which are absent in given file are deleted. Application info block is
+   written only if it is changed. Records with dirty flag on Palm are
+   written too, so their flags are reset after write.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] dbname Database name to write.
+   @param[in] path Path to PDB file with database data.
+   @param[in] readPath Path to database as it was read from Palm.
+   @return 0 if changes are written, 1 if there are no changes or -1 if
+   the whole database should be installed.
+*/
+static int _palm_write_changes(int sd, const char * dbname, const char * path,
+							   const char * readPath)
+{
+	int fd = -1;
+	int readFd = -1;
+	PDB * pdb = NULL;
+	PDB * readPdb = NULL;
+	PDBRecord ** writes = NULL;
+	PDBRecord ** deletes = NULL;
+	int result = -1;
+
+	if((fd = pdb_open(path)) == -1 ||
+	   (pdb = pdb_read(fd, false)) == NULL ||
+	   (readFd = pdb_open(readPath)) == -1 ||
+	   (readPdb = pdb_read(readFd, false)) == NULL)
+	{
+		log_write(LOG_WARNING, "Cannot compare %s with database, read from "
+				  "Palm", path);
+		goto palm_write_changes_end;
+	}
+
+	if((writes = calloc(pdb->recordsQty + 1, sizeof(PDBRecord *))) == NULL ||
+	   (deletes = calloc(readPdb->recordsQty + 1,
+						 sizeof(PDBRecord *))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for changed records: %s",
+				  strerror(errno));
+		goto palm_write_changes_end;
+	}
+
+	/* New and changed records */
+	PDBRecord * record;
+	size_t writesQty = 0;
+	PDB_RECORD_FOREACH(record, pdb)
+	{
+		PDBRecord * readRecord = pdb_record_get(
+			readPdb, pdb_record_get_unique_id(record));
+		size_t length = 0;
+		size_t readLength = 0;
+		const uint8_t * data = pdb_record_data(pdb, record, &length);
+		const uint8_t * readData = readRecord != NULL ?
+			pdb_record_data(readPdb, readRecord, &readLength) : NULL;
+		if(data == NULL)
+		{
+			goto palm_write_changes_end;
+		}
+		/* Dirty flag is cleared in given file, so record, changed on Palm,
+		   differs from read database even with the same data */
+		if(readData == NULL || length != readLength ||
+		   record->attributes != readRecord->attributes ||
+		   memcmp(data, readData, length))
+		{
+			writes[writesQty++] = record;
+		}
+	}
+
+	/* Deleted records */
+	size_t deletesQty = 0;
+	PDB_RECORD_FOREACH(record, readPdb)
+	{
+		if(pdb_record_get(pdb, pdb_record_get_unique_id(record)) == NULL)
+		{
+			deletes[deletesQty++] = record;
+		}
+	}
+
+	/* Application info with categories */
+	size_t appInfoLength = 0;
+	size_t readAppInfoLength = 0;
+	const uint8_t * appInfo = pdb_app_info_data(pdb, &appInfoLength);
+	const uint8_t * readAppInfo = pdb_app_info_data(readPdb,
+													&readAppInfoLength);
+	bool appInfoChanged = appInfoLength != readAppInfoLength ||
+		(appInfoLength > 0 && memcmp(appInfo, readAppInfo, appInfoLength));
+
+	log_write(LOG_DEBUG, "Database %s: %lu records to write, %lu records to "
+			  "delete, application info is %s", dbname, writesQty, deletesQty,
+			  appInfoChanged ? "changed" : "not changed");
+	if(writesQty == 0 && deletesQty == 0 && !appInfoChanged)
+	{
+		result = 1;
+		goto palm_write_changes_end;
+	}
+
+	result = _palm_write_records(sd, dbname, pdb, writes, writesQty, deletes,
+								 deletesQty, appInfoChanged ? appInfo : NULL,
+								 appInfoLength);
+
+palm_write_changes_end:
+	free(writes);
+	free(deletes);
+	if(pdb != NULL)
+	{
+		pdb_free(pdb);
+	}
+	if(readPdb != NULL)
+	{
+		pdb_free(readPdb);
+	}
+	if(fd != -1)
+	{
+		pdb_close(fd);
+	}
+	if(readFd != -1)
+	{
+		pdb_close(readFd);
+	}
+	return result;
+}
+
+/**
+   Write and delete given records in database on Palm.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] dbname Database name to write.
+   @param[in] pdb PDB structure with records to write.
+   @param[in] writes Records to write.
+   @param[in] writesQty Qty of records to write.
+   @param[in] deletes Records to delete.
+   @param[in] deletesQty Qty of records to delete.
+   @param[in] appInfo Application info to write or NULL if it is not changed.
+   @param[in] appInfoLength Length of application info.
+   @return 0 on success or -1 on error.
+*/
+static int _palm_write_records(int sd, const char * dbname, PDB * pdb,
+							   PDBRecord ** writes, size_t writesQty,
+							   PDBRecord ** deletes, size_t deletesQty,
+							   const uint8_t * appInfo, size_t appInfoLength)
+{
+	int db;
+	if(dlp_OpenDB(sd, 0, dlpOpenReadWrite, dbname, &db) < 0)
+	{
+		log_write(LOG_ERR, "Cannot open %s database on Palm for writing",
+				  dbname);
+		return -1;
+	}
+
+	if(appInfo != NULL && dlp_WriteAppBlock(sd, db, appInfo, appInfoLength) < 0)
+	{
+		log_write(LOG_ERR, "Cannot write application info to %s (%d, PalmOS "
+				  "0x%04x)", dbname, pi_error(sd), pi_palmos_error(sd));
+		dlp_CloseDB(sd, db);
+		return -1;
+	}
+
+	for(size_t i = 0; i < deletesQty; i++)
+	{
+		recordid_t id = pdb_record_get_unique_id(deletes[i]);
+		if(dlp_DeleteRecord(sd, db, 0, id) < 0)
+		{
+			log_write(LOG_ERR, "Cannot delete record %lu from %s (%d, PalmOS "
+					  "0x%04x)", id, dbname, pi_error(sd),
+					  pi_palmos_error(sd));
+			dlp_CloseDB(sd, db);
+			return -1;
+		}
+	}
+
+	for(size_t i = 0; i < writesQty; i++)
+	{
+		recordid_t id = pdb_record_get_unique_id(writes[i]);
+		size_t length;
+		const uint8_t * data;
+		if((data = pdb_record_data(pdb, writes[i], &length)) == NULL ||
+		   dlp_WriteRecord(sd, db, writes[i]->attributes &
+						   (PDB_RECORD_ATTR_SECRET | PDB_RECORD_ATTR_DIRTY),
+						   id, writes[i]->attributes & 0x0f, data, length,
+						   NULL) < 0)
+		{
+			log_write(LOG_ERR, "Cannot write record %lu to %s (%d, PalmOS "
+					  "0x%04x)", id, dbname, pi_error(sd),
+					  pi_palmos_error(sd));
+			dlp_CloseDB(sd, db);
+			return -1;
+		}
+	}
+
+	/* Purge deleted records and clear dirty flags, as installing of the
+	   whole database does. Otherwise records, changed on Palm, will be
+	   seen as changed in every next synchronization */
+	if(dlp_CleanUpDatabase(sd, db) < 0 || dlp_ResetSyncFlags(sd, db) < 0)
+	{
+		log_write(LOG_ERR, "Cannot reset synchronization flags of %s (%d, "
+				  "PalmOS 0x%04x)", dbname, pi_error(sd), pi_palmos_error(sd));
+		dlp_CloseDB(sd, db);
+		return -1;
+	}
+
+	if(dlp_CloseDB(sd, db) < 0)
+	{
+		log_write(LOG_ERR, "Cannot close %s database on Palm", dbname);
+		return -1;
+	}
+
+	char synclog[PALM_SYNCLOG_ENTRY_LEN];
+	snprintf(synclog, sizeof(synclog) - 1, "Write %lu and delete %lu records "
+			 "of %s from PC\n", writesQty, deletesQty, dbname);
+	palm_log(sd, synclog);
+	log_write(LOG_INFO, "Write %lu and delete %lu records of %s", writesQty,
+			  deletesQty, dbname);
+	return 0;
+}
+
+/**
+   Install the whole Palm database from given file to Palm device.
+
+   @param[in] sd Palm device descriptor.
+   @param[in] dbname Database name to write.
+   @param[in] path Path to PDB file with database data.
+   @return 0 on success or -1 on error.
+*/
+static int _palm_install_database(int sd, const char * dbname,
+								  const char * path)
+{
 	struct stat sbuf;
 	if(stat(path, &sbuf))
 	{
 		log_write(LOG_ERR, "Cannot stat %s file: %s", path, strerror(errno));
-		return;
+		return -1;
 	}
 
 	struct pi_file * f;
@@ -356,7 +1385,7 @@ static void _palm_write_database(int sd, const char * dbname, const char * path)
 	if(f == NULL)
 	{
 		log_write(LOG_ERR, "Cannot open %s to write to Palm device", path);
-		return;
+		return -1;
 	}
 	if(f->file_name == NULL)
 	{
@@ -382,7 +1411,7 @@ static void _palm_write_database(int sd, const char * dbname, const char * path)
 		log_write(LOG_ERR, "We need %lu and have only %lu available",
 				  (unsigned long)sbuf.st_size, card.ramFree);
 		pi_file_close(f);
-		return;
+		return -1;
 	}
 
 	if(pi_file_install(f, sd, 0, NULL) < 0)
@@ -390,7 +1419,7 @@ static void _palm_write_database(int sd, const char * dbname, const char * path)
 		log_write(LOG_ERR, "Cannot install %s file to Palm (%d, PalmOS 0x%04x)",
 				  path, pi_error(sd), pi_palmos_error(sd));
 		pi_file_close(f);
-		return;
+		return -1;
 	}
 
 	char synclog[PALM_SYNCLOG_ENTRY_LEN];
@@ -400,4 +1429,5 @@ static void _palm_write_database(int sd, const char * dbname, const char * path)
 	pi_file_close(f);
 	log_write(LOG_INFO, "Write %s from %s (%ld bytes)", dbname, path,
 			  sbuf.st_size);
+	return 0;
 }
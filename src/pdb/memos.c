@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "cp1251.h"
 #include "helper.h"
 #include "log.h"
 #include "pdb/memos.h"
@@ -16,8 +17,19 @@
 #define SIX_BYTE_GAP 0x06
 
 
-static Memo * _memos_read_memo(int fd, PDBRecord * record, PDB * pdb);
-static int _memos_write_memo(int fd, Memo * memo);
+static Memo * _memos_read_memo(PDBRecord * record, PDB * pdb,
+							   Arena * arena);
+static int _memos_write_memo(PDBImage * image, Memo * memo);
+static int _memos_index_init(Memos * memos);
+static int _memos_index_add(Memos * memos, Memo * memo);
+static int _memos_index_insert(Memos * memos, Memo * memo,
+							   uint64_t headerHash, uint64_t headerTextHash);
+static void _memos_index_remove(Memos * memos, Memo * memo);
+static uint64_t __memo_header_hash(const char * header);
+static uint64_t __memo_header_text_hash(const char * header, const char * text);
+static uint64_t __memo_hash_combine(uint64_t headerHash, uint64_t textHash);
+static char * __memo_decode(Arena * arena, const uint8_t * data,
+							 size_t length);
 
 
 int memos_open(const char * path)
@@ -31,7 +43,7 @@ int memos_open(const char * path)
 	return fd;
 }
 
-Memos * memos_read(int fd)
+Memos * memos_read(int fd, Arena * arena)
 {
 	Memos * memos;
 	if((memos = calloc(1, sizeof(Memos))) == NULL)
@@ -41,25 +53,19 @@ Memos * memos_read(int fd)
 		return NULL;
 	}
 
-	if((lseek(fd, 0, SEEK_CUR) != 0) && (lseek(fd, 0, SEEK_SET) != 0))
-	{
-		log_write(LOG_ERR, "Cannot rewind to the start of memos file: %s",
-				  strerror(errno));
-		return NULL;
-	}
-
 	if((memos->_pdb = pdb_read(fd, true)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read PDB header from memos file");
 		return NULL;
 	}
 	TAILQ_INIT(&memos->queue);
+	memos->_arena = arena;
 
 	PDBRecord * record;
-	TAILQ_FOREACH(record, &memos->_pdb->records, pointers)
+	PDB_RECORD_FOREACH(record, memos->_pdb)
 	{
 		Memo * memo;
-		if((memo = _memos_read_memo(fd, record, memos->_pdb)) == NULL)
+		if((memo = _memos_read_memo(record, memos->_pdb, arena)) == NULL)
 		{
 			log_write(LOG_ERR, "Error when reading Memos from file. "
 					  "Offset: %x", record->offset);;
@@ -74,68 +80,56 @@ Memos * memos_read(int fd)
 			TAILQ_INSERT_TAIL(&memos->queue, memo, pointers);
 		}
 	}
+
+	if(_memos_index_init(memos))
+	{
+		log_write(LOG_ERR, "Failed to build index of memos");
+		memos_free(memos);
+		return NULL;
+	}
 	return memos;
 }
 
 int memos_write(int fd, Memos * memos)
 {
-	if(lseek(fd, 0, SEEK_CUR) != 0 && lseek(fd, 0, SEEK_SET) != 0)
+	/* Compute length of memos data to allocate memory once */
+	size_t dataLength = 0;
+	Memo * memo;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
 	{
-		log_write(LOG_ERR, "Cannot rewind to the start of memos file: %s",
-				  strerror(errno));
-		return -1;
+		dataLength += memo->_header_cp1251_len + sizeof(char) +
+			(memo->text != NULL ? memo->_text_cp1251_len : 0) + sizeof(char);
 	}
 
-	if(pdb_write(fd, memos->_pdb))
+	/* Application info with categories is followed by six byte gap, filled
+	   with zeroes */
+	PDBImage image;
+	if(pdb_image_init(&image, memos->_pdb, PDB_CATEGORIES_SIZE + SIX_BYTE_GAP,
+					  dataLength))
 	{
 		log_write(LOG_ERR, "Cannot write header to PDB file with memos");
 		return -1;
 	}
 
-	/* Fill gap between application info section and notes data (6 bytes)
-	   with zeroes.
-	*/
-	PDBRecord * record = TAILQ_FIRST(&memos->_pdb->records);
-	if(record == NULL)
-	{
-		log_write(LOG_ERR, "Failed to read first record from PDB structure");
-		return -1;
-	}
-	int currentOffset = lseek(fd, 0, SEEK_CUR);
-	if(currentOffset == -1 || (record->offset - currentOffset != SIX_BYTE_GAP))
-	{
-		if(currentOffset == -1)
-		{
-			log_write(LOG_ERR, "Cannot get current file position: %s",
-					  strerror(errno));
-		}
-		log_write(LOG_ERR, "Cannot fill 6 byte gap with zeroes. "
-				  "First record offset: 0x%08x. "
-				  "Current offset: 0x%08x. "
-				  "Diff: %d",
-				  record->offset, currentOffset, record->offset - currentOffset);
-		return -1;
-	}
-	const char sixByteGap[SIX_BYTE_GAP] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-	if(write(fd, sixByteGap, SIX_BYTE_GAP) != SIX_BYTE_GAP)
-	{
-		log_write(LOG_ERR, "Failed to write six byte gap: %s", strerror(errno));
-		return -1;
-	}
-
-	/* Writing memos to PDB file */
-	Memo * memo;
+	/* Writing memos to PDB image */
 	TAILQ_FOREACH(memo, &memos->queue, pointers)
 	{
-		if(_memos_write_memo(fd, memo))
+		if(_memos_write_memo(&image, memo))
 		{
 			log_write(LOG_ERR, "Failed to write memo with header \"%s\" to "
 					  "file!", memo->header);
+			pdb_image_free(&image);
 			return -1;
 		}
 	}
 
-	return 0;
+	int result = pdb_image_write(fd, memos->_pdb, &image);
+	if(result)
+	{
+		log_write(LOG_ERR, "Cannot write PDB file with memos");
+	}
+	pdb_image_free(&image);
+	return result;
 }
 
 void memos_close(int fd)
@@ -149,22 +143,9 @@ void memos_free(Memos * memos)
 	{
 		return;
 	}
-	Memo * memo1 = TAILQ_FIRST(&memos->queue);
-	Memo * memo2;
-	while(memo1 != NULL)
-	{
-		memo2 = TAILQ_NEXT(memo1, pointers);
-		free(memo1->header);
-		free(memo1->text);
-		free(memo1->category);
-		PDBRecord * record = memo1->_record;
-		memo1->_record = NULL;
-		TAILQ_REMOVE(&memos->queue, memo1, pointers);
-		free(memo1);
-		record->data = NULL;
-		memo1 = memo2;
-	}
-
+	hash_index_free(&memos->_byId);
+	hash_index_free(&memos->_byHeader);
+	hash_index_free(&memos->_byHeaderText);
 	pdb_free(memos->_pdb);
 	free(memos);
 }
@@ -172,182 +153,53 @@ void memos_free(Memos * memos)
 
 /* Functions to operate with memo */
 
-/**
-   Element of array with memos. Maps memo header, or header and text, or ID
-   and pointer to memo.
-
-   Used to sort memos and search for desired memo.
-*/
-struct __SortedMemos
-{
-	uint32_t id;   /**< ID of Memo */
-	char * header; /**< Pointer to Memo header */
-	char * text;   /**< Pointer to Memo text */
-	Memo * memo;   /**< Pointer to Memo structure */
-};
-
-static int __compare_headers(const void * rec1, const void * rec2)
-{
-	return strcmp(((const struct __SortedMemos *)rec1)->header,
-				  ((const struct __SortedMemos *)rec2)->header);
-}
-
-static int __compare_headers_and_text(const void * rec1, const void * rec2)
-{
-	char * text1 = ((const struct __SortedMemos *)rec1)->text;
-	char * text2 = ((const struct __SortedMemos *)rec2)->text;
-	int result = strcmp(((const struct __SortedMemos *)rec1)->header,
-						((const struct __SortedMemos *)rec2)->header);
-	if(result == 0 && text1 != NULL && text2 != NULL)
-	{
-		return strcmp(text1, text2);
-	}
-	else
-	{
-		return result;
-	}
-}
-
-/**
-   Recursive search of memos with given header/text.
-
-   On first iteration function will search for desired memo. On second
-   iteration it will search for the memo with the same header/text,
-   excluding previously found memo.
-
-   @param[in] memos Memos structure.
-   @param[in] header Will search memo with this header.
-   @param[in] text Optional. Will search memo with this text. May be NULL, then
-   memo text will not be used in search.
-   @param[out] id ID of found memo. Will be NULL on error.
-   @param[in] prevId ID of memo, found on previous iteration or NULL on the
-   first iteration.
-   @return Zero on success, E_NOMEMO if no memo is found, E_MULTIPLE_MEMOS if
-   found multiple memos.
-*/
-int _memos_memo_get_id(Memos * memos, char * header, char * text, uint32_t * id,
-					   uint32_t * prevId)
+int memos_memo_get_id(Memos * memos, char * header, char * text, uint32_t * id)
 {
-	int memosQty = memos->_pdb->recordsQty;
-	/* One less element on the 2nd iteration */
-	struct __SortedMemos sortedMemos[prevId == NULL ? memosQty : memosQty - 1];
+	HashIndex * index = text == NULL ? &memos->_byHeader :
+		&memos->_byHeaderText;
+	uint64_t key = text == NULL ? __memo_header_hash(header) :
+		__memo_header_text_hash(header, text);
 
+	Memo * found = NULL;
 	Memo * memo;
-	unsigned short index = 0;
-
-	if(prevId != NULL)
-	{
-		log_write(LOG_DEBUG, "Second iteration of _memos_memo_get_id");
-	}
-	else
+	size_t cursor = 0;
+	while((memo = hash_index_find(index, key, &cursor)) != NULL)
 	{
-		log_write(LOG_DEBUG, "First iteration of _memos_memo_get_id");
-	}
-
-	TAILQ_FOREACH(memo, &memos->queue, pointers)
-	{
-		if(prevId != NULL && *prevId == memo->id)
+		if(strcmp(memo->header, header) != 0 ||
+		   (text != NULL &&
+			strcmp(memo->text != NULL ? memo->text : "", text) != 0))
 		{
 			continue;
 		}
-		sortedMemos[index].header = memo->header;
-		sortedMemos[index].text = memo->text;
-		sortedMemos[index].memo = memo;
-		index++;
-	}
-
-	if(prevId == NULL && memosQty != index)
-	{
-		log_write(LOG_ERR, "Memos count in PDB header: %d, real memos "
-				  "count: %d", memosQty, index);
-		return E_NOMEMO;
-	}
-
-	qsort(&sortedMemos, memosQty, sizeof(struct __SortedMemos),
-		  text == NULL ? __compare_headers : __compare_headers_and_text);
-	struct __SortedMemos searchFor = {0, header, text, NULL};
-	struct __SortedMemos * searchResult = bsearch(
-		&searchFor, &sortedMemos, memosQty, sizeof(struct __SortedMemos),
-		text == NULL ? __compare_headers : __compare_headers_and_text);
-
-	if(searchResult == NULL)
-	{
-		return E_NOMEMO;
-	}
-
-	if(prevId == NULL)
-	{
-		if(_memos_memo_get_id(memos, header, text, id,
-								   &searchResult->memo->id) != E_NOMEMO)
+		if(found != NULL)
 		{
+			log_write(LOG_DEBUG, "Found second memo with header = %s. ID = %d",
+					  header, memo->id);
 			return E_MULTIPLE_MEMOS;
 		}
-		else
-		{
-			*id = searchResult->memo->id;
-			return 0;
-		}
-	}
-	else
-	{
-		*id = searchResult->memo->id;
-		log_write(LOG_DEBUG, "Found second memo with header = %s. ID = %d",
-				  header, *id);
-		return 0;
+		found = memo;
 	}
-}
-
-int memos_memo_get_id(Memos * memos, char * header, char * text, uint32_t * id)
-{
-	return _memos_memo_get_id(memos, header, text, id, NULL);
-}
 
-static int __compare_ids(const void * rec1, const void * rec2)
-{
-	uint32_t id1 = ((const struct __SortedMemos *)rec1)->id;
-	uint32_t id2 = ((const struct __SortedMemos *)rec2)->id;
-	if(id1 < id2)
+	if(found == NULL)
 	{
-		return -1;
-	}
-	else if(id1 == id2)
-	{
-		return 0;
+		return E_NOMEMO;
 	}
-	else
-	{
-		return 1;
-	};
+	*id = found->id;
+	return 0;
 }
 
 Memo * memos_memo_get(Memos * memos, uint32_t id)
 {
-	int memosQty = memos->_pdb->recordsQty;
-	struct __SortedMemos sortedMemos[memosQty];
-
 	Memo * memo;
-	unsigned short index = 0;
-
-	TAILQ_FOREACH(memo, &memos->queue, pointers)
-	{
-		sortedMemos[index].id = memo->id;
-		sortedMemos[index].memo = memo;
-		index++;
-	}
-
-	if(memosQty != index)
+	size_t cursor = 0;
+	while((memo = hash_index_find(&memos->_byId, id, &cursor)) != NULL)
 	{
-		log_write(LOG_ERR, "Memos count in PDB header: %d, real memos "
-				  "count: %d", memosQty, index);
-		return NULL;
+		if(memo->id == id)
+		{
+			return memo;
+		}
 	}
-
-	qsort(&sortedMemos, memosQty, sizeof(struct __SortedMemos), __compare_ids);
-	struct __SortedMemos searchFor = {id, NULL, NULL, NULL};
-	struct __SortedMemos * searchResult = bsearch(
-		&searchFor, &sortedMemos, memosQty, sizeof(struct __SortedMemos),
-		__compare_ids);
-	return searchResult == NULL ? NULL : searchResult->memo;
+	return NULL;
 }
 
 uint32_t memos_memo_add(Memos * memos, char * header, char * text,
@@ -369,7 +221,7 @@ uint32_t memos_memo_add(Memos * memos, char * header, char * text,
 	{
 		category = PDB_DEFAULT_CATEGORY;
 	}
-	int categoryId = pdb_category_get_id(memos->_pdb, category);
+	uint8_t categoryId = pdb_category_get_id(memos->_pdb, category);
 	if(categoryId == UINT8_MAX)
 	{
 		log_write(LOG_DEBUG, "Category with name \"%s\" not found in Memos "
@@ -382,128 +234,45 @@ uint32_t memos_memo_add(Memos * memos, char * header, char * text,
 		}
 	}
 
-	/* Calculate offset for new memo: */
-
-	/* Get last memo */
 	PDBRecord * record;
 	Memo * memo;
-	if((record = TAILQ_LAST(&memos->_pdb->records, RecordQueue)) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot get last memo's record from PDB header");
-		return 0;
-	}
-	if((memo = TAILQ_LAST(&memos->queue, MemosQueue)) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot get last memo");
-		return 0;
-	}
-	if(memo->_record != record)
-	{
-		log_write(LOG_ERR, "Latest memo and latest PDB record doesn't match");
-		return 0;
-	}
-	uint32_t offset = record->offset;
-	log_write(LOG_DEBUG, "Offset of the last record: 0x%08x", offset);
-
-	/* Calculate size of last record and offset beyond it: */
-	/* Header + '\n' */
-	offset += memo->_header_cp1251_len + sizeof(char);
-	/* Text (if exists) + '\0' */
-	offset += (memo->text != NULL ? memo->_text_cp1251_len : 0) + sizeof(char);
-	log_write(LOG_DEBUG, "Offset beyond the last record: 0x%08x", offset);
-	/* New item in record list */
-	offset += PDB_RECORD_ITEM_SIZE;
-	log_write(LOG_DEBUG, "New offset for new memo: 0x%08x", offset);
-
-	/* Prepare header for new memo */
-	char * newHeader;
-	/* '+ 1' for NULL-terminating character */
-	if((newHeader = calloc(strlen(header) + 1, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot allocate memory for new memo header: %s",
-				  strerror(errno));
-		return 0;
-	}
-	strcpy(newHeader, header);
-	/* Calculate length of CP1251 encoded header */
-	char * newHeaderCp1251 = iconv_utf8_to_cp1251(header);
-	if(newHeaderCp1251 == NULL)
+
+	/* Calculate lengths of CP1251 encoded header and text */
+	size_t newHeaderCp1251Len = utf8_to_cp1251_length(header, strlen(header));
+	if(newHeaderCp1251Len == CP1251_ERROR)
 	{
 		log_write(LOG_ERR, "Failed to convert new memo header \"%s\" "
 				  "from UTF8 to CP1251", header);
-		free(newHeader);
 		return 0;
 	}
-	size_t newHeaderCp1251Len = strlen(newHeaderCp1251);
-	free(newHeaderCp1251);
-	log_write(LOG_DEBUG, "New memo header copied, length (CP1251): %d",
-			  newHeaderCp1251Len);
-
-	/* Prepare text for new memo */
-	char * newText = NULL;
-	size_t newTextCp1251Len = 0;
-	if(text != NULL)
+	size_t newTextCp1251Len = text != NULL ?
+		utf8_to_cp1251_length(text, strlen(text)) : 0;
+	if(newTextCp1251Len == CP1251_ERROR)
 	{
-		/* '+1' for NULL-terminated character */
-		if((newText = calloc(strlen(text) + 1, sizeof(char))) == NULL)
-		{
-			log_write(LOG_ERR, "Cannot allocate memory for new memo text: %s",
-					  strerror(errno));
-			free(newHeader);
-			return 0;
-		}
-		strcpy(newText, text);
-		/* Calculate length of CP1251 encoded text */
-		char * newTextCp1251 = iconv_utf8_to_cp1251(text);
-		if(newTextCp1251 == NULL)
-		{
-			log_write(LOG_ERR, "Failed to convert new memo text \"%s\" "
-					  "from UTF8 to CP1251", text);
-			free(newHeader);
-			free(newText);
-			return 0;
-		}
-		newTextCp1251Len = strlen(newTextCp1251);
-		free(newTextCp1251);
-		log_write(LOG_DEBUG, "New memo text copied, length (CP1251): %d",
-				  newTextCp1251Len);
-	}
-
-	/* Prepare category for new memo */
-	char * newCategory;
-	if((newCategory = calloc(strlen(category) + 1, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot allocate memory for new memo category: %s",
-				  strerror(errno));
-		free(newHeader);
-		free(newText);
+		log_write(LOG_ERR, "Failed to convert new memo text \"%s\" "
+				  "from UTF8 to CP1251", text);
 		return 0;
 	}
-	strcpy(newCategory, category);
-	log_write(LOG_DEBUG, "New memo category copied");
+	log_write(LOG_DEBUG, "New memo length (CP1251): header: %d, text: %d",
+			  newHeaderCp1251Len, newTextCp1251Len);
 
-	/* Allocate memory for new memo */
-	if((memo = calloc(1, sizeof(Memo))) == NULL)
+	/* Copy memo and its strings to arena */
+	if((memo = arena_alloc(memos->_arena, sizeof(Memo))) == NULL ||
+	   (memo->header = arena_strdup(memos->_arena, header)) == NULL ||
+	   (text != NULL &&
+		(memo->text = arena_strdup(memos->_arena, text)) == NULL))
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for new memo: %s",
-				  strerror(errno));
-		free(newHeader);
-		free(newText);
-		free(newCategory);
+		log_write(LOG_ERR, "Cannot allocate memory for new memo");
 		return 0;
 	}
-	log_write(LOG_DEBUG, "Memory for new memo allocated");
 
-	/* Add new record for new memo */
+	/* Add new record for new memo. Memo is owned by arena, not by
+	   record */
 	if((record = pdb_record_create(
-			memos->_pdb, offset,
-			PDB_RECORD_ATTR_EMPTY | (0x0f & categoryId), memo)) == NULL)
+			memos->_pdb, 0, PDB_RECORD_ATTR_EMPTY | (0x0f & categoryId),
+			NULL)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot add new PDB record for new memo");
-		free(newHeader);
-		free(newText);
-		free(newCategory);
-		free(memo);
 		return 0;
 	}
 
@@ -513,9 +282,8 @@ uint32_t memos_memo_add(Memos * memos, char * header, char * text,
 
 	/* Fill new memo with data and append it to PDB structure */
 	memo->id = id;
-	memo->header = newHeader;
-	memo->text = newText;
-	memo->category = newCategory;
+	memo->categoryId = categoryId;
+	memo->category = pdb_category_get_name(memos->_pdb, categoryId);
 	memo->_record = record;
 	memo->_header_cp1251_len = newHeaderCp1251Len;
 	memo->_text_cp1251_len = newTextCp1251Len;
@@ -529,19 +297,10 @@ uint32_t memos_memo_add(Memos * memos, char * header, char * text,
 		TAILQ_INSERT_TAIL(&memos->queue, memo, pointers);
 		log_write(LOG_DEBUG, "New memo added as the last memo to the queue");
 	}
-
-	/* Recalculate and update offsets for old memos due to
-	   length of record list change */
-	log_write(LOG_DEBUG, "Changing offsets for old memos due to record list "
-			  "size change");
-	PDBRecord * old_record = TAILQ_PREV(record, RecordQueue, pointers);
-	while(old_record != NULL)
+	if(_memos_index_add(memos, memo))
 	{
-		log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
-				  "new offset=0x%08x", old_record->offset,
-				  old_record->offset + PDB_RECORD_ITEM_SIZE);
-		old_record->offset += PDB_RECORD_ITEM_SIZE;
-		old_record = TAILQ_PREV(old_record, RecordQueue, pointers);
+		log_write(LOG_ERR, "Cannot add new memo to the index");
+		return 0;
 	}
 
 	return id;
@@ -566,26 +325,6 @@ int memos_memo_edit(Memos * memos, uint32_t id, char * header, char * text,
 
 	PDBRecord * record = memo->_record;
 
-	/* Allocate memory for new header and text, if necessary */
-	char * newHeader = NULL;
-	char * newText = NULL;
-	if(header != NULL && strlen(header) > strlen(memo->header) &&
-	   (newHeader = calloc(strlen(header), sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate memory for new memo's header: %s",
-				  strerror(errno));
-		return -1;
-	}
-	size_t strlenOldMemoText = memo->text != NULL ? strlen(text) : 0;
-	if(text != NULL && strlen(text) > strlenOldMemoText &&
-	   (newText = calloc(strlen(text), sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate memory for memo's new text: %s",
-				  strerror(errno));
-		free(newHeader);
-		return -1;
-	}
-
 	/* Load category ID for new category, if necessary */
 	uint8_t categoryId = 0;
 	if(category != NULL &&
@@ -593,72 +332,45 @@ int memos_memo_edit(Memos * memos, uint32_t id, char * header, char * text,
 	{
 		log_write(LOG_ERR, "Cannot find category ID for category \"%s\"",
 				  category);
-		free(newHeader);
-		free(newText);
 		return -1;
 	}
 
-	/* Calculate difference between new and old header/text strings in CP1251
-	   encoding, while old data is exists */
-	uint32_t headerSizeDiff = 0;
-	if(header != NULL)
+	/* Calculate length of new header/text strings in CP1251 encoding */
+	size_t headerCp1251Len = header != NULL ?
+		utf8_to_cp1251_length(header, strlen(header)) :
+		memo->_header_cp1251_len;
+	size_t textCp1251Len = text != NULL ?
+		utf8_to_cp1251_length(text, strlen(text)) : memo->_text_cp1251_len;
+	if(headerCp1251Len == CP1251_ERROR || textCp1251Len == CP1251_ERROR)
 	{
-		char * headerCp1251 = iconv_utf8_to_cp1251(header);
-		headerSizeDiff = strlen(headerCp1251) - memo->_header_cp1251_len;
-		free(headerCp1251);
-	}
-	uint32_t textSizeDiff = 0;
-	if(text != NULL)
-	{
-		char * textCp1251 = iconv_utf8_to_cp1251(text);
-		textSizeDiff = strlen(textCp1251) - memo->_text_cp1251_len;
-		free(textCp1251);
+		log_write(LOG_ERR, "Failed to convert new memo header or text from "
+				  "UTF8 to CP1251");
+		return -1;
 	}
-	log_write(LOG_DEBUG, "Calculate strings' size diffs, header: %d, text: %d",
-			  headerSizeDiff, textSizeDiff);
 
-	/* Set new header for memo */
-	if(newHeader != NULL)
-	{
-		free(memo->header);
-		memo->header = newHeader;
-		strcpy(memo->header, header);
-		log_write(LOG_DEBUG, "New header set");
-	}
-	else if(header != NULL)
+	/* Copy new header and text to arena, old strings are released together
+	   with arena */
+	char * newHeader = memo->header;
+	char * newText = memo->text;
+	if((header != NULL &&
+		(newHeader = arena_strdup(memos->_arena, header)) == NULL) ||
+	   (text != NULL && (newText = arena_strdup(memos->_arena, text)) == NULL))
 	{
-		explicit_bzero(memo->header, strlen(memo->header));
-		strcpy(memo->header, header);
-		log_write(LOG_DEBUG, "New header set");
+		log_write(LOG_ERR, "Failed to allocate memory for new header or text "
+				  "of memo");
+		return -1;
 	}
 
-	/* Set new text for memo */
-	if(newText != NULL)
-	{
-		/* New text size is larger than existing memo's text size */
-		free(memo->text);
-		/* Use newly allocated string */
-		memo->text = newText;
-		/* and copy new text string to it */
-		strcpy(memo->text, text);
-		log_write(LOG_DEBUG, "New text set");
-	}
-	else if(text != NULL)
+	/* Header and text hashes will be changed */
+	_memos_index_remove(memos, memo);
+	memo->header = newHeader;
+	memo->text = newText;
+	log_write(LOG_DEBUG, "New header and text set");
+
+	if(_memos_index_add(memos, memo))
 	{
-		/* New text size is smaller or equals to existing memo's text size */
-		if(memo->text == NULL)
-		{
-			if((memo->text = calloc(strlen(text), sizeof(char))) == NULL)
-			{
-				log_write(LOG_ERR, "Failed to allocate memory for new text in "
-						  "memo structure: %s", strerror(errno));
-				free(newHeader);
-				return -1;
-			}
-		}
-		explicit_bzero(memo->text, strlen(memo->text));
-		strcpy(memo->text, text);
-		log_write(LOG_DEBUG, "New text set");
+		log_write(LOG_ERR, "Cannot update index for memo with ID = %d", id);
+		return -1;
 	}
 
 	/* Set new category for category */
@@ -666,22 +378,14 @@ int memos_memo_edit(Memos * memos, uint32_t id, char * header, char * text,
 	{
 		record->attributes &= 0xf0;
 		record->attributes |= categoryId;
+		memo->categoryId = categoryId;
+		memo->category = pdb_category_get_name(memos->_pdb, categoryId);
 		log_write(LOG_DEBUG, "New category set");
 	}
 
-	/* Should recalculate PDB offsets for next memos */
-	log_write(LOG_DEBUG, "Recalculate offsets for next memos");
-	if(headerSizeDiff + textSizeDiff != 0)
-	{
-		/* Edit offset starting from edited record */
-		while((record = TAILQ_NEXT(record, pointers)) != NULL)
-		{
-			log_write(LOG_DEBUG, "Next memo: old offset=0x%08x, "
-					  "new offset=0x%08x", record->offset,
-					  record->offset + headerSizeDiff + textSizeDiff);
-			record->offset += headerSizeDiff + textSizeDiff;
-		}
-	}
+	/* Offsets of records are calculated when memos are written */
+	memo->_header_cp1251_len = headerCp1251Len;
+	memo->_text_cp1251_len = textCp1251Len;
 
 	return 0;
 }
@@ -704,42 +408,15 @@ int memos_memo_delete(Memos * memos, uint32_t id)
 	uint32_t memoId = memo->id;
 	log_write(LOG_DEBUG, "Deleting memo with ID: %d", memoId);
 
-	uint32_t offset;
-	/* header + '\n' */
-	offset = strlen(memo->header) + sizeof(char);
-	/* text   + '\0' */
-	offset += (memo->text != NULL ? strlen(memo->text) : 0) + sizeof(char);
-
-	/* Delete memo */
-	PDBRecord * record = memo->_record;
-	free(memo->header);
-	free(memo->text);
-	free(memo->category);
+	/* Delete memo, its memory is released together with arena */
+	_memos_index_remove(memos, memo);
 	TAILQ_REMOVE(&memos->queue, memo, pointers);
 
-	/* Recalculate offsets for next memos */
-	log_write(LOG_DEBUG, "Recalculate offsets for existing memos");
-	while((record = TAILQ_NEXT(record, pointers)) != NULL)
-	{
-		log_write(LOG_DEBUG, "Existing memo: old offset=0x%08x, new offset="
-				  "0x%08x", record->offset, record->offset - offset);
-		record->offset -= offset;
-	}
-	/* Recalculate offsets due to record list size change */
-	log_write(LOG_DEBUG, "Recalculate offsets due to record list size change");
-	TAILQ_FOREACH(record, &memos->_pdb->records, pointers)
-	{
-		log_write(LOG_DEBUG, "Existing memo [2]: old offset=0x%08x, "
-				  "new offset=0x%08x", record->offset,
-				  record->offset - PDB_RECORD_ITEM_SIZE);
-		record->offset -= PDB_RECORD_ITEM_SIZE;
-	}
-
 	/* Delete record */
 	if(pdb_record_delete(memos->_pdb, memoId))
 	{
 		log_write(LOG_ERR, "Cannot delete memo record with ID=%d from record "
-				  "list (offset: 0x%08x)", memoId, record->offset);
+				  "list", memoId);
 		return -1;
 	}
 
@@ -747,177 +424,66 @@ int memos_memo_delete(Memos * memos, uint32_t id)
 }
 
 /**
-   Read memo, pointed by PDBRecord, from file with given descriptor.
+   Read memo, pointed by PDBRecord, from PDB file contents in memory.
 
-   @param[in] fd File descriptor.
    @param[in] record PDBRecord, which points to memo.
    @param[in] pdb PDB structure with data from file.
+   @param[in] arena Arena to allocate memo from.
    @return Memo or NULL if error.
 */
-static Memo * _memos_read_memo(int fd, PDBRecord * record, PDB * pdb)
+static Memo * _memos_read_memo(PDBRecord * record, PDB * pdb, Arena * arena)
 {
-	/* Go to memo */
-	if(lseek(fd, record->offset, SEEK_SET) != record->offset)
+	size_t length = 0;
+	const uint8_t * data;
+	if((data = pdb_record_data(pdb, record, &length)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot go to 0x%08x offset in PDB file to read "
-				  "memo: %s", record->offset, strerror(errno));
+		log_write(LOG_ERR, "Cannot get memo data at 0x%08x offset",
+				  record->offset);
 		return NULL;
 	}
 
-	char buffer[CHUNK_SIZE] = "\0";
-	ssize_t readedBytes = 0;
+	/* Memo ends with '\0' or with the end of record */
+	const uint8_t * memoEnd = memchr(data, '\0', length);
+	size_t memoSize = memoEnd != NULL ? (size_t)(memoEnd - data) : length;
 
-	/* Calculate header size */
-	unsigned int headerSize = 0;
-	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
-	{
-		const char * headerEnd = memchr(buffer, '\n', readedBytes);
-		if(headerEnd != NULL)
-		{
-			headerSize += headerEnd - buffer;
-			/* "+ 1" to skip '\n' at the end of memo header */
-			if(lseek(fd, -(readedBytes - (headerEnd - buffer)) + 1,
-					 SEEK_CUR) == (off_t)-1)
-			{
-				log_write(LOG_ERR, "Cannot rewind to start of memo text: %s",
-						  strerror(errno));
-				return NULL;
-			}
-			break;
-		}
-		headerSize += readedBytes;
-	}
-	if(readedBytes < 0)
-	{
-		log_write(LOG_ERR, "Failed to locate memo header: %s", strerror(errno));
-		return NULL;
-	}
+	/* First line of memo is a header, the remaining lines - text */
+	const uint8_t * headerEnd = memchr(data, '\n', memoSize);
+	size_t headerSize = headerEnd != NULL ? (size_t)(headerEnd - data) :
+		memoSize;
+	size_t textSize = headerEnd != NULL ? memoSize - headerSize - 1 : 0;
+	log_write(LOG_DEBUG, "Header size: %lu, text size: %lu", headerSize,
+			  textSize);
 
-	/* Calculate text size */
-	unsigned int textSize = 0;
-	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
-	{
-		const char * textEnd = memchr(buffer, '\0', readedBytes);
-		if(textEnd != NULL)
-		{
-			textSize += textEnd - buffer;
-			if(lseek(fd, -(readedBytes - (textEnd - buffer)),
-					 SEEK_CUR) == (off_t)-1)
-			{
-				log_write(LOG_ERR, "Cannot rewind to end of memo text: %s",
-						  strerror(errno));
-				return NULL;
-			}
-			break;
-		}
-		textSize += readedBytes;
-	}
-	if(readedBytes < 0)
-	{
-		log_write(LOG_ERR, "Failed to locate memo text: %s", strerror(errno));
-		return NULL;
-	}
-	log_write(LOG_DEBUG, "Header size: %d, text size: %d", headerSize, textSize);
-
-	/* Rewinding to the start of memo */
-	if(lseek(fd, record->offset, SEEK_SET) != record->offset)
-	{
-		log_write(LOG_ERR, "Cannot rewind to start of memo: %s",
-				  strerror(errno));
-		return NULL;
-	}
-
-	/* Read CP1251 encoded header */
-	char * headerCp1251;
-	if((headerCp1251 = calloc(headerSize, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate buffer for new memo header "
-				  "(CP1251): %s", strerror(errno));
-		return NULL;
-	}
-	if(read_chunks(fd, headerCp1251, headerSize))
-	{
-		log_write(LOG_ERR, "Cannot read memo header");
-		return NULL;
-	}
-
-	/* Encode header to UTF8 */
-	char * header = iconv_cp1251_to_utf8(headerCp1251);
+	/* Encode header and text to UTF8 directly from file contents */
+	char * header = __memo_decode(arena, data, headerSize);
 	if(header == NULL)
 	{
 		log_write(LOG_ERR, "Failed to encode CP1251 header to UTF8");
-		free(headerCp1251);
-		return NULL;
-	}
-	free(headerCp1251);
-
-	/* Skip '\n' from the header */
-	if(lseek(fd, 1, SEEK_CUR) == (off_t)-1)
-	{
-		log_write(LOG_ERR, "Failed to skip newline symbol between memo header "
-				  "and text: %s", strerror(errno));
-		free(header);
 		return NULL;
 	}
-
-	/* Read CP1251 encoded text */
-	char * textCp1251;
-	if((textCp1251 = calloc(textSize, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Failed to allocate buffer for new memo text "
-				  "(CP1251): %s", strerror(errno));
-		free(header);
-		return NULL;
-	}
-	if(read_chunks(fd, textCp1251, textSize))
-	{
-		log_write(LOG_ERR, "Cannot read memo text");
-		free(header);
-		return NULL;
-	}
-
-	/* Encode text for UTF8 */
-	char * text = iconv_cp1251_to_utf8(textCp1251);
+	char * text = __memo_decode(arena, headerEnd != NULL ? headerEnd + 1 : data,
+								textSize);
 	if(text == NULL)
 	{
 		log_write(LOG_ERR, "Failed to encode CP1251 text to UTF8");
-		free(header);
-		free(textCp1251);
 		return NULL;
 	}
-	free(textCp1251);
 
-	/* Get string with category name */
-	char * categoryName = pdb_category_get_name(pdb, record->attributes & 0x0f);
+	/* Category name is shared with categories of PDB file */
+	uint8_t categoryId = record->attributes & 0x0f;
+	const char * categoryName = pdb_category_get_name(pdb, categoryId);
 	if(categoryName == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read category name");
-		free(header);
-		free(text);
 	    return NULL;
 	}
 
 	/* Allocate memory for memo */
 	Memo * memo;
-	if((memo = calloc(1, sizeof(Memo))) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot allocate memory for memo at offset 0x%08x:"
-				  " %s", record->offset, strerror(errno));
-		free(header);
-		free(text);
-		free(categoryName);
-		return NULL;
-	}
-
-	/* Allocate memory for new memo's category */
-	if((memo->category = calloc(PDB_CATEGORY_LEN, sizeof(char))) == NULL)
+	if((memo = arena_alloc(arena, sizeof(Memo))) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for memo category: %s",
-				  strerror(errno));
-		free(memo);
-		free(header);
-		free(text);
-		free(categoryName);
+		log_write(LOG_ERR, "Cannot allocate memory for memo at offset "
+				  "0x%08x", record->offset);
 		return NULL;
 	}
 
@@ -926,18 +492,14 @@ static Memo * _memos_read_memo(int fd, PDBRecord * record, PDB * pdb)
 	if(id == 0)
 	{
 		log_write(LOG_ERR, "Failed to get ID of memo!");
-		free(memo->category);
-		free(memo);
-		free(text);
-		free(header);
-		free(categoryName);
 		return NULL;
 	}
 
 	memo->id = id;
 	memo->header = header;
 	memo->text = text;
-	strncpy(memo->category, categoryName, PDB_CATEGORY_LEN);
+	memo->categoryId = categoryId;
+	memo->category = categoryName;
 	memo->_record = record;
 	memo->_header_cp1251_len = headerSize;
 	memo->_text_cp1251_len = textSize;
@@ -945,13 +507,15 @@ static Memo * _memos_read_memo(int fd, PDBRecord * record, PDB * pdb)
 }
 
 /**
-   Writes given memo to file.
+   Writes given memo to PDB image.
+
+   Header and text are encoded to CP1251 directly in image memory.
 
-   @param[in] fd File descriptor.
+   @param[in] image PDB image.
    @param[in] memo Memo to write.
    @return 0 on success or non-zero value if error.
 */
-static int _memos_write_memo(int fd, Memo * memo)
+static int _memos_write_memo(PDBImage * image, Memo * memo)
 {
 	if(memo == NULL)
 	{
@@ -959,73 +523,229 @@ static int _memos_write_memo(int fd, Memo * memo)
 		return -1;
 	}
 
-	PDBRecord * record = memo->_record;
-	uint32_t offset = record->offset;
-
-	/* Go to right place */
-	if(lseek(fd, offset, SEEK_SET) != offset)
+	size_t textLength = memo->text != NULL ? memo->_text_cp1251_len : 0;
+	size_t length = memo->_header_cp1251_len + sizeof(char) + textLength +
+		sizeof(char);
+	char * data;
+	if((data = (char *)pdb_image_add_record(image, memo->_record, length)) ==
+	   NULL)
 	{
-		log_write(LOG_ERR, "Failed to go to 0x%08x position in PDB file",
-				  offset);
 		return -1;
 	}
 
-	/* Encode header to CP1251 */
-	char * headerCp1251 = iconv_utf8_to_cp1251(memo->header);
-	if(headerCp1251 == NULL)
+	/* Insert header and '\n' as divider. Null-terminating character of
+	   header is replaced with divider */
+	if(utf8_to_cp1251(memo->header, strlen(memo->header), data,
+					  memo->_header_cp1251_len + 1) != memo->_header_cp1251_len)
 	{
 		log_write(LOG_ERR, "Failed to encode memo's header \"%s\" to CP1251. "
 				  "Memo ID = %d", memo->header, memo->id);
 		return -1;
 	}
+	data += memo->_header_cp1251_len;
+	*data++ = '\n';
 
-	/* Insert header */
-	if(write_chunks(fd, headerCp1251, memo->_header_cp1251_len))
+	/* Insert text and '\0' at the end of memo */
+	if(memo->text != NULL)
 	{
-		log_write(LOG_ERR, "Failed to write memo header!");
-		free(headerCp1251);
-		return -1;
+		if(utf8_to_cp1251(memo->text, strlen(memo->text), data,
+						  textLength + 1) != textLength)
+		{
+			log_write(LOG_ERR, "Failed to encode memo's text \"%s\" to "
+					  "CP1251. Memo ID = %d", memo->text, memo->id);
+			return -1;
+		}
+	}
+	else
+	{
+		*data = '\0';
 	}
-	log_write(LOG_DEBUG, "Write header (len=%d) [%s] for memo",
-			  strlen(memo->header), memo->header);
-	free(headerCp1251);
+	return 0;
+}
+
+/**
+   Build indexes of memos from Memos queue.
 
-    /* Insert '\n' as divider */
-	if(write(fd, "\n", 1) != 1)
+   @param[in] memos Memos structure.
+   @return 0 on success or -1 on error.
+*/
+static int _memos_index_init(Memos * memos)
+{
+	size_t qty = memos->_pdb->recordsQty;
+	if(hash_index_init(&memos->_byId, qty) ||
+	   hash_index_init(&memos->_byHeader, qty) ||
+	   hash_index_init(&memos->_byHeaderText, qty))
 	{
-		log_write(LOG_ERR, "Failed to write \"\\n\" as divider between header "
-				  "and text");
 		return -1;
 	}
 
-	/* Insert text */
-	if(memo->text != NULL)
+	/* Hash headers and texts of all memos in one batch */
+	size_t memosQty = 0;
+	Memo * memo;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
 	{
-		/* Encode text to CP1251 */
-		char * textCp1251 = iconv_utf8_to_cp1251(memo->text);
-		if(textCp1251 == NULL)
-		{
-			log_write(LOG_ERR, "Failed to encode memo's text \"%s\" to CP1251. "
-					  "Memo ID = %d", memo->text, memo->id);
-			return -1;
-		}
+		memosQty++;
+	}
+	if(memosQty == 0)
+	{
+		return 0;
+	}
+	HashString * strings;
+	uint64_t * hashes;
+	if((strings = calloc(memosQty * 2, sizeof(HashString))) == NULL ||
+	   (hashes = calloc(memosQty * 2, sizeof(uint64_t))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for hashes of memos: %s",
+				  strerror(errno));
+		free(strings);
+		return -1;
+	}
+	size_t i = 0;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
+	{
+		strings[i].string = memo->header;
+		strings[i].length = strlen(memo->header);
+		strings[i + 1].string = memo->text != NULL ? memo->text : "";
+		strings[i + 1].length = strlen(strings[i + 1].string);
+		i += 2;
+	}
+	str_hash_batch(strings, memosQty * 2, hashes);
 
-		if(write_chunks(fd, textCp1251, memo->_text_cp1251_len))
+	int result = 0;
+	i = 0;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
+	{
+		if(_memos_index_insert(memos, memo, hashes[i],
+							   __memo_hash_combine(hashes[i], hashes[i + 1])))
 		{
-			log_write(LOG_ERR, "Failed to write memo text!");
-			free(textCp1251);
-			return -1;
+			result = -1;
+			break;
 		}
-		log_write(LOG_DEBUG, "Write text (len=%d) [%s] for memo",
-				  strlen(memo->text), memo->text);
-		free(textCp1251);
+		i += 2;
 	}
+	free(strings);
+	free(hashes);
+	return result;
+}
 
-	/* Insert '\0' at the end of memo */
-	if(write(fd, "\0", 1) != 1)
+/**
+   Add memo to indexes.
+
+   @param[in] memos Memos structure.
+   @param[in] memo Memo to add.
+   @return 0 on success or -1 on error.
+*/
+static int _memos_index_add(Memos * memos, Memo * memo)
+{
+	return _memos_index_insert(memos, memo, __memo_header_hash(memo->header),
+							   __memo_header_text_hash(memo->header,
+													   memo->text));
+}
+
+/**
+   Add memo to indexes with precomputed hashes.
+
+   @param[in] memos Memos structure.
+   @param[in] memo Memo to add.
+   @param[in] headerHash Hash of memo header.
+   @param[in] headerTextHash Hash of memo header and text.
+   @return 0 on success or -1 on error.
+*/
+static int _memos_index_insert(Memos * memos, Memo * memo,
+							   uint64_t headerHash, uint64_t headerTextHash)
+{
+	if(hash_index_insert(&memos->_byId, memo->id, memo) ||
+	   hash_index_insert(&memos->_byHeader, headerHash, memo) ||
+	   hash_index_insert(&memos->_byHeaderText, headerTextHash, memo))
 	{
-		log_write(LOG_ERR, "Failed to write \"\\0\" as divider between memos");
+		log_write(LOG_ERR, "Cannot add memo with ID = %d to index", memo->id);
 		return -1;
 	}
 	return 0;
 }
+
+/**
+   Remove memo from indexes.
+
+   Should be called before header or text of memo is changed.
+
+   @param[in] memos Memos structure.
+   @param[in] memo Memo to remove.
+*/
+static void _memos_index_remove(Memos * memos, Memo * memo)
+{
+	hash_index_remove(&memos->_byId, memo->id, memo);
+	hash_index_remove(&memos->_byHeader, __memo_header_hash(memo->header),
+					  memo);
+	hash_index_remove(&memos->_byHeaderText, __memo_header_text_hash(
+						  memo->header, memo->text), memo);
+}
+
+/**
+   Compute hash for memo header.
+
+   @param[in] header Memo header.
+   @return Hash of header.
+*/
+static uint64_t __memo_header_hash(const char * header)
+{
+	return str_hash((char *)header, strlen(header));
+}
+
+/**
+   Compute hash for memo header and text.
+
+   NULL text is hashed as empty string.
+
+   @param[in] header Memo header.
+   @param[in] text Memo text or NULL.
+   @return Hash of header and text.
+*/
+static uint64_t __memo_header_text_hash(const char * header, const char * text)
+{
+	uint64_t textHash = text != NULL ? str_hash((char *)text, strlen(text)) :
+		str_hash("", 0);
+	return __memo_hash_combine(__memo_header_hash(header), textHash);
+}
+
+/**
+   Combine hashes of memo header and text.
+
+   @param[in] headerHash Hash of memo header.
+   @param[in] textHash Hash of memo text.
+   @return Hash of header and text.
+*/
+static uint64_t __memo_hash_combine(uint64_t headerHash, uint64_t textHash)
+{
+	return headerHash ^ (textHash + 0x9e3779b97f4a7c15 + (headerHash << 6) +
+						 (headerHash >> 2));
+}
+
+/**
+   Convert CP1251 string from PDB file contents to UTF8.
+
+   @param[in] arena Arena to allocate UTF8 string from.
+   @param[in] data CP1251 string, not null-terminated.
+   @param[in] length Length of string in bytes.
+   @return Null-terminated UTF8 string or NULL on error.
+*/
+static char * __memo_decode(Arena * arena, const uint8_t * data,
+							 size_t length)
+{
+	size_t utf8Length;
+	if((utf8Length = cp1251_to_utf8_length((const char *)data, length)) ==
+	   CP1251_ERROR)
+	{
+		log_write(LOG_ERR, "CP1251 string contains undefined character");
+		return NULL;
+	}
+
+	char * result;
+	if((result = arena_alloc(arena, utf8Length + 1)) == NULL)
+	{
+		log_write(LOG_ERR, "Failed to allocate memory for UTF8 string");
+		return NULL;
+	}
+	cp1251_to_utf8((const char *)data, length, result, utf8Length + 1);
+	return result;
+}
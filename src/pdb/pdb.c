@@ -3,9 +3,11 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #if defined(__linux__)
 #include <sys/random.h>
 #endif
+#include <sys/stat.h>
 #include <unistd.h>
 #include "log.h"
 #include "pdb/pdb.h"
@@ -17,19 +19,53 @@
 #define PDB_MAC_UNIX_EPOCH_START_DIFF  2082844800
 /* Record list header size */
 #define PDB_RECORD_LIST_HEADER_SIZE    6
+/* Minimal qty of entries in array for added records */
+#define PDB_RECORD_BLOCK_MIN_CAPACITY  16
 
+/**
+   Marker of deleted record.
+*/
+static char __tombstone;
+#define PDB_RECORD_TOMBSTONE ((void *)&__tombstone)
 
-static int _read8_field(int fd, uint8_t * buf, char * description);
-static int _read16_field(int fd, uint16_t * buf, char * description);
-static int _read32_field(int fd, uint32_t * buf, char * description);
-static int _read_record_list(int fd, int qty, struct RecordQueue * records);
-static int _read_categories(int fd, PDBCategories ** categories);
 
-static int _write8_field(int fd, uint8_t * buf, char * description);
-static int _write16_field(int fd, uint16_t * buf, char * description);
-static int _write32_field(int fd, uint32_t * buf, char * description);
-static int _write_record_list(int fd, struct RecordQueue * records);
-static int _write_categories(int fd, PDBCategories * categories);
+/**
+   Read-only view of PDB file contents, loaded to memory by _map_file().
+*/
+struct __FileView
+{
+	const uint8_t * data; /**< Contents of PDB file */
+	size_t size;          /**< Size of PDB file */
+	size_t position;      /**< Current position to read from */
+};
+
+static int _map_file(int fd, PDB * pdb);
+static void _unmap_file(PDB * pdb);
+static int _read_header(struct __FileView * view, PDB * pdb);
+static int _read8_field(struct __FileView * view, uint8_t * buf,
+						char * description);
+static int _read16_field(struct __FileView * view, uint16_t * buf,
+						 char * description);
+static int _read32_field(struct __FileView * view, uint32_t * buf,
+						 char * description);
+static int _read_record_list(struct __FileView * view, int qty, PDB * pdb);
+static int _read_categories(struct __FileView * view,
+							PDBCategories ** categories);
+static void _categories_index(PDB * pdb);
+
+static PDBRecord * _record_append(PDB * pdb);
+static int _record_locate(PDB * pdb, PDBRecord * record, size_t * block,
+						  size_t * position);
+static PDBRecord * _record_seek(PDB * pdb, size_t block, size_t position,
+								bool forward);
+
+static int _image_layout(PDBImage * image, PDB * pdb, size_t appInfoLength,
+						 size_t dataLength);
+static int _image_reserve(PDBImage * image, size_t length);
+static int _image_pwrite(int fd, PDBImage * image);
+static void _put16(uint8_t * buf, uint16_t value);
+static void _put32(uint8_t * buf, uint32_t value);
+static void _put_categories(uint8_t * buf, PDBCategories * categories);
 
 static time_t _time_palm_to_unix(uint32_t time);
 static uint32_t _time_unix_to_palm(time_t time);
@@ -83,43 +119,26 @@ PDB * pdb_read(const int fd, bool stdCatInfo)
 		return NULL;
 	}
 
-	if((lseek(fd, 0, SEEK_CUR) != 0) && (lseek(fd, 0, SEEK_SET) != 0))
+	pdb->categories = NULL;
+
+	if(_map_file(fd, pdb))
 	{
-		log_write(LOG_ERR, "Cannot rewind to the start of file: %s",
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot load PDB file to memory");
+		free(pdb);
 		return NULL;
 	}
 
-	TAILQ_INIT(&pdb->records);
-	pdb->categories = NULL;
-
-	if(read(fd, pdb->dbname, PDB_DBNAME_LEN) != PDB_DBNAME_LEN)
+	struct __FileView view = {pdb->_file, pdb->_fileSize, 0};
+	if(view.size < PDB_RECORD_LIST_OFFSET + PDB_RECORD_LIST_HEADER_SIZE)
 	{
-		log_write(LOG_ERR, "Cannot read database name from PDB header: %s",
-				  strerror(errno));
-	    free(pdb);
+		log_write(LOG_ERR, "PDB file is too small: %lu bytes", view.size);
+		pdb_free(pdb);
 		return NULL;
 	}
 
-	int result = 0;
-	result += _read16_field(fd, &pdb->attributes, "attributes");
-	result += _read16_field(fd, &pdb->version, "version");
-	result += _read32_field(fd, &pdb->ctime, "creation datetime");
-	result += _read32_field(fd, &pdb->mtime, "modification datetime");
-	result += _read32_field(fd, &pdb->btime, "last backup datetime");
-	result += _read32_field(fd, &pdb->modificationNumber, "modification number");
-	result += _read32_field(fd, &pdb->appInfoOffset, "application info offset");
-	result += _read32_field(fd, &pdb->sortInfoOffset, "sort info offset");
-	result += _read32_field(fd, &pdb->databaseTypeID, "database type ID");
-	result += _read32_field(fd, &pdb->creatorID, "creator ID");
-	result += _read32_field(fd, &pdb->seed, "unique ID seed");
-	result += _read32_field(fd, &pdb->nextRecordListOffset, "next record list "
-							"offset");
-	result += _read16_field(fd, &pdb->recordsQty, "qty of records");
-
-	if(result)
+	if(_read_header(&view, pdb))
 	{
-		free(pdb);
+		pdb_free(pdb);
 		return NULL;
 	}
 
@@ -127,15 +146,15 @@ PDB * pdb_read(const int fd, bool stdCatInfo)
 	{
 		log_write(LOG_ERR, "Malformed PDB file, next record list offset = %d",
 				  pdb->nextRecordListOffset);
-		free(pdb);
+		pdb_free(pdb);
 		return NULL;
 	}
 
 	if(pdb->recordsQty > 0 &&
-	   _read_record_list(fd, pdb->recordsQty, &pdb->records))
+	   _read_record_list(&view, pdb->recordsQty, pdb))
 	{
 		log_write(LOG_ERR, "Cannot read records list");
-		free(pdb);
+		pdb_free(pdb);
 		return NULL;
 	}
 	else if(pdb->recordsQty > 0)
@@ -146,19 +165,22 @@ PDB * pdb_read(const int fd, bool stdCatInfo)
 	/* Read standard Palm OS categories info if necessary */
 	if(pdb->appInfoOffset && stdCatInfo)
 	{
-		if(pdb->appInfoOffset != lseek(fd, pdb->appInfoOffset, SEEK_SET))
+		if(pdb->appInfoOffset >= view.size)
 		{
-			log_write(LOG_ERR, "Failed to reposition to application info in "
-					  "given PDB file: %s", strerror(errno));
-			free(pdb);
+			log_write(LOG_ERR, "Application info offset 0x%08x is beyond the "
+					  "end of PDB file (%lu bytes)", pdb->appInfoOffset,
+					  view.size);
+			pdb_free(pdb);
 			return NULL;
 		}
-		if(_read_categories(fd, &pdb->categories))
+		view.position = pdb->appInfoOffset;
+		if(_read_categories(&view, &pdb->categories))
 		{
 			log_write(LOG_ERR, "Cannot read categories from application info!");
-			free(pdb);
+			pdb_free(pdb);
 			return NULL;
 		}
+		_categories_index(pdb);
 	}
 
 	/* Use Unix time for these fields */
@@ -169,125 +191,119 @@ PDB * pdb_read(const int fd, bool stdCatInfo)
 	return pdb;
 }
 
-int pdb_write(int fd, PDB * pdb)
+int pdb_read_header(const int fd, PDB * pdb)
 {
-	if((lseek(fd, 0, SEEK_CUR) != 0) && (lseek(fd, 0, SEEK_SET) != 0))
+	uint8_t header[PDB_RECORD_LIST_OFFSET + PDB_RECORD_LIST_HEADER_SIZE];
+	ssize_t readed;
+	do
 	{
-		log_write(LOG_ERR, "Cannot rewind to the start of file: %s",
-				  strerror(errno));
-		return -1;
+		readed = pread(fd, header, sizeof(header), 0);
 	}
-
-	/* Use Mac time for these fields */
-	pdb->ctime = _time_unix_to_palm(pdb->ctime);
-	pdb->mtime = _time_unix_to_palm(pdb->mtime);
-	pdb->btime = _time_unix_to_palm(pdb->btime);
-
-	if(pdb->nextRecordListOffset != 0)
+	while(readed == -1 && errno == EINTR);
+	if(readed != sizeof(header))
 	{
-		log_write(LOG_ERR, "Malformed PDB data, next record list offset = %d",
-				  pdb->nextRecordListOffset);
+		log_write(LOG_ERR, "Cannot read header of PDB file: %s",
+				  readed == -1 ? strerror(errno) : "file is too small");
 		return -1;
 	}
 
-	/* Check records qty */
-	uint16_t recordsQty = 0;
-	if(!TAILQ_EMPTY(&pdb->records))
+	memset(pdb, 0, sizeof(PDB));
+	struct __FileView view = {header, sizeof(header), 0};
+	if(_read_header(&view, pdb))
 	{
-		PDBRecord * record;
-		TAILQ_FOREACH(record, &pdb->records, pointers)
-		{
-			recordsQty++;
-		}
+		return -1;
 	}
-	if(recordsQty != pdb->recordsQty)
+
+	pdb->ctime = _time_palm_to_unix(pdb->ctime);
+	pdb->mtime = _time_palm_to_unix(pdb->mtime);
+	pdb->btime = _time_palm_to_unix(pdb->btime);
+	return 0;
+}
+
+int pdb_write(int fd, PDB * pdb)
+{
+	PDBImage image;
+	if(_image_layout(&image, pdb,
+					 pdb->categories != NULL ? PDB_CATEGORIES_SIZE : 0, 0))
 	{
-		log_write(LOG_NOTICE, "Fix records qty. Old: %d, new: %d",
-				  pdb->recordsQty, recordsQty);
-		pdb->recordsQty = recordsQty;
+		return -1;
 	}
 
-	/* Check offset to application info */
-	if(pdb->categories != NULL)
+	/* File contents, loaded by pdb_read() will be overwritten */
+	_unmap_file(pdb);
+
+	int result = _image_pwrite(fd, &image);
+	pdb_image_free(&image);
+	return result;
+}
+
+int pdb_image_init(PDBImage * image, PDB * pdb, size_t appInfoLength,
+				   size_t dataLength)
+{
+	return _image_layout(image, pdb, appInfoLength, dataLength);
+}
+
+uint8_t * pdb_image_add_record(PDBImage * image, PDBRecord * record,
+							   size_t length)
+{
+	if(record == NULL || record != image->_nextRecord)
 	{
-		uint32_t appInfoOffset = PDB_RECORD_LIST_OFFSET +
-			PDB_RECORD_LIST_HEADER_SIZE +
-			pdb->recordsQty * PDB_RECORD_ITEM_SIZE +
-			sizeof(pdb->recordListPadding);
-		if(appInfoOffset != pdb->appInfoOffset)
-		{
-			log_write(LOG_NOTICE, "Fix application info offset. Old: %lu, "
-					  "new: %lu", pdb->appInfoOffset, appInfoOffset);
-			pdb->appInfoOffset = appInfoOffset;
-		}
+		log_write(LOG_ERR, "Records should be added to PDB image in order of "
+				  "record list");
+		return NULL;
 	}
-
-	/* Start file writing */
-	if(lseek(fd, 0, SEEK_SET) != 0)
+	if(image->length + length > UINT32_MAX)
 	{
-		log_write(LOG_ERR, "Cannot go to start of the PDB file for writing: %s",
-				  strerror(errno));
-		return -1;
+		log_write(LOG_ERR, "PDB image is too large for record offsets");
+		return NULL;
 	}
-
-	if(write(fd, pdb->dbname, PDB_DBNAME_LEN) != PDB_DBNAME_LEN)
+	if(_image_reserve(image, length))
 	{
-		log_write(LOG_ERR, "Cannot write database name to PDB header: %s",
-				  strerror(errno));
-		return -1;
+		return NULL;
 	}
 
-	int result = 0;
-	result += _write16_field(fd, &pdb->attributes, "attributes");
-	result += _write16_field(fd, &pdb->version, "version");
-	result += _write32_field(fd, &pdb->ctime, "creation datetime");
-	result += _write32_field(fd, &pdb->mtime, "modification datetime");
-	result += _write32_field(fd, &pdb->btime, "last backup datetime");
-	result += _write32_field(fd, &pdb->modificationNumber, "modification "
-							 "number");
-	result += _write32_field(fd, &pdb->appInfoOffset, "application info offset");
-	result += _write32_field(fd, &pdb->sortInfoOffset, "sort info offset");
-	result += _write32_field(fd, &pdb->databaseTypeID, "database type ID");
-	result += _write32_field(fd, &pdb->creatorID, "creator ID");
-	result += _write32_field(fd, &pdb->seed, "unique ID seed");
-	result += _write32_field(fd, &pdb->nextRecordListOffset, "next record list "
-							 "offset");
-	result += _write16_field(fd, &pdb->recordsQty, "qty of records");
-	if(result)
+	record->offset = image->length;
+	_put32(image->data + image->_nextItem, record->offset);
+	image->_nextItem += PDB_RECORD_ITEM_SIZE;
+	image->_nextRecord = pdb_record_next(image->_pdb, record);
+
+	uint8_t * data = image->data + image->length;
+	image->length += length;
+	return data;
+}
+
+int pdb_image_write(int fd, PDB * pdb, PDBImage * image)
+{
+	if(image->_nextRecord != NULL)
 	{
+		log_write(LOG_ERR, "Not all records are added to PDB image");
 		return -1;
 	}
 
-    /* Write records list if it is not empty */
-	if(pdb->recordsQty > 0 && _write_record_list(fd, &pdb->records))
+	/* File contents, loaded by pdb_read() will be overwritten */
+	_unmap_file(pdb);
+
+	if(_image_pwrite(fd, image))
 	{
-		log_write(LOG_ERR, "Cannot write records list");
 		return -1;
 	}
-	if(_write16_field(fd, &pdb->recordListPadding, "record list padding bytes"))
+	if(ftruncate(fd, image->length))
 	{
-		log_write(LOG_ERR, "Cannot write padding bytes after record list");
+		log_write(LOG_ERR, "Cannot truncate PDB file to %lu bytes: %s",
+				  image->length, strerror(errno));
 		return -1;
 	}
-
-	if(pdb->categories != NULL)
-	{
-		if(pdb->appInfoOffset != lseek(fd, pdb->appInfoOffset, SEEK_SET))
-		{
-			log_write(LOG_ERR, "Failed to reposition to application info in "
-					  "PDB file: %s", strerror(errno));
-			return -1;
-		}
-		if(_write_categories(fd, pdb->categories))
-		{
-			log_write(LOG_ERR, "Cannot write categories to application info");
-			return -1;
-		}
-	}
-
 	return 0;
 }
 
+void pdb_image_free(PDBImage * image)
+{
+	free(image->data);
+	image->data = NULL;
+	image->length = 0;
+	image->_capacity = 0;
+}
+
 void pdb_close(int fd)
 {
 	if(close(fd) == -1)
@@ -304,21 +320,95 @@ void pdb_free(PDB * pdb)
 		log_write(LOG_WARNING, "Got empty PDB structure - nothing to do");
 		return;
 	}
-	PDBRecord * record1 = TAILQ_FIRST(&pdb->records);
-	PDBRecord * record2;
-	while(record1 != NULL)
+	for(size_t i = 0; i < pdb->_blocksQty; i++)
 	{
-		record2 = TAILQ_NEXT(record1, pointers);
-		free(record1->data);
-		TAILQ_REMOVE(&pdb->records, record1, pointers);
-		free(record1);
-		record1 = record2;
+		struct __PDBRecordBlock * block = &pdb->_blocks[i];
+		for(size_t j = 0; j < block->length; j++)
+		{
+			if(block->records[j].data != PDB_RECORD_TOMBSTONE)
+			{
+				free(block->records[j].data);
+			}
+		}
+		free(block->records);
 	}
+	free(pdb->_blocks);
+	hash_index_free(&pdb->_byId);
 
 	free(pdb->categories);
+	_unmap_file(pdb);
 	free(pdb);
 }
 
+const uint8_t * pdb_record_data(PDB * pdb, PDBRecord * record, size_t * length)
+{
+	if(pdb == NULL || record == NULL)
+	{
+		log_write(LOG_ERR, "NULL PDB structure or record in pdb_record_data");
+		return NULL;
+	}
+	if(pdb->_file == NULL)
+	{
+		log_write(LOG_ERR, "PDB file contents are not loaded to memory");
+		return NULL;
+	}
+	if(record->offset >= pdb->_fileSize)
+	{
+		log_write(LOG_ERR, "Record offset 0x%08x is beyond the end of PDB file "
+				  "(%lu bytes)", record->offset, pdb->_fileSize);
+		return NULL;
+	}
+
+	/* Record ends where the next record starts or at the end of file */
+	size_t end = pdb->_fileSize;
+	PDBRecord * next = pdb_record_next(pdb, record);
+	if(next != NULL && next->offset > record->offset &&
+	   next->offset < pdb->_fileSize)
+	{
+		end = next->offset;
+	}
+
+	*length = end - record->offset;
+	return pdb->_file + record->offset;
+}
+
+const uint8_t * pdb_app_info_data(PDB * pdb, size_t * length)
+{
+	*length = 0;
+	if(pdb == NULL || pdb->_file == NULL)
+	{
+		log_write(LOG_ERR, "PDB file contents are not loaded to memory");
+		return NULL;
+	}
+	if(pdb->appInfoOffset == 0)
+	{
+		return NULL;
+	}
+	if(pdb->appInfoOffset >= pdb->_fileSize)
+	{
+		log_write(LOG_ERR, "Application info offset 0x%08x is beyond the end "
+				  "of PDB file (%lu bytes)", pdb->appInfoOffset,
+				  pdb->_fileSize);
+		return NULL;
+	}
+
+	/* Application info ends where sort info or the first record starts */
+	size_t end = pdb->_fileSize;
+	PDBRecord * first = pdb_record_first(pdb);
+	if(pdb->sortInfoOffset > pdb->appInfoOffset && pdb->sortInfoOffset < end)
+	{
+		end = pdb->sortInfoOffset;
+	}
+	else if(first != NULL && first->offset > pdb->appInfoOffset &&
+			first->offset < end)
+	{
+		end = first->offset;
+	}
+
+	*length = end - pdb->appInfoOffset;
+	return pdb->_file + pdb->appInfoOffset;
+}
+
 
 /* Operations with records */
 
@@ -331,7 +421,12 @@ PDBRecord * pdb_record_create(PDB * pdb, uint32_t offset, uint8_t attributes,
 		return NULL;
 	}
 
-	long randomId = random();
+	long randomId;
+	do
+	{
+		randomId = random() & 0x00ffffff;
+	}
+	while(pdb_record_get(pdb, randomId) != NULL);
 	uint8_t id[3] = {
 		(uint8_t)(randomId & 0x000000ff),
 		(uint8_t)((randomId & 0x0000ff00) >> 8),
@@ -351,10 +446,9 @@ PDBRecord * pdb_record_create_with_id(PDB * pdb, uint32_t offset,
 	}
 
 	PDBRecord * newRecord;
-	if((newRecord = calloc(1, sizeof(PDBRecord))) == NULL)
+	if((newRecord = _record_append(pdb)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot allocate memory for new PDB record: %s",
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot allocate memory for new PDB record");
 		return NULL;
 	}
 
@@ -366,13 +460,12 @@ PDBRecord * pdb_record_create_with_id(PDB * pdb, uint32_t offset,
 	newRecord->id[1] = id[1];
 	newRecord->id[2] = id[2];
 
-	if(TAILQ_EMPTY(&pdb->records))
-	{
-		TAILQ_INSERT_HEAD(&pdb->records, newRecord, pointers);
-	}
-	else
+	if(hash_index_insert(&pdb->_byId, pdb_record_get_unique_id(newRecord),
+						 newRecord))
 	{
-		TAILQ_INSERT_TAIL(&pdb->records, newRecord, pointers);
+		log_write(LOG_ERR, "Cannot add new PDB record to the index");
+		pdb->_blocks[pdb->_blocksQty - 1].length--;
+		return NULL;
 	}
 
 	pdb->appInfoOffset += pdb->appInfoOffset != 0 ? PDB_RECORD_ITEM_SIZE : 0;
@@ -390,54 +483,63 @@ int pdb_record_delete(PDB * pdb, long uniqueRecordId)
 		return -1;
 	}
 
-	if(TAILQ_EMPTY(&pdb->records))
+	PDBRecord * record = pdb_record_get(pdb, uniqueRecordId);
+	if(record == NULL)
 	{
-		log_write(LOG_WARNING, "Empty queue, cannot delete record with ID=%d",
+		log_write(LOG_WARNING, "Record with ID=%d not found in record list",
 				  uniqueRecordId);
 		return -1;
 	}
 
-	uint8_t recordId[3] = {0, 0, 0};
-	recordId[0] = (uint8_t)(uniqueRecordId & 0x000000ff);
-	recordId[1] = (uint8_t)((uniqueRecordId & 0x0000ff00) >> 8);
-	recordId[2] = (uint8_t)((uniqueRecordId & 0x00ff0000) >> 16);
+	hash_index_remove(&pdb->_byId, uniqueRecordId, record);
+	free(record->data);
+	record->data = PDB_RECORD_TOMBSTONE;
 
-	PDBRecord * record = TAILQ_FIRST(&pdb->records);
-	while(record != NULL)
-	{
-		if(record->id[0] == recordId[0] && record->id[1] == recordId[1] &&
-		   record->id[2] == recordId[2])
-		{
-			if(record->data != NULL)
-			{
-				free(record->data);
-			}
-			TAILQ_REMOVE(&pdb->records, record, pointers);
-			free(record);
+	pdb->appInfoOffset -= pdb->appInfoOffset != 0 ? PDB_RECORD_ITEM_SIZE : 0;
+	pdb->sortInfoOffset -= pdb->sortInfoOffset != 0 ? PDB_RECORD_ITEM_SIZE : 0;
+	pdb->recordsQty--;
+	return 0;
+}
 
-			pdb->appInfoOffset -= pdb->appInfoOffset != 0 ? PDB_RECORD_ITEM_SIZE : 0;
-			pdb->sortInfoOffset -= pdb->sortInfoOffset != 0 ? PDB_RECORD_ITEM_SIZE : 0;
-			pdb->recordsQty--;
-			return 0;
-		}
-		else
-		{
-			record = TAILQ_NEXT(record, pointers);
-		}
+PDBRecord * pdb_record_get(PDB * pdb, uint32_t uniqueRecordId)
+{
+	size_t cursor = 0;
+	return hash_index_find(&pdb->_byId, uniqueRecordId, &cursor);
+}
+
+PDBRecord * pdb_record_first(PDB * pdb)
+{
+	return _record_seek(pdb, 0, 0, true);
+}
+
+PDBRecord * pdb_record_last(PDB * pdb)
+{
+	if(pdb->_blocksQty == 0)
+	{
+		return NULL;
 	}
+	size_t block = pdb->_blocksQty - 1;
+	return _record_seek(pdb, block, pdb->_blocks[block].length - 1, false);
+}
 
-	if(record == NULL)
+PDBRecord * pdb_record_next(PDB * pdb, PDBRecord * record)
+{
+	size_t block, position;
+	if(_record_locate(pdb, record, &block, &position))
 	{
-		log_write(LOG_WARNING, "Record with ID=%d not found in record list",
-				  uniqueRecordId);
-		return -1;
+		return NULL;
 	}
-	else
+	return _record_seek(pdb, block, position + 1, true);
+}
+
+PDBRecord * pdb_record_prev(PDB * pdb, PDBRecord * record)
+{
+	size_t block, position;
+	if(_record_locate(pdb, record, &block, &position))
 	{
-		log_write(LOG_ERR, "Unexpected error: record with ID=%d found but not deleted",
-				  uniqueRecordId);
-		return 0;
+		return NULL;
 	}
+	return _record_seek(pdb, block, position - 1, false);
 }
 
 uint32_t pdb_record_get_unique_id(PDBRecord * record)
@@ -452,9 +554,10 @@ uint32_t pdb_record_get_unique_id(PDBRecord * record)
 
 char * pdb_category_get_name(PDB * pdb, uint8_t id)
 {
-	if(pdb == NULL)
+	if(pdb == NULL || pdb->categories == NULL)
 	{
-		log_write(LOG_ERR, "NULL PDB structure (%s)", "pdb_category_get");
+		log_write(LOG_ERR, "NULL PDB structure or categories (%s)",
+				  "pdb_category_get");
 		return NULL;
 	}
 	if(id >= PDB_CATEGORIES_STD_QTY)
@@ -467,29 +570,12 @@ char * pdb_category_get_name(PDB * pdb, uint8_t id)
 	return pdb->categories->names[id];
 }
 
-/**
-   Entry for array of categories.
-
-   Used to sort categories by name and search for desired category.
-*/
-struct __SortedCategory
-{
-	uint8_t * id; /**< Pointer to category ID */
-	char * name;  /**< Pointer to category name */
-};
-
-int __compare_categories(const void * cat1, const void * cat2)
-{
-	return strcmp(
-		((const struct __SortedCategory *)cat1)->name,
-		((const struct __SortedCategory *)cat2)->name);
-}
-
-uint8_t pdb_category_get_id(PDB * pdb, char * name)
+uint8_t pdb_category_get_id(PDB * pdb, const char * name)
 {
-	if(pdb == NULL)
+	if(pdb == NULL || pdb->categories == NULL)
 	{
-		log_write(LOG_ERR, "NULL PDB structure in pdb_category_get_id");
+		log_write(LOG_ERR, "NULL PDB structure or categories in "
+				  "pdb_category_get_id");
 		return UINT8_MAX;
 	}
 	if(name == NULL)
@@ -498,21 +584,28 @@ uint8_t pdb_category_get_id(PDB * pdb, char * name)
 		return UINT8_MAX;
 	}
 
-	struct __SortedCategory sortedCategories[PDB_CATEGORIES_STD_QTY];
-
-	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
+	/* Binary search in category IDs, sorted by name */
+	size_t left = 0;
+	size_t right = pdb->_categoriesNamed;
+	while(left < right)
 	{
-		sortedCategories[i].id = &pdb->categories->ids[i];
-		sortedCategories[i].name = pdb->categories->names[i];
+		size_t middle = (left + right) / 2;
+		uint8_t id = pdb->_categoriesByName[middle];
+		int compare = strcmp(pdb->categories->names[id], name);
+		if(compare == 0)
+		{
+			return id;
+		}
+		if(compare < 0)
+		{
+			left = middle + 1;
+		}
+		else
+		{
+			right = middle;
+		}
 	}
-
-	qsort(&sortedCategories, PDB_CATEGORIES_STD_QTY,
-		  sizeof(struct __SortedCategory), __compare_categories);
-	struct __SortedCategory searchFor = {NULL, name};
-	struct __SortedCategory * searchResult = bsearch(
-		&searchFor, &sortedCategories, PDB_CATEGORIES_STD_QTY,
-		sizeof(struct __SortedCategory), __compare_categories);
-	return searchResult != NULL ? *searchResult->id : UINT8_MAX;
+	return UINT8_MAX;
 }
 
 uint8_t pdb_category_add(PDB * pdb, const char * name)
@@ -568,6 +661,7 @@ uint8_t pdb_category_add(PDB * pdb, const char * name)
 
 	pdb->categories->names[freeId][length] = '\0';
 	pdb->categories->ids[freeId] = freeId;
+	_categories_index(pdb);
 
 	if(_name != name)
 	{
@@ -592,6 +686,7 @@ int pdb_category_delete(PDB * pdb, uint8_t id)
 
 	explicit_bzero(pdb->categories->names[id], sizeof(char) * PDB_CATEGORY_LEN);
 	pdb->categories->ids[id] = 0;
+	_categories_index(pdb);
 	return 0;
 }
 
@@ -599,133 +694,272 @@ int pdb_category_delete(PDB * pdb, uint8_t id)
 /* Internal functions */
 
 /**
-   Read 8-bit unsigned value from file
+   Load contents of PDB file to memory.
 
-   @param fd File descriptor
-   @param buf Buffer, 8-bit length
-   @param description Field description for error string
+   File will be mapped to memory. If file cannot be mapped — it will be read
+   to the buffer on heap with one read() call.
+
+   @param[in] fd File descriptor
+   @param[in] pdb PDB structure to store file contents in
    @return 0 on success and -1 on error
 */
-static int _read8_field(int fd, uint8_t * buf, char * description)
+static int _map_file(int fd, PDB * pdb)
 {
-	off_t offset = 0;
-	if(log_is_debug())
+	struct stat sbuf;
+	if(fstat(fd, &sbuf))
+	{
+		log_write(LOG_ERR, "Cannot stat PDB file: %s", strerror(errno));
+		return -1;
+	}
+	if(sbuf.st_size <= 0)
+	{
+		log_write(LOG_ERR, "PDB file is empty");
+		return -1;
+	}
+	size_t size = (size_t)sbuf.st_size;
+
+	void * file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(file != MAP_FAILED)
 	{
-		offset = lseek(fd, 0, SEEK_CUR);
+		pdb->_file = file;
+		pdb->_fileSize = size;
+		pdb->_fileMapped = true;
+		log_write(LOG_DEBUG, "Mapped %lu bytes of PDB file to memory", size);
+		return 0;
 	}
+	log_write(LOG_DEBUG, "Cannot map PDB file to memory: %s. Reading it to "
+			  "buffer", strerror(errno));
 
-	if(read(fd, buf, 1) != 1)
+	uint8_t * buffer;
+	if((buffer = malloc(size)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot read %s from PDB header: %s",
-				  description == NULL ? "8 bit value" : description,
+		log_write(LOG_ERR, "Cannot allocate %lu bytes for PDB file: %s", size,
 				  strerror(errno));
 		return -1;
 	}
+	size_t readed = 0;
+	while(readed < size)
+	{
+		ssize_t result = pread(fd, buffer + readed, size - readed, readed);
+		if(result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if(result <= 0)
+		{
+			log_write(LOG_ERR, "Cannot read PDB file to buffer: %s",
+					  result == 0 ? "unexpected EOF" : strerror(errno));
+			free(buffer);
+			return -1;
+		}
+		readed += result;
+	}
 
-	log_write(LOG_DEBUG, "Read %s 0x%02x from 0x%08x offset",
-			  description, *buf, offset);
+	pdb->_file = buffer;
+	pdb->_fileSize = size;
+	pdb->_fileMapped = false;
 	return 0;
 }
 
 /**
-   Read 16-bit unsigned value from file
+   Release PDB file contents, loaded to memory by _map_file().
 
-   @param fd File descriptor
-   @param buf Buffer, 16-bit length
+   @param[in] pdb PDB structure with file contents
+*/
+static void _unmap_file(PDB * pdb)
+{
+	if(pdb->_file == NULL)
+	{
+		return;
+	}
+	if(pdb->_fileMapped)
+	{
+		if(munmap((void *)pdb->_file, pdb->_fileSize))
+		{
+			log_write(LOG_DEBUG, "Failed to unmap PDB file: %s",
+					  strerror(errno));
+		}
+	}
+	else
+	{
+		free((void *)pdb->_file);
+	}
+	pdb->_file = NULL;
+	pdb->_fileSize = 0;
+}
+
+/**
+   Read fixed-size header of PDB file.
+
+   @param[in] view PDB file contents, positioned at the start of file.
+   @param[out] pdb PDB structure to fill.
+   @return Zero on success or non-zero value on error.
+*/
+static int _read_header(struct __FileView * view, PDB * pdb)
+{
+	memcpy(pdb->dbname, view->data, PDB_DBNAME_LEN);
+	pdb->dbname[PDB_DBNAME_LEN - 1] = '\0';
+	view->position += PDB_DBNAME_LEN;
+
+	int result = 0;
+	result += _read16_field(view, &pdb->attributes, "attributes");
+	result += _read16_field(view, &pdb->version, "version");
+	result += _read32_field(view, &pdb->ctime, "creation datetime");
+	result += _read32_field(view, &pdb->mtime, "modification datetime");
+	result += _read32_field(view, &pdb->btime, "last backup datetime");
+	result += _read32_field(view, &pdb->modificationNumber,
+							"modification number");
+	result += _read32_field(view, &pdb->appInfoOffset,
+							"application info offset");
+	result += _read32_field(view, &pdb->sortInfoOffset, "sort info offset");
+	result += _read32_field(view, &pdb->databaseTypeID, "database type ID");
+	result += _read32_field(view, &pdb->creatorID, "creator ID");
+	result += _read32_field(view, &pdb->seed, "unique ID seed");
+	result += _read32_field(view, &pdb->nextRecordListOffset,
+							"next record list offset");
+	result += _read16_field(view, &pdb->recordsQty, "qty of records");
+
+	return result;
+}
+
+/**
+   Read 8-bit unsigned value from PDB file contents
+
+   @param view View of PDB file contents
+   @param buf Buffer, 8-bit length
    @param description Field description for error string
    @return 0 on success and -1 on error
 */
-static int _read16_field(int fd, uint16_t * buf, char * description)
+static int _read8_field(struct __FileView * view, uint8_t * buf,
+						char * description)
 {
-	off_t offset = 0;
-	if(log_is_debug())
+	if(view->position + 1 > view->size)
 	{
-		offset = lseek(fd, 0, SEEK_CUR);
+		log_write(LOG_ERR, "Cannot read %s from PDB file: unexpected EOF",
+				  description == NULL ? "8 bit value" : description);
+		return -1;
 	}
 
-	if(read(fd, buf, 2) != 2)
+	*buf = view->data[view->position];
+	log_write(LOG_DEBUG, "Read %s 0x%02x from 0x%08x offset",
+			  description, *buf, view->position);
+	view->position += 1;
+	return 0;
+}
+
+/**
+   Read 16-bit unsigned value from PDB file contents
+
+   @param view View of PDB file contents
+   @param buf Buffer, 16-bit length
+   @param description Field description for error string
+   @return 0 on success and -1 on error
+*/
+static int _read16_field(struct __FileView * view, uint16_t * buf,
+						 char * description)
+{
+	if(view->position + 2 > view->size)
 	{
-		log_write(LOG_ERR, "Cannot read %s from PDB header: %s",
-				  description == NULL ? "16 bit value" : description,
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot read %s from PDB file: unexpected EOF",
+				  description == NULL ? "16 bit value" : description);
 		return -1;
 	}
+
+	memcpy(buf, view->data + view->position, 2);
 	*buf = be16toh(*buf);
 	log_write(LOG_DEBUG, "Read %s 0x%04x from 0x%08x offset",
-			  description, *buf, offset);
+			  description, *buf, view->position);
+	view->position += 2;
 	return 0;
 }
 
 /**
-   Read 32-bit unsigned value from file
+   Read 32-bit unsigned value from PDB file contents
 
-   @param fd File descriptor
+   @param view View of PDB file contents
    @param buf Buffer, 32-bit length
    @param description Field description for error string
    @return 0 on success and -1 on error
 */
-static int _read32_field(int fd, uint32_t * buf, char * description)
+static int _read32_field(struct __FileView * view, uint32_t * buf,
+						 char * description)
 {
-	off_t offset = 0;
-	if(log_is_debug())
-	{
-		offset = lseek(fd, 0, SEEK_CUR);
-	}
-
-	if(read(fd, buf, 4) != 4)
+	if(view->position + 4 > view->size)
 	{
-		log_write(LOG_ERR, "Cannot read %s from PDB header: %s",
-				  description == NULL ? "32 bit value" : description,
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot read %s from PDB file: unexpected EOF",
+				  description == NULL ? "32 bit value" : description);
 		return -1;
 	}
+
+	memcpy(buf, view->data + view->position, 4);
 	*buf = be32toh(*buf);
 	log_write(LOG_DEBUG, "Read %s 0x%08x from 0x%08x offset",
-			  description, *buf, offset);
+			  description, *buf, view->position);
+	view->position += 4;
 	return 0;
 }
 
 /**
-   Read record list from PDB file
+   Read record list from PDB file contents
 
-   @param fd File descriptor
+   All records are read to one array and added to index by unique ID.
+
+   @param view View of PDB file contents
    @param qty Count of records
-   @param records Pointer to record queue
+   @param pdb PDB structure to fill record list of
    @return 0 on success, -1 on error
 */
-static int _read_record_list(int fd, int qty, struct RecordQueue * records)
+static int _read_record_list(struct __FileView * view, int qty, PDB * pdb)
 {
-	for(int i = 0; i < qty; i++)
+	if(view->position + (size_t)qty * PDB_RECORD_ITEM_SIZE > view->size)
 	{
-		int result = 0;
-		PDBRecord * record;
-		if((record = calloc(1, sizeof(PDBRecord))) == NULL)
-		{
-			log_write(LOG_ERR, "Cannot allocate memory for PDB record: %s",
-					  strerror(errno));
-			return -1;
-		}
+		log_write(LOG_ERR, "Record list with %d records is beyond the end of "
+				  "PDB file", qty);
+		return -1;
+	}
+	if(qty == 0)
+	{
+		return 0;
+	}
 
-		result += _read32_field(fd, &record->offset, "record offset");
-		result += _read8_field(fd, &record->attributes, "record attributes");
-		result += _read8_field(fd, &(record->id[0]), "record ID 1st byte");
-		result += _read8_field(fd, &(record->id[1]), "record ID 2nd byte");
-		result += _read8_field(fd, &(record->id[2]), "record ID 3rd byte");
-		if(result)
-		{
-			log_write(LOG_ERR, "Cannot read record item");
-			free(record);
-			return -1;
-		}
-		record->data = NULL;
+	if((pdb->_blocks = calloc(1, sizeof(struct __PDBRecordBlock))) == NULL ||
+	   (pdb->_blocks[0].records = calloc(qty, sizeof(PDBRecord))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for %d PDB records: %s",
+				  qty, strerror(errno));
+		return -1;
+	}
+	pdb->_blocksQty = 1;
+	pdb->_blocks[0].capacity = qty;
+	if(hash_index_init(&pdb->_byId, qty))
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for index of PDB records");
+		return -1;
+	}
 
-		if(TAILQ_EMPTY(records))
-		{
-			TAILQ_INSERT_HEAD(records, record, pointers);
-		}
-		else
+	for(int i = 0; i < qty; i++)
+	{
+		PDBRecord * record = &pdb->_blocks[0].records[i];
+		const uint8_t * item = view->data + view->position;
+		memcpy(&record->offset, item, 4);
+		record->offset = be32toh(record->offset);
+		record->attributes = item[4];
+		record->id[0] = item[5];
+		record->id[1] = item[6];
+		record->id[2] = item[7];
+		record->data = NULL;
+		log_write(LOG_DEBUG, "Read record 0x%02x%02x%02x (offset 0x%08x, "
+				  "attributes 0x%02x) from 0x%08x offset", record->id[2],
+				  record->id[1], record->id[0], record->offset,
+				  record->attributes, view->position);
+		view->position += PDB_RECORD_ITEM_SIZE;
+		pdb->_blocks[0].length++;
+
+		if(hash_index_insert(&pdb->_byId, pdb_record_get_unique_id(record),
+							 record))
 		{
-			TAILQ_INSERT_TAIL(records, record, pointers);
+			log_write(LOG_ERR, "Cannot add PDB record to the index");
+			return -1;
 		}
 	}
 	return 0;
@@ -736,11 +970,12 @@ static int _read_record_list(int fd, int qty, struct RecordQueue * records)
 
    Also, check for remaing bytes from deleted categories and prune it.
 
-   @param fd File descriptor
+   @param view View of PDB file contents, positioned to application info
    @param categories Pointer to pointer to categories structure
    @return 0 on success and non-zero on error
 */
-static int _read_categories(int fd, PDBCategories ** categories)
+static int _read_categories(struct __FileView * view,
+							PDBCategories ** categories)
 {
 	if((*categories = calloc(1, sizeof(PDBCategories))) == NULL)
 	{
@@ -750,25 +985,23 @@ static int _read_categories(int fd, PDBCategories ** categories)
 	}
 
 	int result = 0;
-	result += _read16_field(fd, &((*categories)->renamedCategories),
+	result += _read16_field(view, &((*categories)->renamedCategories),
 							"renamed categories");
-	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
+	if(view->position + PDB_CATEGORIES_STD_QTY * PDB_CATEGORY_LEN > view->size)
 	{
-		if(read(fd, &((*categories)->names[i]),
-				PDB_CATEGORY_LEN) != PDB_CATEGORY_LEN)
-		{
-			log_write(LOG_ERR, "Cannot read category #%d name: %s", i,
-					  strerror(errno));
-			return -1;
-		}
+		log_write(LOG_ERR, "Cannot read category names: unexpected EOF");
+		return -1;
 	}
+	memcpy((*categories)->names, view->data + view->position,
+		   PDB_CATEGORIES_STD_QTY * PDB_CATEGORY_LEN);
+	view->position += PDB_CATEGORIES_STD_QTY * PDB_CATEGORY_LEN;
 	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
 	{
-		result += _read8_field(fd, &((*categories)->ids[i]), "category id");
+		result += _read8_field(view, &((*categories)->ids[i]), "category id");
 	}
-	result += _read8_field(fd, &((*categories)->lastUniqueId), "category last "
-						   "unique id");
-	result += _read8_field(fd, &((*categories)->padding), "category padding");
+	result += _read8_field(view, &((*categories)->lastUniqueId),
+						   "category last unique id");
+	result += _read8_field(view, &((*categories)->padding), "category padding");
 
 	if(result)
 	{
@@ -805,180 +1038,359 @@ static int _read_categories(int fd, PDBCategories ** categories)
 }
 
 /**
-   Write 8-bit unsigned value to file
+   Sort IDs of named categories by category name.
 
-   @param fd File descriptor
-   @param buf Buffer, 8-bit length
-   @param description Field description for error string
-   @return 0 on success and -1 on error
+   Called once after reading categories and after every change of
+   category names, so pdb_category_get_id() does not sort categories on
+   every call.
+
+   @param[in] pdb PDB structure with categories.
 */
-static int _write8_field(int fd, uint8_t * buf, char * description)
+static void _categories_index(PDB * pdb)
 {
-	if(log_is_debug())
+	uint8_t named = 0;
+	for(uint8_t id = 0; id < PDB_CATEGORIES_STD_QTY; id++)
 	{
-		off_t offset = lseek(fd, 0, SEEK_CUR);
-		log_write(LOG_DEBUG, "Writing %s 0x%02x to 0x%08x offset",
-				  description, *buf, offset);
-	}
+		const char * name = pdb->categories->names[id];
+		if(name[0] == '\0')
+		{
+			continue;
+		}
 
-	if(write(fd, buf, 1) != 1)
-	{
-		log_write(LOG_ERR, "Cannot write %s to PDB file: %s",
-				  description == NULL ? "8 bit value" : description,
-				  strerror(errno));
-		return -1;
+		/* Insertion sort: there are only 16 categories */
+		uint8_t position = named++;
+		while(position > 0 &&
+			  strcmp(pdb->categories->names[
+						 pdb->_categoriesByName[position - 1]], name) > 0)
+		{
+			pdb->_categoriesByName[position] =
+				pdb->_categoriesByName[position - 1];
+			position--;
+		}
+		pdb->_categoriesByName[position] = id;
 	}
-
-	return 0;
+	pdb->_categoriesNamed = named;
 }
 
 /**
-   Write 16-bit unsigned value to file
+   Returns new entry at the end of record list.
 
-   @param fd File descriptor
-   @param buf Buffer, 16-bit length
-   @param description Field description for error string
-   @return 0 on success and -1 on error
+   If the last array of records is full, new array is allocated, twice
+   larger than the last one. Arrays are never reallocated, so pointers
+   to existing records remain valid.
+
+   @param[in] pdb PDB structure.
+   @return New zeroed entry or NULL on error.
 */
-static int _write16_field(int fd, uint16_t * buf, char * description)
+static PDBRecord * _record_append(PDB * pdb)
 {
-	uint16_t htobe = htobe16(*buf);
-	if(log_is_debug())
+	struct __PDBRecordBlock * block = pdb->_blocksQty > 0 ?
+		&pdb->_blocks[pdb->_blocksQty - 1] : NULL;
+	if(block == NULL || block->length == block->capacity)
 	{
-		off_t offset = lseek(fd, 0, SEEK_CUR);
-		log_write(LOG_DEBUG, "Writing %s 0x%04x (htobe: 0x%04x) to 0x%08x "
-				  "offset", description, *buf, htobe, offset);
-	}
-	if(write(fd, &htobe, 2) != 2)
-	{
-		log_write(LOG_ERR, "Cannot write %s to PDB file: %s",
-				  description == NULL ? "16 bit value" : description,
-				  strerror(errno));
-		return -1;
+		size_t capacity = block != NULL ? block->capacity * 2 : 0;
+		if(capacity < PDB_RECORD_BLOCK_MIN_CAPACITY)
+		{
+			capacity = PDB_RECORD_BLOCK_MIN_CAPACITY;
+		}
+
+		struct __PDBRecordBlock * blocks;
+		if((blocks = realloc(pdb->_blocks, (pdb->_blocksQty + 1) *
+							 sizeof(struct __PDBRecordBlock))) == NULL)
+		{
+			log_write(LOG_ERR, "Cannot allocate memory for PDB records: %s",
+					  strerror(errno));
+			return NULL;
+		}
+		pdb->_blocks = blocks;
+		block = &pdb->_blocks[pdb->_blocksQty];
+		if((block->records = calloc(capacity, sizeof(PDBRecord))) == NULL)
+		{
+			log_write(LOG_ERR, "Cannot allocate memory for %lu PDB records: "
+					  "%s", capacity, strerror(errno));
+			return NULL;
+		}
+		block->length = 0;
+		block->capacity = capacity;
+		pdb->_blocksQty++;
 	}
 
-	return 0;
+	return &block->records[block->length++];
 }
 
 /**
-   Write 32-bit unsigned value to file
+   Find array and position inside it for given record.
 
-   @param fd File descriptor
-   @param buf Buffer, 32-bit length
-   @param description Field description for error string
-   @return 0 on success and -1 on error
+   @param[in] pdb PDB structure.
+   @param[in] record Record from PDB structure.
+   @param[out] block Index of array with record.
+   @param[out] position Position of record in array.
+   @return 0 on success or -1 if record is not from given PDB structure.
 */
-static int _write32_field(int fd, uint32_t * buf, char * description)
+static int _record_locate(PDB * pdb, PDBRecord * record, size_t * block,
+						  size_t * position)
 {
-	uint32_t htobe = htobe32(*buf);
-	if(log_is_debug())
-	{
-		off_t offset = lseek(fd, 0, SEEK_CUR);
-		log_write(LOG_DEBUG, "Writing %s 0x%08x (htobe: 0x%08x) to 0x%08x "
-				  "offset", description, *buf, htobe, offset);
-	}
-	if(write(fd, &htobe, 4) != 4)
+	/* There are only a few arrays, the first one holds records from file */
+	for(size_t i = 0; i < pdb->_blocksQty; i++)
 	{
-		log_write(LOG_ERR, "Cannot write %s to PDB file: %s",
-				  description == NULL ? "32 bit value" : description,
-				  strerror(errno));
-		return -1;
+		struct __PDBRecordBlock * b = &pdb->_blocks[i];
+		if(record >= b->records && record < b->records + b->length)
+		{
+			*block = i;
+			*position = record - b->records;
+			return 0;
+		}
 	}
-
-	return 0;
+	log_write(LOG_ERR, "Record is not found in record list");
+	return -1;
 }
 
 /**
-   Write record list to PDB file.
+   Returns first not deleted record, starting from given position.
 
-   Drop changed flag. It should be set only inside Palm handheld.
+   Positions are unsigned: moving backward beyond the start of array
+   wraps position to the value, larger than any array length.
 
-   @param fd File descriptor
-   @param records Queue of records
-   @return 0 on success, -1 on error
+   @param[in] pdb PDB structure.
+   @param[in] block Index of array to start from.
+   @param[in] position Position in array to start from.
+   @param[in] forward Search forward if true, otherwise — backward.
+   @return Record or NULL if there are no records in given direction.
 */
-static int _write_record_list(int fd, struct RecordQueue * records)
+static PDBRecord * _record_seek(PDB * pdb, size_t block, size_t position,
+								bool forward)
 {
-	if(records == NULL)
+	while(block < pdb->_blocksQty)
 	{
-		log_write(LOG_ERR, "NULL records list: %s");
-		return -1;
+		struct __PDBRecordBlock * b = &pdb->_blocks[block];
+		while(position < b->length)
+		{
+			if(b->records[position].data != PDB_RECORD_TOMBSTONE)
+			{
+				return &b->records[position];
+			}
+			position = forward ? position + 1 : position - 1;
+		}
+
+		block = forward ? block + 1 : block - 1;
+		position = forward || block >= pdb->_blocksQty ? 0 :
+			pdb->_blocks[block].length - 1;
 	}
-	if(TAILQ_EMPTY(records))
+	return NULL;
+}
+
+/**
+   Lay out header, record list and application info of PDB file in memory.
+
+   Record list contains current offsets of records. They are replaced
+   with actual offsets when data of each record is added with
+   pdb_image_add_record().
+
+   @param[out] image PDB image to initialize.
+   @param[in] pdb PDB structure.
+   @param[in] appInfoLength Length of application info block. If it is
+   zero, application info is not laid out and its offset is not changed.
+   @param[in] dataLength Expected length of records data, memory for it is
+   allocated in advance.
+   @return 0 on success or -1 on error.
+*/
+static int _image_layout(PDBImage * image, PDB * pdb, size_t appInfoLength,
+						 size_t dataLength)
+{
+	image->data = NULL;
+	image->length = 0;
+	image->_capacity = 0;
+	image->_pdb = pdb;
+	image->_nextRecord = pdb_record_first(pdb);
+	image->_nextItem = PDB_RECORD_LIST_OFFSET + PDB_RECORD_LIST_HEADER_SIZE;
+
+	if(pdb->nextRecordListOffset != 0)
 	{
-		log_write(LOG_NOTICE, "Nothing to write - record list is empty");
-		return 0;
+		log_write(LOG_ERR, "Malformed PDB data, next record list offset = %d",
+				  pdb->nextRecordListOffset);
+		return -1;
 	}
 
+	/* Check records qty */
+	uint16_t recordsQty = 0;
 	PDBRecord * record;
-	TAILQ_FOREACH(record, records, pointers)
+	PDB_RECORD_FOREACH(record, pdb)
+	{
+		recordsQty++;
+	}
+	if(recordsQty != pdb->recordsQty)
+	{
+		log_write(LOG_NOTICE, "Fix records qty. Old: %d, new: %d",
+				  pdb->recordsQty, recordsQty);
+		pdb->recordsQty = recordsQty;
+	}
+
+	/* Check offset to application info */
+	size_t recordListEnd = PDB_RECORD_LIST_OFFSET +
+		PDB_RECORD_LIST_HEADER_SIZE +
+		pdb->recordsQty * PDB_RECORD_ITEM_SIZE +
+		sizeof(pdb->recordListPadding);
+	if(appInfoLength > 0 && recordListEnd != pdb->appInfoOffset)
+	{
+		log_write(LOG_NOTICE, "Fix application info offset. Old: %lu, "
+				  "new: %lu", pdb->appInfoOffset, recordListEnd);
+		pdb->appInfoOffset = recordListEnd;
+	}
+
+	if(_image_reserve(image, recordListEnd + appInfoLength + dataLength))
+	{
+		return -1;
+	}
+	uint8_t * buf = image->data;
+	memset(buf, 0, recordListEnd + appInfoLength);
+
+	/* Header. Use Mac time for datetime fields */
+	memcpy(buf, pdb->dbname, PDB_DBNAME_LEN);
+	_put16(buf + 32, pdb->attributes);
+	_put16(buf + 34, pdb->version);
+	_put32(buf + 36, _time_unix_to_palm(pdb->ctime));
+	_put32(buf + 40, _time_unix_to_palm(pdb->mtime));
+	_put32(buf + 44, _time_unix_to_palm(pdb->btime));
+	_put32(buf + 48, pdb->modificationNumber);
+	_put32(buf + 52, pdb->appInfoOffset);
+	_put32(buf + 56, pdb->sortInfoOffset);
+	_put32(buf + 60, pdb->databaseTypeID);
+	_put32(buf + 64, pdb->creatorID);
+	_put32(buf + 68, pdb->seed);
+	_put32(buf + 72, pdb->nextRecordListOffset);
+	_put16(buf + 76, pdb->recordsQty);
+
+	/* Record list. Drop "changed" flag, it should be set only inside Palm
+	   handheld */
+	uint8_t * item = buf + PDB_RECORD_LIST_OFFSET + PDB_RECORD_LIST_HEADER_SIZE;
+	PDB_RECORD_FOREACH(record, pdb)
 	{
-		/* Drop "changed" flag */
 		record->attributes &= ~PDB_RECORD_ATTR_DIRTY;
+		_put32(item, record->offset);
+		item[4] = record->attributes;
+		memcpy(item + 5, record->id, sizeof(record->id));
+		item += PDB_RECORD_ITEM_SIZE;
+	}
+	_put16(item, pdb->recordListPadding);
+	image->length = recordListEnd;
 
-		int result = 0;
-		result += _write32_field(fd, &record->offset, "record offset");
-		result += _write8_field(fd, &record->attributes, "record attributes");
-		result += _write8_field(fd, &(record->id[0]), "record ID 1st byte");
-		result += _write8_field(fd, &(record->id[1]), "record ID 2nd byte");
-		result += _write8_field(fd, &(record->id[2]), "record ID 3rd byte");
-		if(result)
+	/* Application info, categories are at the start of it */
+	if(appInfoLength > 0)
+	{
+		if(pdb->categories != NULL && appInfoLength >= PDB_CATEGORIES_SIZE)
 		{
-			log_write(LOG_ERR, "Cannot write record item");
-			return -1;
+			_put_categories(buf + recordListEnd, pdb->categories);
 		}
+		image->length += appInfoLength;
 	}
 
+	log_write(LOG_DEBUG, "Laid out %lu bytes of PDB header, record list and "
+			  "application info", image->length);
 	return 0;
 }
 
 /**
-   Write standard Palm OS category information to application info block.
+   Ensure that PDB image has memory for given qty of bytes after its end.
 
-   @param fd File descriptor
-   @param categories Pointer to category information
-   @return 0 on success and non-zero on error
+   @param[in] image PDB image.
+   @param[in] length Qty of bytes.
+   @return 0 on success or -1 on error.
 */
-static int _write_categories(int fd, PDBCategories * categories)
+static int _image_reserve(PDBImage * image, size_t length)
 {
-	if(categories == NULL)
+	if(image->length + length <= image->_capacity)
 	{
-		log_write(LOG_ERR, "NULL categories");
+		return 0;
+	}
+	size_t capacity = image->_capacity > 0 ? image->_capacity : 1024;
+	while(capacity < image->length + length)
+	{
+		capacity *= 2;
+	}
+	uint8_t * data;
+	if((data = realloc(image->data, capacity)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate %lu bytes for PDB image: %s",
+				  capacity, strerror(errno));
 		return -1;
 	}
+	image->data = data;
+	image->_capacity = capacity;
+	return 0;
+}
 
-	int result = 0;
-	result += _write16_field(fd, &categories->renamedCategories,
-							 "renamed categories");
-	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
+/**
+   Write PDB image to the start of file.
+
+   @param[in] fd File descriptor.
+   @param[in] image PDB image.
+   @return 0 on success or -1 on error.
+*/
+static int _image_pwrite(int fd, PDBImage * image)
+{
+	size_t written = 0;
+	while(written < image->length)
 	{
-		if(write(fd, &(categories->names[i]),
-				 PDB_CATEGORY_LEN) != PDB_CATEGORY_LEN)
+		ssize_t result = pwrite(fd, image->data + written,
+								image->length - written, written);
+		if(result < 0 && errno == EINTR)
 		{
-			log_write(LOG_ERR, "Cannot write category #%d name: %s", i,
-					  strerror(errno));
+			continue;
+		}
+		else if(result < 0)
+		{
+			log_write(LOG_ERR, "Cannot write PDB file: %s", strerror(errno));
 			return -1;
 		}
+		written += result;
 	}
-	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
-	{
-		result += _write8_field(fd, &(categories->ids[i]), "category id");
-	}
+	log_write(LOG_DEBUG, "Written %lu bytes of PDB file", written);
+	return 0;
+}
 
-	categories->lastUniqueId = 0x0f;
-	categories->padding = 0x00;
+/**
+   Store 16-bit unsigned value to buffer as big-endian.
 
-	result += _write8_field(fd, &categories->lastUniqueId,
-							"category last unique id");
-	result += _write8_field(fd, &categories->padding, "category padding");
+   @param buf Buffer, at least 2 bytes long
+   @param value Value to store
+*/
+static void _put16(uint8_t * buf, uint16_t value)
+{
+	uint16_t htobe = htobe16(value);
+	memcpy(buf, &htobe, 2);
+}
 
-	if(result)
-	{
-		log_write(LOG_ERR, "Failed to write categories to application info");
-		return -1;
-	}
+/**
+   Store 32-bit unsigned value to buffer as big-endian.
 
-	return 0;
+   @param buf Buffer, at least 4 bytes long
+   @param value Value to store
+*/
+static void _put32(uint8_t * buf, uint32_t value)
+{
+	uint32_t htobe = htobe32(value);
+	memcpy(buf, &htobe, 4);
+}
+
+/**
+   Store standard Palm OS category information to buffer.
+
+   @param buf Buffer, at least PDB_CATEGORIES_SIZE bytes long
+   @param categories Pointer to category information
+*/
+static void _put_categories(uint8_t * buf, PDBCategories * categories)
+{
+	categories->lastUniqueId = 0x0f;
+	categories->padding = 0x00;
+
+	_put16(buf, categories->renamedCategories);
+	buf += 2;
+	memcpy(buf, categories->names, PDB_CATEGORIES_STD_QTY * PDB_CATEGORY_LEN);
+	buf += PDB_CATEGORIES_STD_QTY * PDB_CATEGORY_LEN;
+	memcpy(buf, categories->ids, PDB_CATEGORIES_STD_QTY);
+	buf += PDB_CATEGORIES_STD_QTY;
+	buf[0] = categories->lastUniqueId;
+	buf[1] = categories->padding;
 }
 
 /**
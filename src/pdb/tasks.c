@@ -9,12 +9,18 @@
 #include "pdb/tasks.h"
 
 
-static Task * _tasks_read_task(int fd, PDBRecord * record, PDB * pdb);
-static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks);
-static Task * __parse_taskdb_data(int fd, uint8_t type);
+static Task * _tasks_read_task(PDBRecord * record, PDB * pdb);
+static int _tasks_append_task(PDBRecord * record, Tasks * tasks);
+static Task * __parse_taskdb_data(const uint8_t * data, size_t length,
+								  uint8_t type);
+static Task * __tasks_join_task(Tasks * tasks, PDBRecord * record,
+								char * header);
 static void _task_free(Task * task);
 static void __task_clear_ptod(Task * task);
 static int _tasks_write_task(TasksFD tfd, Task * task);
+static int _tasks_index_add(Tasks * tasks, Task * task);
+static void _tasks_index_remove(Tasks * tasks, Task * task);
+static uint64_t __task_header_hash(const char * header);
 
 
 TasksFD tasks_open(const char * pathToDoDB, const char * pathTasksDB)
@@ -48,23 +54,6 @@ Tasks * tasks_read(TasksFD tfd)
 		return NULL;
 	}
 
-	if((lseek(tfd.todo_fd, 0, SEEK_CUR) != 0) &&
-	   (lseek(tfd.todo_fd, 0, SEEK_SET) != 0))
-	{
-		log_write(LOG_ERR, "Cannot rewind to the start of ToDoDB file: %s",
-				  strerror(errno));
-		free(tasks);
-		return NULL;
-	}
-	if((lseek(tfd.tasks_fd, 0, SEEK_CUR) != 0) &&
-	   (lseek(tfd.tasks_fd, 0, SEEK_SET) != 0))
-	{
-		log_write(LOG_ERR, "Cannot rewind to the start of TasksDB-PTod file: %s",
-				  strerror(errno));
-		free(tasks);
-		return NULL;
-	}
-
 	if((tasks->_pdb_tododb = pdb_read(tfd.todo_fd, true)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read PDB header from ToDoDB");
@@ -82,11 +71,10 @@ Tasks * tasks_read(TasksFD tfd)
 
 	PDBRecord * record;
 	/* Read tasks from ToDoDB PDB structure: */
-	TAILQ_FOREACH(record, &tasks->_pdb_tododb->records, pointers)
+	PDB_RECORD_FOREACH(record, tasks->_pdb_tododb)
 	{
 		Task * task;
-		if((task = _tasks_read_task(
-				tfd.todo_fd, record, tasks->_pdb_tododb)) == NULL)
+		if((task = _tasks_read_task(record, tasks->_pdb_tododb)) == NULL)
 		{
 			log_write(LOG_ERR, "Error when reading tasks from ToDoDB. "
 					  "Offset: %x", record->offset);
@@ -102,10 +90,29 @@ Tasks * tasks_read(TasksFD tfd)
 			TAILQ_INSERT_TAIL(&tasks->queue, task, pointers);
 		}
 	}
+
+	/* Index tasks from ToDoDB to join them with TasksDB-PTod data */
+	if(hash_index_init(&tasks->_byId, tasks->_pdb_tododb->recordsQty) ||
+	   hash_index_init(&tasks->_byHeader, tasks->_pdb_tododb->recordsQty))
+	{
+		log_write(LOG_ERR, "Failed to initialize index of tasks");
+		tasks_free(tasks);
+		return NULL;
+	}
+	Task * task;
+	TAILQ_FOREACH(task, &tasks->queue, pointers)
+	{
+		if(_tasks_index_add(tasks, task))
+		{
+			tasks_free(tasks);
+			return NULL;
+		}
+	}
+
 	/* Append info to tasks with data from TasksDB-PTod  structure */
-	TAILQ_FOREACH(record, &tasks->_pdb_tasks->records, pointers)
+	PDB_RECORD_FOREACH(record, tasks->_pdb_tasks)
 	{
-		if(_tasks_append_task(tfd.tasks_fd, record, tasks))
+		if(_tasks_append_task(record, tasks))
 		{
 			log_write(LOG_ERR, "Error when appending tasks from TasksDB-PTod. "
 					  "Offset: 0x%08x", record->offset);
@@ -192,7 +199,6 @@ void tasks_free(Tasks * tasks)
 		{
 			free(task1->text);
 		}
-		free(task1->category);
 		__task_clear_ptod(task1);
 		PDBRecord * recordToDoDB = task1->_record_todo;
 		PDBRecord * recordTasksDB = task1->_record_tasks;
@@ -203,6 +209,8 @@ void tasks_free(Tasks * tasks)
 		recordTasksDB->data = NULL;
 		task1 = task2;
 	}
+	hash_index_free(&tasks->_byId);
+	hash_index_free(&tasks->_byHeader);
 	pdb_free(tasks->_pdb_tododb);
 	pdb_free(tasks->_pdb_tasks);
 	free(tasks);
@@ -211,53 +219,19 @@ void tasks_free(Tasks * tasks)
 
 /* Functions to operate with task */
 
-/**
-   Element of array with tasks. Maps task header and pointer of task.
-
-   Used to sort tasks by header and search for desired task by it's header.
-*/
-struct __SortedTasks
-{
-	char * header; /**< Pointer to Tasks header */
-	Task * task;   /**< Pointer to Task structure */
-};
-
-static int __compare_headers(const void * rec1, const void * rec2)
-{
-	return strcmp(
-		((const struct __SortedTasks *)rec1)->header,
-		((const struct __SortedTasks *)rec2)->header);
-}
-
 Task * tasks_task_get(Tasks * tasks, char * header)
 {
-	int tasksQty = tasks->_pdb_tododb->recordsQty;
-	struct __SortedTasks sortedTasks[tasksQty];
-
 	Task * task;
-	unsigned short index = 0;
-
-	TAILQ_FOREACH(task, &tasks->queue, pointers)
+	size_t cursor = 0;
+	while((task = hash_index_find(&tasks->_byHeader, __task_header_hash(header),
+								  &cursor)) != NULL)
 	{
-		sortedTasks[index].header = task->header;
-		sortedTasks[index].task = task;
-		index++;
-	}
-
-	if(tasksQty != index)
-	{
-		log_write(LOG_ERR, "Tasks count in PDB header: %d, real tasks "
-				  "count: %d", tasksQty, index);
-		return NULL;
+		if(strcmp(task->header, header) == 0)
+		{
+			return task;
+		}
 	}
-
-	qsort(&sortedTasks, tasksQty, sizeof(struct __SortedTasks),
-		  __compare_headers);
-	struct __SortedTasks searchFor = {header, NULL};
-	struct __SortedTasks * searchResult = bsearch(
-		&searchFor, &sortedTasks, tasksQty, sizeof(struct __SortedTasks),
-		__compare_headers);
-	return searchResult != NULL ? searchResult->task : NULL;
+	return NULL;
 }
 
 Task * tasks_task_add(Tasks * tasks, char * header, char * text,
@@ -279,7 +253,8 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 	{
 		category = PDB_DEFAULT_CATEGORY;
 	}
-	int categoryIdToDoDB = pdb_category_get_id(tasks->_pdb_tododb, category);
+	uint8_t categoryIdToDoDB = pdb_category_get_id(tasks->_pdb_tododb,
+												   category);
 	if(categoryIdToDoDB == UINT8_MAX)
 	{
 		log_write(LOG_DEBUG, "Category with name \"%s\" not found in ToDoDB "
@@ -292,7 +267,8 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 			return NULL;
 		}
 	}
-	int categoryIdTasksDB = pdb_category_get_id(tasks->_pdb_tasks, category);
+	uint8_t categoryIdTasksDB = pdb_category_get_id(tasks->_pdb_tasks,
+													category);
 	if(categoryIdTasksDB == UINT8_MAX)
 	{
 		log_write(LOG_DEBUG, "Category with name \"%s\" not found in TasksDB "
@@ -319,15 +295,13 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 	PDBRecord * recordToDoDB;
 	PDBRecord * recordTasksDB;
 	Task * task;
-	if((recordToDoDB = TAILQ_LAST(&tasks->_pdb_tododb->records,
-								  RecordQueue)) == NULL)
+	if((recordToDoDB = pdb_record_last(tasks->_pdb_tododb)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot get last task's record from ToDoDB PDB "
 				  "header");
 		return NULL;
 	}
-	if((recordTasksDB = TAILQ_LAST(&tasks->_pdb_tasks->records,
-								   RecordQueue)) == NULL)
+	if((recordTasksDB = pdb_record_last(tasks->_pdb_tasks)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot get last task's record from TasksDB PDB "
 				  "header");
@@ -420,18 +394,6 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 		free(task);
 		return NULL;
 	}
-	if((task->category = calloc(strlen(category) + 1, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot allocate memory for new task category: %s",
-				  strerror(errno));
-		if(text != NULL)
-		{
-			free(task->text);
-		}
-		free(task->header);
-		free(task);
-		return NULL;
-	}
 
 	/* Add new records for new task */
 	if((recordToDoDB = pdb_record_create(
@@ -439,7 +401,6 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 			PDB_RECORD_ATTR_EMPTY | (0x0f & categoryIdToDoDB), task)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot add new record for new task in ToDoDB PDB");
-		free(task->category);
 		if(text != NULL)
 		{
 			free(task->text);
@@ -459,7 +420,6 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 			id, task)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot add new record for new task in TasksDB PDB");
-		free(task->category);
 		if(text != NULL)
 		{
 			free(task->text);
@@ -472,7 +432,9 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 	/* Fill new task with data and append it to PDB structure */
 	strcpy(task->header, header);
 	task->text = text != NULL ? strcpy(task->text, text) : NULL;
-	strcpy(task->category, category);
+	task->categoryId = categoryIdToDoDB;
+	task->category = pdb_category_get_name(tasks->_pdb_tododb,
+										   categoryIdToDoDB);
 	task->priority = priority;
 	task->dueDay = 0;
 	task->dueMonth = 0;
@@ -489,38 +451,43 @@ Task * tasks_task_add(Tasks * tasks, char * header, char * text,
 	{
 		TAILQ_INSERT_TAIL(&tasks->queue, task, pointers);
 	}
+	if(_tasks_index_add(tasks, task))
+	{
+		log_write(LOG_ERR, "Cannot add new task to the index");
+		return NULL;
+	}
 
 	/* Recalculate and update offsets for old tasks */
 	log_write(LOG_DEBUG, "Changing offsets for old tasks in ToDoDB PDB");
-	PDBRecord * oldRecord = TAILQ_PREV(recordToDoDB, RecordQueue, pointers);
+	PDBRecord * oldRecord = pdb_record_prev(tasks->_pdb_tododb, recordToDoDB);
 	while(oldRecord != NULL)
 	{
 		log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
 				  "new offset=0x%08x", oldRecord->offset,
 				  oldRecord->offset + PDB_RECORD_ITEM_SIZE);
 		oldRecord->offset += PDB_RECORD_ITEM_SIZE;
-		oldRecord = TAILQ_PREV(oldRecord, RecordQueue, pointers);
+		oldRecord = pdb_record_prev(tasks->_pdb_tododb, oldRecord);
 	}
 
 	log_write(LOG_DEBUG, "Changing offsets for old tasks in TasksDB PDB");
-	oldRecord = TAILQ_PREV(recordTasksDB, RecordQueue, pointers);
+	oldRecord = pdb_record_prev(tasks->_pdb_tasks, recordTasksDB);
 	while(oldRecord != NULL)
 	{
 		log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
 				  "new offset=0x%08x", oldRecord->offset,
 				  oldRecord->offset + PDB_RECORD_ITEM_SIZE);
 		oldRecord->offset += PDB_RECORD_ITEM_SIZE;
-		oldRecord = TAILQ_PREV(oldRecord, RecordQueue, pointers);
+		oldRecord = pdb_record_prev(tasks->_pdb_tasks, oldRecord);
 	}
 
 	return task;
 }
 
-int tasks_task_set_due(Task * task, uint16_t dueYear, uint8_t dueMonth,
-					   uint8_t dueDay)
+int tasks_task_set_due(Tasks * tasks, Task * task, uint16_t dueYear,
+					   uint8_t dueMonth, uint8_t dueDay)
 {
 	int32_t offsetTasksDBDelta = 0;
-	if(task == NULL)
+	if(tasks == NULL || task == NULL)
 	{
 		log_write(LOG_ERR, "Got NULL pointer to task, can't set due date");
 		return -1;
@@ -577,23 +544,24 @@ int tasks_task_set_due(Task * task, uint16_t dueYear, uint8_t dueMonth,
 	{
 		log_write(LOG_DEBUG, "Changing offsets for next tasks in TasksDB PDB. "
 				  "Offset delta = %d", offsetTasksDBDelta);
-		PDBRecord * nextRecord = TAILQ_NEXT(task->_record_tasks, pointers);
+		PDBRecord * nextRecord = pdb_record_next(tasks->_pdb_tasks,
+												 task->_record_tasks);
 		while(nextRecord != NULL)
 		{
 			log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
 					  "new offset=0x%08x", nextRecord->offset,
 					  nextRecord->offset + offsetTasksDBDelta);
 			nextRecord->offset += offsetTasksDBDelta;
-			nextRecord = TAILQ_NEXT(nextRecord, pointers);
+			nextRecord = pdb_record_next(tasks->_pdb_tasks, nextRecord);
 		}
 	}
 
 	return 0;
 }
 
-int tasks_task_set_alarm(Task * task, Alarm * alarm)
+int tasks_task_set_alarm(Tasks * tasks, Task * task, Alarm * alarm)
 {
-	if(task == NULL)
+	if(tasks == NULL || task == NULL)
 	{
 		log_write(LOG_ERR, "Got NULL pointer to task, can't set alarm");
 		return -1;
@@ -645,23 +613,24 @@ int tasks_task_set_alarm(Task * task, Alarm * alarm)
 	{
 		log_write(LOG_DEBUG, "Changing offsets for next tasks in TasksDB PDB. "
 				  "Offset delta = %d", offsetDelta);
-		PDBRecord * nextRecord = TAILQ_NEXT(task->_record_tasks, pointers);
+		PDBRecord * nextRecord = pdb_record_next(tasks->_pdb_tasks,
+												 task->_record_tasks);
 		while(nextRecord != NULL)
 		{
 			log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
 					  "new offset=0x%08x", nextRecord->offset,
 					  nextRecord->offset + offsetDelta);
 			nextRecord->offset += offsetDelta;
-			nextRecord = TAILQ_NEXT(nextRecord, pointers);
+			nextRecord = pdb_record_next(tasks->_pdb_tasks, nextRecord);
 		}
 	}
 
 	return 0;
 }
 
-int tasks_task_set_repeat(Task * task, Repeat * repeat)
+int tasks_task_set_repeat(Tasks * tasks, Task * task, Repeat * repeat)
 {
-	if(task == NULL)
+	if(tasks == NULL || task == NULL)
 	{
 		log_write(LOG_ERR, "Got NULL pointer to task, can't set repeat interval");
 		return -1;
@@ -719,14 +688,15 @@ int tasks_task_set_repeat(Task * task, Repeat * repeat)
 	{
 		log_write(LOG_DEBUG, "Changing offsets for next tasks in TasksDB PDB. "
 				  "Offset delta = %d", offsetDelta);
-		PDBRecord * nextRecord = TAILQ_NEXT(task->_record_tasks, pointers);
+		PDBRecord * nextRecord = pdb_record_next(tasks->_pdb_tasks,
+												 task->_record_tasks);
 		while(nextRecord != NULL)
 		{
 			log_write(LOG_DEBUG, "For existing record: old offset=0x%08x, "
 					  "new offset=0x%08x", nextRecord->offset,
 					  nextRecord->offset + offsetDelta);
 			nextRecord->offset += offsetDelta;
-			nextRecord = TAILQ_NEXT(nextRecord, pointers);
+			nextRecord = pdb_record_next(tasks->_pdb_tasks, nextRecord);
 		}
 	}
 
@@ -821,6 +791,8 @@ int tasks_task_edit(Tasks * tasks, Task * task, char * header, char * text,
 		strlen(text) - strlen(task->text) :
 		0;
 
+	/* Header hash will be changed */
+	_tasks_index_remove(tasks, task);
 	if(newHeader != NULL)
 	{
 		free(task->header);
@@ -832,6 +804,12 @@ int tasks_task_edit(Tasks * tasks, Task * task, char * header, char * text,
 		explicit_bzero(task->header, strlen(task->header));
 		strcpy(task->header, header);
 	}
+	if(_tasks_index_add(tasks, task))
+	{
+		log_write(LOG_ERR, "Cannot update index for task with header \"%s\"",
+				  task->header);
+		return -1;
+	}
 
 	if(newText != NULL)
 	{
@@ -867,21 +845,25 @@ int tasks_task_edit(Tasks * tasks, Task * task, char * header, char * text,
 		recordToDo->attributes |= categoryIdToDoDB;
 		recordTasks->attributes &= 0xf0;
 		recordTasks->attributes |= categoryIdTasksDB;
+		task->categoryId = categoryIdToDoDB;
+		task->category = pdb_category_get_name(tasks->_pdb_tododb,
+											   categoryIdToDoDB);
 	}
 
 	/* Should recalculate offset for next tasks */
 	log_write(LOG_DEBUG, "Recalculate offsets for next tasks");
 	if(headerSizeDiff + textSizeDiff != 0)
 	{
-		PDBRecord * record;
-		while((record = TAILQ_NEXT(recordToDo, pointers)) != NULL)
+		PDBRecord * record = recordToDo;
+		while((record = pdb_record_next(tasks->_pdb_tododb, record)) != NULL)
 		{
 			log_write(LOG_DEBUG, "[ToDoDB] Next task: old offset=0x%08x, "
 					  "new offset=0x%08x", record->offset,
 					  record->offset + headerSizeDiff + textSizeDiff);
 			record->offset += headerSizeDiff + textSizeDiff;
 		}
-		while((record = TAILQ_NEXT(recordTasks, pointers)) != NULL)
+		record = recordTasks;
+		while((record = pdb_record_next(tasks->_pdb_tasks, record)) != NULL)
 		{
 			log_write(LOG_DEBUG, "[TasksDB] Next task: old offset=0x%08x, "
 					  "new offset=0x%08x", record->offset,
@@ -939,12 +921,12 @@ int tasks_task_delete(Tasks * tasks, Task * task)
 	/* Delete task */
 	PDBRecord * recordToDoDB = task->_record_todo;
 	PDBRecord * recordTasksDB = task->_record_tasks;
+	_tasks_index_remove(tasks, task);
 	free(task->header);
 	if(task->text != NULL)
 	{
 		free(task->text);
 	}
-	free(task->category);
 	if(task->alarm != NULL)
 	{
 		free(task->alarm);
@@ -959,14 +941,16 @@ int tasks_task_delete(Tasks * tasks, Task * task)
 	PDBRecord * recordToDoDB2 = recordToDoDB;
 	PDBRecord * recordTasksDB2 = recordTasksDB;
 	log_write(LOG_DEBUG, "Recalculate offsets for next tasks");
-	while((recordToDoDB2 = TAILQ_NEXT(recordToDoDB2, pointers)) != NULL)
+	while((recordToDoDB2 = pdb_record_next(tasks->_pdb_tododb,
+										   recordToDoDB2)) != NULL)
 	{
 		log_write(LOG_DEBUG, "[ToDoDB] Existing task: old offset=0x%08x, "
 				  "new offset=0x%08x", recordToDoDB2->offset,
 				  recordToDoDB2->offset - offsetToDo);
 		recordToDoDB2->offset -= offsetToDo;
 	}
-	while((recordTasksDB2 = TAILQ_NEXT(recordTasksDB2, pointers)) != NULL)
+	while((recordTasksDB2 = pdb_record_next(tasks->_pdb_tasks,
+											recordTasksDB2)) != NULL)
 	{
 		log_write(LOG_DEBUG, "[TasksDB] Existing task: old offset=0x%08x, "
 				  "new offset=0x%08x", recordTasksDB2->offset,
@@ -979,16 +963,16 @@ int tasks_task_delete(Tasks * tasks, Task * task)
 	recordTasksDB2 = recordTasksDB;
 	log_write(LOG_DEBUG, "Recalculate offsets due to record list size change "
 			  "for previous change");
-	while((recordToDoDB2 = TAILQ_PREV(
-			   recordToDoDB2, RecordQueue, pointers)) != NULL)
+	while((recordToDoDB2 = pdb_record_prev(tasks->_pdb_tododb,
+										   recordToDoDB2)) != NULL)
 	{
 		log_write(LOG_DEBUG, "[ToDoDB] Existing task [2]: old offset=0x%08x, "
 				  "new offset=0x%08x", recordToDoDB2->offset,
 				  recordToDoDB2->offset - PDB_RECORD_ITEM_SIZE);
 		recordToDoDB2->offset -= PDB_RECORD_ITEM_SIZE;
 	}
-	while((recordTasksDB2 = TAILQ_PREV(
-			   recordTasksDB2, RecordQueue, pointers)) != NULL)
+	while((recordTasksDB2 = pdb_record_prev(tasks->_pdb_tasks,
+											recordTasksDB2)) != NULL)
 	{
 		log_write(LOG_DEBUG, "[TasksDB] Existing task [2]: old offset=0x%08x, "
 				  "new offset=0x%08x", recordTasksDB2->offset,
@@ -1018,87 +1002,56 @@ int tasks_task_delete(Tasks * tasks, Task * task)
 /* Local private functions */
 
 /**
-   Read task, pointed by PDBRecord, from file with given descriptor.
+   Read task, pointed by PDBRecord, from PDB file contents in memory.
 
-   @param[in] fd File descriptor.
    @param[in] record PDBRecord, which points to task.
    @param[in] pdb PDB structure with data from file.
    @return Task or NULL if error.
 */
-static Task * _tasks_read_task(int fd, PDBRecord * record, PDB * pdb)
+static Task * _tasks_read_task(PDBRecord * record, PDB * pdb)
 {
+	size_t length = 0;
+	const uint8_t * data;
+	if((data = pdb_record_data(pdb, record, &length)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot get task data at 0x%08x offset in ToDoDB",
+				  record->offset);
+		return NULL;
+	}
+
 	/* Go to task.
 	   Skip scheduled date and priority - will read it from
 	   TasksDB-PTod database
 	*/
-	if(lseek(fd, record->offset + 3, SEEK_SET) != (record->offset + 3))
+	if(length < 3)
 	{
-		log_write(LOG_ERR, "Cannot go to 0x%08x offset in ToDoDB PDB file "
-				  "to read task: %s", record->offset + 3, strerror(errno));
+		log_write(LOG_ERR, "Task at 0x%08x offset in ToDoDB is truncated",
+				  record->offset);
 		return NULL;
 	}
-
-	char buffer[CHUNK_SIZE] = "\0";
-	ssize_t readedBytes = 0;
+	const uint8_t * headerStart = data + 3;
+	length -= 3;
 
 	/* Calculate header size */
-	unsigned int headerSize = 0;
-	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
-	{
-		const char * headerEnd = memchr(buffer, '\0', readedBytes);
-		if(headerEnd != NULL)
-		{
-			headerSize += headerEnd - buffer;
-			/* "+1" to skip '\0' at the end of header */
-			if(lseek(fd, -(readedBytes - (headerEnd - buffer)) + 1,
-					 SEEK_CUR) == (off_t)-1)
-			{
-				log_write(LOG_ERR, "Cannot rewind to start of task header: %s",
-						  strerror(errno));
-				return NULL;
-			}
-			break;
-		}
-		headerSize += readedBytes;
-	}
-	if(readedBytes < 0)
+	const uint8_t * headerEnd = memchr(headerStart, '\0', length);
+	if(headerEnd == NULL)
 	{
-		log_write(LOG_ERR, "Failed to locate task header: %s", strerror(errno));
-		return NULL;
-	}
-
-	/* Calculate text size */
-	unsigned int textSize = 0;
-	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
-	{
-		const char * textEnd = memchr(buffer, '\0', readedBytes);
-		if(textEnd != NULL)
-		{
-			textSize += textEnd - buffer;
-			if(lseek(fd, -(readedBytes - (textEnd - buffer)),
-					 SEEK_CUR) == (off_t)-1)
-			{
-				log_write(LOG_ERR, "Cannot rewind to end of task note: %s",
-						  strerror(errno));
-				return NULL;
-			}
-			break;
-		}
-		textSize += readedBytes;
-	}
-	if(readedBytes < 0)
-	{
-		log_write(LOG_ERR, "Failed to locate task note: %s", strerror(errno));
+		log_write(LOG_ERR, "Failed to locate task header at 0x%08x offset",
+				  record->offset);
 		return NULL;
 	}
+	size_t headerSize = headerEnd - headerStart;
 
-	/* Rewinding to the start of the task's header */
-	if(lseek(fd, record->offset + 3, SEEK_SET) != (record->offset + 3))
+	/* Calculate text size. "+1" to skip '\0' at the end of header */
+	const uint8_t * textStart = headerEnd + 1;
+	const uint8_t * textEnd = memchr(textStart, '\0', length - headerSize - 1);
+	if(textEnd == NULL)
 	{
-		log_write(LOG_ERR, "Cannot rewind to start of task: %s",
-				  strerror(errno));
+		log_write(LOG_ERR, "Failed to locate task note at 0x%08x offset",
+				  record->offset);
 		return NULL;
 	}
+	size_t textSize = textEnd - textStart;
 
 	/* Allocate memory for task */
 	Task * task;
@@ -1124,110 +1077,63 @@ static Task * _tasks_read_task(int fd, PDBRecord * record, PDB * pdb)
 		free(task);
 		return NULL;
 	}
-	if((task->category = calloc(PDB_CATEGORY_LEN, sizeof(char))) == NULL)
-	{
-		log_write(LOG_ERR, "Cannot allocate memory for task category: %s",
-				  strerror(errno));
-		free(task->text);
-		free(task->header);
-		free(task);
-		return NULL;
-	}
 
-	log_write(LOG_DEBUG, "Header size: %d, note size: %d", headerSize, textSize);
+	log_write(LOG_DEBUG, "Header size: %lu, note size: %lu", headerSize,
+			  textSize);
 
-	/* Reading header */
-	if(read_chunks(fd, task->header, headerSize))
+	/* Copy header and text */
+	memcpy(task->header, headerStart, headerSize);
+	if(textSize != 0)
 	{
-		log_write(LOG_ERR, "Cannot read task header");
-		free(task->header);
-		free(task->text);
-		free(task->category);
-		free(task);
-		return NULL;
-	}
-	/* Skip '\0' at the end of header */
-	if(lseek(fd, 1, SEEK_CUR) == (off_t)-1)
-	{
-		log_write(LOG_ERR, "Failed to skip NULL terminator between task header "
-				  "and note: %s", strerror(errno));
-		free(task->header);
-		free(task->text);
-		free(task->category);
-		free(task);
-		return NULL;
-	}
-
-	/* Reading text */
-	if(textSize != 0 && read_chunks(fd, task->text, textSize))
-	{
-		log_write(LOG_ERR, "Cannot read task note");
-		free(task->header);
-		free(task->text);
-		free(task->category);
-		free(task);
-		return NULL;
+		memcpy(task->text, textStart, textSize);
 	}
 
-	/* Reading category */
-	char * categoryName = pdb_category_get_name(pdb, record->attributes & 0x0f);
-	strncpy(task->category, categoryName, PDB_CATEGORY_LEN);
+	/* Category name is shared with categories of PDB file */
+	task->categoryId = record->attributes & 0x0f;
+	task->category = pdb_category_get_name(pdb, task->categoryId);
 
 	task->_record_todo = record;
 	return task;
 }
 
 /**
-   Read additional task's data from file and append it to task.
+   Read additional task's data from file contents and append it to task.
 
-   Additional data will be read from TasksDB-PTod PDB file.
+   Additional data will be read from TasksDB-PTod PDB file contents in memory.
 
-   @param[in] fd File descriptor.
    @param[in] record PDBRecord which points to task's data.
    @param[in] tasks Initialized Tasks structure to append data to necessary
    task.
    @return 0 on success or -1 on error.
 */
-static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks)
+static int _tasks_append_task(PDBRecord * record, Tasks * tasks)
 {
 	/* Go to task's data */
-	if(lseek(fd, record->offset, SEEK_SET) != record->offset)
+	size_t length = 0;
+	const uint8_t * data;
+	if((data = pdb_record_data(tasks->_pdb_tasks, record, &length)) == NULL)
 	{
-		log_write(LOG_ERR, "Cannot go to 0x%08x offset in TasksDB-PTod "
-				  "PDB file to append task's data: %s", record->offset,
-				  strerror(errno));
+		log_write(LOG_ERR, "Cannot get task's data at 0x%08x offset in "
+				  "TasksDB-PTod", record->offset);
 		return -1;
 	}
 
-	/* Read task type */
-	uint8_t type = 0;
-	if(read(fd, &type, 1) != 1)
+	/* Task type, four zero bytes and task priority */
+	if(length < 6)
 	{
-		log_write(LOG_ERR, "Cannot read task type from TaskDB-PTod. "
-				  "Unique record ID: %dl", pdb_record_get_unique_id(
-					  record));
+		log_write(LOG_ERR, "Cannot read task type and priority from "
+				  "TaskDB-PTod. Unique record ID: %dl",
+				  pdb_record_get_unique_id(record));
 		return -1;
 	}
-	log_write(LOG_DEBUG, "Task type: 0x%02x", type);
 
-	/* Skip four zero bytes */
-	if(lseek(fd, 4, SEEK_CUR) == (off_t)-1)
-	{
-		log_write(LOG_ERR, "Cannot skip four zero bytes at the start "
-				  "of task: %s", strerror(errno));
-		return -1;
-	}
+	/* Read task type */
+	uint8_t type = data[0];
+	log_write(LOG_DEBUG, "Task type: 0x%02x", type);
 
 	/* Read task priority */
 	TaskPriority priority;
-	uint8_t rawPriority = 0;
-	if(read(fd, &rawPriority, 1) != 1)
-	{
-		log_write(LOG_ERR, "Cannot read task priority from TaskDB-PTod."
-				  " Unique record ID: %dl", pdb_record_get_unique_id(
-					  record));
-		return -1;
-	}
+	uint8_t rawPriority = data[5];
 	log_write(LOG_DEBUG, "Task raw priority: %d", rawPriority);
 	switch(rawPriority)
 	{
@@ -1256,7 +1162,7 @@ static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks)
 	log_write(LOG_DEBUG, "Task priority: %d", priority + 1);
 
 	/* Parse task data */
-	Task * parsedTaskData = __parse_taskdb_data(fd, type);
+	Task * parsedTaskData = __parse_taskdb_data(data + 6, length - 6, type);
 	Task * task;
 	if(parsedTaskData == NULL)
 	{
@@ -1266,7 +1172,8 @@ static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks)
 	}
 
 	/* Get Task element corresponding to parsed data */
-	if((task = tasks_task_get(tasks, parsedTaskData->header)) == NULL)
+	if((task = __tasks_join_task(tasks, record,
+								 parsedTaskData->header)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot find task with header `%s' in Tasks queue!",
 				  parsedTaskData->header);
@@ -1314,6 +1221,55 @@ static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks)
 	return 0;
 }
 
+/**
+   Find task from ToDoDB, corresponding to TasksDB-PTod record.
+
+   Task with the same unique record ID and header is preferred. If there
+   is no such task — first task with the same header and without data
+   from TasksDB-PTod is returned, so tasks with duplicated headers are
+   joined one-to-one.
+
+   @param[in] tasks Tasks structure with indexes of tasks.
+   @param[in] record Record from TasksDB-PTod.
+   @param[in] header Task header from TasksDB-PTod record.
+   @return Task or NULL if not found.
+*/
+static Task * __tasks_join_task(Tasks * tasks, PDBRecord * record,
+								char * header)
+{
+	Task * task;
+	size_t cursor = 0;
+	uint32_t id = pdb_record_get_unique_id(record);
+	while((task = hash_index_find(&tasks->_byId, id, &cursor)) != NULL)
+	{
+		if(task->_record_tasks == NULL && strcmp(task->header, header) == 0)
+		{
+			return task;
+		}
+	}
+
+	Task * found = NULL;
+	cursor = 0;
+	while((task = hash_index_find(&tasks->_byHeader, __task_header_hash(header),
+								  &cursor)) != NULL)
+	{
+		/* Hash index does not keep order of tasks, so choose the first task
+		   from the ToDoDB record list */
+		if(task->_record_tasks == NULL && strcmp(task->header, header) == 0 &&
+		   (found == NULL ||
+			task->_record_todo->offset < found->_record_todo->offset))
+		{
+			found = task;
+		}
+	}
+	if(found != NULL)
+	{
+		log_write(LOG_DEBUG, "Task with header \"%s\" joined by header, "
+				  "TasksDB-PTod record ID: %d", header, id);
+	}
+	return found;
+}
+
 /* Bits, encoding types of task. Can be mixed with OR. */
 #define HEADER_PRESENT   0x08
 #define NOTE_PRESENT     0x04
@@ -1331,12 +1287,16 @@ static int _tasks_append_task(int fd, PDBRecord * record, Tasks * tasks)
 /**
    Parse task data from TasksDB-PTod database.
 
-   @param[in] fd File descriptor of opened TasksDB-PTod database.
+   @param[in] data Task data from TasksDB-PTod database, right after task
+   priority.
+   @param[in] length Count of bytes available in data.
    @param[in] type Type of Task from TasksDB-PTod database.
    @return Temporary Task only with parsed data.
 */
-static Task * __parse_taskdb_data(int fd, uint8_t type)
+static Task * __parse_taskdb_data(const uint8_t * data, size_t length,
+								  uint8_t type)
 {
+	size_t position = 0;
 	Task * result;
 	if((result = calloc(1, sizeof(Task))) == NULL)
 	{
@@ -1348,13 +1308,15 @@ static Task * __parse_taskdb_data(int fd, uint8_t type)
 	if(type & DUE_DATE_PRESENT)
 	{
 		uint16_t dueDate;
-		if(read(fd, &dueDate, 2) != 2)
+		if(position + 2 > length)
 		{
 			log_write(LOG_ERR, "Failed to read due date from TasksDB-PTod. "
 					  "Record type: 0x%02x", type);
 			_task_free(result);
 			return NULL;
 		}
+		memcpy(&dueDate, data + position, 2);
+		position += 2;
 		dueDate = be16toh(dueDate);
 		result->dueDay = dueDate & 0x001f; /* First 5 bits */
 		result->dueMonth = (dueDate & 0x01e0) >> 5; /* 4 bits starting from
@@ -1374,24 +1336,20 @@ static Task * __parse_taskdb_data(int fd, uint8_t type)
 			_task_free(result);
 			return NULL;
 		}
-		uint16_t alarmTime;
-	    if(read(fd, &alarmTime, 2) != 2)
+		if(position + 4 > length)
 		{
-			log_write(LOG_ERR, "Cannot read alarm time from task: %s",
-					  strerror(errno));
+			log_write(LOG_ERR, "Cannot read alarm time and days earlier from "
+					  "task: unexpected end of record");
 			_task_free(result);
 			return NULL;
 		}
+		uint16_t alarmTime;
+		memcpy(&alarmTime, data + position, 2);
 		alarmTime = be16toh(alarmTime);
 		uint16_t alarmDaysEarlier;
-		if(read(fd, &alarmDaysEarlier, 2) != 2)
-		{
-			log_write(LOG_ERR, "Cannot read alarm days earlier from task: %s",
-					  strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
+		memcpy(&alarmDaysEarlier, data + position + 2, 2);
 		alarmDaysEarlier = be16toh(alarmDaysEarlier);
+		position += 4;
 		result->alarm->alarmHour = (uint8_t)(alarmTime >> 8);
 		result->alarm->alarmMinute = (uint8_t)alarmTime;
 		result->alarm->daysEarlier = alarmDaysEarlier;
@@ -1409,49 +1367,31 @@ static Task * __parse_taskdb_data(int fd, uint8_t type)
 			_task_free(result);
 			return NULL;
 		}
-		/* Skip repeat of due date */
-		if(lseek(fd, 2, SEEK_CUR) == (off_t)-1)
+		/* Duplicate of due date, repeat type, repeat until date, repeat
+		   interval and three unknown bytes */
+		if(position + 10 > length)
 		{
-			log_write(LOG_ERR, "Cannot skip duplicate of due date in repeat "
-					  "section of task: %s", strerror(errno));
+			log_write(LOG_ERR, "Cannot read repeat section of task: "
+					  "unexpected end of record");
 			_task_free(result);
 			return NULL;
 		}
+		/* Skip repeat of due date */
+		position += 2;
 		uint16_t repeatType;
-		if(read(fd, &repeatType, 2) != 2)
-		{
-			log_write(LOG_ERR, "Cannot read repeat type from task: %s",
-					  strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
+		memcpy(&repeatType, data + position, 2);
 		repeatType = be16toh(repeatType);
+		position += 2;
 		uint16_t repeatUntilDate;
-		if(read(fd, &repeatUntilDate, 2) != 2)
-		{
-			log_write(LOG_ERR, "Cannot read repeat until date data from task: "
-					  "%s", strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
+		memcpy(&repeatUntilDate, data + position, 2);
 		repeatUntilDate = be16toh(repeatUntilDate);
-		uint8_t repeatInterval;
-		if(read(fd, &repeatInterval, 1) != 1)
-		{
-			log_write(LOG_ERR, "Cannot read repeat interval from task: %s",
-					  strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
-		uint32_t unknownBits;
-		if(read(fd, &unknownBits, 3) != 3)
-		{
-			log_write(LOG_ERR, "Cannot read last three unknown bytes from "
-					  "repeat interval: %s", strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
+		position += 2;
+		uint8_t repeatInterval = data[position];
+		position += 1;
+		uint32_t unknownBits = 0;
+		memcpy(&unknownBits, data + position, 3);
 		unknownBits = be32toh(unknownBits & 0x00ffffff);
+		position += 3;
 
 		switch(repeatType)
 		{
@@ -1497,38 +1437,20 @@ static Task * __parse_taskdb_data(int fd, uint8_t type)
 	}
 	if(type & HEADER_PRESENT)
 	{
-		char buffer[CHUNK_SIZE] = "\0";
-		ssize_t readedBytes = 0;
-
-		off_t currPos = lseek(fd, 0, SEEK_CUR);
-		log_write(LOG_DEBUG, "Reading header. Current offset: 0x%08x", currPos);
+		log_write(LOG_DEBUG, "Reading header. Current position: 0x%08x",
+				  position);
 
 		/* Calculate header size */
-		unsigned int headerSize = 0;
-		while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
+		const uint8_t * headerEnd = memchr(data + position, '\0',
+										   length - position);
+		if(headerEnd == NULL)
 		{
-			const char * headerEnd = memchr(buffer, '\0', readedBytes);
-			if(headerEnd != NULL)
-			{
-				headerSize += headerEnd - buffer;
-				break;
-			}
-			headerSize += readedBytes;
-		}
-		if(readedBytes < 0)
-		{
-			log_write(LOG_ERR, "Failed to locate task header: %s", strerror(errno));
-			_task_free(result);
-			return NULL;
-		}
-		/* Rewinding to the start of header */
-		if(lseek(fd, currPos, SEEK_SET) != currPos)
-		{
-			log_write(LOG_ERR, "Cannot rewind to start of header: %s",
-					  strerror(errno));
+			log_write(LOG_ERR, "Failed to locate task header: unexpected end "
+					  "of record");
 			_task_free(result);
 			return NULL;
 		}
+		size_t headerSize = headerEnd - (data + position);
 		/* Allocate memory for header */
 		if((result->header = calloc(headerSize + 1, sizeof(char))) == NULL)
 		{
@@ -1537,14 +1459,9 @@ static Task * __parse_taskdb_data(int fd, uint8_t type)
 			_task_free(result);
 			return NULL;
 		}
-		/* Reading header */
-		log_write(LOG_DEBUG, "Header size: %d", headerSize);
-		if(read_chunks(fd, result->header, headerSize))
-		{
-			log_write(LOG_ERR, "Cannot read task header from TasksDB-PTod");
-			_task_free(result);
-			return NULL;
-		}
+		/* Copying header */
+		log_write(LOG_DEBUG, "Header size: %lu", headerSize);
+		memcpy(result->header, data + position, headerSize);
 		log_write(LOG_DEBUG, "Header: %s", result->header);
 	}
 	else
@@ -1577,7 +1494,6 @@ static void _task_free(Task * task)
 	{
 		free(task->text);
 	}
-	free(task->category);
 	__task_clear_ptod(task);
 
 	task->_record_todo = NULL;
@@ -1948,3 +1864,51 @@ static int _tasks_write_task(TasksFD tfd, Task * task)
 
 	return 0;
 }
+
+/**
+   Add task to indexes.
+
+   @param[in] tasks Tasks structure.
+   @param[in] task Task to add.
+   @return 0 on success or -1 on error.
+*/
+static int _tasks_index_add(Tasks * tasks, Task * task)
+{
+	if(hash_index_insert(&tasks->_byId, pdb_record_get_unique_id(
+							 task->_record_todo), task) ||
+	   hash_index_insert(&tasks->_byHeader, __task_header_hash(task->header),
+						 task))
+	{
+		log_write(LOG_ERR, "Cannot add task with header \"%s\" to index",
+				  task->header);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+   Remove task from indexes.
+
+   Should be called before header of task is changed.
+
+   @param[in] tasks Tasks structure.
+   @param[in] task Task to remove.
+*/
+static void _tasks_index_remove(Tasks * tasks, Task * task)
+{
+	hash_index_remove(&tasks->_byId, pdb_record_get_unique_id(
+						  task->_record_todo), task);
+	hash_index_remove(&tasks->_byHeader, __task_header_hash(task->header),
+					  task);
+}
+
+/**
+   Compute hash for task header.
+
+   @param[in] header Task header.
+   @return Hash of header.
+*/
+static uint64_t __task_header_hash(const char * header)
+{
+	return str_hash((char *)header, strlen(header));
+}
@@ -2,12 +2,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "helper.h"
 #include "log.h"
+#include "hash_index.h"
 #include "palm.h"
-#include "pdb_memos.h"
+#include "pdb/memos.h"
 #include "org_notes.h"
 #include "sync.h"
 
@@ -17,6 +22,18 @@
 */
 #define SYNC_LOG_LENGTH 1000
 
+/**
+   Name of file in data directory with state of OrgMode file with notes
+   after previous synchronization.
+*/
+#define SYNC_NOTES_STATE "notes.state"
+
+/**
+   Name of file in data directory with index of parsed OrgMode file with
+   notes.
+*/
+#define SYNC_NOTES_INDEX "notes.index"
+
 /**
    Possible synchronization actions for items to sync.
 */
@@ -33,11 +50,72 @@ enum SyncAction
 };
 typedef enum SyncAction SyncAction;
 
+/**
+   Status of record from handheld, compared with the same record from
+   previous synchronization.
+*/
+enum RecordStatus
+{
+	RECORD_NO_RECORD,   /**< No record or it should not be synchronized */
+	RECORD_ADDED,       /**< Record added on handheld */
+	RECORD_NOT_CHANGED, /**< Record is not changed on handheld */
+	RECORD_CHANGED,     /**< Record changed on handheld */
+	RECORD_DELETED      /**< Record deleted on handheld */
+};
+
+/**
+   Memo from handheld with data, necessary for synchronization.
+*/
+struct __SyncMemo
+{
+	Memo * memo;               /**< Memo from handheld */
+	uint32_t id;               /**< ID of memo */
+	char * headerCp1251;       /**< Memo header in CP1251, like in OrgNote */
+	uint64_t headerHash;       /**< Hash of header in CP1251 */
+	enum RecordStatus status;  /**< Status of memo record */
+};
+
+/**
+   Note from org-file with synchronization state.
+*/
+struct __SyncNote
+{
+	OrgNote * note;  /**< Note from org-file */
+	size_t position; /**< Position of note in org-file */
+	bool matched;    /**< True if note is matched with memo from handheld */
+};
+
+/**
+   State of file, used to detect changes between synchronizations.
+*/
+struct __SyncFileState
+{
+	long long size;         /**< Size of file in bytes */
+	long long mtimeSec;     /**< Modification time, seconds */
+	long mtimeNsec;         /**< Modification time, nanoseconds */
+	struct umash_fp hash;   /**< Fingerprint of file contents */
+};
+
+static int _sync_needed(SyncSettings * syncSettings, int palmfd);
+static int _file_state(const char * path, struct __SyncFileState * state,
+					   bool withHash);
+static char * _data_file_path(const char * dataDir, const char * name);
+static int _org_file_changed(const char * orgPath, const char * dataDir);
+static void _org_file_save_state(const char * orgPath, const char * dataDir);
 static int _sync_memos(char * pdbPath, char * prevPdbPath, char * orgPath,
-					   int palmfd, int dryRun);
-static int _compute_record_statuses(PDB * pdb, char * prevPdbPath);
+					   const char * indexPath, OrgWatch * notesWatch,
+					   int palmfd, int dryRun, Arena * arena);
+static int _compute_record_statuses(struct __SyncMemo * syncMemos, size_t qty,
+									char * prevPdbPath);
+static enum RecordStatus _compute_record_status(uint8_t attribute,
+												uint8_t prevAttribute,
+												bool prevExists);
 static SyncAction _compute_action_for_record(enum RecordStatus recordStatus,
 											 bool orgNoteExists);
+static struct __SyncNote * _index_notes(OrgNotes * notes, size_t * qty,
+										HashIndex * index, Arena * arena);
+static struct __SyncNote * _match_note(HashIndex * index,
+									   struct __SyncMemo * syncMemo);
 
 
 int sync_this(SyncSettings * syncSettings)
@@ -54,8 +132,16 @@ int sync_this(SyncSettings * syncSettings)
 		return -1;
 	}
 
+	if(!_sync_needed(syncSettings, palmfd))
+	{
+		log_write(LOG_INFO, "Nothing is changed since previous "
+				  "synchronization, skip it");
+		palm_log(palmfd, "Nothing to synchronize\n");
+		return palm_close(palmfd, syncSettings->device) ? -1 : 0;
+	}
+
 	PalmData * palmData;
-	if((palmData = palm_read(palmfd)) == NULL)
+	if((palmData = palm_read(palmfd, syncSettings->dataDir)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read PDBs from Palm");
 		if(palm_close(palmfd, syncSettings->device))
@@ -65,8 +151,22 @@ int sync_this(SyncSettings * syncSettings)
 		return -1;
 	}
 
-	if(_sync_memos(palmData->memoDBPath, syncSettings->prevMemosPDB,
-				   syncSettings->notesOrgFile, palmfd, syncSettings->dryRun))
+	/* Memos and notes live only during one cycle, so they are allocated
+	   from arena, which memory is reused by the next cycle */
+	static Arena arena;
+	/* Without index notes are just parsed from the whole file */
+	char * indexPath = _data_file_path(syncSettings->dataDir,
+									   SYNC_NOTES_INDEX);
+	int memosResult = _sync_memos(palmData->memoDBPath,
+								  syncSettings->prevMemosPDB,
+								  syncSettings->notesOrgFile, indexPath,
+								  syncSettings->notesWatch, palmfd,
+								  syncSettings->dryRun, &arena);
+	free(indexPath);
+	log_write(LOG_DEBUG, "Allocated from arena while synchronizing Memos: "
+			  "%lu bytes", arena.allocated);
+	arena_reset(&arena);
+	if(memosResult)
 	{
 		log_write(LOG_ERR, "Failed to synchronize Memos");
 		goto sync_this_error;
@@ -84,6 +184,11 @@ int sync_this(SyncSettings * syncSettings)
 				  "iteration");
 		goto sync_this_error;
 	}
+	if(!syncSettings->dryRun)
+	{
+		_org_file_save_state(syncSettings->notesOrgFile,
+							 syncSettings->dataDir);
+	}
 
 	palm_free(palmData);
 	if(palm_close(palmfd, syncSettings->device))
@@ -100,307 +205,674 @@ sync_this_error:
 	return -1;
 }
 
+int sync_watch_init(SyncSettings * syncSettings)
+{
+	OrgWatch * notesWatch;
+	if((notesWatch = malloc(sizeof(OrgWatch))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for watcher of %s",
+				  syncSettings->notesOrgFile);
+		return -1;
+	}
+	char * indexPath = _data_file_path(syncSettings->dataDir,
+									   SYNC_NOTES_INDEX);
+	int result = org_watch_init(notesWatch, syncSettings->notesOrgFile,
+								indexPath);
+	free(indexPath);
+	if(result)
+	{
+		free(notesWatch);
+		return -1;
+	}
+	syncSettings->notesWatch = notesWatch;
+	return 0;
+}
+
+int sync_watch_update(SyncSettings * syncSettings)
+{
+	if(syncSettings->notesWatch == NULL)
+	{
+		return -1;
+	}
+	org_watch_update(syncSettings->notesWatch);
+	return syncSettings->notesWatch->fd;
+}
+
+void sync_watch_free(SyncSettings * syncSettings)
+{
+	if(syncSettings->notesWatch != NULL)
+	{
+		org_watch_free(syncSettings->notesWatch);
+		free(syncSettings->notesWatch);
+		syncSettings->notesWatch = NULL;
+	}
+}
+
+/**
+   Check whether synchronization is necessary.
+
+   Synchronization is not necessary if MemoDB on Palm is not changed since
+   previous synchronization and OrgMode file with notes is not changed
+   too. Only information about database is read from Palm for this check.
+
+   @param[in] syncSettings Settings for synchronization.
+   @param[in] palmfd Palm device descriptor.
+   @return Zero if synchronization can be skipped, non-zero value
+   otherwise.
+*/
+static int _sync_needed(SyncSettings * syncSettings, int palmfd)
+{
+	if(palm_database_changed(palmfd, "MemoDB", syncSettings->prevMemosPDB))
+	{
+		return 1;
+	}
+	if(_org_file_changed(syncSettings->notesOrgFile, syncSettings->dataDir))
+	{
+		return 1;
+	}
+	return 0;
+}
+
+/**
+   Get state of file.
+
+   @param[in] path Path to file.
+   @param[out] state State of file.
+   @param[in] withHash Compute fingerprint of file contents if true.
+   @return Zero on success or non-zero value on error.
+*/
+static int _file_state(const char * path, struct __SyncFileState * state,
+					   bool withHash)
+{
+	int fd;
+	if((fd = open(path, O_RDONLY)) == -1)
+	{
+		log_write(LOG_WARNING, "Cannot open %s: %s", path, strerror(errno));
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd, &st))
+	{
+		log_write(LOG_WARNING, "Cannot get status of %s: %s", path,
+				  strerror(errno));
+		close(fd);
+		return -1;
+	}
+	state->size = st.st_size;
+	state->mtimeSec = st.st_mtim.tv_sec;
+	state->mtimeNsec = st.st_mtim.tv_nsec;
+	state->hash = str_fingerprint("", 0);
+	if(!withHash || st.st_size == 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	void * contents;
+	if((contents = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+	   MAP_FAILED)
+	{
+		log_write(LOG_WARNING, "Cannot map %s to memory: %s", path,
+				  strerror(errno));
+		close(fd);
+		return -1;
+	}
+	state->hash = str_fingerprint(contents, st.st_size);
+	munmap(contents, st.st_size);
+	close(fd);
+	return 0;
+}
+
+/**
+   Returns path to file in data directory.
+
+   @param[in] dataDir Path to data directory, with trailing slash.
+   @param[in] name Name of file.
+   @return Path to file or NULL on error. Memory should be freed outside
+   of this function.
+*/
+static char * _data_file_path(const char * dataDir, const char * name)
+{
+	size_t length = strlen(dataDir) + strlen(name) + 1;
+	char * path;
+	if((path = calloc(length, sizeof(char))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for path to %s", name);
+		return NULL;
+	}
+	snprintf(path, length, "%s%s", dataDir, name);
+	return path;
+}
+
+/**
+   Check whether OrgMode file is changed since previous synchronization.
+
+   Size and modification time of file are compared with saved
+   ones. If only modification time is changed, fingerprint of file
+   contents is compared too.
+
+   @param[in] orgPath Path to OrgMode file.
+   @param[in] dataDir Path to data directory.
+   @return 0 if file is not changed, 1 if it is changed or there is no
+   saved state, -1 on error.
+*/
+static int _org_file_changed(const char * orgPath, const char * dataDir)
+{
+	char * statePath;
+	if((statePath = _data_file_path(dataDir, SYNC_NOTES_STATE)) == NULL)
+	{
+		return -1;
+	}
+	FILE * stateFile = fopen(statePath, "r");
+	free(statePath);
+	if(stateFile == NULL)
+	{
+		log_write(LOG_DEBUG, "No saved state of %s", orgPath);
+		return 1;
+	}
+	struct __SyncFileState prev;
+	int fields = fscanf(stateFile, "%lld %lld %ld %" SCNx64 " %" SCNx64,
+						&prev.size, &prev.mtimeSec, &prev.mtimeNsec,
+						&prev.hash.hash[0], &prev.hash.hash[1]);
+	fclose(stateFile);
+	if(fields != 5)
+	{
+		log_write(LOG_WARNING, "Malformed saved state of %s", orgPath);
+		return 1;
+	}
+
+	struct __SyncFileState current;
+	if(_file_state(orgPath, &current, false))
+	{
+		return -1;
+	}
+	if(current.size != prev.size)
+	{
+		log_write(LOG_DEBUG, "File %s is changed: size %lld -> %lld", orgPath,
+				  prev.size, current.size);
+		return 1;
+	}
+	if(current.mtimeSec == prev.mtimeSec && current.mtimeNsec == prev.mtimeNsec)
+	{
+		log_write(LOG_DEBUG, "File %s is not changed since previous "
+				  "synchronization", orgPath);
+		return 0;
+	}
+	if(_file_state(orgPath, &current, true))
+	{
+		return -1;
+	}
+	if(current.hash.hash[0] != prev.hash.hash[0] ||
+	   current.hash.hash[1] != prev.hash.hash[1])
+	{
+		log_write(LOG_DEBUG, "File %s is changed: contents differ", orgPath);
+		return 1;
+	}
+	log_write(LOG_DEBUG, "File %s is touched, but its contents are not "
+			  "changed", orgPath);
+	return 0;
+}
+
+/**
+   Save state of OrgMode file after synchronization.
+
+   If state cannot be saved, saved state is removed, so next
+   synchronization will not be skipped.
+
+   @param[in] orgPath Path to OrgMode file.
+   @param[in] dataDir Path to data directory.
+*/
+static void _org_file_save_state(const char * orgPath, const char * dataDir)
+{
+	char * statePath;
+	if((statePath = _data_file_path(dataDir, SYNC_NOTES_STATE)) == NULL)
+	{
+		return;
+	}
+
+	struct __SyncFileState state;
+	FILE * stateFile;
+	int result = -1;
+	if(!_file_state(orgPath, &state, true) &&
+	   (stateFile = fopen(statePath, "w")) != NULL)
+	{
+		result = fprintf(stateFile, "%lld %lld %ld %016" PRIx64 " %016" PRIx64
+						 "\n", state.size, state.mtimeSec, state.mtimeNsec,
+						 state.hash.hash[0], state.hash.hash[1]) < 0 ? -1 : 0;
+		if(fclose(stateFile))
+		{
+			result = -1;
+		}
+	}
+	if(result)
+	{
+		log_write(LOG_WARNING, "Cannot save state of %s to %s", orgPath,
+				  statePath);
+		unlink(statePath);
+	}
+	free(statePath);
+}
+
 /**
    Synchonize Memos data and OrgMode notes file.
 
+   Memos are matched with notes by header hash from the hash index, built
+   once per synchronization. If several memos or several notes have the
+   same header, they are matched one-to-one in the order of org-file;
+   remaining duplicates are treated as unmatched.
+
    @param[in] pdbPath Path to temporary PDB file from Palm PDA.
    @param[in] prevPdbPath Path to PDB file from previous synchronization cycle.
    @param[in] orgPath Path to OrgMode file with notes.
+   @param[in] indexPath Path to index of OrgMode file. May be NULL.
+   @param[in] notesWatch Watcher with notes, parsed before synchronization.
+   May be NULL.
    @param[in] palmfd Palm device descriptor.
    @param[in] dryRun If non-zero - do not sync data, just simulate process.
+   @param[in] arena Arena for memos, notes and their strings. Caller resets
+   it after synchronization.
    @return Zero on sucessfull or non-zero on error.
 */
 static int _sync_memos(char * pdbPath, char * prevPdbPath, char * orgPath,
-					   int palmfd, int dryRun)
+					   const char * indexPath, OrgWatch * notesWatch,
+					   int palmfd, int dryRun, Arena * arena)
 {
 	/* Read memos from PDB file */
-	PDB * pdb;
-	if((pdb = pdb_memos_read(pdbPath)) == NULL)
+	int memosFd;
+	Memos * memos;
+	if((memosFd = memos_open(pdbPath)) == -1)
+	{
+		log_write(LOG_ERR, "Failed to open MemosDB");
+		palm_log(palmfd, "Cannot parse Memos\n");
+		return -1;
+	}
+	if((memos = memos_read(memosFd, arena)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read MemosDB");
 		palm_log(palmfd, "Cannot parse Memos\n");
+		memos_close(memosFd);
 		return -1;
 	}
-	if(_compute_record_statuses(pdb, prevPdbPath))
+
+	/* Memos queue will be changed while synchronizing, so take a snapshot of
+	   memos from handheld */
+	size_t qtyMemos = 0;
+	Memo * memo;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
+	{
+		qtyMemos++;
+	}
+	struct __SyncMemo * syncMemos;
+	if((syncMemos = arena_alloc(arena, (qtyMemos + 1) *
+								sizeof(struct __SyncMemo))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for memos to sync");
+		memos_free(memos);
+		memos_close(memosFd);
+		return -1;
+	}
+	size_t i = 0;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
+	{
+		syncMemos[i].memo = memo;
+		syncMemos[i].id = memo->id;
+		if((syncMemos[i].headerCp1251 = iconv_utf8_to_cp1251_arena(
+				arena, memo->header)) == NULL)
+		{
+			log_write(LOG_ERR, "Cannot convert header of memo with ID = %d to "
+					  "CP1251", memo->id);
+			memos_free(memos);
+			memos_close(memosFd);
+			return -1;
+		}
+		syncMemos[i].headerHash = str_hash(syncMemos[i].headerCp1251,
+										   strlen(syncMemos[i].headerCp1251));
+		i++;
+	}
+
+	if(_compute_record_statuses(syncMemos, qtyMemos, prevPdbPath))
 	{
 		log_write(LOG_ERR, "Cannot compute statuses for records from %s",
 				  pdbPath);
 		palm_log(palmfd, "Cannot parse Memos\n");
+		memos_free(memos);
+		memos_close(memosFd);
 		return -1;
 	}
 
-	/* Read notes from OrgMode file */
-	const OrgNotes * notes;
-	if((notes = org_notes_parse(orgPath)) == NULL)
+	/* Read notes from OrgMode file, if they are not parsed while waiting
+	   for Palm */
+	struct stat orgStat;
+	OrgNotes * notes = notesWatch != NULL ?
+		org_watch_notes(notesWatch, &orgStat) : NULL;
+	if(notes == NULL &&
+	   (notes = org_notes_parse(orgPath, indexPath, arena,
+								&orgStat)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to parse file with notes: %s", orgPath);
 		char log[SYNC_LOG_LENGTH];
 		snprintf(log, SYNC_LOG_LENGTH, "Cannot parse OrgMode file: %s\n",
 				 orgPath);
 		palm_log(palmfd, log);
+		memos_free(memos);
+		memos_close(memosFd);
+		return -1;
+	}
+
+	/* Index notes by header hash */
+	size_t qtyNotes = 0;
+	HashIndex notesIndex;
+	struct __SyncNote * syncNotes;
+	if((syncNotes = _index_notes(notes, &qtyNotes, &notesIndex,
+									 arena)) == NULL)
+	{
+		log_write(LOG_ERR, "Failed to index notes from %s", orgPath);
+		memos_free(memos);
+		memos_close(memosFd);
 		return -1;
 	}
 
-	/* Open org-file for writing */
-	int orgNoteFd = org_notes_open(orgPath);
-	if(orgNoteFd == -1)
+	/* Changes of org-file are collected and written at once, if file is
+	   not changed since parsing */
+	OrgNotesWriter * orgWriter = org_notes_open(orgPath, &orgStat, arena);
+	if(orgWriter == NULL)
 	{
 		log_write(LOG_ERR, "Failed to open org-file %s for writing", orgPath);
 		char log[SYNC_LOG_LENGTH];
 		snprintf(log, SYNC_LOG_LENGTH, "Cannot parse OrgMode file: %s\n",
 				 orgPath);
 		palm_log(palmfd, log);
+		hash_index_free(&notesIndex);
+		memos_free(memos);
+		memos_close(memosFd);
 		return -1;
 	}
 
 	/* Compare and sync notes from handheld with notes from org-file */
 	unsigned int qtyDesktopAdded = 0;
+	unsigned int qtyDesktopReplaced = 0;
 	unsigned int qtyHandheldAdded = 0;
 	unsigned int qtyHandheldReplaced = 0;
 	unsigned int qtyHandheldDeleted = 0;
 	unsigned int qtyErrors = 0;
-	PDBRecord * record;
-	TAILQ_FOREACH(record, &pdb->records, pointers)
+	for(i = 0; i < qtyMemos; i++)
 	{
-		OrgNote * note = TAILQ_FIRST(notes);
-		while(note != NULL && note->header_hash != record->hash)
-		{
-			note = TAILQ_NEXT(note, pointers);
-		}
+		struct __SyncMemo * syncMemo = &syncMemos[i];
+		struct __SyncNote * syncNote = _match_note(&notesIndex, syncMemo);
+		OrgNote * note = syncNote != NULL ? syncNote->note : NULL;
+		memo = syncMemo->memo;
 
-		PDBMemo * memo = (PDBMemo *)record->data;
 		SyncAction action = _compute_action_for_record(
-			record->status, note != NULL);
+			syncMemo->status, note != NULL);
+		char * header = NULL;
+		char * text = NULL;
 		switch(action)
 		{
 		case ACTION_DO_NOTHING:
 			break;
 		case ACTION_ADD_TO_DESKTOP:
 		case ACTION_COPY_TO_DESKTOP:
-			log_write(LOG_INFO, "Add note \"%s\" from handheld to desktop",
-					  iconv_cp1251_to_utf8(memo->header));
-			char * category = pdb_category_get_name(
-				pdb, record->attributes & 0x0f);
-			if(category == NULL)
+			/* Handheld version wins, so existing note is rewritten in
+			   place */
+			if(note != NULL)
 			{
-				log_write(LOG_ERR, "Failed to get note (\"%s\") category with "
-						  "id = %d", iconv_cp1251_to_utf8(memo->header),
-						  record->attributes & 0x0f);
-				break;
+				log_write(LOG_INFO, "Replace note \"%s\" on desktop with "
+						  "handheld version", memo->header);
+			}
+			else
+			{
+				log_write(LOG_INFO, "Add note \"%s\" from handheld to desktop",
+						  memo->header);
 			}
 			if(dryRun)
 			{
 				break;
 			}
-			if(org_notes_write(orgNoteFd, memo->header, memo->text, category))
+			text = memo->text != NULL ?
+				iconv_utf8_to_cp1251_arena(arena, memo->text) : NULL;
+			if(note != NULL ?
+			   org_notes_replace(orgWriter, note, syncMemo->headerCp1251, text,
+								 memo->category) :
+			   org_notes_write(orgWriter, syncMemo->headerCp1251, text,
+							   memo->category))
 			{
 				log_write(LOG_ERR, "Failed to write note (\"%s\") to org "
-						  "file %s", iconv_cp1251_to_utf8(memo->header),
-						  orgPath);
+						  "file %s", memo->header, orgPath);
+			}
+			if(note != NULL)
+			{
+				qtyDesktopReplaced++;
+			}
+			else
+			{
+				qtyDesktopAdded++;
 			}
-			qtyDesktopAdded++;
 			break;
 		case ACTION_ADD_TO_HANDHELD:
+			header = iconv_cp1251_to_utf8_arena(arena, note->header);
+			text = note->text != NULL ?
+				iconv_cp1251_to_utf8_arena(arena, note->text) : NULL;
 			log_write(LOG_INFO, "Add note \"%s\" from desktop to handheld",
-					  iconv_cp1251_to_utf8(note->header));
-			if(pdb_memos_memo_add(
-				   pdb, note->header, note->text, note->category) == NULL)
+					  header);
+			if(memos_memo_add(memos, header, text, note->category) == 0)
 			{
 				log_write(LOG_ERR,
 						  "Failed to add note (\"%s\") from desktop to handheld",
-						  iconv_cp1251_to_utf8(note->header));
+						  header);
 			}
 			qtyHandheldAdded++;
 			break;
 		case ACTION_REPLACE_ON_HANDHELD:
 			log_write(LOG_INFO, "Replacing \"%s\" memo on handheld with "
-					  "desktop version", iconv_cp1251_to_utf8(memo->header));
-			if(pdb_memos_memo_edit(pdb, memo, note->header, note->text,
-								   note->category))
+					  "desktop version", memo->header);
+			header = iconv_cp1251_to_utf8_arena(arena, note->header);
+			text = note->text != NULL ?
+				iconv_cp1251_to_utf8_arena(arena, note->text) : NULL;
+			if(memos_memo_edit(memos, syncMemo->id, header, text,
+							   note->category))
 			{
 				log_write(LOG_ERR,
 						  "Failed to replace memo (\"%s\") on handheld with "
-						  "desktop note", iconv_cp1251_to_utf8(memo->header));
+						  "desktop note", header);
 			}
 			qtyHandheldReplaced++;
 			break;
 		case ACTION_DELETE_ON_HANDHELD:
 			log_write(LOG_INFO, "Removing \"%s\" memo on handheld",
-					  iconv_cp1251_to_utf8(memo->header));
-			if(pdb_memos_memo_delete(pdb, memo))
+					  memo->header);
+			if(memos_memo_delete(memos, syncMemo->id))
 			{
 				log_write(LOG_ERR,
-						  "Failed to remove memo (\"%s\") on handheld",
-						  iconv_cp1251_to_utf8(memo->header));
+						  "Failed to remove memo with ID = %d on handheld",
+						  syncMemo->id);
 			}
 			qtyHandheldDeleted++;
 			break;
 		case ACTION_ERROR:
 		default:
-			log_write(LOG_ERR, "Unknown record (%s) status: %d", memo->header,
-					  record->status);
+			log_write(LOG_ERR, "Unknown record (ID = %d) status: %d",
+					  syncMemo->id, syncMemo->status);
 			log_write(LOG_ERR, "Unknown action number: %d", action);
 			qtyErrors++;
 		}
-	} /* TAILQ_FOREACH(...) */
+	}
 
     /* Process notes from org-file which are not exists in Palm yet */
-	OrgNote * note;
-	TAILQ_FOREACH(note, notes, pointers)
+	for(i = 0; i < qtyNotes; i++)
 	{
-		record = TAILQ_FIRST(&pdb->records);
-		while(record != NULL && note->header_hash != record->hash)
+		if(syncNotes[i].matched)
 		{
-			record = TAILQ_NEXT(record, pointers);
+			continue;
 		}
-		if(record == NULL)
+		OrgNote * note = syncNotes[i].note;
+		char * header = iconv_cp1251_to_utf8_arena(arena, note->header);
+		char * text = note->text != NULL ?
+			iconv_cp1251_to_utf8_arena(arena, note->text) : NULL;
+		log_write(LOG_INFO, "Adding new record (\"%s\") to handheld from "
+				  "org-file", header);
+		if(memos_memo_add(memos, header, text, note->category) == 0)
 		{
-			log_write(LOG_INFO, "Adding new record (\"%s\") to handheld from "
-					  "org-file",
-					  iconv_cp1251_to_utf8(note->header));
-			if(pdb_memos_memo_add(
-				   pdb, note->header, note->text, note->category) == NULL)
-			{
-				log_write(LOG_ERR,
-						  "Failed to add note (\"%s\") from desktop to handheld",
-						  iconv_cp1251_to_utf8(note->header));
-			}
-			qtyHandheldAdded++;
+			log_write(LOG_ERR,
+					  "Failed to add note (\"%s\") from desktop to handheld",
+					  header);
 		}
+		qtyHandheldAdded++;
 	}
 
+	hash_index_free(&notesIndex);
+
 	/* Writing changes back to files */
 	char message[SYNC_LOG_LENGTH];
 	snprintf(message, SYNC_LOG_LENGTH, "Notes added to desktop: %d\n"
+			 "Notes replaced on desktop: %d\n"
 			 "Notes added to handheld: %d\n"
 			 "Notes replaced on handheld: %d\n"
 			 "Notes deleted on handheld: %d\n"
 			 "Notes with errors: %d\n",
-			 qtyDesktopAdded, qtyHandheldAdded, qtyHandheldReplaced,
+			 qtyDesktopAdded, qtyDesktopReplaced, qtyHandheldAdded,
+			 qtyHandheldReplaced,
 			 qtyHandheldDeleted, qtyErrors);
 	palm_log(palmfd, message);
-	if(org_notes_close(orgNoteFd))
+	if(org_notes_close(orgWriter))
 	{
-		log_write(LOG_ERR, "Failed to close org-file %s opened for writing",
-				  orgPath);
+		log_write(LOG_ERR, "Failed to write notes to org-file %s", orgPath);
+		memos_free(memos);
+		memos_close(memosFd);
 		return -1;
 	}
 	if(!dryRun)
 	{
-		if(pdb_memos_write(pdbPath, pdb))
+		if(memos_write(memosFd, memos))
 		{
 			log_write(LOG_ERR, "Failed to write redacted PDB with memos to "
 					  "file: %s", pdbPath);
+			memos_free(memos);
+			memos_close(memosFd);
 			return -1;
 		}
 	}
+	memos_free(memos);
+	memos_close(memosFd);
 	return 0;
 }
 
 /**
-   Compute status of each record in PDB structure.
+   Compute status of each memo record.
 
-   @param[in] pdb
-   @param[in] prevPdbPath
+   @param[in] syncMemos Memos from handheld.
+   @param[in] qty Qty of memos.
+   @param[in] prevPdbPath Path to PDB file from previous synchronization.
    @return Zero on success or non-zero value on error.
 */
-int _compute_record_statuses(PDB * pdb, char * prevPdbPath)
+static int _compute_record_statuses(struct __SyncMemo * syncMemos, size_t qty,
+									char * prevPdbPath)
 {
 	int prevFd;
-	PDB * prevPdb;
-	PDBRecord * record;
-	if((prevFd = pdb_read(prevPdbPath, 1, &prevPdb)) == -1)
+	PDB * prevPdb = NULL;
+	if((prevFd = pdb_open(prevPdbPath)) == -1 ||
+	   (prevPdb = pdb_read(prevFd, true)) == NULL)
 	{
 		log_write(LOG_WARNING, "Cannot open %s file as PDB from previous "
 				  "synchronization", prevPdbPath);
 		log_write(LOG_NOTICE, "Set all records statuses to ADDED");
-		TAILQ_FOREACH(record, &pdb->records, pointers)
+		for(size_t i = 0; i < qty; i++)
+		{
+			syncMemos[i].status = RECORD_ADDED;
+			log_write(LOG_DEBUG, "Record %d: %d", syncMemos[i].id,
+					  syncMemos[i].status);
+		}
+		if(prevFd != -1)
 		{
-			record->status = RECORD_ADDED;
-			log_write(LOG_DEBUG, "Record %02x%02x%02x: %d", record->id[2],
-					  record->id[1], record->id[0], record->status);
+			pdb_close(prevFd);
 		}
 		return 0;
 	}
 
-	TAILQ_FOREACH(record, &pdb->records, pointers)
+	PDBRecord * prevRecord;
+	unsigned int statusesQty[RECORD_DELETED + 1] = {0};
+	for(size_t i = 0; i < qty; i++)
 	{
+		PDBRecord * record = syncMemos[i].memo->_record;
 		const uint8_t attribute = record->attributes & 0xf0;
-		if(attribute & PDB_RECORD_ATTR_SECRET ||
-		   attribute & PDB_RECORD_ATTR_LOCKED)
+		prevRecord = pdb_record_get(prevPdb, pdb_record_get_unique_id(record));
+
+		syncMemos[i].status = _compute_record_status(
+			attribute, prevRecord != NULL ? prevRecord->attributes & 0xf0 : 0,
+			prevRecord != NULL);
+		statusesQty[syncMemos[i].status]++;
+		log_write(LOG_DEBUG, "Record %02x%02x%02x: %d", record->id[2],
+				  record->id[1], record->id[0], syncMemos[i].status);
+	}
+	log_write(LOG_DEBUG, "Record statuses: no record: %d, added: %d, not "
+			  "changed: %d, changed: %d, deleted: %d",
+			  statusesQty[RECORD_NO_RECORD], statusesQty[RECORD_ADDED],
+			  statusesQty[RECORD_NOT_CHANGED], statusesQty[RECORD_CHANGED],
+			  statusesQty[RECORD_DELETED]);
+
+	pdb_free(prevPdb);
+	pdb_close(prevFd);
+	return 0;
+}
+
+/**
+   Compute status of record from handheld.
+
+   @param[in] attribute Attributes of record from handheld (upper four bits).
+   @param[in] prevAttribute Attributes of the same record from previous
+   synchronization (upper four bits).
+   @param[in] prevExists True if record exists in PDB from previous
+   synchronization.
+   @return Status of record.
+*/
+static enum RecordStatus _compute_record_status(uint8_t attribute,
+												uint8_t prevAttribute,
+												bool prevExists)
+{
+	if(attribute & PDB_RECORD_ATTR_SECRET ||
+	   attribute & PDB_RECORD_ATTR_LOCKED)
+	{
+		return RECORD_NO_RECORD;
+	}
+	if(!prevExists)
+	{
+		return (attribute & PDB_RECORD_ATTR_DELETED) ?
+			RECORD_NO_RECORD :
+			RECORD_ADDED;
+	}
+
+	switch(prevAttribute)
+	{
+	case PDB_RECORD_ATTR_DELETED:
+		switch(attribute)
 		{
-			record->status = RECORD_NO_RECORD;
-			continue;
+		case PDB_RECORD_ATTR_DELETED:
+			return RECORD_DELETED;
+		case PDB_RECORD_ATTR_DIRTY:
+			return RECORD_ADDED;
+		default:
+			return RECORD_ADDED;
 		}
-
-		PDBRecord * prevRecord;
-		char matchedPrevRecordFound = 0;
-		TAILQ_FOREACH(prevRecord, &prevPdb->records, pointers)
+	case PDB_RECORD_ATTR_DIRTY:
+		switch(attribute)
 		{
-			if(record->id[0] != prevRecord->id[0] ||
-			   record->id[1] != prevRecord->id[1] ||
-			   record->id[2] != prevRecord->id[2])
-			{
-				continue;
-			}
-			matchedPrevRecordFound = 1;
-			const uint8_t prevAttribute = prevRecord->attributes & 0x0f;
-			switch(prevAttribute)
-			{
-			case PDB_RECORD_ATTR_DELETED:
-				switch(attribute)
-				{
-				case PDB_RECORD_ATTR_DELETED:
-					record->status = RECORD_DELETED;
-					break;
-				case PDB_RECORD_ATTR_DIRTY:
-					record->status = RECORD_ADDED;
-					break;
-				default:
-					record->status = RECORD_ADDED;
-				}
-				break;
-			case PDB_RECORD_ATTR_DIRTY:
-				switch(attribute)
-				{
-				case PDB_RECORD_ATTR_DELETED:
-					record->status = RECORD_DELETED;
-					break;
-				case PDB_RECORD_ATTR_DIRTY:
-					record->status = RECORD_CHANGED;
-					break;
-				default:
-					record->status = RECORD_NOT_CHANGED;
-				}
-				break;
-			default: /* Record just exists */
-				switch(attribute)
-				{
-				case PDB_RECORD_ATTR_DELETED:
-					record->status = RECORD_DELETED;
-					break;
-				case PDB_RECORD_ATTR_DIRTY:
-					record->status = RECORD_CHANGED;
-					break;
-				default:
-					record->status = RECORD_NOT_CHANGED;
-				}
-			}
+		case PDB_RECORD_ATTR_DELETED:
+			return RECORD_DELETED;
+		case PDB_RECORD_ATTR_DIRTY:
+			return RECORD_CHANGED;
+		default:
+			return RECORD_NOT_CHANGED;
 		}
-
-		if(!matchedPrevRecordFound)
+	default: /* Record just exists */
+		switch(attribute)
 		{
-			record->status = (attribute & PDB_RECORD_ATTR_DELETED) ?
-				RECORD_NO_RECORD :
-				RECORD_ADDED;
+		case PDB_RECORD_ATTR_DELETED:
+			return RECORD_DELETED;
+		case PDB_RECORD_ATTR_DIRTY:
+			return RECORD_CHANGED;
+		default:
+			return RECORD_NOT_CHANGED;
 		}
-
-		log_write(LOG_DEBUG, "Record %02x%02x%02x: %d", record->id[2],
-				  record->id[1], record->id[0], record->status);
-	} /* TAILQ_FOREACH(record, &pdb->records, pointers) */
-
-	pdb_free(prevFd, prevPdb);
-	return 0;
+	}
 }
 
 /**
@@ -431,3 +903,100 @@ static SyncAction _compute_action_for_record(enum RecordStatus recordStatus,
 		return ACTION_ERROR;
 	}
 }
+
+/**
+   Build hash index of notes by header hash.
+
+   @param[in] notes Notes from org-file.
+   @param[out] qty Qty of notes.
+   @param[out] index Hash index to initialize. Elements of index are
+   pointers to elements of returned array.
+   @param[in] arena Arena to allocate array from.
+   @return Array of notes with synchronization state or NULL on error.
+*/
+static struct __SyncNote * _index_notes(OrgNotes * notes, size_t * qty,
+										HashIndex * index, Arena * arena)
+{
+	OrgNote * note;
+	*qty = 0;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		(*qty)++;
+	}
+
+	struct __SyncNote * syncNotes;
+	if((syncNotes = arena_alloc(arena, (*qty + 1) *
+								sizeof(struct __SyncNote))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for notes to sync");
+		return NULL;
+	}
+	if(hash_index_init(index, *qty))
+	{
+		return NULL;
+	}
+
+	size_t i = 0;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		syncNotes[i].note = note;
+		syncNotes[i].position = i;
+		syncNotes[i].matched = false;
+		if(hash_index_insert(index, note->header_hash, &syncNotes[i]))
+		{
+			hash_index_free(index);
+			return NULL;
+		}
+		i++;
+	}
+	return syncNotes;
+}
+
+/**
+   Find note from org-file for given memo and mark it as matched.
+
+   If there are several notes with the same header — the first unmatched
+   note from org-file is used. So duplicated headers are matched
+   one-to-one in the order of org-file.
+
+   @param[in] index Hash index of notes.
+   @param[in] syncMemo Memo from handheld.
+   @return Matched note or NULL if there are no unmatched notes with the
+   same header.
+*/
+static struct __SyncNote * _match_note(HashIndex * index,
+									   struct __SyncMemo * syncMemo)
+{
+	struct __SyncNote * found = NULL;
+	struct __SyncNote * syncNote;
+	unsigned int duplicates = 0;
+	size_t cursor = 0;
+	while((syncNote = hash_index_find(index, syncMemo->headerHash,
+									  &cursor)) != NULL)
+	{
+		if(strcmp(syncNote->note->header, syncMemo->headerCp1251) != 0)
+		{
+			continue;
+		}
+		duplicates++;
+		if(!syncNote->matched &&
+		   (found == NULL || syncNote->position < found->position))
+		{
+			found = syncNote;
+		}
+	}
+
+	if(duplicates > 1)
+	{
+		log_write(LOG_WARNING, "Found %d notes with header \"%s\" in org-file. "
+				  "Memo with ID = %d is matched with %s", duplicates,
+				  syncMemo->memo->header, syncMemo->id,
+				  found != NULL ? "the first unmatched of them" :
+				  "none of them");
+	}
+	if(found != NULL)
+	{
+		found->matched = true;
+	}
+	return found;
+}
@@ -0,0 +1,68 @@
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+#include "log.h"
+
+
+static void arena_test();
+
+
+int main(int argc, char * argv[])
+{
+	log_init(1, 0);
+	arena_test();
+	log_close();
+	return 0;
+}
+
+static void arena_test()
+{
+	Arena arena = {0};
+
+	/* Objects should be aligned like objects from malloc() */
+	char * first = arena_alloc(&arena, 3);
+	char * second = arena_alloc(&arena, 5);
+	log_write(LOG_INFO, "Objects are aligned: %s",
+			  (uintptr_t)first % alignof(max_align_t) == 0 &&
+			  (uintptr_t)second % alignof(max_align_t) == 0 ? "yes" : "no");
+
+	char * string = arena_strdup(&arena, "Test string");
+	log_write(LOG_INFO, "Copied string: %s", string);
+
+	/* Enough objects to allocate several chunks */
+	int zeroed = 1;
+	for(int i = 0; i < 1000; i++)
+	{
+		uint8_t * object = arena_alloc(&arena, 1000);
+		for(int j = 0; j < 1000; j++)
+		{
+			zeroed &= object[j] == 0;
+		}
+		memset(object, 0xff, 1000);
+	}
+	log_write(LOG_INFO, "Objects are zeroed: %s", zeroed ? "yes" : "no");
+	log_write(LOG_INFO, "String after allocations: %s", string);
+
+	/* Large object does not fit into default chunk */
+	uint8_t * large = arena_alloc(&arena, 1024 * 1024);
+	log_write(LOG_INFO, "Large object allocated: %s",
+			  large != NULL ? "yes" : "no");
+
+	/* Memory is reused after reset without new chunks */
+	arena_reset(&arena);
+	log_write(LOG_INFO, "Allocated after reset: %lu", arena.allocated);
+	struct __ArenaChunk * chunk = arena._chunks;
+	for(int i = 0; i < 1000; i++)
+	{
+		arena_alloc(&arena, 1000);
+	}
+	arena_alloc(&arena, 1024 * 1024);
+	log_write(LOG_INFO, "Chunk is reused: %s", arena._chunks == chunk &&
+			  chunk->next == NULL ? "yes" : "no");
+	log_write(LOG_INFO, "Object after reset is zeroed: %s",
+			  ((uint8_t *)arena_alloc(&arena, 1))[0] == 0 ? "yes" : "no");
+
+	arena_free(&arena);
+	log_write(LOG_INFO, "Allocated after free: %lu", arena.allocated);
+}
@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+
+EXPECTED_RESULT=("[INFO]: Objects are aligned: yes")
+EXPECTED_RESULT+=("[INFO]: Copied string: Test string")
+EXPECTED_RESULT+=("[INFO]: Objects are zeroed: yes")
+EXPECTED_RESULT+=("[INFO]: String after allocations: Test string")
+EXPECTED_RESULT+=("[INFO]: Large object allocated: yes")
+EXPECTED_RESULT+=("[INFO]: Allocated after reset: 0")
+EXPECTED_RESULT+=("[INFO]: Chunk is reused: yes")
+EXPECTED_RESULT+=("[INFO]: Object after reset is zeroed: yes")
+EXPECTED_RESULT+=("[INFO]: Allocated after free: 0")
+
+mapfile -t ACTUAL_RESULT < <(./arena_test 2>&1)
+
+for index in $(seq 0 8); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1
+    fi
+done
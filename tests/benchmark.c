@@ -0,0 +1,73 @@
+#include <endian.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "log.h"
+#include "pdb/pdb.h"
+
+
+int benchmark_generate_memos_pdb(int fd, unsigned int qty)
+{
+	const size_t headerSize = 78;
+	const size_t appInfoOffset = headerSize + qty * PDB_RECORD_ITEM_SIZE + 2;
+	const size_t memosOffset = appInfoOffset + PDB_CATEGORIES_SIZE + 6;
+
+	/* Memos are "Memo #N\n" + text with some lines */
+	const char * text = "Lorem ipsum dolor sit amet, consectetur adipiscing "
+		"elit.\nSed do eiusmod tempor incididunt ut labore et dolore magna "
+		"aliqua.\nUt enim ad minim veniam, quis nostrud exercitation.";
+	size_t memoMaxSize = strlen("Memo #") + 10 + 1 + strlen(text) + 1;
+
+	size_t size = memosOffset + qty * memoMaxSize;
+	uint8_t * buffer;
+	if((buffer = calloc(size, sizeof(uint8_t))) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot allocate memory for PDB: %s",
+				  strerror(errno));
+		return -1;
+	}
+
+	uint16_t value16;
+	uint32_t value32;
+	strcpy((char *)buffer, "MemoDB");
+	value32 = htobe32(appInfoOffset);
+	memcpy(buffer + 52, &value32, 4);
+	memcpy(buffer + 60, "DATAmemo", 8);
+	value16 = htobe16(qty);
+	memcpy(buffer + 76, &value16, 2);
+
+	strcpy((char *)buffer + appInfoOffset + 2, PDB_DEFAULT_CATEGORY);
+
+	size_t offset = memosOffset;
+	for(unsigned int i = 0; i < qty; i++)
+	{
+		uint8_t * item = buffer + headerSize + i * PDB_RECORD_ITEM_SIZE;
+		value32 = htobe32(offset);
+		memcpy(item, &value32, 4);
+		item[5] = (uint8_t)((i + 1) >> 16);
+		item[6] = (uint8_t)((i + 1) >> 8);
+		item[7] = (uint8_t)(i + 1);
+
+		offset += sprintf((char *)buffer + offset, "Memo #%u\n%s", i, text) + 1;
+	}
+
+	int result = 0;
+	if(write(fd, buffer, offset) != (ssize_t)offset)
+	{
+		log_write(LOG_ERR, "Cannot write generated PDB: %s", strerror(errno));
+		result = -1;
+	}
+	free(buffer);
+	return result;
+}
+
+double benchmark_elapsed_ms(struct timespec * start, struct timespec * end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
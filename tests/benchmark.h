@@ -0,0 +1,31 @@
+/**
+   @author Eugene Andrienko
+   @brief Common functions for benchmarks
+   @file benchmark.h
+*/
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <time.h>
+
+
+/**
+   Write generated Memos PDB file with given count of memos.
+
+   @param[in] fd File descriptor of empty file.
+   @param[in] qty Count of memos.
+   @return 0 on success or -1 on error.
+*/
+int benchmark_generate_memos_pdb(int fd, unsigned int qty);
+
+/**
+   Returns milliseconds between two timestamps.
+
+   @param[in] start Start timestamp.
+   @param[in] end End timestamp.
+   @return Milliseconds between timestamps.
+*/
+double benchmark_elapsed_ms(struct timespec * start, struct timespec * end);
+
+#endif
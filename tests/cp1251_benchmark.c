@@ -0,0 +1,156 @@
+#include <errno.h>
+#include <iconv.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "benchmark.h"
+#include "cp1251.h"
+#include "log.h"
+
+/**
+   Count of strings in one iteration.
+*/
+#define STRINGS_QTY 10000
+/**
+   How many times each convertor will convert all strings.
+*/
+#define ITERATIONS 10
+
+#if defined (__FreeBSD__)
+#define UTF8 "UTF-8"
+#else
+#define UTF8 "UTF8"
+#endif
+#define CP1251 "CP1251"
+
+
+/**
+   Convert string with new iconv descriptor, as it was done in helper.c.
+
+   @param[in] string String to convert.
+   @param[in] to Target encoding.
+   @param[in] from Source encoding.
+   @return Converted string or NULL on error.
+*/
+static char * _iconv_convert(const char * string, const char * to,
+							 const char * from)
+{
+	iconv_t iconvfd;
+	if((iconvfd = iconv_open(to, from)) == (iconv_t)-1)
+	{
+		log_write(LOG_ERR, "Cannot initialize convertor: %s", strerror(errno));
+		return NULL;
+	}
+
+	char * inString = (char *)string;
+	size_t inStringLen = strlen(string);
+	size_t outStringLen = inStringLen * 2;
+	char * outString;
+	if((outString = calloc(outStringLen, sizeof(char))) == NULL)
+	{
+		iconv_close(iconvfd);
+		return NULL;
+	}
+	char * result = outString;
+	if(iconv(iconvfd, &inString, &inStringLen, &outString, &outStringLen) ==
+	   (size_t)-1)
+	{
+		free(result);
+		result = NULL;
+	}
+	iconv_close(iconvfd);
+	return result;
+}
+
+/**
+   Convert string with lookup tables and buffer of exact size.
+
+   @param[in] string String to convert.
+   @param[in] toCp1251 Convert from UTF8 to CP1251 if true, otherwise
+   from CP1251 to UTF8.
+   @return Converted string or NULL on error.
+*/
+static char * _table_convert(const char * string, bool toCp1251)
+{
+	size_t length = strlen(string);
+	size_t outLength = toCp1251 ? utf8_to_cp1251_length(string, length) :
+		cp1251_to_utf8_length(string, length);
+	char * result;
+	if(outLength == CP1251_ERROR || (result = malloc(outLength + 1)) == NULL)
+	{
+		return NULL;
+	}
+	if(toCp1251)
+	{
+		utf8_to_cp1251(string, length, result, outLength + 1);
+	}
+	else
+	{
+		cp1251_to_utf8(string, length, result, outLength + 1);
+	}
+	return result;
+}
+
+int main(int argc, char * argv[])
+{
+	log_init(1, 0);
+
+	/* Mixed ASCII and Cyrillic strings, similar to memos and tasks */
+	const char * samples[] = {
+		"Buy milk and bread",
+		"Купить молоко и хлеб",
+		"TODO: позвонить Ивану про meeting в 10:00",
+		"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+		"eiusmod tempor incididunt ut labore et dolore magna aliqua."
+	};
+	const size_t samplesQty = sizeof(samples) / sizeof(samples[0]);
+	char * samplesCp1251[samplesQty];
+	for(size_t i = 0; i < samplesQty; i++)
+	{
+		if((samplesCp1251[i] = _table_convert(samples[i], true)) == NULL)
+		{
+			log_write(LOG_ERR, "Cannot convert sample string");
+			return 1;
+		}
+	}
+
+	struct timespec start, end;
+	double iconvMs = 0;
+	double tableMs = 0;
+	for(int i = 0; i < ITERATIONS; i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(int j = 0; j < STRINGS_QTY; j++)
+		{
+			free(_iconv_convert(samples[j % samplesQty], CP1251, UTF8));
+			free(_iconv_convert(samplesCp1251[j % samplesQty], UTF8, CP1251));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		iconvMs += benchmark_elapsed_ms(&start, &end);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(int j = 0; j < STRINGS_QTY; j++)
+		{
+			free(_table_convert(samples[j % samplesQty], true));
+			free(_table_convert(samplesCp1251[j % samplesQty], false));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		tableMs += benchmark_elapsed_ms(&start, &end);
+	}
+
+	log_write(LOG_INFO, "Strings: %d (both directions), iterations: %d",
+			  STRINGS_QTY, ITERATIONS);
+	log_write(LOG_INFO, "iconv: %.3f ms per iteration", iconvMs / ITERATIONS);
+	log_write(LOG_INFO, "Lookup tables: %.3f ms per iteration",
+			  tableMs / ITERATIONS);
+
+	for(size_t i = 0; i < samplesQty; i++)
+	{
+		free(samplesCp1251[i]);
+	}
+	log_close();
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cp1251.h"
+#include "log.h"
+
+
+static void cp1251_round_trip_test();
+static void cp1251_utf8_test();
+static void cp1251_errors_test();
+
+
+int main(int argc, char * argv[])
+{
+	log_init(1, 0);
+	cp1251_round_trip_test();
+	cp1251_utf8_test();
+	cp1251_errors_test();
+	log_close();
+	return 0;
+}
+
+static void cp1251_round_trip_test()
+{
+	/* All defined CP1251 characters, except NULL */
+	char cp1251[255];
+	size_t length = 0;
+	for(int i = 1; i < 256; i++)
+	{
+		if(i != 0x98)
+		{
+			cp1251[length++] = (char)i;
+		}
+	}
+
+	char utf8[1024];
+	size_t utf8Length = cp1251_to_utf8(cp1251, length, utf8, sizeof(utf8));
+	log_write(LOG_INFO, "CP1251 to UTF8: %lu -> %lu bytes, expected %lu",
+			  length, utf8Length, cp1251_to_utf8_length(cp1251, length));
+
+	char result[256];
+	size_t resultLength = utf8_to_cp1251(utf8, utf8Length, result,
+										 sizeof(result));
+	log_write(LOG_INFO, "Round trip: %s",
+			  resultLength == length && memcmp(result, cp1251, length) == 0 ?
+			  "equal" : "different");
+}
+
+static void cp1251_utf8_test()
+{
+	const char * utf8 = "Съешь же ещё этих мягких французских булок — "
+		"да выпей №1 чаю…";
+	char cp1251[128];
+	size_t length = utf8_to_cp1251(utf8, strlen(utf8), cp1251, sizeof(cp1251));
+	log_write(LOG_INFO, "UTF8 to CP1251: %lu -> %lu bytes, expected %lu",
+			  strlen(utf8), length, utf8_to_cp1251_length(utf8, strlen(utf8)));
+	log_write(LOG_INFO, "CP1251 bytes: %02x %02x %02x",
+			  (unsigned char)cp1251[0], (unsigned char)cp1251[13],
+			  (unsigned char)cp1251[length - 1]);
+}
+
+static void cp1251_errors_test()
+{
+	char buffer[16];
+	log_write(LOG_INFO, "Undefined CP1251 character: %s",
+			  cp1251_to_utf8_length("\x98", 1) == CP1251_ERROR ?
+			  "error" : "converted");
+	log_write(LOG_INFO, "Unmappable UTF8 character: %s",
+			  utf8_to_cp1251_length("\xe2\x82\xbd", 3) == CP1251_ERROR ?
+			  "error" : "converted");
+	log_write(LOG_INFO, "Truncated UTF8 sequence: %s",
+			  utf8_to_cp1251_length("\xd0", 1) == CP1251_ERROR ?
+			  "error" : "converted");
+	log_write(LOG_INFO, "Overlong UTF8 sequence: %s",
+			  utf8_to_cp1251_length("\xc0\xaf", 2) == CP1251_ERROR ?
+			  "error" : "converted");
+	log_write(LOG_INFO, "Small buffer: %s",
+			  cp1251_to_utf8("\xc0\xc1\xc2\xc3\xc4\xc5\xc6\xc7", 8, buffer,
+							 sizeof(buffer)) == CP1251_ERROR ?
+			  "error" : "converted");
+}
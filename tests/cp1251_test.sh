@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+
+EXPECTED_RESULT=("[INFO]: CP1251 to UTF8: 254 -> 399 bytes, expected 399")
+EXPECTED_RESULT+=("[INFO]: Round trip: equal")
+EXPECTED_RESULT+=("[INFO]: UTF8 to CP1251: 113 -> 61 bytes, expected 61")
+EXPECTED_RESULT+=("[INFO]: CP1251 bytes: d1 fd 85")
+EXPECTED_RESULT+=("[INFO]: Undefined CP1251 character: error")
+EXPECTED_RESULT+=("[INFO]: Unmappable UTF8 character: error")
+EXPECTED_RESULT+=("[INFO]: Truncated UTF8 sequence: error")
+EXPECTED_RESULT+=("[INFO]: Overlong UTF8 sequence: error")
+EXPECTED_RESULT+=("[INFO]: Small buffer: error")
+
+mapfile -t ACTUAL_RESULT < <(./cp1251_test 2>&1)
+
+for index in $(seq 0 8); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1
+    fi
+done
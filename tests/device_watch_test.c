@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "device_watch.h"
+#include "log.h"
+
+
+static void device_watch_test(const char * directory);
+
+
+int main(int argc, char * argv[])
+{
+	if(argc != 2)
+	{
+		return 1;
+	}
+	log_init(1, 0);
+	device_watch_test(argv[1]);
+	log_close();
+	return 0;
+}
+
+static void device_watch_test(const char * directory)
+{
+	char device[256];
+	snprintf(device, sizeof(device), "%s/ttyUSB1", directory);
+
+	log_write(LOG_INFO, "Wait for absent device: %d",
+			  device_wait_appear(device, 1, -1));
+	log_write(LOG_INFO, "Wait for device, which is not a path: %d",
+			  device_wait_appear("usb:", 1, -1));
+
+	/* Write event from other process */
+	int eventFds[2];
+	if(pipe(eventFds))
+	{
+		return;
+	}
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		usleep(200000);
+		if(write(eventFds[1], "", 1) != 1)
+		{
+			_exit(1);
+		}
+		_exit(0);
+	}
+	log_write(LOG_INFO, "Wait for absent device with event: %d",
+			  device_wait_appear(device, 5, eventFds[0]));
+	waitpid(pid, NULL, 0);
+	close(eventFds[0]);
+	close(eventFds[1]);
+
+	/* Create device from other process */
+	pid = fork();
+	if(pid == 0)
+	{
+		usleep(200000);
+		close(open(device, O_CREAT | O_WRONLY, 0600));
+		_exit(0);
+	}
+	log_write(LOG_INFO, "Wait for device to appear: %d",
+			  device_wait_appear(device, 5, -1));
+	waitpid(pid, NULL, 0);
+	log_write(LOG_INFO, "Wait for existing device to appear: %d",
+			  device_wait_appear(device, 1, -1));
+
+	/* Remove device from other process */
+	pid = fork();
+	if(pid == 0)
+	{
+		usleep(200000);
+		unlink(device);
+		_exit(0);
+	}
+	log_write(LOG_INFO, "Wait for device to disappear: %d",
+			  device_wait_disappear(device, 5));
+	waitpid(pid, NULL, 0);
+	log_write(LOG_INFO, "Wait for absent device to disappear: %d",
+			  device_wait_disappear(device, 1));
+}
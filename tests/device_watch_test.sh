@@ -0,0 +1,28 @@
+#!/usr/bin/env bash
+
+TEST_DIR=$(mktemp -d /tmp/test.XXXXXX)
+function cleanup()
+{
+    rm -rf "$TEST_DIR"
+}
+trap cleanup EXIT
+
+EXPECTED_RESULT=("[INFO]: Wait for absent device: 1")
+EXPECTED_RESULT+=("[INFO]: Wait for device, which is not a path: -1")
+EXPECTED_RESULT+=("[INFO]: Wait for absent device with event: 1")
+EXPECTED_RESULT+=("[INFO]: Wait for device to appear: 0")
+EXPECTED_RESULT+=("[INFO]: Wait for existing device to appear: -1")
+EXPECTED_RESULT+=("[INFO]: Wait for device to disappear: 0")
+EXPECTED_RESULT+=("[INFO]: Wait for absent device to disappear: 0")
+
+mapfile -t ACTUAL_RESULT < <(./device_watch_test "$TEST_DIR" 2>&1)
+
+for index in $(seq 0 6); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1
+    fi
+done
@@ -0,0 +1,60 @@
+#include "hash_index.h"
+#include "log.h"
+
+
+static void hash_index_test();
+
+
+int main(int argc, char * argv[])
+{
+	log_init(1, 0);
+	hash_index_test();
+	log_close();
+	return 0;
+}
+
+static void hash_index_test()
+{
+	HashIndex index;
+	if(hash_index_init(&index, 0))
+	{
+		log_write(LOG_ERR, "Cannot initialize hash index");
+		return;
+	}
+
+	/* Enough elements to grow index several times */
+	static int values[1000];
+	for(int i = 0; i < 1000; i++)
+	{
+		values[i] = i;
+		hash_index_insert(&index, i % 500, &values[i]);
+	}
+	log_write(LOG_INFO, "Elements in index: %lu", index.count);
+
+	int found = 0;
+	int * value;
+	size_t cursor = 0;
+	while((value = hash_index_find(&index, 42, &cursor)) != NULL)
+	{
+		found += *value;
+	}
+	log_write(LOG_INFO, "Sum of elements with key 42: %d", found);
+
+	hash_index_remove(&index, 42, &values[42]);
+	found = 0;
+	cursor = 0;
+	while((value = hash_index_find(&index, 42, &cursor)) != NULL)
+	{
+		found += *value;
+	}
+	log_write(LOG_INFO, "Sum of elements with key 42 after removal: %d", found);
+
+	cursor = 0;
+	log_write(LOG_INFO, "Element with key 1000 %s",
+			  hash_index_find(&index, 1000, &cursor) == NULL ? "not found" :
+			  "found");
+	log_write(LOG_INFO, "Removal of absent element: %d",
+			  hash_index_remove(&index, 1000, &values[0]));
+
+	hash_index_free(&index);
+}
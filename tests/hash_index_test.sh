@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+
+EXPECTED_RESULT=("[INFO]: Elements in index: 1000")
+EXPECTED_RESULT+=("[INFO]: Sum of elements with key 42: 584")
+EXPECTED_RESULT+=("[INFO]: Sum of elements with key 42 after removal: 542")
+EXPECTED_RESULT+=("[INFO]: Element with key 1000 not found")
+EXPECTED_RESULT+=("[INFO]: Removal of absent element: -1")
+
+mapfile -t ACTUAL_RESULT < <(./hash_index_test 2>&1)
+
+for index in $(seq 0 4); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1
+    fi
+done
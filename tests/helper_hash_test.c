@@ -3,12 +3,16 @@
 
 
 static void hash_test();
+static void hash_batch_test();
+static void fingerprint_test();
 
 
 int main(int argc, char * argv[])
 {
 	log_init(1, 0);
 	hash_test();
+	hash_batch_test();
+	fingerprint_test();
 	log_close();
 	return 0;
 }
@@ -40,3 +44,51 @@ static void hash_test()
 		log_write(LOG_INFO, "Hashes of str1 and str3 are not equal");
 	}
 }
+
+static void hash_batch_test()
+{
+	HashString strings[] = {
+		{"Test string 1", 13},
+		{"Test string 2", 13},
+		{"", 0}
+	};
+	uint64_t hashes[3];
+	str_hash_batch(strings, 3, hashes);
+
+	if(hashes[0] == str_hash("Test string 1", 13) &&
+	   hashes[1] == str_hash("Test string 2", 13) &&
+	   hashes[2] == str_hash("", 0))
+	{
+		log_write(LOG_INFO, "Batch hashes are equal to single hashes");
+	}
+	else
+	{
+		log_write(LOG_INFO, "Batch hashes are not equal to single hashes");
+	}
+}
+
+static void fingerprint_test()
+{
+	struct umash_fp fp1 = str_fingerprint("Test string 1", 13);
+	struct umash_fp fp2 = str_fingerprint("Test string 2", 13);
+	struct umash_fp fp3 = str_fingerprint("Test string 1", 13);
+
+	if((fp1.hash[0] != fp2.hash[0] || fp1.hash[1] != fp2.hash[1]) &&
+	   fp1.hash[0] == fp3.hash[0] && fp1.hash[1] == fp3.hash[1])
+	{
+		log_write(LOG_INFO, "Fingerprints are correct");
+	}
+	else
+	{
+		log_write(LOG_INFO, "Fingerprints are incorrect");
+	}
+
+	if(fp1.hash[0] == str_hash("Test string 1", 13))
+	{
+		log_write(LOG_INFO, "Fingerprint starts with hash");
+	}
+	else
+	{
+		log_write(LOG_INFO, "Fingerprint does not start with hash");
+	}
+}
@@ -2,10 +2,13 @@
 
 EXPECTED_RESULT=("[INFO]: Hashes of str1 and str2 are not equal")
 EXPECTED_RESULT+=("[INFO]: Hashes of str1 and str3 are equal")
+EXPECTED_RESULT+=("[INFO]: Batch hashes are equal to single hashes")
+EXPECTED_RESULT+=("[INFO]: Fingerprints are correct")
+EXPECTED_RESULT+=("[INFO]: Fingerprint starts with hash")
 
 mapfile -t ACTUAL_RESULT < <(./helper_hash_test 2>&1)
 
-for index in $(seq 0 1); do
+for index in $(seq 0 4); do
     echo "${ACTUAL_RESULT[$index]}" | \
         sed -r 's/.+(\[.+)$/\1/g' | \
         grep -Fxq "${EXPECTED_RESULT[$index]}"
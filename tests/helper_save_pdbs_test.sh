@@ -21,6 +21,10 @@ fi
 if [ ! -f /tmp/previousTodo.pdb ]; then
     echo "/tmp/todo.pdb not saved as /tmp/previousTodo.pdb"
 fi
+if compgen -G "/tmp/previous*.pdb.??????" > /dev/null; then
+    echo "Temporary files are left after saving PDB files"
+    exit 1
+fi
 
 rm -rf /tmp/previousDatebook.pdb \
    /tmp/previousMemos.pdb \
@@ -0,0 +1,170 @@
+#include <endian.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "helper.h"
+#include "log.h"
+#include "pdb/memos.h"
+
+/**
+   Default count of memos in generated Memos database.
+*/
+#define MEMOS_QTY 4000
+/**
+   How many times each decoder will read the whole database.
+*/
+#define ITERATIONS 10
+
+
+/**
+   Read memo with previous decoder: scan for terminators by CHUNK_SIZE
+   bytes from file, then read header and text again with read_chunks().
+
+   @param[in] fd File descriptor.
+   @param[in] record PDBRecord, which points to memo.
+   @param[out] header Header of memo in UTF8.
+   @param[out] text Text of memo in UTF8.
+   @return 0 on success or -1 on error.
+*/
+static int _read_memo_chunked(int fd, PDBRecord * record, char ** header,
+							  char ** text)
+{
+	char buffer[CHUNK_SIZE];
+	ssize_t readedBytes = 0;
+
+	if(lseek(fd, record->offset, SEEK_SET) != record->offset)
+	{
+		return -1;
+	}
+	unsigned int headerSize = 0;
+	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
+	{
+		const char * headerEnd = memchr(buffer, '\n', readedBytes);
+		if(headerEnd != NULL)
+		{
+			headerSize += headerEnd - buffer;
+			lseek(fd, -(readedBytes - (headerEnd - buffer)) + 1, SEEK_CUR);
+			break;
+		}
+		headerSize += readedBytes;
+	}
+	unsigned int textSize = 0;
+	while((readedBytes = read(fd, buffer, CHUNK_SIZE)) > 0)
+	{
+		const char * textEnd = memchr(buffer, '\0', readedBytes);
+		if(textEnd != NULL)
+		{
+			textSize += textEnd - buffer;
+			lseek(fd, -(readedBytes - (textEnd - buffer)), SEEK_CUR);
+			break;
+		}
+		textSize += readedBytes;
+	}
+	if(lseek(fd, record->offset, SEEK_SET) != record->offset)
+	{
+		return -1;
+	}
+
+	char * headerCp1251 = calloc(headerSize + 1, sizeof(char));
+	char * textCp1251 = calloc(textSize + 1, sizeof(char));
+	if(headerCp1251 == NULL || textCp1251 == NULL ||
+	   read_chunks(fd, headerCp1251, headerSize) ||
+	   lseek(fd, 1, SEEK_CUR) == (off_t)-1 ||
+	   read_chunks(fd, textCp1251, textSize))
+	{
+		free(headerCp1251);
+		free(textCp1251);
+		return -1;
+	}
+	*header = iconv_cp1251_to_utf8(headerCp1251);
+	*text = iconv_cp1251_to_utf8(textCp1251);
+	free(headerCp1251);
+	free(textCp1251);
+	return *header == NULL || *text == NULL ? -1 : 0;
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int qty = argc == 2 ? strtoul(argv[1], NULL, 10) : MEMOS_QTY;
+	log_init(1, 0);
+
+	char path[] = "/tmp/memos_benchmark.XXXXXX";
+	int fd;
+	if((fd = mkstemp(path)) == -1)
+	{
+		log_write(LOG_ERR, "Cannot create temporary file: %s", strerror(errno));
+		return 1;
+	}
+	if(benchmark_generate_memos_pdb(fd, qty))
+	{
+		unlink(path);
+		return 1;
+	}
+
+	struct timespec start, end;
+	double chunkedMs = 0;
+	double mappedMs = 0;
+	Arena arena = {0};
+	for(int i = 0; i < ITERATIONS; i++)
+	{
+		/* Previous decoder */
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		PDB * pdb;
+		if((pdb = pdb_read(fd, true)) == NULL)
+		{
+			log_write(LOG_ERR, "Failed to read generated PDB");
+			unlink(path);
+			return 1;
+		}
+		PDBRecord * record;
+		PDB_RECORD_FOREACH(record, pdb)
+		{
+			char * header = NULL;
+			char * text = NULL;
+			if(_read_memo_chunked(fd, record, &header, &text))
+			{
+				log_write(LOG_ERR, "Failed to read memo at 0x%08x offset",
+						  record->offset);
+				unlink(path);
+				return 1;
+			}
+			free(header);
+			free(text);
+		}
+		pdb_free(pdb);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		chunkedMs += benchmark_elapsed_ms(&start, &end);
+
+		/* Current decoder */
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		Memos * memos;
+		if((memos = memos_read(fd, &arena)) == NULL)
+		{
+			log_write(LOG_ERR, "Failed to read memos from generated PDB");
+			unlink(path);
+			return 1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		mappedMs += benchmark_elapsed_ms(&start, &end);
+		memos_free(memos);
+		arena_reset(&arena);
+	}
+	arena_free(&arena);
+
+	log_write(LOG_INFO, "Memos: %u, iterations: %d", qty, ITERATIONS);
+	log_write(LOG_INFO, "Chunked decoder: %.3f ms per database",
+			  chunkedMs / ITERATIONS);
+	log_write(LOG_INFO, "In-memory decoder: %.3f ms per database",
+			  mappedMs / ITERATIONS);
+
+	close(fd);
+	unlink(path);
+	log_close();
+	return 0;
+}
@@ -10,12 +10,13 @@ int main(int argc, char * argv[])
 	log_init(1, 0);
 
 	Memos * memos;
+	Arena arena = {0};
 	int fd;
 	if((fd = memos_open(argv[1])) == -1)
 	{
 		return 1;
 	}
-	if((memos = memos_read(fd)) == NULL)
+	if((memos = memos_read(fd, &arena)) == NULL)
 	{
 		return 1;
 	}
@@ -50,12 +51,13 @@ int main(int argc, char * argv[])
 	}
 	memos_close(fd);
 	memos_free(memos);
+	arena_reset(&arena);
 
 	if((fd = memos_open(argv[1])) == -1)
 	{
 		return 1;
 	}
-	if((memos = memos_read(fd)) == NULL)
+	if((memos = memos_read(fd, &arena)) == NULL)
 	{
 		return 1;
 	}
@@ -69,6 +71,7 @@ int main(int argc, char * argv[])
 
 	memos_close(fd);
 	memos_free(memos);
+	arena_free(&arena);
 	log_close();
 	return 0;
 }
@@ -11,13 +11,14 @@ int main(int argc, char * argv[])
 
 	/* Read and write PDB Memos file */
 	Memos * memos;
+	Arena arena = {0};
 	int fd;
 	if((fd = memos_open(argv[1])) == -1)
 	{
 		log_write(LOG_ERR, "Failed to open file: %s", argv[1]);
 		return 1;
 	}
-	if((memos = memos_read(fd)) == NULL)
+	if((memos = memos_read(fd, &arena)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read memos");
 		return 1;
@@ -29,6 +30,7 @@ int main(int argc, char * argv[])
 	}
 	memos_close(fd);
 	memos_free(memos);
+	arena_reset(&arena);
 
 	/* Check the result */
 	if((fd = memos_open(argv[1])) == -1)
@@ -36,7 +38,7 @@ int main(int argc, char * argv[])
 		log_write(LOG_ERR, "Failed to open file2: %s", argv[1]);
 		return 1;
 	}
-	if((memos = memos_read(fd)) == NULL)
+	if((memos = memos_read(fd, &arena)) == NULL)
 	{
 		log_write(LOG_ERR, "Failed to read memos2");
 		return 1;
@@ -52,6 +54,7 @@ int main(int argc, char * argv[])
 
 	memos_close(fd);
 	memos_free(memos);
+	arena_free(&arena);
 	log_close();
 	return 0;
 }
@@ -0,0 +1,190 @@
+#include <endian.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "helper.h"
+#include "log.h"
+#include "pdb/memos.h"
+
+/**
+   Default count of memos in generated Memos database.
+*/
+#define MEMOS_QTY 5000
+/**
+   How many times each writer will write the whole database.
+*/
+#define ITERATIONS 10
+
+
+/**
+   Write 16-bit value with separate write() call, as previous writer did.
+*/
+static int _write16(int fd, uint16_t value)
+{
+	value = htobe16(value);
+	return write(fd, &value, 2) != 2;
+}
+
+/**
+   Write 32-bit value with separate write() call, as previous writer did.
+*/
+static int _write32(int fd, uint32_t value)
+{
+	value = htobe32(value);
+	return write(fd, &value, 4) != 4;
+}
+
+/**
+   Write memos with previous writer: one write() per header field and
+   record list item field, memos are encoded to separate buffers and
+   written with write_chunks().
+
+   @param[in] fd File descriptor.
+   @param[in] memos Memos to write.
+   @return 0 on success or -1 on error.
+*/
+static int _write_memos_fieldwise(int fd, Memos * memos)
+{
+	PDB * pdb = memos->_pdb;
+	int result = 0;
+	result += lseek(fd, 0, SEEK_SET) != 0;
+	result += write(fd, pdb->dbname, PDB_DBNAME_LEN) != PDB_DBNAME_LEN;
+	result += _write16(fd, pdb->attributes);
+	result += _write16(fd, pdb->version);
+	result += _write32(fd, pdb->ctime);
+	result += _write32(fd, pdb->mtime);
+	result += _write32(fd, pdb->btime);
+	result += _write32(fd, pdb->modificationNumber);
+	result += _write32(fd, pdb->appInfoOffset);
+	result += _write32(fd, pdb->sortInfoOffset);
+	result += _write32(fd, pdb->databaseTypeID);
+	result += _write32(fd, pdb->creatorID);
+	result += _write32(fd, pdb->seed);
+	result += _write32(fd, pdb->nextRecordListOffset);
+	result += _write16(fd, pdb->recordsQty);
+
+	PDBRecord * record;
+	PDB_RECORD_FOREACH(record, pdb)
+	{
+		result += _write32(fd, record->offset);
+		result += write(fd, &record->attributes, 1) != 1;
+		for(int i = 0; i < 3; i++)
+		{
+			result += write(fd, &record->id[i], 1) != 1;
+		}
+	}
+	result += _write16(fd, pdb->recordListPadding);
+
+	PDBCategories * categories = pdb->categories;
+	result += lseek(fd, pdb->appInfoOffset, SEEK_SET) != pdb->appInfoOffset;
+	result += _write16(fd, categories->renamedCategories);
+	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
+	{
+		result += write(fd, categories->names[i], PDB_CATEGORY_LEN) !=
+			PDB_CATEGORY_LEN;
+	}
+	for(int i = 0; i < PDB_CATEGORIES_STD_QTY; i++)
+	{
+		result += write(fd, &categories->ids[i], 1) != 1;
+	}
+	result += write(fd, &categories->lastUniqueId, 1) != 1;
+	result += write(fd, &categories->padding, 1) != 1;
+	result += write(fd, "\0\0\0\0\0\0", 6) != 6;
+
+	Memo * memo;
+	TAILQ_FOREACH(memo, &memos->queue, pointers)
+	{
+		result += lseek(fd, memo->_record->offset, SEEK_SET) !=
+			memo->_record->offset;
+		char * header = iconv_utf8_to_cp1251(memo->header);
+		result += header == NULL ||
+			write_chunks(fd, header, memo->_header_cp1251_len);
+		free(header);
+		result += write(fd, "\n", 1) != 1;
+		if(memo->text != NULL)
+		{
+			char * text = iconv_utf8_to_cp1251(memo->text);
+			result += text == NULL ||
+				write_chunks(fd, text, memo->_text_cp1251_len);
+			free(text);
+		}
+		result += write(fd, "\0", 1) != 1;
+	}
+	return result ? -1 : 0;
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int qty = argc == 2 ? strtoul(argv[1], NULL, 10) : MEMOS_QTY;
+	log_init(1, 0);
+
+	char path[] = "/tmp/memos_write_benchmark.XXXXXX";
+	int fd;
+	if((fd = mkstemp(path)) == -1)
+	{
+		log_write(LOG_ERR, "Cannot create temporary file: %s", strerror(errno));
+		return 1;
+	}
+	if(benchmark_generate_memos_pdb(fd, qty))
+	{
+		unlink(path);
+		return 1;
+	}
+
+	struct timespec start, end;
+	double fieldwiseMs = 0;
+	double imageMs = 0;
+	Arena arena = {0};
+	for(int i = 0; i < ITERATIONS; i++)
+	{
+		Memos * memos;
+		if((memos = memos_read(fd, &arena)) == NULL)
+		{
+			log_write(LOG_ERR, "Failed to read memos from generated PDB");
+			unlink(path);
+			return 1;
+		}
+
+		/* Previous writer */
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if(_write_memos_fieldwise(fd, memos))
+		{
+			log_write(LOG_ERR, "Failed to write memos with previous writer");
+			unlink(path);
+			return 1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		fieldwiseMs += benchmark_elapsed_ms(&start, &end);
+
+		/* Current writer */
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if(memos_write(fd, memos))
+		{
+			log_write(LOG_ERR, "Failed to write memos");
+			unlink(path);
+			return 1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		imageMs += benchmark_elapsed_ms(&start, &end);
+		memos_free(memos);
+		arena_reset(&arena);
+	}
+	arena_free(&arena);
+
+	log_write(LOG_INFO, "Memos: %u, iterations: %d", qty, ITERATIONS);
+	log_write(LOG_INFO, "Field by field writer: %.3f ms per database",
+			  fieldwiseMs / ITERATIONS);
+	log_write(LOG_INFO, "One pass writer: %.3f ms per database",
+			  imageMs / ITERATIONS);
+
+	close(fd);
+	unlink(path);
+	log_close();
+	return 0;
+}
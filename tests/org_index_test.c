@@ -0,0 +1,43 @@
+#include <stddef.h>
+#include "log.h"
+#include "org_index.h"
+
+int main(int argc, char * argv[])
+{
+	if(argc != 3)
+	{
+		return 1;
+	}
+	log_init(1, 1);
+
+	OrgModeEntries * entries;
+	unsigned int errors;
+	if((entries = org_index_parse(argv[1], argv[2], &errors, NULL)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot parse %s file", argv[1]);
+		return 1;
+	}
+	log_write(LOG_INFO, "Errors: %u", errors);
+
+	OrgModeEntry * entry;
+	TAILQ_FOREACH(entry, entries, pointers)
+	{
+		log_write(LOG_INFO, "Header: %s", entry->header);
+		if(entry->tag != NULL)
+		{
+			log_write(LOG_INFO, "Tag: %s", entry->tag);
+		}
+		if(entry->text != NULL)
+		{
+			log_write(LOG_INFO, "Text: %s", entry->text);
+		}
+		if(entry->repeaterRange != NO_RANGE)
+		{
+			log_write(LOG_INFO, "Repeater value: %d", entry->repeaterValue);
+		}
+	}
+
+	free_orgmode_parser(entries);
+	log_close();
+	return 0;
+}
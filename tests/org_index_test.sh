@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+
+TEST_ORG=$(mktemp /tmp/test.XXXXXX)
+TEST_INDEX=$(mktemp -u /tmp/test.XXXXXX)
+function cleanup()
+{
+    rm -f "$TEST_ORG" "$TEST_INDEX"
+}
+trap cleanup EXIT
+tail -n 8 "$0" > "$TEST_ORG"
+
+# First parsing: there is no index
+EXPECTED_RESULT=("[DEBUG]: Cannot open index $TEST_INDEX: No such file or directory")
+EXPECTED_RESULT+=("[DEBUG]: Took 0 of 4 blocks of $TEST_ORG from index")
+EXPECTED_RESULT+=("[INFO]: Errors: 0")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Header with tag")
+EXPECTED_RESULT+=("[INFO]: Tag: testtag")
+EXPECTED_RESULT+=("[INFO]: Header: Header with text and date")
+EXPECTED_RESULT+=("[INFO]: Text: First text line")
+EXPECTED_RESULT+=("Last text line")
+EXPECTED_RESULT+=("[INFO]: Repeater value: 2")
+# Second parsing: file is not changed
+EXPECTED_RESULT+=("[DEBUG]: File $TEST_ORG is not changed, take all headlines from index")
+EXPECTED_RESULT+=("[INFO]: Errors: 0")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Header with tag")
+EXPECTED_RESULT+=("[INFO]: Tag: testtag")
+EXPECTED_RESULT+=("[INFO]: Header: Header with text and date")
+EXPECTED_RESULT+=("[INFO]: Text: First text line")
+EXPECTED_RESULT+=("Last text line")
+EXPECTED_RESULT+=("[INFO]: Repeater value: 2")
+# Third parsing: one headline is changed
+EXPECTED_RESULT+=("[DEBUG]: Took 3 of 4 blocks of $TEST_ORG from index")
+EXPECTED_RESULT+=("[INFO]: Errors: 0")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Changed header with tag")
+EXPECTED_RESULT+=("[INFO]: Tag: testtag")
+EXPECTED_RESULT+=("[INFO]: Header: Header with text and date")
+EXPECTED_RESULT+=("[INFO]: Text: First text line")
+EXPECTED_RESULT+=("Last text line")
+EXPECTED_RESULT+=("[INFO]: Repeater value: 2")
+
+mapfile -t ACTUAL_RESULT < <(./org_index_test "$TEST_ORG" "$TEST_INDEX" 2>&1
+    ./org_index_test "$TEST_ORG" "$TEST_INDEX" 2>&1
+    sed -i 's/^\* Header with tag/* Changed header with tag/' "$TEST_ORG"
+    ./org_index_test "$TEST_ORG" "$TEST_INDEX" 2>&1)
+
+for index in $(seq 0 27); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq -- "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1;
+    fi
+done
+rm -f "$TEST_ORG" "$TEST_INDEX"
+exit 0;
+#+COMMENT
+
+* Just a header
+* Header with tag                                                   :testtag:
+* Header with text and date
+SCHEDULED: <2024-01-30 Tue 10:00 +2d>
+First text line
+Last text line
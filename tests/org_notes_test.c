@@ -11,7 +11,8 @@ int main(int argc, char * argv[])
 	log_init(1, 1);
 
 	OrgNotes * notes;
-	if((notes = org_notes_parse(argv[1])) == NULL)
+	Arena arena = {0};
+	if((notes = org_notes_parse(argv[1], NULL, &arena, NULL)) == NULL)
 	{
 		log_write(LOG_ERR, "Cannot open %s file", argv[1]);
 		return 1;
@@ -31,7 +32,7 @@ int main(int argc, char * argv[])
 		}
 	}
 
-	org_notes_free(notes);
+	arena_free(&arena);
 	log_close();
 	return 0;
 }
@@ -32,6 +32,13 @@ for index in $(seq 0 11); do
         exit 1;
     fi
 done
+
+# Note, which cannot be converted to CP1251, should not be skipped
+printf '* Just a header\n* Header with \xc3\xbc\n' > "$TEST_ORG"
+if ./org_notes_test "$TEST_ORG" > /dev/null 2>&1; then
+    echo "Failed test! File with unconvertible note is parsed"
+    exit 1;
+fi
 rm -f "$TEST_ORG"
 exit 0;
 #+COMMENT
@@ -1,4 +1,7 @@
 #include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
 #include "log.h"
 #include "org_notes.h"
 
@@ -11,40 +14,79 @@ int main(int argc, char * argv[])
 	}
 	log_init(1, 0);
 
-	int fd;
-	if((fd = org_notes_open(argv[1])) == -1)
+	Arena arena = {0};
+	OrgNotes * notes;
+	struct stat fileStat;
+	if((notes = org_notes_parse(argv[1], NULL, &arena, &fileStat)) == NULL)
+	{
+		return 1;
+	}
+	OrgNotesWriter * writer;
+	if((writer = org_notes_open(argv[1], &fileStat, &arena)) == NULL)
 	{
 		return 1;
 	}
 
-	if(org_notes_write(fd, "Just a header TEST", NULL, NULL))
+	/* Note in the middle of file is replaced in place */
+	OrgNote * note;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		if(strcmp(note->header, "Header with text below") == 0 &&
+		   org_notes_replace(writer, note, "Replaced header TEST",
+							 "Replaced text", "tag3"))
+		{
+			return 1;
+		}
+	}
+
+	if(org_notes_write(writer, "Just a header TEST", NULL, NULL))
 	{
 		return 1;
 	}
-	if(org_notes_write(fd, "Just a header TEST2", NULL, "Unfiled"))
+	if(org_notes_write(writer, "Just a header TEST2", NULL, "Unfiled"))
 	{
 		return 1;
 	}
-	if(org_notes_write(fd, "Header with tag TEST", NULL, "tag"))
+	if(org_notes_write(writer, "Header with tag TEST", NULL, "tag"))
 	{
 		return 1;
 	}
-	if(org_notes_write(fd, "Header with text TEST", "Some test text\nSecond line", NULL))
+	if(org_notes_write(writer, "Header with text TEST",
+					   "Some test text\nSecond line", NULL))
 	{
 		return 1;
 	}
-	if(org_notes_write(fd, "Header with text and tag TEST",
+	if(org_notes_write(writer, "Header with text and tag TEST",
 					   "Some test text 2\nLast line", "tag2"))
 	{
 		return 1;
 	}
 
-	if(org_notes_close(fd))
+	if(org_notes_close(writer))
+	{
+		arena_free(&arena);
+		log_close();
+		return 1;
+	}
+
+	/* File, changed after parsing, should not be written */
+	FILE * file;
+	if(org_notes_parse(argv[1], NULL, &arena, &fileStat) == NULL ||
+	   (file = fopen(argv[1], "a")) == NULL ||
+	   fputs("* Header from editor TEST\n", file) == EOF || fclose(file))
+	{
+		return 1;
+	}
+	if((writer = org_notes_open(argv[1], &fileStat, &arena)) == NULL ||
+	   org_notes_write(writer, "Lost header TEST", NULL, NULL) ||
+	   !org_notes_close(writer))
 	{
+		arena_free(&arena);
 		log_close();
 		return 1;
 	}
 
+	arena_free(&arena);
 	log_close();
 	return 0;
 }
@@ -6,16 +6,16 @@ function cleanup()
     rm -f "$TEST_ORG"
 }
 trap cleanup EXIT
-tail -n 11 "$0" > "$TEST_ORG"
+tail -n 14 "$0" > "$TEST_ORG"
 
 EXPECTED_RESULT="#+COMMENT
 * Just a header
 * TODO Header with category                                         :testtag:
-* [#A] Header with text below
-First text line
-Second text line
+* Replaced header TEST		:tag3:
+Replaced text
 
-Last text line
+#+STARTUP: showall
+   
 * VERIFIED [#B] Header with category and with text below           :testtag2:
 First text line
 Last text line
@@ -27,7 +27,8 @@ Some test text
 Second line
 * Header with text and tag TEST		:tag2:
 Some test text 2
-Last line"
+Last line
+* Header from editor TEST"
 
 ./org_notes_write_test "$TEST_ORG"
 ACTUAL_RESULT=$(cat "$TEST_ORG")
@@ -51,6 +52,9 @@ First text line
 Second text line
 
 Last text line
+
+#+STARTUP: showall
+   
 * VERIFIED [#B] Header with category and with text below           :testtag2:
 First text line
 Last text line
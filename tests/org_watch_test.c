@@ -0,0 +1,91 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include "log.h"
+#include "org_watch.h"
+
+
+static void org_watch_test_notes(OrgWatch * watch);
+static int org_watch_test_write(const char * path, const char * mode,
+								const char * contents);
+
+
+int main(int argc, char * argv[])
+{
+	if(argc != 2)
+	{
+		return 1;
+	}
+	log_init(1, 1);
+
+	OrgWatch watch;
+	if(org_watch_init(&watch, argv[1], NULL))
+	{
+		log_write(LOG_ERR, "Cannot watch %s file", argv[1]);
+		return 1;
+	}
+	log_write(LOG_INFO, "Descriptor: %d", watch.fd != -1);
+
+	/* The second call should not parse file again */
+	org_watch_test_notes(&watch);
+	org_watch_test_notes(&watch);
+
+	/* Append note like daemon does */
+	if(org_watch_test_write(argv[1], "a", "* Appended header\n"))
+	{
+		return 1;
+	}
+	struct pollfd pfd = {.fd = watch.fd, .events = POLLIN};
+	log_write(LOG_INFO, "Descriptor is readable: %d", poll(&pfd, 1, 1000));
+	org_watch_test_notes(&watch);
+
+	/* Save file like editors do */
+	char tmpPath[256];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", argv[1]);
+	if(org_watch_test_write(tmpPath, "w", "* Renamed header\n") ||
+	   rename(tmpPath, argv[1]))
+	{
+		return 1;
+	}
+	org_watch_test_notes(&watch);
+
+	/* Broken file should not be parsed again until it is changed */
+	if(org_watch_test_write(argv[1], "w", "* Broken :tag: header\n"))
+	{
+		return 1;
+	}
+	org_watch_test_notes(&watch);
+	org_watch_test_notes(&watch);
+
+	org_watch_free(&watch);
+	log_close();
+	return 0;
+}
+
+static void org_watch_test_notes(OrgWatch * watch)
+{
+	OrgNotes * notes;
+	if((notes = org_watch_notes(watch, NULL)) == NULL)
+	{
+		log_write(LOG_INFO, "No notes");
+		return;
+	}
+	OrgNote * note;
+	TAILQ_FOREACH(note, notes, pointers)
+	{
+		log_write(LOG_INFO, "Header: %s", note->header);
+	}
+}
+
+static int org_watch_test_write(const char * path, const char * mode,
+								const char * contents)
+{
+	FILE * file;
+	if((file = fopen(path, mode)) == NULL)
+	{
+		log_write(LOG_ERR, "Cannot open %s file", path);
+		return -1;
+	}
+	fputs(contents, file);
+	return fclose(file);
+}
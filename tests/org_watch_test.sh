@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+
+TEST_ORG=$(mktemp /tmp/test.XXXXXX)
+function cleanup()
+{
+    rm -f "$TEST_ORG" "$TEST_ORG.tmp"
+}
+trap cleanup EXIT
+tail -n 3 "$0" > "$TEST_ORG"
+
+EXPECTED_RESULT=("[INFO]: Descriptor: 1")
+EXPECTED_RESULT+=("[DEBUG]: Parsed $TEST_ORG before synchronization")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Header with category")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Header with category")
+EXPECTED_RESULT+=("[INFO]: Descriptor is readable: 1")
+EXPECTED_RESULT+=("[DEBUG]: Parsed $TEST_ORG before synchronization")
+EXPECTED_RESULT+=("[INFO]: Header: Just a header")
+EXPECTED_RESULT+=("[INFO]: Header: Header with category")
+EXPECTED_RESULT+=("[INFO]: Header: Appended header")
+EXPECTED_RESULT+=("[DEBUG]: Parsed $TEST_ORG before synchronization")
+EXPECTED_RESULT+=("[INFO]: Header: Renamed header")
+EXPECTED_RESULT+=("[ERROR]: OrgMode parse error in $TEST_ORG: syntax error, unexpected T_WORD, expecting T_NEWLINE at line 1, symbols: \"header\"")
+EXPECTED_RESULT+=("[WARNING]: Skip broken OrgMode entry at line 1 of $TEST_ORG")
+EXPECTED_RESULT+=("[WARNING]: Skipped 1 broken entries in OrgMode file $TEST_ORG")
+EXPECTED_RESULT+=("[ERROR]: There are 1 broken notes in $TEST_ORG file, fix them to synchronize notes")
+EXPECTED_RESULT+=("[WARNING]: Cannot parse $TEST_ORG before synchronization, wait for its change")
+EXPECTED_RESULT+=("[INFO]: No notes")
+EXPECTED_RESULT+=("[INFO]: No notes")
+
+mapfile -t ACTUAL_RESULT < <(./org_watch_test "$TEST_ORG" 2>&1)
+
+for index in $(seq 0 19); do
+    echo "${ACTUAL_RESULT[$index]}" | \
+        sed -r 's/.+(\[.+)$/\1/g' | \
+        grep -Fxq -- "${EXPECTED_RESULT[$index]}"
+    if [ "$?" -ne "0" ]; then
+        echo "Failed test! Expected ${EXPECTED_RESULT[$index]}. But actual: ${ACTUAL_RESULT[$index]}"
+        exit 1;
+    fi
+done
+rm -f "$TEST_ORG"
+exit 0;
+#+COMMENT
+* Just a header
+* Header with category                                              :testtag:
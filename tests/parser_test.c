@@ -16,10 +16,12 @@ int main(int argc, char * argv[])
 	log_init(1, 0);
 
 	OrgModeEntries * parseResult;
-	if((parseResult = parse_orgmode_file(argv[1])) == NULL)
+	unsigned int errors;
+	if((parseResult = parse_orgmode_file(argv[1], &errors)) == NULL)
 	{
 		return 1;
 	}
+	log_write(LOG_INFO, "Errors: %u", errors);
 
 	OrgModeEntry * entry;
 	TAILQ_FOREACH(entry, parseResult, pointers)
@@ -6,9 +6,13 @@ function cleanup()
     rm -f "$TEST_ORG"
 }
 trap cleanup EXIT
-tail -n 39 "$0" > "$TEST_ORG"
+tail -n 47 "$0" > "$TEST_ORG"
 
-EXPECTED_RESULT=("[INFO]: ---")
+EXPECTED_RESULT=("[ERROR]: OrgMode parse error in $TEST_ORG: syntax error, unexpected T_WORD, expecting T_NEWLINE at line 10, symbols: \"with\"")
+EXPECTED_RESULT+=("[WARNING]: Skip broken OrgMode entry at line 10 of $TEST_ORG")
+EXPECTED_RESULT+=("[WARNING]: Skipped 1 broken entries in OrgMode file $TEST_ORG")
+EXPECTED_RESULT+=("[INFO]: Errors: 1")
+EXPECTED_RESULT+=("[INFO]: ---")
 EXPECTED_RESULT+=("[INFO]: Header: Just a header")
 EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
 EXPECTED_RESULT+=("[INFO]: Tag: (null)")
@@ -83,12 +87,24 @@ EXPECTED_RESULT+=("- tag")
 EXPECTED_RESULT+=("- priority")
 EXPECTED_RESULT+=("- text")
 EXPECTED_RESULT+=("[INFO]: ---")
+EXPECTED_RESULT+=("[INFO]: Header: Header with long line")
+EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
+EXPECTED_RESULT+=("[INFO]: Tag: (null)")
+EXPECTED_RESULT+=("[INFO]: Priority: no priority")
+EXPECTED_RESULT+=("[INFO]: Text: word00 word01 word02 word03 word04 word05 word06 word07 word08 word09 word10 word11 word12 word13 word14 word15 word16 word17 word18 word19 word20 word21 word22 word23 word24 word25 word26 word27 word28 word29 word30 word31 word32 word33 word34 word35 word36 word37 word38 word39 word40 word41 word42 word43 word44 word45 word46 word47 word48 word49 word50 word51 word52 word53 word54 word55 word56 word57 word58 word59 word60 word61 word62 word63 word64 word65 word66 word67 word68 word69 word70 word71 word72 word73 word74 word75 word76 word77 word78 word79")
+EXPECTED_RESULT+=("[INFO]: ---")
 EXPECTED_RESULT+=("[INFO]: Header: Кириллический заголовок")
 EXPECTED_RESULT+=("[INFO]: TODO-keyword: TODO")
 EXPECTED_RESULT+=("[INFO]: Tag: (null)")
 EXPECTED_RESULT+=("[INFO]: Priority: no priority")
 EXPECTED_RESULT+=("[INFO]: Text: (null)")
 EXPECTED_RESULT+=("[INFO]: ---")
+EXPECTED_RESULT+=("[INFO]: Header: Header with angle brackets")
+EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
+EXPECTED_RESULT+=("[INFO]: Tag: (null)")
+EXPECTED_RESULT+=("[INFO]: Priority: no priority")
+EXPECTED_RESULT+=("[INFO]: Text: See <v1.2> and <file.txt>")
+EXPECTED_RESULT+=("[INFO]: ---")
 EXPECTED_RESULT+=("[INFO]: Header: Header with date")
 EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
 EXPECTED_RESULT+=("[INFO]: Tag: (null)")
@@ -111,6 +127,14 @@ EXPECTED_RESULT+=("[INFO]: Text: (null)")
 EXPECTED_RESULT+=("[INFO]: Time: Tue Jan 30 23:59:00 2024")
 EXPECTED_RESULT+=("[INFO]: Repeater interval: +1d")
 EXPECTED_RESULT+=("[INFO]: ---")
+EXPECTED_RESULT+=("[INFO]: Header: Header with leap day, repeater and delay")
+EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
+EXPECTED_RESULT+=("[INFO]: Tag: (null)")
+EXPECTED_RESULT+=("[INFO]: Priority: no priority")
+EXPECTED_RESULT+=("[INFO]: Text: (null)")
+EXPECTED_RESULT+=("[INFO]: Time: Thu Feb 29 10:05:00 2024")
+EXPECTED_RESULT+=("[INFO]: Repeater interval: +2m")
+EXPECTED_RESULT+=("[INFO]: ---")
 EXPECTED_RESULT+=("[INFO]: Header: Header with range")
 EXPECTED_RESULT+=("[INFO]: TODO-keyword: no keyword")
 EXPECTED_RESULT+=("[INFO]: Tag: (null)")
@@ -129,7 +153,7 @@ EXPECTED_RESULT+=("[INFO]: Repeater interval: +1w")
 
 mapfile -t ACTUAL_RESULT < <(./parser_test "$TEST_ORG" 2>&1)
 
-for index in $(seq 0 117); do
+for index in $(seq 0 139); do
     echo "${ACTUAL_RESULT[$index]}" | \
         sed -r 's/.+(\[.+)$/\1/g' | \
         grep -Fxq -- "${EXPECTED_RESULT[$index]}"
@@ -149,6 +173,8 @@ First text line
 Second text line
 
 Last text line
+* Broken header :tag: with words after tag
+Text of broken header
 * Header with tag and with text below                              :testtag2:
 First text line
 Last text line
@@ -166,13 +192,19 @@ Some text for header with:
 - tag
 - priority
 - text
+* Header with long line
+word00 word01 word02 word03 word04 word05 word06 word07 word08 word09 word10 word11 word12 word13 word14 word15 word16 word17 word18 word19 word20 word21 word22 word23 word24 word25 word26 word27 word28 word29 word30 word31 word32 word33 word34 word35 word36 word37 word38 word39 word40 word41 word42 word43 word44 word45 word46 word47 word48 word49 word50 word51 word52 word53 word54 word55 word56 word57 word58 word59 word60 word61 word62 word63 word64 word65 word66 word67 word68 word69 word70 word71 word72 word73 word74 word75 word76 word77 word78 word79
 * TODO Кириллический заголовок
+* Header with angle brackets
+See <v1.2> and <file.txt>
 * Header with date
 SCHEDULED: <2024-01-30 Tue>
 * Header with date and time
 DEADLINE: <2024-01-30 Tue 23:59>
 * Header with repetitive interval
 SCHEDULED: <2024-01-30 Tue 23:59 +1d>
+* Header with leap day, repeater and delay
+DEADLINE: <2024-02-29 Thu 10:05 .+2m -1d>
 * Header with range
 SCHEDULED: <2024-01-30 Tue 23:00-23:59>
 * Header with range and repetitive interval
@@ -55,6 +55,12 @@ int main(int argc, char * argv[])
 		log_write(LOG_INFO, "ID: %d", categories->ids[i]);
 	}
 
+	/* Category IDs are positions of categories, not their unique IDs */
+	log_write(LOG_INFO, "ID of GHI: %d", pdb_category_get_id(pdb, "GHI"));
+	log_write(LOG_INFO, "ID of NEW2: %d", pdb_category_get_id(pdb, "NEW2"));
+	log_write(LOG_INFO, "ID of deleted ABC: %d",
+			  pdb_category_get_id(pdb, "ABC"));
+
 	pdb_free(pdb);
 	pdb_close(fd);
 	log_close();
@@ -34,7 +34,8 @@ int main(int argc, char * argv[])
 		log_write(LOG_ERR, "Failed to write new record #2");
 		return 1;
 	}
-	if(pdb_record_delete(pdb, pdb_record_get_unique_id(record)))
+	uint32_t deletedId = pdb_record_get_unique_id(record);
+	if(pdb_record_delete(pdb, deletedId))
 	{
 		log_write(LOG_ERR, "Failed to delete record #1");
 		return 1;
@@ -43,7 +44,7 @@ int main(int argc, char * argv[])
 	log_write(LOG_INFO, "Application info offset: 0x%02x", pdb->appInfoOffset);
 	log_write(LOG_INFO, "Qty of records: %d", pdb->recordsQty);
 
-	TAILQ_FOREACH(record, &pdb->records, pointers)
+	PDB_RECORD_FOREACH(record, pdb)
 	{
 		log_write(LOG_INFO, "Offset: 0x%08x", record->offset);
 		log_write(LOG_INFO, "Attribute: 0x%02x", record->attributes);
@@ -51,6 +52,19 @@ int main(int argc, char * argv[])
 				  record->id[0], record->id[1], record->id[2]);
 	}
 
+	/* Walk back from the last record over deleted one */
+	record = pdb_record_last(pdb);
+	log_write(LOG_INFO, "Last attribute: 0x%02x", record->attributes);
+	record = pdb_record_prev(pdb, record);
+	log_write(LOG_INFO, "Previous attribute: 0x%02x", record->attributes);
+
+	/* Search records by unique ID */
+	log_write(LOG_INFO, "Deleted record found: %d",
+			  pdb_record_get(pdb, deletedId) != NULL);
+	record = pdb_record_get(pdb, 0x54a056);
+	log_write(LOG_INFO, "Record 0x54a056 attribute: 0x%02x",
+			  record != NULL ? record->attributes : 0);
+
 	pdb_free(pdb);
 	pdb_close(fd);
 	log_close();
@@ -53,7 +53,7 @@ int main(int argc, char * argv[])
 	log_write(LOG_INFO, "Qty of records: %d", pdb2->recordsQty);
 
 	PDBRecord * record;
-	TAILQ_FOREACH(record, &pdb2->records, pointers)
+	PDB_RECORD_FOREACH(record, pdb2)
 	{
 		log_write(LOG_INFO, "Offset: 0x%08x", record->offset);
 		log_write(LOG_INFO, "Attribute: 0x%02x", record->attributes);
@@ -71,6 +71,19 @@ int main(int argc, char * argv[])
 		log_write(LOG_INFO, "ID: %d", categories->ids[i]);
 	}
 
+	size_t appInfoLength;
+	pdb_app_info_data(pdb2, &appInfoLength);
+	log_write(LOG_INFO, "Application info length: %lu", appInfoLength);
+
+	PDB header;
+	if(pdb_read_header(fd, &header))
+	{
+		return 1;
+	}
+	log_write(LOG_INFO, "Header modification number: %d",
+			  header.modificationNumber);
+	log_write(LOG_INFO, "Header modification datetime: %lu", header.mtime);
+
 	pdb_close(fd);
 	pdb_free(pdb2);
 	log_close();
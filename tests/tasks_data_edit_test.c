@@ -52,7 +52,7 @@ int main(int argc, char * argv[])
 		log_write(LOG_ERR, "Failed to get task [1]");
 		return 1;
 	}
-	if(tasks_task_set_due(task, 2025, 5, 11))
+	if(tasks_task_set_due(tasks, task, 2025, 5, 11))
 	{
 		log_write(LOG_ERR, "Failed to set due date");
 		return 1;
@@ -62,7 +62,7 @@ int main(int argc, char * argv[])
 		.alarmMinute = 11,
 		.daysEarlier = 2
 	};
-	if(tasks_task_set_alarm(task, &alarm))
+	if(tasks_task_set_alarm(tasks, task, &alarm))
 	{
 		log_write(LOG_ERR, "Failed to set alarm");
 		return 1;
@@ -74,7 +74,7 @@ int main(int argc, char * argv[])
 		.year = 2025,
 		.interval = 3
 	};
-	if(tasks_task_set_repeat(task, &repeat))
+	if(tasks_task_set_repeat(tasks, task, &repeat))
 	{
 		log_write(LOG_ERR, "Failed to set repeat data");
 		return 1;